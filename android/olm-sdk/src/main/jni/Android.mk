@@ -33,6 +33,7 @@ LOCAL_SRC_FILES := $(SRC_ROOT_DIR)/src/account.cpp \
 $(SRC_ROOT_DIR)/src/base64.cpp \
 $(SRC_ROOT_DIR)/src/cipher.cpp \
 $(SRC_ROOT_DIR)/src/crypto.cpp \
+$(SRC_ROOT_DIR)/src/key_store.cpp \
 $(SRC_ROOT_DIR)/src/memory.cpp \
 $(SRC_ROOT_DIR)/src/message.cpp \
 $(SRC_ROOT_DIR)/src/olm.cpp \
@@ -41,13 +42,18 @@ $(SRC_ROOT_DIR)/src/ratchet.cpp \
 $(SRC_ROOT_DIR)/src/session.cpp \
 $(SRC_ROOT_DIR)/src/utility.cpp \
 $(SRC_ROOT_DIR)/src/pk.cpp \
+$(SRC_ROOT_DIR)/src/parallel.cpp \
 $(SRC_ROOT_DIR)/src/sas.c \
+$(SRC_ROOT_DIR)/src/aes_ni.c \
+$(SRC_ROOT_DIR)/src/cpu.c \
+$(SRC_ROOT_DIR)/src/sha256_hw.c \
 $(SRC_ROOT_DIR)/src/ed25519.c \
 $(SRC_ROOT_DIR)/src/error.c \
 $(SRC_ROOT_DIR)/src/inbound_group_session.c \
 $(SRC_ROOT_DIR)/src/megolm.c \
 $(SRC_ROOT_DIR)/src/outbound_group_session.c \
 $(SRC_ROOT_DIR)/src/pickle_encoding.c \
+$(SRC_ROOT_DIR)/src/session_archive.c \
 $(SRC_ROOT_DIR)/lib/crypto-algorithms/sha256.c \
 $(SRC_ROOT_DIR)/lib/crypto-algorithms/aes.c \
 $(SRC_ROOT_DIR)/lib/curve25519-donna/curve25519-donna.c \
@@ -0,0 +1,140 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/crypto.h"
+
+#include "ed25519/src/ed25519.h"
+#include "curve25519-donna.h"
+
+#include "bench.hh"
+
+#include <cstring>
+
+/* Time the curve25519 and ed25519 operations behind session setup and
+ * signature checks. */
+int main() {
+#ifdef ED25519_FE51
+    std::cout << "field backend: radix 2^51" << std::endl;
+#else
+    std::cout << "field backend: radix 2^25.5" << std::endl;
+#endif
+
+    std::uint8_t random[32];
+    for (std::size_t i = 0; i < sizeof(random); ++i) {
+        random[i] = std::uint8_t(i * 7 + 1);
+    }
+
+    _olm_curve25519_key_pair alice, bob;
+    _olm_crypto_curve25519_generate_key(random, &alice);
+    random[0] ^= 1;
+    _olm_crypto_curve25519_generate_key(random, &bob);
+
+    std::uint8_t secret[CURVE25519_SHARED_SECRET_LENGTH];
+    double donna = benchmark("curve25519_donna (32-bit limbs)", [&]() {
+        ::curve25519_donna(
+            secret, alice.private_key.private_key, bob.public_key.public_key
+        );
+    });
+    double shared = benchmark("_olm_crypto_curve25519_shared_secret", [&]() {
+        _olm_crypto_curve25519_shared_secret(&alice, &bob.public_key, secret);
+    });
+    std::cout << "  speedup over donna: " << std::setprecision(2)
+        << donna / shared << "x" << std::endl;
+    double generate = benchmark("_olm_crypto_curve25519_generate_key", [&]() {
+        _olm_crypto_curve25519_generate_key(random, &alice);
+    });
+    std::cout << "  speedup over shared secret: " << std::setprecision(2)
+        << shared / generate << "x" << std::endl;
+
+    /* the first call also builds the fixed-base table when the library is
+     * configured with OLM_ED25519_BASE_WINDOW */
+    _olm_ed25519_key_pair signing;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    _olm_crypto_ed25519_generate_key(random, &signing);
+    std::cout << std::left << std::setw(48) << "first _olm_crypto_ed25519_generate_key"
+        << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+        << std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start
+        ).count() << " ns" << std::endl;
+    std::uint8_t message[128];
+    std::memset(message, 'm', sizeof(message));
+    std::uint8_t signature[ED25519_SIGNATURE_LENGTH];
+
+    benchmark("_olm_crypto_ed25519_generate_key", [&]() {
+        _olm_crypto_ed25519_generate_key(random, &signing);
+    });
+    benchmark("_olm_crypto_ed25519_sign (128 bytes)", [&]() {
+        _olm_crypto_ed25519_sign(
+            &signing, message, sizeof(message), signature
+        );
+    });
+    double single = benchmark("_olm_crypto_ed25519_verify (128 bytes)", [&]() {
+        _olm_crypto_ed25519_verify(
+            &signing.public_key, message, sizeof(message), signature
+        );
+    });
+    _olm_ed25519_prepared_public_key prepared;
+    _olm_crypto_ed25519_prepare_public_key(&signing.public_key, &prepared);
+    double verify_prepared = benchmark(
+        "_olm_crypto_ed25519_verify_prepared (128 bytes)", [&]() {
+            _olm_crypto_ed25519_verify_prepared(
+                &prepared, message, sizeof(message), signature
+            );
+        }
+    );
+    std::cout << "  speedup over single: " << std::setprecision(2)
+        << single / verify_prepared << "x" << std::endl;
+
+    /* 64 messages from one sender, as when backfilling a megolm session,
+     * and 64 messages from different senders */
+    const std::size_t batch = 64;
+    static std::uint8_t messages[batch][128];
+    static std::uint8_t signatures[batch][ED25519_SIGNATURE_LENGTH];
+    static _olm_ed25519_key_pair signers[batch];
+    _olm_ed25519_public_key const * keys[batch];
+    std::uint8_t const * message_pointers[batch];
+    std::size_t message_lengths[batch];
+    std::uint8_t const * signature_pointers[batch];
+    int results[batch];
+    for (std::size_t i = 0; i < batch; ++i) {
+        random[1] = std::uint8_t(i);
+        _olm_crypto_ed25519_generate_key(random, &signers[i]);
+        std::memset(messages[i], int(i), sizeof(messages[i]));
+        message_pointers[i] = messages[i];
+        message_lengths[i] = sizeof(messages[i]);
+        signature_pointers[i] = signatures[i];
+    }
+    for (int distinct = 0; distinct < 2; ++distinct) {
+        for (std::size_t i = 0; i < batch; ++i) {
+            _olm_ed25519_key_pair const & signer = distinct ? signers[i] : signing;
+            _olm_crypto_ed25519_sign(
+                &signer, messages[i], sizeof(messages[i]), signatures[i]
+            );
+            keys[i] = &signer.public_key;
+        }
+        double batched = benchmark(
+            distinct
+                ? "_olm_crypto_ed25519_verify_batch (64 keys)"
+                : "_olm_crypto_ed25519_verify_batch (1 key)",
+            [&]() {
+                _olm_crypto_ed25519_verify_batch(
+                    batch, keys, message_pointers, message_lengths,
+                    signature_pointers, results
+                );
+            }, batch
+        );
+        std::cout << "  speedup over single: " << std::setprecision(2)
+            << single / batched << "x" << std::endl;
+    }
+}
@@ -0,0 +1,135 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/crypto.h"
+#include "olm/olm.h"
+#include "olm/parallel.hh"
+
+#include "bench.hh"
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Job {
+    std::uint8_t const * random;
+    _olm_curve25519_key_pair * key_pairs;
+};
+
+void generate_range(std::size_t begin, std::size_t end, void * context) {
+    Job const & job = *static_cast<Job *>(context);
+    _olm_curve25519_key_pair * pointers[16];
+    while (begin != end) {
+        std::size_t count = end - begin < 16 ? end - begin : 16;
+        for (std::size_t i = 0; i < count; ++i) {
+            pointers[i] = &job.key_pairs[begin + i];
+        }
+        _olm_crypto_curve25519_generate_keys(
+            count, job.random + begin * CURVE25519_RANDOM_LENGTH, pointers
+        );
+        begin += count;
+    }
+}
+
+/* the account clears the random bytes it is given, so refill them for each
+ * call to keep the keys distinct */
+void fill_random(std::vector<std::uint8_t> & random, std::uint32_t & seed) {
+    for (std::size_t i = 0; i < random.size(); ++i) {
+        seed = seed * 1103515245 + 12345;
+        random[i] = std::uint8_t(seed >> 16);
+    }
+}
+
+void keys_per_second(double ns_per_key) {
+    std::cout << "  " << std::fixed << std::setprecision(0)
+        << 1e9 / ns_per_key << " keys/s" << std::endl;
+}
+
+} // namespace
+
+/* Throughput of one time key generation: one key at a time, batched, and
+ * batched across threads. The thread count defaults to the number of CPUs
+ * and can be given as the first argument. */
+int main(int argc, char ** argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    if (argc > 1) {
+        threads = unsigned(std::atoi(argv[1]));
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    std::cout << "threads: " << threads << std::endl;
+
+    std::size_t const sizes[] = {100, 1000, 10000};
+    for (std::size_t count : sizes) {
+        std::vector<std::uint8_t> random(count * CURVE25519_RANDOM_LENGTH);
+        for (std::size_t i = 0; i < random.size(); ++i) {
+            random[i] = std::uint8_t(i * 31 + 7);
+        }
+        std::vector<_olm_curve25519_key_pair> key_pairs(count);
+        Job job = {random.data(), key_pairs.data()};
+        std::string label = " x" + std::to_string(count);
+
+        keys_per_second(benchmark(("one at a time" + label).c_str(), [&]() {
+            for (std::size_t i = 0; i < count; ++i) {
+                _olm_crypto_curve25519_generate_key(
+                    random.data() + i * CURVE25519_RANDOM_LENGTH, &key_pairs[i]
+                );
+            }
+        }, count));
+        keys_per_second(benchmark(("batched" + label).c_str(), [&]() {
+            generate_range(0, count, &job);
+        }, count));
+        keys_per_second(benchmark(("batched, threaded" + label).c_str(), [&]() {
+            olm::parallel_for(count, threads, generate_range, &job);
+        }, count));
+    }
+
+    /* through an account with room for all the keys */
+    std::vector<std::uint8_t> account_buffer(
+        ::olm_account_size_with_capacity(10000)
+    );
+    ::OlmAccount * account = ::olm_account_with_capacity(
+        account_buffer.data(), 10000
+    );
+    std::vector<std::uint8_t> random(::olm_create_account_random_length(account));
+    ::olm_create_account(account, random.data(), random.size());
+    std::uint32_t seed = 1;
+    for (std::size_t count : sizes) {
+        random.resize(
+            ::olm_account_generate_one_time_keys_random_length(account, count)
+        );
+        std::string label = " x" + std::to_string(count);
+        keys_per_second(benchmark(
+            ("olm_account_generate_one_time_keys" + label).c_str(), [&]() {
+                fill_random(random, seed);
+                ::olm_account_generate_one_time_keys(
+                    account, count, random.data(), random.size()
+                );
+            }, count
+        ));
+        keys_per_second(benchmark(
+            ("olm_account_generate_one_time_keys_parallel" + label).c_str(),
+            [&]() {
+                fill_random(random, seed);
+                ::olm_account_generate_one_time_keys_parallel(
+                    account, count, random.data(), random.size(), threads
+                );
+            }, count
+        ));
+    }
+}
@@ -0,0 +1,85 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/crypto.h"
+#include "olm/cpu.h"
+#include "olm/sha256_hw.h"
+
+extern "C" {
+#include "crypto-algorithms/sha256.h"
+}
+
+#include "bench.hh"
+
+#include <cstring>
+
+/* Time per SHA-256 compression for each backend, then for the operations
+ * built on top of it. */
+int main() {
+    static std::uint8_t data[64 * 16];
+    for (std::size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = std::uint8_t(i);
+    }
+    std::uint32_t state[8] = {};
+
+    double portable = benchmark("compression, portable", [&]() {
+        ::sha256_blocks_portable(state, data, 1);
+    });
+    benchmark("compression x16, portable", [&]() {
+        ::sha256_blocks_portable(state, data, 16);
+    }, 16);
+
+    unsigned int features = _olm_cpu_features();
+    if (features & OLM_CPU_AVX2) {
+        double avx2 = benchmark("compression, AVX2", [&]() {
+            _olm_sha256_blocks_avx2(state, data, 1);
+        });
+        double avx2_16 = benchmark("compression x16, AVX2", [&]() {
+            _olm_sha256_blocks_avx2(state, data, 16);
+        }, 16);
+        std::cout << "  AVX2 speedup: " << std::setprecision(2)
+            << portable / avx2 << "x single, "
+            << portable / avx2_16 << "x bulk" << std::endl;
+    }
+    if ((features & OLM_CPU_SHA) && (features & OLM_CPU_SSE41)) {
+        double shani = benchmark("compression, SHA-NI", [&]() {
+            _olm_sha256_blocks_shani(state, data, 1);
+        });
+        std::cout << "  SHA-NI speedup: " << std::setprecision(2)
+            << portable / shani << "x" << std::endl;
+    }
+
+    std::uint8_t output[32];
+    std::uint8_t key[32] = {1};
+    benchmark("_olm_crypto_sha256 (32 bytes)", [&]() {
+        _olm_crypto_sha256(data, 32, output);
+    });
+    benchmark("_olm_crypto_hmac_sha256 (1 byte)", [&]() {
+        _olm_crypto_hmac_sha256(key, sizeof(key), data, 1, output);
+    });
+    _olm_hmac_sha256_key prepared_key;
+    _olm_crypto_hmac_sha256_prepare(key, sizeof(key), &prepared_key);
+    benchmark("_olm_crypto_hmac_sha256_prepared (1 byte)", [&]() {
+        _olm_crypto_hmac_sha256_prepared(&prepared_key, data, 1, output);
+    });
+    benchmark("_olm_crypto_hmac_sha256 (1 KiB)", [&]() {
+        _olm_crypto_hmac_sha256(key, sizeof(key), data, 1024, output);
+    });
+    std::uint8_t derived[80];
+    benchmark("_olm_crypto_hkdf_sha256 (80 bytes)", [&]() {
+        _olm_crypto_hkdf_sha256(
+            key, sizeof(key), NULL, 0, data, 6, derived, sizeof(derived)
+        );
+    });
+}
@@ -0,0 +1,52 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+/* Runs `operation` repeatedly for at least `min_seconds` and prints the mean
+ * time per call. `operations_per_call` scales the result when one call does
+ * several units of work, e.g. compresses several blocks. */
+template<typename F>
+double benchmark(
+    char const * name, F operation,
+    std::size_t operations_per_call = 1, double min_seconds = 0.5
+) {
+    typedef std::chrono::steady_clock clock;
+    /* warm up, which also lets lazy CPU feature detection happen */
+    operation();
+
+    std::size_t calls = 0;
+    std::size_t batch = 1;
+    clock::time_point start = clock::now();
+    double elapsed;
+    for (;;) {
+        for (std::size_t i = 0; i < batch; ++i) {
+            operation();
+        }
+        calls += batch;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        if (elapsed >= min_seconds) {
+            break;
+        }
+        batch *= 2;
+    }
+    double ns = elapsed * 1e9 / (double(calls) * operations_per_call);
+    std::cout << std::left << std::setw(48) << name
+        << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+        << ns << " ns/op" << std::endl;
+    return ns;
+}
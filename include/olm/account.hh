@@ -15,7 +15,7 @@
 #ifndef OLM_ACCOUNT_HH_
 #define OLM_ACCOUNT_HH_
 
-#include "olm/list.hh"
+#include "olm/key_store.hh"
 #include "olm/crypto.h"
 #include "olm/error.h"
 
@@ -29,23 +29,37 @@ struct IdentityKeys {
     _olm_curve25519_key_pair curve25519_key;
 };
 
-struct OneTimeKey {
-    std::uint32_t id;
-    bool published;
-    _olm_curve25519_key_pair key;
-};
-
-
-static std::size_t const MAX_ONE_TIME_KEYS = 100;
 
+/** What an account was like when it was last pickled or unpickled, in full or
+ * as a delta. A delta pickle holds the changes since then. */
+struct AccountJournal {
+    /** The number of deltas since the last full pickle */
+    std::uint32_t sequence;
+    /** The next_one_time_key_id. The one time keys with lower ids were in the
+     * account then, and the ones since have higher ids. */
+    std::uint32_t next_one_time_key_id;
+    /** The public identity keys */
+    std::uint8_t identity_keys[ED25519_PUBLIC_KEY_LENGTH + CURVE25519_KEY_LENGTH];
+};
 
 struct Account {
+    /** An account holding up to MAX_ONE_TIME_KEYS one time keys */
     Account();
+    /** An account holding up to capacity one time keys. If capacity is more
+     * than MAX_ONE_TIME_KEYS then the keys are kept in the
+     * OneTimeKeyStore::storage_size(capacity) bytes at storage. */
+    Account(void * storage, std::size_t capacity);
+    Account(Account const &) = delete;
+    Account & operator=(Account const &) = delete;
+
     IdentityKeys identity_keys;
-    List<OneTimeKey, MAX_ONE_TIME_KEYS> one_time_keys;
+    OneTimeKeyStore one_time_keys;
     std::uint32_t next_one_time_key_id;
     OlmErrorCode last_error;
 
+    /** The base for the next delta pickle. It isn't pickled. */
+    AccountJournal journal;
+
     /** Number of random bytes needed to create a new account */
     std::size_t new_account_random_length();
 
@@ -126,6 +140,14 @@ struct Account {
         std::uint8_t const * random, std::size_t random_length
     );
 
+    /** As generate_one_time_keys, but splits the work across up to `threads`
+     * threads. Produces the same keys as the single-threaded version. */
+    std::size_t generate_one_time_keys(
+        std::size_t number_of_keys,
+        std::uint8_t const * random, std::size_t random_length,
+        unsigned threads
+    );
+
     /** Lookup a one time key with the given public key */
     OneTimeKey const * lookup_key(
         _olm_curve25519_public_key const & public_key
@@ -135,6 +157,11 @@ struct Account {
     std::size_t remove_key(
         _olm_curve25519_public_key const & public_key
     );
+
+private:
+    alignas(OneTimeKey) std::uint8_t default_storage[
+        OneTimeKeyStore::storage_size(MAX_ONE_TIME_KEYS)
+    ];
 };
 
 
@@ -155,6 +182,36 @@ std::uint8_t const * unpickle(
 );
 
 
+/** Make the current state of the account the base for the next delta pickle,
+ * as pickling or unpickling it in full does. */
+void reset_journal(
+    Account & value
+);
+
+
+std::size_t pickle_delta_length(
+    Account const & value
+);
+
+
+/** Pickle the changes to the account since it was last pickled or
+ * unpickled, in full or as a delta, and make its current state the base for
+ * the next delta. The one time keys from before are pickled by id alone. */
+std::uint8_t * pickle_delta(
+    std::uint8_t * pos,
+    Account & value
+);
+
+
+/** Apply a delta pickle to an account in the state the delta was taken from.
+ * Sets last_error to BAD_PICKLE_DELTA and returns end if it is in any other
+ * state. */
+std::uint8_t const * unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    Account & value
+);
+
+
 } // namespace olm
 
 #endif /* OLM_ACCOUNT_HH_ */
@@ -0,0 +1,101 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* AES-256 using the x86 AES-NI instructions. These functions must only be
+ * called if _olm_aes_ni_supported() returns true. They work on whole blocks;
+ * padding is left to the caller.
+ */
+
+#ifndef OLM_AES_NI_H_
+#define OLM_AES_NI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** number of round keys in an AES-256 key schedule */
+#define AES_NI_ROUND_KEYS 15
+
+/** length of an AES block */
+#define AES_NI_BLOCK_LENGTH 16
+
+/** Expanded AES-256 round keys for encryption and decryption */
+struct _olm_aes_ni_key {
+    uint8_t encrypt[AES_NI_ROUND_KEYS][AES_NI_BLOCK_LENGTH];
+    uint8_t decrypt[AES_NI_ROUND_KEYS][AES_NI_BLOCK_LENGTH];
+};
+
+/** Returns non-zero if this build and the CPU we are running on support the
+ * AES-NI code path */
+int _olm_aes_ni_supported(void);
+
+/** Expands a 32 byte AES-256 key into its encryption and decryption round
+ * keys. */
+void _olm_aes_ni_key_setup(
+    uint8_t const * key,
+    struct _olm_aes_ni_key * expanded_key
+);
+
+/** Encrypts whole blocks with AES-256 in CBC mode. iv is updated to the last
+ * ciphertext block so that a following call continues the chain. input and
+ * output may be the same buffer. */
+void _olm_aes_ni_encrypt_cbc(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t * iv,
+    uint8_t const * input, size_t blocks,
+    uint8_t * output
+);
+
+/** Decrypts whole blocks with AES-256 in CBC mode, working on several
+ * blocks at once. input and output may be the same buffer. */
+void _olm_aes_ni_decrypt_cbc(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t const * iv,
+    uint8_t const * input, size_t blocks,
+    uint8_t * output
+);
+
+/** Encrypts or decrypts length bytes with AES-256 in the counter mode that
+ * GCM uses: the last 4 bytes of counter are a big-endian block number, which
+ * wraps without carrying into the rest. counter is updated past the blocks
+ * used, so length need not be a whole number of blocks. input and output may
+ * be the same buffer. */
+void _olm_aes_ni_encrypt_ctr32(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t * counter,
+    uint8_t const * input, size_t length,
+    uint8_t * output
+);
+
+/** Returns non-zero if this build and the CPU we are running on also
+ * support the PCLMUL and SSSE3 instructions that _olm_aes_ni_ghash uses */
+int _olm_aes_ni_ghash_supported(void);
+
+/** Updates the GCM hash state with whole blocks of input, using carry-less
+ * multiplication. hash_key is H, the encryption of the zero block. */
+void _olm_aes_ni_ghash(
+    uint8_t const * hash_key,
+    uint8_t * state,
+    uint8_t const * input, size_t blocks
+);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_AES_NI_H_ */
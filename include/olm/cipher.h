@@ -92,8 +92,39 @@ struct _olm_cipher_ops {
         uint8_t const * ciphertext, size_t ciphertext_length,
         uint8_t * plaintext, size_t max_plaintext_length
     );
+
+    /**
+     * Returns the length of the keys that derive_keys writes. This is at most
+     * OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH.
+     */
+    size_t (*derived_keys_length)(const struct _olm_cipher *cipher);
+
+    /**
+     * Derives the keys that decrypt uses from the key material, so that they
+     * can be kept and passed to decrypt_derived for later messages with the
+     * same key.
+     */
+    void (*derive_keys)(
+        const struct _olm_cipher *cipher,
+        uint8_t const * key, size_t key_length,
+        uint8_t * derived_keys
+    );
+
+    /**
+     * As decrypt, but with keys from derive_keys instead of the key material.
+     */
+    size_t (*decrypt_derived)(
+        const struct _olm_cipher *cipher,
+        uint8_t const * derived_keys,
+        uint8_t const * input, size_t input_length,
+        uint8_t const * ciphertext, size_t ciphertext_length,
+        uint8_t * plaintext, size_t max_plaintext_length
+    );
 };
 
+/** the most that derived_keys_length returns for any cipher */
+#define OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH 80
+
 struct _olm_cipher {
     const struct _olm_cipher_ops *ops;
     /* cipher-specific fields follow */
@@ -103,7 +134,9 @@ struct _olm_cipher_aes_sha_256 {
     struct _olm_cipher base_cipher;
 
     /** context string for the HKDF used for deriving the AES256 key, HMAC key,
-     * and AES IV, from the key material passed to encrypt/decrypt.
+     * and AES IV, from the key material passed to encrypt/decrypt. derive_keys
+     * writes the 32 byte AES256 key, the 32 byte HMAC key and the 16 byte AES
+     * IV, in that order.
      */
     uint8_t const * kdf_info;
 
@@ -131,6 +164,72 @@ extern const struct _olm_cipher_ops _olm_cipher_aes_sha_256_ops;
     (&((CIPHER)->base_cipher))
 
 
+/**
+ * AES-256-GCM. The AES key and a nonce key are derived from the key material
+ * with HKDF. The nonce is synthetic: the first 12 bytes of an HMAC-SHA-256,
+ * keyed with the HMAC of the associated data under the nonce key, of the
+ * plain-text. So equal inputs give equal outputs, but a nonce is never reused
+ * for different ones. The "mac" is the nonce followed by the 16 byte tag.
+ *
+ * Everything in the output or input buffer before the cipher-text is
+ * authenticated as associated data, and the cipher-text must end where the
+ * mac starts. decrypt checks the tag before writing any plain-text, so a
+ * failed decryption leaves an in-place buffer as it was.
+ */
+struct _olm_cipher_aes_gcm {
+    struct _olm_cipher base_cipher;
+
+    /** context string for the HKDF used for deriving the AES256 key and the
+     * nonce key from the key material passed to encrypt/decrypt. derive_keys
+     * writes the 32 byte AES256 key and the 32 byte nonce key, in that order.
+     */
+    uint8_t const * kdf_info;
+
+    /** length of context string kdf_info */
+    size_t kdf_info_length;
+};
+
+extern const struct _olm_cipher_ops _olm_cipher_aes_gcm_ops;
+
+/**
+ * get an initializer for an instance of struct _olm_cipher_aes_gcm, used as
+ * OLM_CIPHER_INIT_AES_SHA_256 is.
+ */
+#define OLM_CIPHER_INIT_AES_GCM(KDF_INFO) {             \
+    /*.base_cipher = */{ &_olm_cipher_aes_gcm_ops },    \
+    /*.kdf_info = */(uint8_t *)(KDF_INFO),              \
+    /*.kdf_info_length = */sizeof(KDF_INFO) - 1         \
+}
+
+struct _olm_aes256_gcm_key;
+struct _olm_hmac_sha256_key;
+
+/**
+ * Encrypts as _olm_cipher_aes_gcm_ops does, with keys that have already been
+ * prepared: gcm_key from the AES256 key, and data_key from the HMAC of the
+ * associated data under the nonce key. One data_key therefore serves every
+ * output with the same associated data.
+ */
+size_t _olm_cipher_aes_gcm_encrypt_prepared(
+    const struct _olm_aes256_gcm_key *gcm_key,
+    const struct _olm_hmac_sha256_key *data_key,
+    uint8_t const * plaintext, size_t plaintext_length,
+    uint8_t * ciphertext, size_t ciphertext_length,
+    uint8_t * output, size_t output_length
+);
+
+/**
+ * Decrypts as _olm_cipher_aes_gcm_ops does, with an AES256 key that has
+ * already been prepared.
+ */
+size_t _olm_cipher_aes_gcm_decrypt_prepared(
+    const struct _olm_aes256_gcm_key *gcm_key,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t * plaintext, size_t max_plaintext_length
+);
+
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
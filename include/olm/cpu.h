@@ -0,0 +1,61 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Runtime detection of the CPU features that have accelerated code paths. */
+
+#ifndef OLM_CPU_H_
+#define OLM_CPU_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Whether we know how to query and use x86 instruction set extensions with
+ * this compiler. On other targets _olm_cpu_features() always returns 0. */
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__GNUC__) || defined(__clang__))
+#define OLM_CPU_X86 1
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define OLM_CPU_X86 1
+#else
+#define OLM_CPU_X86 0
+#endif
+
+/** AES-NI instructions */
+#define OLM_CPU_AESNI 0x01
+/** carry-less multiplication */
+#define OLM_CPU_PCLMUL 0x02
+/** SSSE3 instructions */
+#define OLM_CPU_SSSE3 0x04
+/** SHA extensions */
+#define OLM_CPU_SHA 0x08
+/** AVX2 instructions, with the OS saving the YMM registers */
+#define OLM_CPU_AVX2 0x10
+/** SSE4.1 instructions */
+#define OLM_CPU_SSE41 0x20
+/** BMI2 instructions */
+#define OLM_CPU_BMI2 0x40
+
+/**
+ * Returns a bitmask of the OLM_CPU_* features supported by the CPU we are
+ * running on. The CPU is only queried on the first call.
+ */
+unsigned int _olm_cpu_features(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_CPU_H_ */
@@ -23,6 +23,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "olm/aes_ni.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -51,12 +53,27 @@ extern "C" {
 /** length of an Ed25519 signature */
 #define ED25519_SIGNATURE_LENGTH 64
 
+/** length of the precomputation kept for a prepared Ed25519 public key */
+#define ED25519_PREPARED_TABLE_LENGTH 1280
+
+/** length of the digest from _olm_crypto_ed25519_digest */
+#define ED25519_DIGEST_LENGTH 32
+
 /** length of an aes256 key */
 #define AES256_KEY_LENGTH 32
 
 /** length of an aes256 initialisation vector */
 #define AES256_IV_LENGTH 16
 
+/** number of words in a portable aes256 key schedule */
+#define AES256_KEY_SCHEDULE_LENGTH 60
+
+/** length of an AES-GCM initialisation vector */
+#define AES_GCM_IV_LENGTH 12
+
+/** length of an AES-GCM authentication tag */
+#define AES_GCM_TAG_LENGTH 16
+
 struct _olm_aes256_key {
     uint8_t key[AES256_KEY_LENGTH];
 };
@@ -65,6 +82,26 @@ struct _olm_aes256_iv {
     uint8_t iv[AES256_IV_LENGTH];
 };
 
+/** An aes256 key with its round keys already expanded, in the form used by
+ * whichever AES implementation was picked when it was prepared. */
+struct _olm_aes256_prepared_key {
+    /** non-zero if aes_ni_key is set rather than key_schedule */
+    uint8_t use_aes_ni;
+    union {
+        struct _olm_aes_ni_key aes_ni_key;
+        uint32_t key_schedule[AES256_KEY_SCHEDULE_LENGTH];
+    } round_keys;
+};
+
+/** An aes256 key prepared for GCM, with the hash key it implies */
+struct _olm_aes256_gcm_key {
+    struct _olm_aes256_prepared_key aes_key;
+    /** non-zero if GHASH uses carry-less multiplication */
+    uint8_t use_pclmul;
+    /** H, the encryption of the zero block */
+    uint8_t hash_key[16];
+};
+
 
 struct _olm_curve25519_public_key {
     uint8_t public_key[CURVE25519_KEY_LENGTH];
@@ -92,6 +129,15 @@ struct _olm_ed25519_key_pair {
     struct _olm_ed25519_private_key private_key;
 };
 
+/** An Ed25519 public key that has already been decompressed, together with
+ * the odd multiples of the point that signature checks use. */
+struct _olm_ed25519_prepared_public_key {
+    struct _olm_ed25519_public_key public_key;
+    /** zero if public_key is not a valid point; nothing then verifies */
+    uint8_t is_valid;
+    uint8_t table[ED25519_PREPARED_TABLE_LENGTH];
+};
+
 
 /** The length of output the aes_encrypt_cbc function will write */
 size_t _olm_crypto_aes_encrypt_cbc_length(
@@ -118,6 +164,60 @@ size_t _olm_crypto_aes_decrypt_cbc(
     uint8_t * output
 );
 
+/** Expands a key for use with the _prepared AES functions. */
+void _olm_crypto_aes_prepare_key(
+    const struct _olm_aes256_key *key,
+    struct _olm_aes256_prepared_key *prepared_key
+);
+
+/** As _olm_crypto_aes_encrypt_cbc, with a prepared key. */
+void _olm_crypto_aes_encrypt_cbc_prepared(
+    const struct _olm_aes256_prepared_key *prepared_key,
+    const struct _olm_aes256_iv *iv,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output
+);
+
+/** As _olm_crypto_aes_decrypt_cbc, with a prepared key. */
+size_t _olm_crypto_aes_decrypt_cbc_prepared(
+    const struct _olm_aes256_prepared_key *prepared_key,
+    const struct _olm_aes256_iv *iv,
+    uint8_t const * input, size_t input_length,
+    uint8_t * output
+);
+
+
+/** Prepares a key for use with the AES-GCM functions. */
+void _olm_crypto_aes_gcm_prepare_key(
+    const struct _olm_aes256_key *key,
+    struct _olm_aes256_gcm_key *gcm_key
+);
+
+/** Encrypts the input using AES256 in GCM mode (NIST SP 800-38D), also
+ * authenticating the additional data. The iv must be AES_GCM_IV_LENGTH (12)
+ * bytes long and must never be reused with the same key for a different
+ * input. Writes input_length bytes of output and AES_GCM_TAG_LENGTH (16)
+ * bytes of tag. input and output may be the same buffer. */
+void _olm_crypto_aes_gcm_encrypt(
+    const struct _olm_aes256_gcm_key *gcm_key,
+    uint8_t const * iv,
+    uint8_t const * additional_data, size_t additional_data_length,
+    uint8_t const * input, size_t input_length,
+    uint8_t * output, uint8_t * tag
+);
+
+/** Decrypts the input using AES256 in GCM mode. The tag is checked before
+ * anything is written, so on failure the output is untouched. Returns
+ * non-zero if the tag was valid. input and output may be the same buffer. */
+int _olm_crypto_aes_gcm_decrypt(
+    const struct _olm_aes256_gcm_key *gcm_key,
+    uint8_t const * iv,
+    uint8_t const * additional_data, size_t additional_data_length,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * tag,
+    uint8_t * output
+);
+
 
 /** Computes SHA-256 of the input. The output buffer must be a least
  * SHA256_OUTPUT_LENGTH (32) bytes long. */
@@ -137,6 +237,29 @@ void _olm_crypto_hmac_sha256(
 );
 
 
+/** An HMAC-SHA-256 key with the inner and outer padded key blocks already
+ * compressed, so that several HMACs with the same key need only compress the
+ * message and the inner hash. */
+struct _olm_hmac_sha256_key {
+    uint32_t inner_state[8];
+    uint32_t outer_state[8];
+};
+
+/** Prepares a key for use with _olm_crypto_hmac_sha256_prepared. */
+void _olm_crypto_hmac_sha256_prepare(
+    uint8_t const * key, size_t key_length,
+    struct _olm_hmac_sha256_key * prepared_key
+);
+
+/** Computes HMAC-SHA-256 of the input with a prepared key. The output buffer
+ * must be at least SHA256_OUTPUT_LENGTH (32) bytes long. */
+void _olm_crypto_hmac_sha256_prepared(
+    const struct _olm_hmac_sha256_key * prepared_key,
+    uint8_t const * input, size_t input_length,
+    uint8_t * output
+);
+
+
 /** HMAC-based Key Derivation Function (HKDF)
  * https://tools.ietf.org/html/rfc5869
  * Derives key material from the input bytes. */
@@ -157,6 +280,17 @@ void _olm_crypto_curve25519_generate_key(
 );
 
 
+/** Generate count curve25519 key pairs, the i-th from the 32 bytes at
+ * random + i * CURVE25519_RANDOM_LENGTH. Gives the same keys as calling
+ * _olm_crypto_curve25519_generate_key for each one, but shares the field
+ * inversions between the keys.
+ */
+void _olm_crypto_curve25519_generate_keys(
+    size_t count, uint8_t const * random,
+    struct _olm_curve25519_key_pair * const * outputs
+);
+
+
 /** Create a shared secret using our private key and their public key.
  * The output buffer must be at least CURVE25519_SHARED_SECRET_LENGTH (32) bytes long.
  */
@@ -193,6 +327,59 @@ int _olm_crypto_ed25519_verify(
     const uint8_t * signature
 );
 
+/** Decompress an ed25519 public key for use with
+ * _olm_crypto_ed25519_verify_prepared. */
+void _olm_crypto_ed25519_prepare_public_key(
+    const struct _olm_ed25519_public_key *key,
+    struct _olm_ed25519_prepared_public_key *prepared
+);
+
+/** As _olm_crypto_ed25519_verify, for a prepared key. This saves
+ * decompressing the key and building its table, just under a tenth of the
+ * cost of a check.
+ * Returns non-zero if the signature is valid. */
+int _olm_crypto_ed25519_verify_prepared(
+    const struct _olm_ed25519_prepared_public_key *their_key,
+    const uint8_t * message, size_t message_length,
+    const uint8_t * signature
+);
+
+/** Verify count ed25519 signatures together, which is several times faster
+ * than verifying them one at a time. Entry i checks signatures[i] (which must
+ * be ED25519_SIGNATURE_LENGTH bytes long) over messages[i] against
+ * their_keys[i]. results[i] is set to non-zero if that signature is valid.
+ * If the combined check fails the signatures are checked individually, so
+ * results[] always identifies the bad entries.
+ * Returns non-zero if every signature is valid. */
+int _olm_crypto_ed25519_verify_batch(
+    size_t count,
+    const struct _olm_ed25519_public_key * const * their_keys,
+    const uint8_t * const * messages, const size_t * message_lengths,
+    const uint8_t * const * signatures,
+    int * results
+);
+
+/** Hash a message for checking the signature over it against their_key
+ * later, with _olm_crypto_ed25519_verify_digest_batch, without keeping the
+ * message. The output buffer must be at least ED25519_DIGEST_LENGTH (32) bytes
+ * long. */
+void _olm_crypto_ed25519_digest(
+    const struct _olm_ed25519_public_key *their_key,
+    const uint8_t * message, size_t message_length,
+    const uint8_t * signature,
+    uint8_t * digest
+);
+
+/** As _olm_crypto_ed25519_verify_batch, with digests[i] from
+ * _olm_crypto_ed25519_digest in place of the messages. */
+int _olm_crypto_ed25519_verify_digest_batch(
+    size_t count,
+    const struct _olm_ed25519_public_key * const * their_keys,
+    const uint8_t * const * digests,
+    const uint8_t * const * signatures,
+    int * results
+);
+
 
 
 #ifdef __cplusplus
@@ -53,10 +53,40 @@ enum OlmErrorCode {
 
     OLM_INPUT_BUFFER_TOO_SMALL = 15,
 
-    // Not an error code, just here to pad out the enum past 16 because
-    // otherwise the compiler warns about a redunant check. If you're
-    // adding an error code, replace this one!
-    OLM_ERROR_NOT_INVENTED_YET = 16,
+    /**
+     * The pickled account has more one time keys than the account being
+     * unpickled into can hold.
+     */
+    OLM_KEY_STORE_TOO_SMALL = 16,
+
+    /**
+     * Decrypting the message would take more hash steps than the work budget
+     * set on the session allows.
+     */
+    OLM_WORK_BUDGET_EXCEEDED = 17,
+
+    /**
+     * There is no room left in the verification queue for the message's
+     * signature.
+     */
+    OLM_VERIFY_QUEUE_FULL = 18,
+
+    /**
+     * The delta pickle wasn't taken from the state the object is in: it is
+     * out of order, or follows a different full pickle.
+     */
+    OLM_BAD_PICKLE_DELTA = 19,
+
+    /**
+     * The session archive is truncated or its index points outside it, or
+     * the sessions written to it don't have distinct ids.
+     */
+    OLM_BAD_SESSION_ARCHIVE = 20,
+
+    /**
+     * The session archive has no session with the given id.
+     */
+    OLM_UNKNOWN_SESSION_ID = 21,
 
     /* remember to update the list of string constants in error.c when updating
      * this list. */
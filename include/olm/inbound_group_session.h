@@ -18,15 +18,38 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "olm/pickle_key.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct OlmInboundGroupSession OlmInboundGroupSession;
 
+typedef struct OlmGroupDecryptScratch OlmGroupDecryptScratch;
+
+typedef struct OlmGroupVerifyQueue OlmGroupVerifyQueue;
+
 /** get the size of an inbound group session, in bytes. */
 size_t olm_inbound_group_session_size(void);
 
+/**
+ * get the size of an inbound group session that keeps up to checkpoints
+ * copies of its ratchet, in bytes. Each takes 132 bytes, and capacities
+ * above 65536 are rounded down to it.
+ */
+size_t olm_inbound_group_session_size_with_checkpoints(size_t checkpoints);
+
+/**
+ * get the size of an inbound group session that keeps up to checkpoints
+ * copies of its ratchet and the keys of up to cached_keys messages, in bytes.
+ * Each cached key takes 120 bytes, and capacities above 1024 are rounded down
+ * to it.
+ */
+size_t olm_inbound_group_session_size_with_caches(
+    size_t checkpoints, size_t cached_keys
+);
+
 /**
  * Initialise an inbound group session object using the supplied memory
  * The supplied memory should be at least olm_inbound_group_session_size()
@@ -36,6 +59,43 @@ OlmInboundGroupSession * olm_inbound_group_session(
     void *memory
 );
 
+/**
+ * Initialise an inbound group session object that keeps up to checkpoints
+ * copies of its ratchet using the supplied memory. The supplied memory should
+ * be at least olm_inbound_group_session_size_with_checkpoints(checkpoints)
+ * bytes.
+ *
+ * A checkpoint is taken every 256 message indices passed while decrypting or
+ * exporting, overwriting the oldest one when they are all in use. Messages
+ * older than the latest one decrypted are then reached from the closest
+ * checkpoint, in at most 255 hash steps if the one for their block of 256
+ * indices is still kept, instead of up to 1020 from the earliest known
+ * ratchet value. Each costs extra hash steps, so with a work budget only
+ * as many are taken as it has room for. Checkpoints are not pickled: an
+ * unpickled session takes them again as it goes.
+ */
+OlmInboundGroupSession * olm_inbound_group_session_with_checkpoints(
+    void *memory, size_t checkpoints
+);
+
+/**
+ * Initialise an inbound group session object that keeps up to checkpoints
+ * copies of its ratchet, as olm_inbound_group_session_with_checkpoints(), and
+ * the keys of up to cached_keys recently decrypted messages, using the
+ * supplied memory. The supplied memory should be at least
+ * olm_inbound_group_session_size_with_caches(checkpoints, cached_keys) bytes.
+ *
+ * Decrypting a message whose index is in the cache skips the ratchet and key
+ * derivation, and if it is the same message that was last decrypted with
+ * that index, the signature check too. When the cache is full the least
+ * recently used keys are dropped. The cache is emptied by
+ * olm_clear_inbound_group_session() and when the session is unpickled, and
+ * is never pickled.
+ */
+OlmInboundGroupSession * olm_inbound_group_session_with_caches(
+    void *memory, size_t checkpoints, size_t cached_keys
+);
+
 /**
  * A null terminated string describing the most recent error to happen to a
  * group session */
@@ -83,6 +143,98 @@ size_t olm_unpickle_inbound_group_session(
     void * pickled, size_t pickled_length
 );
 
+/** Returns the number of bytes needed to store an inbound group session with a
+ * prepared pickle key */
+size_t olm_pickle_inbound_group_session_with_key_length(
+    const OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key
+);
+
+/**
+ * As olm_pickle_inbound_group_session, with a prepared pickle key. The pickle
+ * output buffer must be at least
+ * olm_pickle_inbound_group_session_with_key_length() bytes.
+ */
+size_t olm_pickle_inbound_group_session_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/**
+ * As olm_unpickle_inbound_group_session, with a prepared pickle key.
+ */
+size_t olm_unpickle_inbound_group_session_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store a group session without base64
+ * encoding */
+size_t olm_pickle_inbound_group_session_binary_length(
+    const OlmInboundGroupSession *session
+);
+
+/**
+ * As olm_pickle_inbound_group_session, but the encrypted session is stored as it is
+ * rather than as a base64 string. If the pickle output buffer is smaller than
+ * olm_pickle_inbound_group_session_binary_length() then
+ * olm_inbound_group_session_last_error() will be "OUTPUT_BUFFER_TOO_SMALL"
+ */
+size_t olm_pickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/**
+ * Loads a group session from a pickle written by
+ * olm_pickle_inbound_group_session_binary. The input pickled buffer is destroyed
+ */
+size_t olm_unpickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store a group session without base64
+ * encoding, with a prepared pickle key */
+size_t olm_pickle_inbound_group_session_binary_with_key_length(
+    const OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key
+);
+
+/**
+ * As olm_pickle_inbound_group_session_binary, with a prepared pickle key. The
+ * pickle output buffer must be at least
+ * olm_pickle_inbound_group_session_binary_with_key_length() bytes.
+ */
+size_t olm_pickle_inbound_group_session_binary_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/**
+ * Loads a group session from a pickle written by
+ * olm_pickle_inbound_group_session_binary or
+ * olm_pickle_inbound_group_session_binary_with_key, with a prepared pickle
+ * key. Unlike the other unpickle functions this leaves the pickled buffer as
+ * it is, so it can be read-only memory such as a mapped file: the pickle is
+ * decrypted into scratch, which must be at least pickled_length bytes and is
+ * cleared before returning.
+ *
+ * Returns olm_error() on failure. If scratch is too small then
+ * olm_inbound_group_session_last_error() will be "OUTPUT_BUFFER_TOO_SMALL".
+ */
+size_t olm_unpickle_inbound_group_session_binary_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void const * pickled, size_t pickled_length,
+    void * scratch, size_t scratch_length
+);
+
 
 /**
  * Start a new inbound group session, from a key exported from
@@ -149,6 +301,8 @@ size_t olm_group_decrypt_max_plaintext_length(
  *   * OLM_UNKNOWN_MESSAGE_INDEX  if we do not have a session key corresponding to the
  *     message's index (ie, it was sent before the session key was shared with
  *     us)
+ *   * OLM_WORK_BUDGET_EXCEEDED if reaching the key for the message would take
+ *     more hash steps than olm_inbound_group_session_set_work_budget() allows
  */
 size_t olm_group_decrypt(
     OlmInboundGroupSession *session,
@@ -162,6 +316,190 @@ size_t olm_group_decrypt(
     uint32_t * message_index
 );
 
+/**
+ * Decrypt count messages. messages[i], of message_lengths[i] bytes, is
+ * decrypted into plaintexts[i], which must be at least
+ * max_plaintext_lengths[i] bytes. This does the same as calling
+ * olm_group_decrypt() for each message, but faster: the signatures are
+ * checked together, and the messages are worked through in index order, so
+ * that those older than the latest one decrypted share the ratchet steps
+ * between them rather than each starting from an earlier ratchet value.
+ * The work budget applies to each message.
+ *
+ * The input message buffers are destroyed.
+ *
+ * results[i] is set to the length of the plain-text of messages[i], or
+ * olm_error() if it could not be decrypted. If message_indexes is not NULL,
+ * message_indexes[i] is set to the index of messages[i] if it could be
+ * decoded. If errors is not NULL, errors[i] is set to NULL for a message that
+ * was decrypted, and otherwise to a string as from
+ * olm_inbound_group_session_last_error() for the reason it was not.
+ *
+ * Returns the number of messages decrypted. If any failed, last_error is set
+ * to the error of the last of them, in the order given.
+ */
+size_t olm_group_decrypt_batch(
+    OlmInboundGroupSession *session,
+    size_t count,
+    uint8_t * const * messages, size_t const * message_lengths,
+    uint8_t * const * plaintexts, size_t const * max_plaintext_lengths,
+    size_t * results,
+    uint32_t * message_indexes,
+    const char ** errors
+);
+
+/** get the size of a verification queue that can hold up to capacity
+ * signature checks, in bytes. Each takes 128 bytes and a pointer. */
+size_t olm_group_verify_queue_size(size_t capacity);
+
+/**
+ * Initialise a verification queue for olm_group_decrypt_deferred() that can
+ * hold up to capacity signature checks, using the supplied memory. The
+ * supplied memory should be at least olm_group_verify_queue_size(capacity)
+ * bytes. One queue may be used with any number of sessions.
+ */
+OlmGroupVerifyQueue * olm_group_verify_queue(
+    void *memory, size_t capacity
+);
+
+/**
+ * A null terminated string describing the most recent error to happen to a
+ * verification queue */
+const char *olm_group_verify_queue_last_error(
+    const OlmGroupVerifyQueue *queue
+);
+
+/** The number of signature checks waiting in the queue */
+size_t olm_group_verify_queue_length(
+    const OlmGroupVerifyQueue *queue
+);
+
+/** Clears the memory used to back this verification queue, dropping any
+ * checks in it */
+size_t olm_clear_group_verify_queue(
+    OlmGroupVerifyQueue *queue
+);
+
+/**
+ * Decrypt a message as olm_group_decrypt_read_only() does, but without
+ * checking its signature first. Instead the check is added to the queue, to
+ * be done with others by olm_group_verify_flush(). Until then the plain-text
+ * is unverified: it is only known to come from someone who has the session
+ * key, not from the session's owner. The session itself is not changed: the
+ * ratchet is advanced in the scratch space, which
+ * olm_inbound_group_session_commit_ratchet() refuses until
+ * olm_group_verify_flush() has passed every check queued with it. The scratch
+ * space must therefore be kept until the queue has been flushed.
+ *
+ * queue_position is set to where the check was put in the queue, which is
+ * the index olm_group_verify_flush() reports it at. If this exact message has
+ * already had its signature checked, which the session only knows if it has
+ * a message key cache, nothing is queued and queue_position is set to
+ * olm_error().
+ *
+ * The input message buffer is destroyed.
+ *
+ * Returns the length of the decrypted plain-text, or olm_error() on failure,
+ * in which case olm_group_decrypt_scratch_last_error() gives the reason, as
+ * for olm_group_decrypt(). If the queue is full then it will be
+ * "VERIFY_QUEUE_FULL".
+ */
+size_t olm_group_decrypt_deferred(
+    const OlmInboundGroupSession *session,
+    OlmGroupDecryptScratch *scratch,
+    OlmGroupVerifyQueue *queue,
+    uint8_t * message, size_t message_length,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index,
+    size_t * queue_position
+);
+
+/**
+ * Check every signature in the queue, together, and empty it. results[i] is
+ * set to 1 if the check at queue position i passed and 0 if it failed, so
+ * that the plain-text decrypted with it must not be trusted.
+ *
+ * Returns the number of checks that failed, or olm_error() if results_length
+ * is less than olm_group_verify_queue_length(), in which case
+ * olm_group_verify_queue_last_error() will be "OUTPUT_BUFFER_TOO_SMALL" and
+ * the queue is left as it was.
+ */
+size_t olm_group_verify_flush(
+    OlmGroupVerifyQueue *queue,
+    int * results, size_t results_length
+);
+
+/** get the size of the scratch space for olm_group_decrypt_read_only() and
+ * olm_group_decrypt_deferred(), in bytes. */
+size_t olm_group_decrypt_scratch_size(void);
+
+/**
+ * Initialise scratch space for olm_group_decrypt_read_only() using the
+ * supplied memory, which should be at least olm_group_decrypt_scratch_size()
+ * bytes.
+ */
+OlmGroupDecryptScratch * olm_group_decrypt_scratch(
+    void *memory
+);
+
+/**
+ * A null terminated string describing the most recent error from a
+ * olm_group_decrypt_read_only() or olm_group_decrypt_deferred() call with this
+ * scratch space */
+const char *olm_group_decrypt_scratch_last_error(
+    const OlmGroupDecryptScratch *scratch
+);
+
+/** Clears the memory used to back this scratch space, which holds key
+ * material after a successful decrypt */
+size_t olm_clear_group_decrypt_scratch(
+    OlmGroupDecryptScratch *scratch
+);
+
+/**
+ * Decrypt a message as olm_group_decrypt() does, but without writing to the
+ * session. Several threads may therefore decrypt with the same session at
+ * once, as long as each has its own scratch space and nothing modifies the
+ * session meanwhile.
+ *
+ * The ratchet is advanced in the scratch space instead. The furthest ratchet
+ * value reached by a successful decrypt is kept there, and is used to start
+ * from for later messages from the same session. Pass it to
+ * olm_inbound_group_session_commit_ratchet() so that the session itself
+ * moves on. Checkpoints and the message key cache are read but not updated.
+ *
+ * The input message buffer is destroyed.
+ *
+ * Returns the length of the decrypted plain-text, or olm_error() on failure,
+ * in which case olm_group_decrypt_scratch_last_error() gives the reason, as
+ * for olm_group_decrypt().
+ */
+size_t olm_group_decrypt_read_only(
+    const OlmInboundGroupSession *session,
+    OlmGroupDecryptScratch *scratch,
+    uint8_t * message, size_t message_length,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index
+);
+
+/**
+ * Advance the session's latest ratchet value to the one in the scratch space,
+ * if that is further on, and mark the session as verified if the scratch
+ * space has decrypted a message with it. This must not run at the same time
+ * as other calls using the session.
+ *
+ * Returns olm_error() on failure. If the scratch space was last used with a
+ * different session then olm_inbound_group_session_last_error() will be
+ * "BAD_SESSION_KEY". If it has been used with olm_group_decrypt_deferred()
+ * and olm_group_verify_flush() has not yet passed every signature check
+ * queued with it, or has failed one, then it will be "BAD_SIGNATURE"; such a
+ * scratch space has to be cleared before it can be committed.
+ */
+size_t olm_inbound_group_session_commit_ratchet(
+    OlmInboundGroupSession *session,
+    const OlmGroupDecryptScratch *scratch
+);
+
 
 /**
  * Get the number of bytes returned by olm_inbound_group_session_id()
@@ -221,12 +559,32 @@ size_t olm_export_inbound_group_session_length(
  *   * OLM_UNKNOWN_MESSAGE_INDEX  if we do not have a session key corresponding to the
  *     given index (ie, it was sent before the session key was shared with
  *     us)
+ *   * OLM_WORK_BUDGET_EXCEEDED if reaching the key for the index would take
+ *     more hash steps than olm_inbound_group_session_set_work_budget() allows
  */
 size_t olm_export_inbound_group_session(
     OlmInboundGroupSession *session,
     uint8_t * key, size_t key_length, uint32_t message_index
 );
 
+/**
+ * Limit the work a single olm_group_decrypt() or
+ * olm_export_inbound_group_session() call may do to reach the ratchet value
+ * for a message index. What counts is the hash steps taken to advance the
+ * ratchet, including those taken to stop at any checkpoints on the way (see
+ * olm_inbound_group_session_with_checkpoints()). Reaching an index directly
+ * can take up to 1020 hash steps, for example when the message is older
+ * than the latest one decrypted. Calls that would take more than
+ * max_hash_steps that way fail straight away with OLM_WORK_BUDGET_EXCEEDED
+ * and leave the session unchanged, so that the message can be retried later
+ * without a budget. Otherwise checkpoints are only taken while the budget
+ * has room for them, so no call goes over it. A budget of 0, the default,
+ * means no limit. The budget is not pickled.
+ */
+void olm_inbound_group_session_set_work_budget(
+    OlmInboundGroupSession *session, uint32_t max_hash_steps
+);
+
 
 #ifdef __cplusplus
 } // extern "C"
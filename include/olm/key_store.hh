@@ -0,0 +1,238 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OLM_KEY_STORE_HH_
+#define OLM_KEY_STORE_HH_
+
+#include "olm/crypto.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace olm {
+
+struct OneTimeKey {
+    std::uint32_t id;
+    _olm_curve25519_key_pair key;
+};
+
+
+/** The number of entries in a SlotIndex for a store of the given capacity:
+ * the smallest power of two that keeps the index at most half full. */
+constexpr std::size_t slot_index_size(
+    std::size_t capacity, std::size_t size = 1
+) {
+    return size >= 2 * capacity ? size : slot_index_size(capacity, 2 * size);
+}
+
+
+/**
+ * An open-addressed hash index of the slots of a key store. It probes
+ * linearly and shifts entries back on removal, so it never fills up with
+ * deleted markers. The store keeps the keys: home(slot) must give the hash
+ * of the key in a slot.
+ */
+class SlotIndex {
+public:
+    static std::uint32_t const NONE = 0xFFFFFFFF;
+
+    /** Use size entries at entries, where size is a power of two. The
+     * entries must be zero. */
+    void init(std::uint32_t * entries, std::size_t size) {
+        _entries = entries;
+        _mask = std::uint32_t(size - 1);
+    }
+
+    template<typename Home>
+    void insert(std::uint32_t slot, Home const & home) {
+        std::uint32_t i = home(slot) & _mask;
+        while (_entries[i] != 0) {
+            i = (i + 1) & _mask;
+        }
+        _entries[i] = slot + 1;
+    }
+
+    /** The first slot with the given hash for which match(slot) is true, or
+     * NONE */
+    template<typename Match>
+    std::uint32_t find(std::uint32_t hash, Match const & match) const {
+        for (std::uint32_t i = hash & _mask; _entries[i] != 0; i = (i + 1) & _mask) {
+            if (match(_entries[i] - 1)) {
+                return _entries[i] - 1;
+            }
+        }
+        return NONE;
+    }
+
+    /** Remove a slot from the index. Does nothing if it isn't there. */
+    template<typename Home>
+    void remove(std::uint32_t slot, Home const & home) {
+        std::uint32_t i = home(slot) & _mask;
+        while (_entries[i] != slot + 1) {
+            if (_entries[i] == 0) {
+                return;
+            }
+            i = (i + 1) & _mask;
+        }
+        /* Shift later entries of the probe sequence back into the gap, so
+         * that lookups never stop early at it. */
+        std::uint32_t j = i;
+        for (;;) {
+            _entries[i] = 0;
+            for (;;) {
+                j = (j + 1) & _mask;
+                if (_entries[j] == 0) {
+                    return;
+                }
+                std::uint32_t k = home(_entries[j] - 1) & _mask;
+                /* leave the entry if its home lies cyclically in (i, j] */
+                if (!(i <= j ? (i < k && k <= j) : (i < k || k <= j))) {
+                    break;
+                }
+            }
+            _entries[i] = _entries[j];
+            i = j;
+        }
+    }
+
+    /** Remove every slot from the index */
+    void clear() {
+        for (std::uint32_t i = 0; i <= _mask; ++i) {
+            _entries[i] = 0;
+        }
+    }
+
+private:
+    std::uint32_t * _entries;
+    std::uint32_t _mask;
+};
+
+
+/** The number of one time keys an account holds unless it is created with a
+ * larger capacity. */
+static std::size_t const MAX_ONE_TIME_KEYS = 100;
+
+
+/**
+ * The one time keys of an account, held in storage supplied by the owner.
+ *
+ * Keys live in fixed slots, linked from newest to oldest so that the oldest
+ * key can be discarded when the store is full. An open-addressed index on the
+ * public key finds and removes keys in constant time, and a bitmap records
+ * which keys have been published.
+ */
+class OneTimeKeyStore {
+public:
+    /** The largest capacity a store can have. */
+    static std::size_t const MAX_CAPACITY = std::size_t(1) << 24;
+
+    /** The number of bytes of storage needed for a store of the given
+     * capacity. */
+    static constexpr std::size_t storage_size(std::size_t capacity) {
+        return capacity * (sizeof(OneTimeKey) + 2 * sizeof(std::uint32_t))
+            + slot_index_size(capacity) * sizeof(std::uint32_t)
+            + (capacity + 31) / 32 * sizeof(std::uint32_t);
+    }
+
+    /** Use storage_size(capacity) bytes at storage, aligned for a
+     * OneTimeKey, for an empty store holding up to capacity keys. */
+    void init(void * storage, std::size_t capacity);
+
+    /** Remove all the keys, clearing their memory. */
+    void clear();
+
+    std::size_t capacity() const { return _capacity; }
+    std::size_t size() const { return _size; }
+
+    /** Make a slot for a key newer than all the others, discarding the
+     * oldest key if the store is full. The key is unpublished. It can't be
+     * found until its public key is set and it is passed to add_to_index(). */
+    OneTimeKey * push_newest();
+
+    /** Make a slot for a key older than all the others. Returns 0 if the
+     * store is full. */
+    OneTimeKey * push_oldest();
+
+    /** Make a key findable by its public key */
+    void add_to_index(OneTimeKey const * key);
+
+    /** Find the key with the given public key, or 0 if there isn't one */
+    OneTimeKey const * find(
+        _olm_curve25519_public_key const & public_key
+    ) const;
+
+    /** Remove a key from the store, clearing its memory */
+    void erase(OneTimeKey const * key);
+
+    bool is_published(OneTimeKey const * key) const;
+    void set_published(OneTimeKey const * key, bool published);
+
+    /** Iterates over the keys from newest to oldest */
+    class const_iterator {
+    public:
+        OneTimeKey const & operator*() const {
+            return _store->_keys[_slot];
+        }
+        OneTimeKey const * operator->() const {
+            return &_store->_keys[_slot];
+        }
+        const_iterator & operator++() {
+            _slot = _store->_links[2 * _slot];
+            return *this;
+        }
+        bool operator!=(const_iterator const & other) const {
+            return _slot != other._slot;
+        }
+    private:
+        friend class OneTimeKeyStore;
+        const_iterator(
+            OneTimeKeyStore const * store, std::uint32_t slot
+        ) : _store(store), _slot(slot) {}
+        OneTimeKeyStore const * _store;
+        std::uint32_t _slot;
+    };
+
+    const_iterator begin() const { return const_iterator(this, _newest); }
+    const_iterator end() const { return const_iterator(this, NONE); }
+
+private:
+    static std::uint32_t const NONE = 0xFFFFFFFF;
+
+    std::uint32_t slot_of(OneTimeKey const * key) const {
+        return std::uint32_t(key - _keys);
+    }
+    void unlink(std::uint32_t slot);
+
+    /** Hashes the public key in a slot, for the index */
+    struct Home {
+        OneTimeKeyStore const * store;
+        std::uint32_t operator()(std::uint32_t slot) const;
+    };
+
+    OneTimeKey * _keys;
+    /* older and newer neighbours of each slot; free slots are chained
+     * through the newer link */
+    std::uint32_t * _links;
+    SlotIndex _index;
+    std::uint32_t * _published;
+    std::size_t _capacity;
+    std::size_t _size;
+    std::uint32_t _newest;
+    std::uint32_t _oldest;
+    std::uint32_t _free;
+};
+
+} // namespace olm
+
+#endif /* OLM_KEY_STORE_HH_ */
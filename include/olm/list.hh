@@ -46,6 +46,11 @@ public:
 
     T const & operator[](std::size_t index) const { return _data[index]; }
 
+    /**
+     * Remove all the items from the list. Doesn't clear their memory.
+     */
+    void clear() { _end = _data; }
+
     /**
      * Erase the item from the list at the given position.
      */
@@ -77,6 +82,31 @@ public:
         return pos;
     }
 
+    /**
+     * Make space for count items in the list at a given position, shifting
+     * the items after it once. If this makes the list longer than max_size
+     * then the end of the list is discarded, and if count is larger than the
+     * space after pos then only that many items are made.
+     * Returns the number of items made.
+     */
+    std::size_t insert_many(T * pos, std::size_t count) {
+        std::size_t room = (_data + max_size) - pos;
+        if (count > room) {
+            count = room;
+        }
+        if (size() + count < max_size) {
+            _end += count;
+        } else {
+            _end = _data + max_size;
+        }
+        T * tmp = _end;
+        while (tmp - count > pos) {
+            --tmp;
+            *tmp = *(tmp - count);
+        }
+        return count;
+    }
+
     /**
      * Make space for an item in the list at the start of the list
      */
@@ -88,6 +88,17 @@ void megolm_advance(Megolm *megolm);
 /** advance the ratchet to a given count */
 void megolm_advance_to(Megolm *megolm, uint32_t advance_to);
 
+/**
+ * The number of hashes megolm_advance_to() would compute to advance the
+ * ratchet to a given count
+ */
+uint32_t megolm_advance_cost(const Megolm *megolm, uint32_t advance_to);
+
+/**
+ * As megolm_advance_cost(), for a ratchet at the count counter
+ */
+uint32_t megolm_advance_cost_from(uint32_t counter, uint32_t advance_to);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
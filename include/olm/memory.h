@@ -33,6 +33,14 @@ void _olm_unset(
     void volatile * buffer, size_t buffer_length
 );
 
+/**
+ * Check if two buffers are equal in constant time. Returns non-zero if they
+ * are.
+ */
+int _olm_is_equal(
+    void const * buffer_a, void const * buffer_b, size_t length
+);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -135,4 +135,15 @@ void decode_one_time_key_message(
 );
 
 
+/**
+ * Reads the message headers from the start of a message that may have been
+ * cut short anywhere after them. If the input stops part way through the
+ * message this one carries then reader.message holds the part that is there.
+ */
+void decode_one_time_key_message_header(
+    PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length
+);
+
+
 } // namespace olm
@@ -21,6 +21,7 @@
 
 #include "olm/inbound_group_session.h"
 #include "olm/outbound_group_session.h"
+#include "olm/pickle_key.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,9 +30,15 @@ extern "C" {
 static const size_t OLM_MESSAGE_TYPE_PRE_KEY = 0;
 static const size_t OLM_MESSAGE_TYPE_MESSAGE = 1;
 
+/** The results of olm_session_can_decrypt_hint() */
+static const size_t OLM_DECRYPT_HINT_IMPOSSIBLE = 0;
+static const size_t OLM_DECRYPT_HINT_NEW_CHAIN = 1;
+static const size_t OLM_DECRYPT_HINT_KNOWN_CHAIN = 2;
+
 typedef struct OlmAccount OlmAccount;
 typedef struct OlmSession OlmSession;
 typedef struct OlmUtility OlmUtility;
+typedef struct OlmEd25519PreparedKey OlmEd25519PreparedKey;
 
 /** Get the version number of the library.
  * Arguments will be updated if non-null.
@@ -47,18 +54,52 @@ size_t olm_session_size(void);
 /** The size of a utility object in bytes */
 size_t olm_utility_size(void);
 
+/** The size in bytes of an account object that can store up to capacity one
+ * time keys. Capacities below the default of 100 keys are rounded up to it,
+ * so for those this is the same as olm_account_size(). */
+size_t olm_account_size_with_capacity(
+    size_t capacity
+);
+
+/** The size in bytes of a session object that can store up to capacity
+ * skipped message keys, which are the keys for messages that are yet to
+ * arrive after later messages in the same chain. Capacities below the default
+ * of 40 keys are rounded up to it, so for those this is the same as
+ * olm_session_size(). */
+size_t olm_session_size_with_capacity(
+    size_t capacity
+);
+
 /** Initialise an account object using the supplied memory
  *  The supplied memory must be at least olm_account_size() bytes */
 OlmAccount * olm_account(
     void * memory
 );
 
+/** Initialise an account object that can store up to capacity one time keys
+ * using the supplied memory. The supplied memory must be at least
+ * olm_account_size_with_capacity(capacity) bytes. Unpickling an account with
+ * more one time keys than this fails with "KEY_STORE_TOO_SMALL". */
+OlmAccount * olm_account_with_capacity(
+    void * memory,
+    size_t capacity
+);
+
 /** Initialise a session object using the supplied memory
  *  The supplied memory must be at least olm_session_size() bytes */
 OlmSession * olm_session(
     void * memory
 );
 
+/** Initialise a session object that can store up to capacity skipped
+ * message keys using the supplied memory. The supplied memory must be at
+ * least olm_session_size_with_capacity(capacity) bytes. When a pickled
+ * session has more skipped message keys than this the oldest are dropped. */
+OlmSession * olm_session_with_capacity(
+    void * memory,
+    size_t capacity
+);
+
 /** Initialise a utility object using the supplied memory
  *  The supplied memory must be at least olm_utility_size() bytes */
 OlmUtility * olm_utility(
@@ -133,6 +174,40 @@ size_t olm_pickle_session(
     void * pickled, size_t pickled_length
 );
 
+/** Returns the number of bytes needed to store an account with a prepared
+ * pickle key. This is olm_pickle_account_length() unless the pickle key was
+ * made with olm_pickle_key_aes_gcm() */
+size_t olm_pickle_account_with_key_length(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key
+);
+
+/** Returns the number of bytes needed to store a session with a prepared
+ * pickle key */
+size_t olm_pickle_session_with_key_length(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key
+);
+
+/** As olm_pickle_account, with a prepared pickle key. The output is the same
+ * as olm_pickle_account gives with the key the pickle key was made from,
+ * unless the pickle key was made with olm_pickle_key_aes_gcm(). If the pickle
+ * output buffer is smaller than olm_pickle_account_with_key_length() then
+ * olm_account_last_error() will be "OUTPUT_BUFFER_TOO_SMALL" */
+size_t olm_pickle_account_with_key(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_pickle_session, with a prepared pickle key. The pickle output
+ * buffer must be at least olm_pickle_session_with_key_length() bytes. */
+size_t olm_pickle_session_with_key(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
 /** Loads an account from a pickled base64 string. Decrypts the account using
  * the supplied key. Returns olm_error() on failure. If the key doesn't
  * match the one used to encrypt the account then olm_account_last_error()
@@ -157,6 +232,145 @@ size_t olm_unpickle_session(
     void * pickled, size_t pickled_length
 );
 
+/** As olm_unpickle_account, with a prepared pickle key. */
+size_t olm_unpickle_account_with_key(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_unpickle_session, with a prepared pickle key. */
+size_t olm_unpickle_session_with_key(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store the changes to an account
+ * since it was last pickled or unpickled, in full or as a delta */
+size_t olm_pickle_account_delta_length(
+    OlmAccount * account
+);
+
+/** Returns the number of bytes needed to store the changes to a session
+ * since it was last pickled or unpickled, in full or as a delta */
+size_t olm_pickle_session_delta_length(
+    OlmSession * session
+);
+
+/** Stores the changes to an account since it was last pickled or unpickled,
+ * in full or as a delta, as a base64 string encrypted with the supplied key.
+ * This is usually much shorter than a full pickle: the one time keys from
+ * before are stored by id alone. Returns the length of the delta on success.
+ * Returns olm_error() on failure. If the pickle output buffer is smaller than
+ * olm_pickle_account_delta_length() then olm_account_last_error() will be
+ * "OUTPUT_BUFFER_TOO_SMALL" */
+size_t olm_pickle_account_delta(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** Stores the changes to a session since it was last pickled or unpickled,
+ * in full or as a delta, as a base64 string encrypted with the supplied key.
+ * Only the chains that have changed are stored, and the skipped message keys
+ * only if any were added or used. Returns the length of the delta on success.
+ * Returns olm_error() on failure. If the pickle output buffer is smaller than
+ * olm_pickle_session_delta_length() then olm_session_last_error() will be
+ * "OUTPUT_BUFFER_TOO_SMALL" */
+size_t olm_pickle_session_delta(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** Applies a delta from olm_pickle_account_delta to an account. The account
+ * must be in the state the delta was taken from: unpickled from the full
+ * pickle before it and from each delta in between, in order. If it isn't
+ * then olm_account_last_error() will be "BAD_PICKLE_DELTA". Otherwise fails
+ * as olm_unpickle_account does. The input pickled buffer is destroyed */
+size_t olm_unpickle_account_delta(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** Applies a delta from olm_pickle_session_delta to a session, as
+ * olm_unpickle_account_delta does to an account */
+size_t olm_unpickle_session_delta(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** Loads an account from a full pickle and the delta_count deltas pickled
+ * after it, in order. Returns the length of the full pickle on success.
+ * Returns olm_error() on failure, as olm_unpickle_account and
+ * olm_unpickle_account_delta do. The input buffers are destroyed */
+size_t olm_unpickle_account_journal(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length,
+    void * const * deltas, size_t const * delta_lengths, size_t delta_count
+);
+
+/** Loads a session from a full pickle and the delta_count deltas pickled
+ * after it, in order, as olm_unpickle_account_journal does an account */
+size_t olm_unpickle_session_journal(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length,
+    void * const * deltas, size_t const * delta_lengths, size_t delta_count
+);
+
+/** Returns the number of bytes needed to store an account without base64
+ * encoding */
+size_t olm_pickle_account_binary_length(
+    OlmAccount * account
+);
+
+/** Returns the number of bytes needed to store a session without base64
+ * encoding */
+size_t olm_pickle_session_binary_length(
+    OlmSession * session
+);
+
+/** As olm_pickle_account, but the encrypted account is stored as it is
+ * rather than as a base64 string. If the pickle output buffer is smaller than
+ * olm_pickle_account_binary_length() then olm_account_last_error() will be
+ * "OUTPUT_BUFFER_TOO_SMALL" */
+size_t olm_pickle_account_binary(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_pickle_session, but the encrypted session is stored as it is
+ * rather than as a base64 string. If the pickle output buffer is smaller than
+ * olm_pickle_session_binary_length() then olm_session_last_error() will be
+ * "OUTPUT_BUFFER_TOO_SMALL" */
+size_t olm_pickle_session_binary(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** Loads an account from a pickle written by olm_pickle_account_binary. The
+ * input pickled buffer is destroyed */
+size_t olm_unpickle_account_binary(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/** Loads a session from a pickle written by olm_pickle_session_binary. The
+ * input pickled buffer is destroyed */
+size_t olm_unpickle_session_binary(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
 /** The number of random bytes needed to create an account.*/
 size_t olm_create_account_random_length(
     OlmAccount * account
@@ -254,6 +468,18 @@ size_t olm_account_generate_one_time_keys(
     void * random, size_t random_length
 );
 
+/** As olm_account_generate_one_time_keys, but splits the work across up to
+ * the given number of threads. The keys are the same as those generated by
+ * olm_account_generate_one_time_keys from the same random data. If olm was
+ * built without thread support then the keys are generated on the calling
+ * thread. */
+size_t olm_account_generate_one_time_keys_parallel(
+    OlmAccount * account,
+    size_t number_of_keys,
+    void * random, size_t random_length,
+    unsigned threads
+);
+
 /** The number of random bytes needed to create an outbound session */
 size_t olm_create_outbound_session_random_length(
     OlmSession * session
@@ -408,6 +634,36 @@ size_t olm_decrypt_max_plaintext_length(
     void * message, size_t message_length
 );
 
+/** Limits the work a single olm_decrypt() call may do to reach the key for a
+ * message, counted as the number of steps a hash ratchet chain is advanced
+ * by. A message can be up to 2000 steps ahead of its chain. Messages that
+ * would take more than max_hash_steps fail straight away with
+ * "WORK_BUDGET_EXCEEDED" and leave the session unchanged, so that they can
+ * be retried later without a budget. A budget of 0, the default, means no
+ * limit. The budget is not pickled. */
+void olm_session_set_work_budget(
+    OlmSession * session,
+    uint32_t max_hash_steps
+);
+
+/** Guesses whether olm_decrypt() could succeed for a message, by reading its
+ * headers and checking them against the state of the session. No
+ * cryptography is done and the message buffer is left untouched, so this is
+ * cheap enough to rank or rule out sessions before trying olm_decrypt().
+ * Returns OLM_DECRYPT_HINT_IMPOSSIBLE if the session can't decrypt the
+ * message. Returns OLM_DECRYPT_HINT_KNOWN_CHAIN if the message is on a chain
+ * the session is receiving, which only costs a few hashes to check. Returns
+ * OLM_DECRYPT_HINT_NEW_CHAIN if the message would start a new chain, which
+ * needs a key exchange to check. The MAC isn't checked, so olm_decrypt() can
+ * still fail for the last two. Returns olm_error() on failure. If the message
+ * base64 couldn't be decoded then olm_session_last_error() will be
+ * "INVALID_BASE64". */
+size_t olm_session_can_decrypt_hint(
+    OlmSession * session,
+    size_t message_type,
+    void const * message, size_t message_length
+);
+
 /** Decrypts a message using the session. The input message buffer is destroyed.
  * Returns the length of the plain-text on success. Returns olm_error() on
  * failure. If the plain-text buffer is smaller than
@@ -418,7 +674,9 @@ size_t olm_decrypt_max_plaintext_length(
  * be "BAD_MESSAGE_VERSION". If the message couldn't be decoded then
  * olm_session_last_error() will be BAD_MESSAGE_FORMAT".
  * If the MAC on the message was invalid then olm_session_last_error() will
- * be "BAD_MESSAGE_MAC". */
+ * be "BAD_MESSAGE_MAC". If reaching the key for the message would take more
+ * hash steps than olm_session_set_work_budget() allows then
+ * olm_session_last_error() will be "WORK_BUDGET_EXCEEDED". */
 size_t olm_decrypt(
     OlmSession * session,
     size_t message_type,
@@ -450,6 +708,60 @@ size_t olm_ed25519_verify(
     void * signature, size_t signature_length
 );
 
+/** The size of a prepared ed25519 key object in bytes */
+size_t olm_ed25519_prepared_key_size(void);
+
+/** Initialise a prepared ed25519 key object using the supplied memory.
+ *  The supplied memory must be at least olm_ed25519_prepared_key_size()
+ *  bytes. A prepared key holds an ed25519 public key in decompressed form,
+ *  which makes repeated calls to olm_ed25519_verify_prepared() with the same
+ *  key cheaper than calling olm_ed25519_verify() each time. */
+OlmEd25519PreparedKey * olm_ed25519_prepared_key(
+    void * memory
+);
+
+/** Clears the memory used to back this prepared key */
+size_t olm_clear_ed25519_prepared_key(
+    OlmEd25519PreparedKey * key
+);
+
+/** Load a base64 ed25519 public key into a prepared key object. If the key
+ * was too small then olm_utility_last_error() will be "INVALID_BASE64". A key
+ * that is not a valid curve point is accepted here, but no signature will
+ * verify against it. */
+size_t olm_ed25519_prepare_key(
+    OlmUtility * utility,
+    OlmEd25519PreparedKey * prepared_key,
+    void const * key, size_t key_length
+);
+
+/** Verify an ed25519 signature against a prepared key. Behaves like
+ * olm_ed25519_verify(): if the signature was invalid then
+ * olm_utility_last_error() will be "BAD_MESSAGE_MAC". */
+size_t olm_ed25519_verify_prepared(
+    OlmUtility * utility,
+    OlmEd25519PreparedKey const * prepared_key,
+    void const * message, size_t message_length,
+    void * signature, size_t signature_length
+);
+
+/** Verify count ed25519 signatures at once, which is several times faster than
+ * calling olm_ed25519_verify() for each of them. Each argument is an array of
+ * count entries with the same meaning as for olm_ed25519_verify(); the
+ * signatures are base64-decoded in place. results[i] is set to 1 if the i-th
+ * signature is valid and 0 otherwise. Returns 0 if every signature is valid.
+ * Otherwise returns olm_error() and olm_utility_last_error() will be
+ * "INVALID_BASE64" if a key or signature could not be decoded, or else
+ * "BAD_MESSAGE_MAC"; results tells which entries failed. */
+size_t olm_ed25519_verify_batch(
+    OlmUtility * utility,
+    size_t count,
+    void const * const * keys, size_t const * key_lengths,
+    void const * const * messages, size_t const * message_lengths,
+    void * const * signatures, size_t const * signature_lengths,
+    int * results
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,6 +18,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "olm/pickle_key.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -83,6 +85,61 @@ size_t olm_unpickle_outbound_group_session(
     void * pickled, size_t pickled_length
 );
 
+/** Returns the number of bytes needed to store an outbound group session with a
+ * prepared pickle key */
+size_t olm_pickle_outbound_group_session_with_key_length(
+    const OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key
+);
+
+/**
+ * As olm_pickle_outbound_group_session, with a prepared pickle key. The pickle
+ * output buffer must be at least
+ * olm_pickle_outbound_group_session_with_key_length() bytes.
+ */
+size_t olm_pickle_outbound_group_session_with_key(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/**
+ * As olm_unpickle_outbound_group_session, with a prepared pickle key.
+ */
+size_t olm_unpickle_outbound_group_session_with_key(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store a group session without base64
+ * encoding */
+size_t olm_pickle_outbound_group_session_binary_length(
+    const OlmOutboundGroupSession *session
+);
+
+/**
+ * As olm_pickle_outbound_group_session, but the encrypted session is stored as it is
+ * rather than as a base64 string. If the pickle output buffer is smaller than
+ * olm_pickle_outbound_group_session_binary_length() then
+ * olm_outbound_group_session_last_error() will be "OUTPUT_BUFFER_TOO_SMALL"
+ */
+size_t olm_pickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
+/**
+ * Loads a group session from a pickle written by
+ * olm_pickle_outbound_group_session_binary. The input pickled buffer is destroyed
+ */
+size_t olm_unpickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+);
+
 
 /** The number of random bytes needed to create an outbound group session */
 size_t olm_init_outbound_group_session_random_length(
@@ -119,6 +176,92 @@ size_t olm_group_encrypt(
     uint8_t * message, size_t message_length
 );
 
+/**
+ * Encrypt count plain-texts, giving the same messages as count calls to
+ * olm_group_encrypt() would. plaintexts[i], of plaintext_lengths[i] bytes, is
+ * encrypted into messages[i], which must be at least max_message_lengths[i]
+ * bytes, and message_lengths[i] is set to the length of the message. Message
+ * i has the index olm_outbound_group_session_message_index() + i, so its
+ * length can be larger than olm_group_encrypt_message_length() gives.
+ *
+ * Returns count, or olm_error() on failure. If any of the message buffers is
+ * too small then last_error will be OUTPUT_BUFFER_TOO_SMALL, and nothing is
+ * encrypted.
+ */
+size_t olm_group_encrypt_batch(
+    OlmOutboundGroupSession *session,
+    size_t count,
+    uint8_t const * const * plaintexts, size_t const * plaintext_lengths,
+    uint8_t * const * messages, size_t const * max_message_lengths,
+    size_t * message_lengths
+);
+
+/**
+ * As olm_group_encrypt_batch(), but splits the encryption across up to the
+ * given number of threads. The messages are the same as those
+ * olm_group_encrypt_batch() gives. If olm was built without thread support
+ * then they are encrypted on the calling thread.
+ */
+size_t olm_group_encrypt_batch_parallel(
+    OlmOutboundGroupSession *session,
+    size_t count,
+    uint8_t const * const * plaintexts, size_t const * plaintext_lengths,
+    uint8_t * const * messages, size_t const * max_message_lengths,
+    size_t * message_lengths,
+    unsigned threads
+);
+
+/**
+ * The number of bytes needed to reserve one message index with
+ * olm_group_encrypt_reserve()
+ */
+size_t olm_group_encrypt_reservation_size(void);
+
+/**
+ * Reserve the next count message indexes, for messages to be encrypted later
+ * with olm_group_encrypt_reserved(). The ratchet value for each is stored in
+ * reservations, one after the other, each
+ * olm_group_encrypt_reservation_size() bytes long, and the session moves on
+ * past them.
+ *
+ * The reservations are key material, and should be cleared once used.
+ *
+ * Returns count, or olm_error() on failure. If the reservations buffer is too
+ * small then last_error will be OUTPUT_BUFFER_TOO_SMALL.
+ */
+size_t olm_group_encrypt_reserve(
+    OlmOutboundGroupSession *session,
+    size_t count,
+    void * reservations, size_t reservations_length
+);
+
+/**
+ * The number of bytes that will be created by encrypting a message with a
+ * reservation
+ */
+size_t olm_group_encrypt_reserved_message_length(
+    void const * reservation,
+    size_t plaintext_length
+);
+
+/**
+ * Encrypt some plain-text with a reservation from olm_group_encrypt_reserve(),
+ * giving the message olm_group_encrypt() would have for that index. This only
+ * reads the session, so several threads may encrypt with their own
+ * reservations from the same session at once. The reservation is cleared on
+ * success.
+ *
+ * Returns the length of the encrypted message or olm_error() if the output
+ * buffer is smaller than olm_group_encrypt_reserved_message_length(). This
+ * does not set the session's last_error.
+ */
+size_t olm_group_encrypt_reserved(
+    const OlmOutboundGroupSession *session,
+    void * reservation,
+    uint8_t const * plaintext, size_t plaintext_length,
+    uint8_t * message, size_t max_message_length
+);
+
 
 /**
  * Get the number of bytes returned by olm_outbound_group_session_id()
@@ -0,0 +1,46 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* C bindings for parallel functions */
+
+
+#ifndef OLM_PARALLEL_H_
+#define OLM_PARALLEL_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Calls function(begin, end, context) for contiguous ranges covering
+ * [0, count), running up to threads ranges at once, as olm::parallel_for
+ * does.
+ */
+void _olm_parallel_for(
+    size_t count, unsigned threads,
+    void (*function)(size_t begin, size_t end, void * context),
+    void * context
+);
+
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+
+#endif /* OLM_PARALLEL_H_ */
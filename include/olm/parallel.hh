@@ -0,0 +1,35 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OLM_PARALLEL_HH_
+#define OLM_PARALLEL_HH_
+
+#include <cstddef>
+
+namespace olm {
+
+/** Calls function(begin, end, context) for contiguous ranges covering
+ * [0, count), running up to `threads` ranges at once. The calls run on the
+ * calling thread if threads is less than 2, if olm was built without
+ * OLM_THREADS, or if a thread cannot be started. The function must not
+ * throw. */
+void parallel_for(
+    std::size_t count, unsigned threads,
+    void (*function)(std::size_t begin, std::size_t end, void * context),
+    void * context
+);
+
+} // namespace olm
+
+#endif /* OLM_PARALLEL_HH_ */
@@ -22,6 +22,7 @@
 #include <stdint.h>
 
 #include "olm/error.h"
+#include "olm/pickle_key.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,6 +69,118 @@ size_t _olm_enc_input(
     enum OlmErrorCode * last_error
 );
 
+/**
+ * Get the number of bytes needed for an encrypted pickle of the length given,
+ * without the base64 encoding.
+ */
+size_t _olm_enc_binary_output_length(size_t raw_length);
+
+/**
+ * Encrypt the given pickle in-situ, without base64 encoding it.
+ *
+ * The raw pickle should have been written to the start of the buffer, which
+ * must be at least _olm_enc_binary_output_length(raw_length) bytes long.
+ *
+ * Returns the number of bytes in the encrypted pickle.
+ */
+size_t _olm_enc_binary_output(
+    uint8_t const * key, size_t key_length,
+    uint8_t *pickle, size_t raw_length
+);
+
+/**
+ * Decrypt the given pickle, which is not base64 encoded, in-situ.
+ *
+ * Returns the number of bytes in the decrypted pickle, or olm_error() on
+ * error, in which case *last_error will be updated, if last_error is non-NULL.
+ */
+size_t _olm_enc_binary_input(
+    uint8_t const * key, size_t key_length,
+    uint8_t * input, size_t length,
+    enum OlmErrorCode * last_error
+);
+
+/**
+ * As _olm_enc_output_length, for a pickle written with a prepared pickle key.
+ */
+size_t _olm_enc_output_length_with_key(
+    const OlmPickleKey * pickle_key,
+    size_t raw_length
+);
+
+/**
+ * As _olm_enc_output_pos, for a pickle written with a prepared pickle key.
+ */
+uint8_t *_olm_enc_output_pos_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * output, size_t raw_length
+);
+
+/**
+ * As _olm_enc_output, with a prepared pickle key. The raw pickle should have
+ * been written to _olm_enc_output_pos_with_key(pickle_key, pickle,
+ * raw_length).
+ */
+size_t _olm_enc_output_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t *pickle, size_t raw_length
+);
+
+/**
+ * As _olm_enc_input, with a prepared pickle key. Pickles encrypted with
+ * AES-256-GCM are recognised by their first byte, as they are by
+ * _olm_enc_input and _olm_enc_binary_input.
+ */
+size_t _olm_enc_input_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * input, size_t b64_length,
+    enum OlmErrorCode * last_error
+);
+
+/**
+ * As _olm_enc_binary_output_length, for a pickle written with a prepared
+ * pickle key.
+ */
+size_t _olm_enc_binary_output_length_with_key(
+    const OlmPickleKey * pickle_key,
+    size_t raw_length
+);
+
+/**
+ * Get the point in the output buffer that the raw pickle should be written to
+ * for _olm_enc_binary_output_with_key. It is after the envelope byte of an
+ * AES-256-GCM pickle.
+ */
+uint8_t *_olm_enc_binary_output_pos_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * output
+);
+
+/**
+ * As _olm_enc_binary_output, with a prepared pickle key. The raw pickle
+ * should have been written to _olm_enc_binary_output_pos_with_key(pickle_key,
+ * pickle).
+ */
+size_t _olm_enc_binary_output_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t *pickle, size_t raw_length
+);
+
+/**
+ * Decrypt the given pickle, which is not base64 encoded, with a prepared
+ * pickle key. The plaintext is written to output, which must be at least
+ * length bytes long and may be input itself; otherwise input is not modified.
+ *
+ * Returns the number of bytes in the decrypted pickle, or olm_error() on
+ * error, in which case *last_error will be updated, if last_error is non-NULL.
+ */
+size_t _olm_enc_binary_input_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t const * input, size_t length,
+    uint8_t * output,
+    enum OlmErrorCode * last_error
+);
+
 
 #ifdef __cplusplus
 } // extern "C"
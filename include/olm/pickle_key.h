@@ -0,0 +1,67 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OLM_PICKLE_KEY_H_
+#define OLM_PICKLE_KEY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A pickle key with the keys derived from it already expanded. Pickling or
+ * unpickling with one gives the same results as passing the key itself, but
+ * skips the key derivation and AES and HMAC key setup that every call would
+ * otherwise repeat. Use it when many objects are pickled with the same key.
+ */
+typedef struct OlmPickleKey OlmPickleKey;
+
+/** get the size of a pickle key object, in bytes. */
+size_t olm_pickle_key_size(void);
+
+/**
+ * Initialise a pickle key object using the supplied memory and key. The
+ * supplied memory should be at least olm_pickle_key_size() bytes.
+ */
+OlmPickleKey * olm_pickle_key(
+    void * memory,
+    void const * key, size_t key_length
+);
+
+/**
+ * As olm_pickle_key, but pickles written with the returned key are encrypted
+ * with AES-256-GCM rather than AES-CBC with an HMAC-SHA-256. They are longer
+ * by a few bytes, so use the *_with_key_length functions to size the buffer.
+ * Setting one up takes about twice as long as olm_pickle_key, since it
+ * derives the keys for both kinds. It loads pickles of either kind, as does
+ * the key itself; a pickle key from olm_pickle_key only loads AES-CBC ones.
+ */
+OlmPickleKey * olm_pickle_key_aes_gcm(
+    void * memory,
+    void const * key, size_t key_length
+);
+
+/** Clears the memory used to back this pickle key object */
+size_t olm_clear_pickle_key(
+    OlmPickleKey * pickle_key
+);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_PICKLE_KEY_H_ */
@@ -19,6 +19,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "olm/pickle_key.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -174,6 +176,56 @@ size_t olm_unpickle_pk_decryption(
     void *pubkey, size_t pubkey_length
 );
 
+/** Get the length of a pickled PkDecryption object with a prepared pickle
+ * key */
+size_t olm_pickle_pk_decryption_with_key_length(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key
+);
+
+/** As olm_pickle_pk_decryption, with a prepared pickle key. The pickle output
+ * buffer must be at least olm_pickle_pk_decryption_with_key_length() bytes. */
+size_t olm_pickle_pk_decryption_with_key(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length
+);
+
+/** As olm_unpickle_pk_decryption, with a prepared pickle key. */
+size_t olm_unpickle_pk_decryption_with_key(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
+);
+
+/** Returns the number of bytes needed to store a decryption object without
+ * base64 encoding. */
+size_t olm_pickle_pk_decryption_binary_length(
+    OlmPkDecryption * decryption
+);
+
+/** As olm_pickle_pk_decryption, but the encrypted object is stored as it is
+ * rather than as a base64 string. If the pickle output buffer is smaller than
+ * olm_pickle_pk_decryption_binary_length() then
+ * olm_pk_decryption_last_error() will be "OUTPUT_BUFFER_TOO_SMALL" */
+size_t olm_pickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    void const * key, size_t key_length,
+    void *pickled, size_t pickled_length
+);
+
+/** Loads a decryption object from a pickle written by
+ * olm_pickle_pk_decryption_binary, writing its public key to the pubkey
+ * buffer as olm_unpickle_pk_decryption does. The input pickled buffer is
+ * destroyed */
+size_t olm_unpickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    void const * key, size_t key_length,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
+);
+
 /** Get the length of the plaintext that will correspond to a ciphertext of the
  * given length. */
 size_t olm_pk_max_plaintext_length(
@@ -18,6 +18,7 @@
 #include "olm/crypto.h"
 #include "olm/list.hh"
 #include "olm/error.h"
+#include "olm/key_store.hh"
 
 struct _olm_cipher;
 
@@ -60,10 +61,165 @@ struct SkippedMessageKey {
 };
 
 
+/** A receiver chain derived for a ratchet key that no message has been
+ * decrypted with yet, and the root key that would come with it. */
+struct PendingChain {
+    ReceiverChain chain;
+    SharedKey root_key;
+};
+
+
 static std::size_t const MAX_RECEIVER_CHAINS = 5;
+static std::size_t const MAX_PENDING_CHAINS = 2;
+/** The number of skipped message keys a ratchet holds unless it is created
+ * with a larger capacity. */
 static std::size_t const MAX_SKIPPED_MESSAGE_KEYS = 40;
 
 
+/**
+ * The message keys a ratchet has skipped over, held in storage supplied by
+ * the owner.
+ *
+ * Keys are kept in a ring buffer in the order they were skipped, so that the
+ * oldest key is discarded when the ring is full. An open-addressed index on
+ * the ratchet key and message index finds and removes keys in constant time.
+ * Removing a key from the middle of the ring leaves a hole, which is reclaimed
+ * once the keys either side of it have gone.
+ */
+class SkippedMessageKeyStore {
+public:
+    /** The largest capacity a store can have. */
+    static std::size_t const MAX_CAPACITY = std::size_t(1) << 20;
+
+    /** The number of bytes of storage needed for a store of the given
+     * capacity. */
+    static constexpr std::size_t storage_size(std::size_t capacity) {
+        return capacity * sizeof(SkippedMessageKey)
+            + slot_index_size(capacity) * sizeof(std::uint32_t)
+            + (capacity + 31) / 32 * sizeof(std::uint32_t);
+    }
+
+    /** Use storage_size(capacity) bytes at storage, aligned for a
+     * SkippedMessageKey, for an empty store holding up to capacity keys.
+     * The capacity must be at least 1. */
+    void init(void * storage, std::size_t capacity);
+
+    /** Remove all the keys, clearing their memory. */
+    void clear();
+
+    std::size_t capacity() const { return _capacity; }
+    std::size_t size() const { return _size; }
+
+    /** Changes whenever a key is added or removed, so that a delta pickle
+     * can tell whether the keys need pickling again. It isn't pickled. */
+    std::uint32_t version() const { return _version; }
+
+    /** Make a slot for a key newer than all the others, discarding the
+     * oldest key if the store is full. It can't be found until it is set and
+     * passed to add_to_index(). Slots are only reused once every other key
+     * has been indexed, as this may move them. */
+    SkippedMessageKey * push_newest();
+
+    /** Make a slot for a key older than all the others. Returns 0 if the
+     * store is full. */
+    SkippedMessageKey * push_oldest();
+
+    /** Make a key findable by its ratchet key and message index */
+    void add_to_index(SkippedMessageKey const * key);
+
+    /** Find the key for a message, or 0 if there isn't one */
+    SkippedMessageKey * find(
+        std::uint8_t const * ratchet_key, std::uint32_t index
+    );
+
+    /** Remove a key from the store, clearing its memory */
+    void erase(SkippedMessageKey * key);
+
+    /** Iterates over the keys from newest to oldest */
+    class const_iterator {
+    public:
+        SkippedMessageKey const & operator*() const {
+            return _store->_keys[_store->slot_at(_pos)];
+        }
+        SkippedMessageKey const * operator->() const {
+            return &**this;
+        }
+        const_iterator & operator++() {
+            do {
+                ++_pos;
+            } while (
+                _pos != _store->_span
+                    && !_store->is_live(_store->slot_at(_pos))
+            );
+            return *this;
+        }
+        bool operator!=(const_iterator const & other) const {
+            return _pos != other._pos;
+        }
+    private:
+        friend class SkippedMessageKeyStore;
+        const_iterator(
+            SkippedMessageKeyStore const * store, std::uint32_t pos
+        ) : _store(store), _pos(pos) {}
+        SkippedMessageKeyStore const * _store;
+        /* the distance back from the newest slot */
+        std::uint32_t _pos;
+    };
+
+    /* The ends of the ring are always live, so iteration can start at the
+     * newest slot without skipping. */
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, _span); }
+
+private:
+    std::uint32_t slot_of(SkippedMessageKey const * key) const {
+        return std::uint32_t(key - _keys);
+    }
+    /** The slot pos places back from the newest */
+    std::uint32_t slot_at(std::uint32_t pos) const {
+        return (_head + _capacity - 1 - pos) % _capacity;
+    }
+    bool is_live(std::uint32_t slot) const {
+        return (_live[slot / 32] >> (slot % 32)) & 1;
+    }
+    void set_live(std::uint32_t slot, bool live);
+    void remove(std::uint32_t slot);
+    void trim();
+    void compact();
+
+    /** Hashes the ratchet key and message index in a slot, for the index */
+    struct Home {
+        SkippedMessageKeyStore const * store;
+        std::uint32_t operator()(std::uint32_t slot) const;
+    };
+
+    SkippedMessageKey * _keys;
+    SlotIndex _index;
+    std::uint32_t * _live;
+    std::uint32_t _capacity;
+    /* the slot after the newest key */
+    std::uint32_t _head;
+    /* the number of slots from the oldest key to the newest, holes included */
+    std::uint32_t _span;
+    std::uint32_t _size;
+    std::uint32_t _version;
+};
+
+
+/** How likely a ratchet is to be able to decrypt a message, judging only by
+ * its headers */
+enum struct DecryptHint {
+    /** The message can't be decrypted */
+    IMPOSSIBLE = 0,
+    /** The message would start a new receiver chain. Checking it needs a
+     * key exchange */
+    NEW_CHAIN = 1,
+    /** The message is on a receiver chain we have, and we still have the
+     * key for it or can reach it */
+    KNOWN_CHAIN = 2,
+};
+
+
 struct KdfInfo {
     std::uint8_t const * root_info;
     std::size_t root_info_length;
@@ -78,6 +234,16 @@ struct Ratchet {
         KdfInfo const & kdf_info,
         _olm_cipher const *ratchet_cipher
     );
+    /** A ratchet holding up to capacity skipped message keys. If capacity is
+     * more than MAX_SKIPPED_MESSAGE_KEYS then the keys are kept in the
+     * SkippedMessageKeyStore::storage_size(capacity) bytes at storage. */
+    Ratchet(
+        KdfInfo const & kdf_info,
+        _olm_cipher const *ratchet_cipher,
+        void * storage, std::size_t capacity
+    );
+    Ratchet(Ratchet const &) = delete;
+    Ratchet & operator=(Ratchet const &) = delete;
 
     /** A some strings identifying the application to feed into the KDF. */
     KdfInfo const & kdf_info;
@@ -88,6 +254,11 @@ struct Ratchet {
     /** The last error that happened encrypting or decrypting a message. */
     OlmErrorCode last_error;
 
+    /** The most steps decrypt may advance a chain by to reach the key for a
+     * message, or 0 for no limit besides the maximum message gap. It isn't
+     * pickled. */
+    std::uint32_t work_budget;
+
     /** The root key is used to generate chain keys from the ephemeral keys.
      * A new root_key derived each time a new chain is started. */
     SharedKey root_key;
@@ -102,9 +273,16 @@ struct Ratchet {
      * received yet. */
     List<ReceiverChain, MAX_RECEIVER_CHAINS> receiver_chains;
 
-    /** List of message keys we've skipped over when advancing the receiver
+    /** The message keys we've skipped over when advancing the receiver
      * chain. */
-    List<SkippedMessageKey, MAX_SKIPPED_MESSAGE_KEYS> skipped_message_keys;
+    SkippedMessageKeyStore skipped_message_keys;
+
+    /** The chains derived for new ratchet keys while checking messages, so
+     * that a chain doesn't need deriving again when it is accepted, or when
+     * another message with the same key is checked first. They depend on
+     * the root key and our ratchet key, so are cleared when those change.
+     * They aren't pickled. */
+    List<PendingChain, MAX_PENDING_CHAINS> pending_chains;
 
     /** Initialise the session using a shared secret and the public part of the
      * remote's first ratchet key */
@@ -148,6 +326,14 @@ struct Ratchet {
         std::uint8_t const * input, std::size_t input_length
     );
 
+    /** Guess whether decrypt could succeed for a message, from its headers
+     * alone. The input can stop anywhere after the message counter. This
+     * doesn't check the MAC, so a message we can't decrypt can still get
+     * KNOWN_CHAIN or NEW_CHAIN. */
+    DecryptHint decrypt_hint(
+        std::uint8_t const * input, std::size_t input_length
+    );
+
     /** Decrypt a message. Returns the length of the decrypted plain-text or
      * std::size_t(-1) on failure. On failure last_error will be set with an
      * error code. The last_error will be OUTPUT_BUFFER_TOO_SMALL if the
@@ -155,11 +341,18 @@ struct Ratchet {
      * BAD_MESSAGE_VERSION if the message was encrypted with an unsupported
      * version of the protocol. The last_error will be BAD_MESSAGE_FORMAT if
      * the message headers could not be decoded. The last_error will be
-     * BAD_MESSAGE_MAC if the message could not be verified */
+     * BAD_MESSAGE_MAC if the message could not be verified. The last_error
+     * will be WORK_BUDGET_EXCEEDED if reaching the key for the message would
+     * take more steps than the work budget allows. */
     std::size_t decrypt(
         std::uint8_t const * input, std::size_t input_length,
         std::uint8_t * plaintext, std::size_t max_plaintext_length
     );
+
+private:
+    alignas(SkippedMessageKey) std::uint8_t default_storage[
+        SkippedMessageKeyStore::storage_size(MAX_SKIPPED_MESSAGE_KEYS)
+    ];
 };
 
 
@@ -181,4 +374,44 @@ std::uint8_t const * unpickle(
 );
 
 
+/** The number of bytes in a snapshot of a ratchet: the root key, the sender
+ * chain and each receiver chain, pickled into slots of fixed size. */
+std::size_t const RATCHET_SNAPSHOT_LENGTH = OLM_SHARED_KEY_LENGTH
+    + 4 + 2 * CURVE25519_KEY_LENGTH + OLM_SHARED_KEY_LENGTH + 4
+    + 4 + MAX_RECEIVER_CHAINS * (CURVE25519_KEY_LENGTH + OLM_SHARED_KEY_LENGTH + 4);
+
+
+/** Write a snapshot of the ratchet to RATCHET_SNAPSHOT_LENGTH bytes at
+ * snapshot, for a later delta pickle to compare against. */
+void take_snapshot(
+    std::uint8_t * snapshot,
+    Ratchet const & value
+);
+
+
+std::size_t pickle_delta_length(
+    Ratchet const & value,
+    std::uint8_t const * snapshot,
+    bool skipped_keys_changed
+);
+
+
+/** Pickle the parts of the ratchet that differ from a snapshot of it. The
+ * skipped message keys aren't in the snapshot, so they are pickled in full
+ * if skipped_keys_changed is set. */
+std::uint8_t * pickle_delta(
+    std::uint8_t * pos,
+    Ratchet const & value,
+    std::uint8_t const * snapshot,
+    bool skipped_keys_changed
+);
+
+
+/** Apply a delta pickle to a ratchet in the state its snapshot was of */
+std::uint8_t const * unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    Ratchet & value
+);
+
+
 } // namespace olm
@@ -26,9 +26,27 @@ enum struct MessageType {
     MESSAGE = 1,
 };
 
+/** The number of bytes in a snapshot of a session */
+std::size_t const SESSION_SNAPSHOT_LENGTH =
+    1 + 3 * CURVE25519_KEY_LENGTH + RATCHET_SNAPSHOT_LENGTH;
+
+/** What a session was like when it was last pickled or unpickled, in full or
+ * as a delta. A delta pickle holds the changes since then. */
+struct SessionJournal {
+    /** The number of deltas since the last full pickle */
+    std::uint32_t sequence;
+    /** The version() of the skipped message keys */
+    std::uint32_t skipped_keys_version;
+    std::uint8_t snapshot[SESSION_SNAPSHOT_LENGTH];
+};
+
 struct Session {
 
     Session();
+    /** A session holding up to capacity skipped message keys. If capacity is
+     * more than MAX_SKIPPED_MESSAGE_KEYS then the keys are kept in the
+     * SkippedMessageKeyStore::storage_size(capacity) bytes at storage. */
+    Session(void * storage, std::size_t capacity);
 
     Ratchet ratchet;
     OlmErrorCode last_error;
@@ -39,6 +57,9 @@ struct Session {
     _olm_curve25519_public_key alice_base_key;
     _olm_curve25519_public_key bob_one_time_key;
 
+    /** The base for the next delta pickle. It isn't pickled. */
+    SessionJournal journal;
+
     /** The number of random bytes that are needed to create a new outbound
      * session. This will be 64 bytes since two ephemeral keys are needed. */
     std::size_t new_outbound_session_random_length();
@@ -118,6 +139,13 @@ struct Session {
         std::uint8_t const * message, std::size_t message_length
     );
 
+    /** Guess whether decrypt could succeed for a message, from its headers
+     * alone. The message can be cut short anywhere after the headers. */
+    DecryptHint decrypt_hint(
+        MessageType message_type,
+        std::uint8_t const * message, std::size_t message_length
+    );
+
     /** Decrypt a message. Returns the length of the decrypted plain-text or
      * std::size_t(-1) on failure. On failure last_error will be set with an
      * error code. The last_error will be OUTPUT_BUFFER_TOO_SMALL if the
@@ -159,6 +187,36 @@ std::uint8_t const * unpickle(
 );
 
 
+/** Make the current state of the session the base for the next delta pickle,
+ * as pickling or unpickling it in full does. */
+void reset_journal(
+    Session & value
+);
+
+
+std::size_t pickle_delta_length(
+    Session const & value
+);
+
+
+/** Pickle the changes to the session since it was last pickled or
+ * unpickled, in full or as a delta, and make its current state the base for
+ * the next delta. */
+std::uint8_t * pickle_delta(
+    std::uint8_t * pos,
+    Session & value
+);
+
+
+/** Apply a delta pickle to a session in the state the delta was taken from.
+ * Sets last_error to BAD_PICKLE_DELTA and returns end if it is in any other
+ * state. */
+std::uint8_t const * unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    Session & value
+);
+
+
 } // namespace olm
 
 #endif /* OLM_SESSION_HH_ */
@@ -0,0 +1,193 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OLM_SESSION_ARCHIVE_H_
+#define OLM_SESSION_ARCHIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "olm/inbound_group_session.h"
+#include "olm/pickle_key.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SessionArchive Inbound group session archives
+ * A session archive holds many inbound group sessions in one buffer, each
+ * pickled and encrypted on its own, with an index sorted by session id and
+ * optional room id tags. It is meant to be written to a file and mapped into
+ * memory: opening an archive only checks its header, and a session is only
+ * decrypted when it is looked up, so the cost of loading an archive depends
+ * on how many sessions are used rather than how many it holds. The archive
+ * is never written to while it is read.
+ * @{
+ */
+
+typedef struct OlmSessionArchive OlmSessionArchive;
+
+/** A null terminated string describing the most recent error to happen to a
+ * session archive. */
+const char * olm_session_archive_last_error(
+    const OlmSessionArchive * archive
+);
+
+/** The size of a session archive object in bytes. */
+size_t olm_session_archive_size(void);
+
+/** Initialize a session archive object using the supplied memory.
+ * The supplied memory must be at least `olm_session_archive_size()` bytes. */
+OlmSessionArchive * olm_session_archive(
+    void * memory
+);
+
+/** Clears the memory used to back a session archive object. The archive
+ * buffer itself is left as it is. */
+size_t olm_clear_session_archive(
+    OlmSessionArchive * archive
+);
+
+/** The number of bytes needed to write an archive of the given sessions.
+ *
+ * @param[in] sessions the sessions to archive.
+ * @param[in] room_ids the room id to tag each session with, or NULL if no
+ *    session is tagged. An entry may be NULL to leave that session untagged.
+ * @param[in] room_id_lengths the length of each room id, or NULL if room_ids
+ *    is NULL.
+ * @param[in] count the number of sessions.
+ * @param[in] pickle_key the key the sessions will be encrypted with.
+ */
+size_t olm_session_archive_length(
+    OlmInboundGroupSession * const * sessions,
+    uint8_t const * const * room_ids, size_t const * room_id_lengths,
+    size_t count,
+    const OlmPickleKey * pickle_key
+);
+
+/** Writes an archive of the given sessions, taking the same arguments as
+ * `olm_session_archive_length()`, and opens the archive object on it.
+ *
+ * @return the length of the archive, or `olm_error()` on failure. If the
+ * output buffer is smaller than `olm_session_archive_length()` then
+ * `olm_session_archive_last_error()` will be `OUTPUT_BUFFER_TOO_SMALL`. If two
+ * of the sessions have the same id, or the archive would be 4GiB or more,
+ * then it will be `BAD_SESSION_ARCHIVE`.
+ */
+size_t olm_write_session_archive(
+    OlmSessionArchive * archive,
+    OlmInboundGroupSession * const * sessions,
+    uint8_t const * const * room_ids, size_t const * room_id_lengths,
+    size_t count,
+    const OlmPickleKey * pickle_key,
+    void * output, size_t output_length
+);
+
+/** Opens the archive object on an archive written by
+ * `olm_write_session_archive()`. Only the header is read, so this takes the
+ * same time however many sessions the archive holds. The buffer must stay
+ * valid, and unchanged, while the archive object is used.
+ *
+ * @return the number of sessions in the archive, or `olm_error()` on failure.
+ * If the buffer is too short for its header and index, or has an unknown
+ * version, then `olm_session_archive_last_error()` will be
+ * `BAD_SESSION_ARCHIVE`.
+ */
+size_t olm_open_session_archive(
+    OlmSessionArchive * archive,
+    void const * data, size_t data_length
+);
+
+/** The number of sessions in the archive. Entries are numbered from 0 in
+ * order of session id. */
+size_t olm_session_archive_entry_count(
+    const OlmSessionArchive * archive
+);
+
+/** Finds the entry for a session, by the id given by
+ * `olm_inbound_group_session_id()`.
+ *
+ * @return the entry number, or `olm_error()` on failure. If there is no such
+ * session then `olm_session_archive_last_error()` will be
+ * `UNKNOWN_SESSION_ID`.
+ */
+size_t olm_session_archive_find(
+    OlmSessionArchive * archive,
+    uint8_t const * session_id, size_t session_id_length
+);
+
+/** Finds the entries tagged with a room id. Up to max_entries of their entry
+ * numbers are written to entries, in order.
+ *
+ * @return the number of entries tagged with the room id, which may be more
+ * than max_entries, or `olm_error()` on failure.
+ */
+size_t olm_session_archive_find_room(
+    OlmSessionArchive * archive,
+    uint8_t const * room_id, size_t room_id_length,
+    size_t * entries, size_t max_entries
+);
+
+/** Copies the session id of an entry to the output buffer.
+ *
+ * @return the length of the session id, or `olm_error()` on failure. If the
+ * output buffer is too small then `olm_session_archive_last_error()` will be
+ * `OUTPUT_BUFFER_TOO_SMALL`.
+ */
+size_t olm_session_archive_session_id(
+    OlmSessionArchive * archive, size_t entry,
+    uint8_t * session_id, size_t session_id_length
+);
+
+/** Copies the room id an entry is tagged with to the output buffer.
+ *
+ * @return the length of the room id, which is 0 if the entry has no tag, or
+ * `olm_error()` on failure. If the output buffer is too small then
+ * `olm_session_archive_last_error()` will be `OUTPUT_BUFFER_TOO_SMALL`.
+ */
+size_t olm_session_archive_room_id(
+    OlmSessionArchive * archive, size_t entry,
+    uint8_t * room_id, size_t room_id_length
+);
+
+/** The number of bytes of scratch space needed to load an entry. */
+size_t olm_session_archive_scratch_length(
+    OlmSessionArchive * archive, size_t entry
+);
+
+/** Loads the session of an entry, as
+ * `olm_unpickle_inbound_group_session_binary_with_key()` does: its pickle is
+ * decrypted into scratch, which must be at least
+ * `olm_session_archive_scratch_length()` bytes.
+ *
+ * @return `olm_error()` on failure. If the entry number is out of range, or
+ * its record lies outside the archive, then
+ * `olm_session_archive_last_error()` will be `BAD_SESSION_ARCHIVE`. Errors
+ * loading the session itself, such as a wrong pickle key, are reported by
+ * `olm_inbound_group_session_last_error()`.
+ */
+size_t olm_session_archive_unpickle(
+    OlmSessionArchive * archive, size_t entry,
+    OlmInboundGroupSession * session,
+    const OlmPickleKey * pickle_key,
+    void * scratch, size_t scratch_length
+);
+
+/** @} */ // end of SessionArchive group
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_SESSION_ARCHIVE_H_ */
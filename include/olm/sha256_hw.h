@@ -0,0 +1,57 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Hardware accelerated SHA-256 compression functions. lib/crypto-algorithms
+ * picks one of these on first use, so everything built on sha256_update
+ * gets them automatically.
+ */
+
+#ifndef OLM_SHA256_HW_H_
+#define OLM_SHA256_HW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Compresses a number of consecutive 64 byte blocks into a SHA-256 state */
+typedef void (*_olm_sha256_blocks_function)(
+    uint32_t state[8], uint8_t const * data, size_t blocks
+);
+
+/** SHA-256 using the SHA extensions. Requires OLM_CPU_SHA and OLM_CPU_SSE41. */
+void _olm_sha256_blocks_shani(
+    uint32_t state[8], uint8_t const * data, size_t blocks
+);
+
+/** SHA-256 with the message schedule computed using AVX2, two blocks at a
+ * time. Requires OLM_CPU_AVX2. */
+void _olm_sha256_blocks_avx2(
+    uint32_t state[8], uint8_t const * data, size_t blocks
+);
+
+/**
+ * Returns the fastest SHA-256 compression function supported by the CPU we
+ * are running on, or NULL if the portable implementation should be used.
+ */
+_olm_sha256_blocks_function _olm_sha256_hw_blocks(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_SHA256_HW_H_ */
@@ -22,6 +22,7 @@
 #include <cstdint>
 
 struct _olm_ed25519_public_key;
+struct _olm_ed25519_prepared_public_key;
 
 namespace olm {
 
@@ -53,6 +54,29 @@ struct Utility {
         std::uint8_t const * signature, std::size_t signature_length
     );
 
+    /** As ed25519_verify, against a key prepared with
+     * _olm_crypto_ed25519_prepare_public_key. */
+    std::size_t ed25519_verify_prepared(
+        _olm_ed25519_prepared_public_key const & key,
+        std::uint8_t const * message, std::size_t message_length,
+        std::uint8_t const * signature, std::size_t signature_length
+    );
+
+    /** Verify count ed25519 signatures together. An entry whose signature is
+     * shorter than ED25519_SIGNATURE_LENGTH is rejected without being
+     * checked. results[i] is set to 1 if the i-th signature is valid and 0
+     * otherwise. Returns std::size_t(0) if every signature is valid. Returns
+     * std::size_t(-1) otherwise and last_error will be BAD_MESSAGE_MAC. */
+    std::size_t ed25519_verify_batch(
+        std::size_t count,
+        _olm_ed25519_public_key const * const * keys,
+        std::uint8_t const * const * messages,
+        std::size_t const * message_lengths,
+        std::uint8_t const * const * signatures,
+        std::size_t const * signature_lengths,
+        int * results
+    );
+
 };
 
 
@@ -17,6 +17,7 @@
 #include <memory.h>
 #include <string.h>
 #include "sha256.h"
+#include "olm/sha256_hw.h"
 
 /****************************** MACROS ******************************/
 #define ROTLEFT(a,b) (((a) << (b)) | ((a) >> (32-(b))))
@@ -41,8 +42,15 @@ static const WORD k[64] = {
 	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
 };
 
+static void sha256_blocks_select(WORD state[8], const BYTE data[], size_t blocks);
+
+// The compression function in use. Starts out pointing at a function which
+// picks the fastest implementation for this CPU on first use.
+static void (*volatile sha256_blocks)(WORD state[8], const BYTE data[], size_t blocks)
+	= sha256_blocks_select;
+
 /*********************** FUNCTION DEFINITIONS ***********************/
-void sha256_transform(SHA256_CTX *ctx, const BYTE data[])
+static void sha256_block_portable(WORD state[8], const BYTE data[])
 {
 	WORD a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
 
@@ -51,14 +59,14 @@ void sha256_transform(SHA256_CTX *ctx, const BYTE data[])
 	for ( ; i < 64; ++i)
 		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
 
-	a = ctx->state[0];
-	b = ctx->state[1];
-	c = ctx->state[2];
-	d = ctx->state[3];
-	e = ctx->state[4];
-	f = ctx->state[5];
-	g = ctx->state[6];
-	h = ctx->state[7];
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
 
 	for (i = 0; i < 64; ++i) {
 		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
@@ -73,14 +81,34 @@ void sha256_transform(SHA256_CTX *ctx, const BYTE data[])
 		a = t1 + t2;
 	}
 
-	ctx->state[0] += a;
-	ctx->state[1] += b;
-	ctx->state[2] += c;
-	ctx->state[3] += d;
-	ctx->state[4] += e;
-	ctx->state[5] += f;
-	ctx->state[6] += g;
-	ctx->state[7] += h;
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+void sha256_blocks_portable(WORD state[8], const BYTE data[], size_t blocks)
+{
+	for (; blocks > 0; --blocks, data += 64)
+		sha256_block_portable(state, data);
+}
+
+static void sha256_blocks_select(WORD state[8], const BYTE data[], size_t blocks)
+{
+	// Every thread that gets here picks the same function, so it doesn't
+	// matter if several race to store it.
+	_olm_sha256_blocks_function hw = _olm_sha256_hw_blocks();
+	sha256_blocks = hw ? (void (*)(WORD *, const BYTE *, size_t)) hw : sha256_blocks_portable;
+	sha256_blocks(state, data, blocks);
+}
+
+void sha256_transform(SHA256_CTX *ctx, const BYTE data[])
+{
+	sha256_blocks(ctx->state, data, 1);
 }
 
 void sha256_init(SHA256_CTX *ctx)
@@ -99,17 +127,35 @@ void sha256_init(SHA256_CTX *ctx)
 
 void sha256_update(SHA256_CTX *ctx, const BYTE data[], size_t len)
 {
-	WORD i;
+	size_t fill, blocks;
+
+	// Top up a partially filled buffer first
+	if (ctx->datalen > 0) {
+		fill = 64 - ctx->datalen;
+		if (fill > len)
+			fill = len;
+		memcpy(ctx->data + ctx->datalen, data, fill);
+		ctx->datalen += fill;
+		data += fill;
+		len -= fill;
+		if (ctx->datalen < 64)
+			return;
+		sha256_transform(ctx, ctx->data);
+		ctx->bitlen += 512;
+		ctx->datalen = 0;
+	}
 
-	for (i = 0; i < len; ++i) {
-		ctx->data[ctx->datalen] = data[i];
-		ctx->datalen++;
-		if (ctx->datalen == 64) {
-			sha256_transform(ctx, ctx->data);
-			ctx->bitlen += 512;
-			ctx->datalen = 0;
-		}
+	// Then compress whole blocks straight from the input
+	blocks = len / 64;
+	if (blocks > 0) {
+		sha256_blocks(ctx->state, data, blocks);
+		ctx->bitlen += 512 * (unsigned long long)blocks;
+		data += 64 * blocks;
+		len -= 64 * blocks;
 	}
+
+	memcpy(ctx->data, data, len);
+	ctx->datalen = len;
 }
 
 void sha256_final(SHA256_CTX *ctx, BYTE hash[])
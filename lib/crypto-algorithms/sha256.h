@@ -31,4 +31,12 @@ void sha256_init(SHA256_CTX *ctx);
 void sha256_update(SHA256_CTX *ctx, const BYTE data[], size_t len);
 void sha256_final(SHA256_CTX *ctx, BYTE hash[]);
 
+// Compresses one 64 byte block into the context's state, using the fastest
+// implementation the CPU supports.
+void sha256_transform(SHA256_CTX *ctx, const BYTE data[]);
+
+// Compresses 64 byte blocks into the state using the portable code,
+// whatever the CPU supports.
+void sha256_blocks_portable(WORD state[8], const BYTE data[], size_t blocks);
+
 #endif   // SHA256_H
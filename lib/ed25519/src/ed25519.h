@@ -15,6 +15,22 @@
     #define ED25519_DECLSPEC
 #endif
 
+/*
+    Use the radix 2^51 field arithmetic in fe51.c on 64-bit targets that have
+    a 128-bit multiply; everywhere else (or with ED25519_NO_FE51) use the
+    radix 2^25.5 ref10 arithmetic in fe.c.
+*/
+#if !defined(ED25519_NO_FE51) && defined(__SIZEOF_INT128__) && defined(__LP64__)
+    #define ED25519_FE51
+#endif
+
+
+/*
+    Size of the table ed25519_prepare_public_key fills in: the odd multiples
+    A,3A,...,15A of the decompressed key, which is the same size in both
+    field representations.
+*/
+#define ED25519_PREPARED_TABLE_SIZE 1280
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,11 +40,23 @@ extern "C" {
 int ED25519_DECLSPEC ed25519_create_seed(unsigned char *seed);
 #endif
 
+#ifdef ED25519_BASE_WINDOW
+void ED25519_DECLSPEC ed25519_init_base_table(void);
+#endif
+
 void ED25519_DECLSPEC ed25519_create_keypair(unsigned char *public_key, unsigned char *private_key, const unsigned char *seed);
 void ED25519_DECLSPEC ed25519_sign(unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key, const unsigned char *private_key);
 int ED25519_DECLSPEC ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key);
+int ED25519_DECLSPEC ed25519_prepare_public_key(unsigned char *table, const unsigned char *public_key);
+int ED25519_DECLSPEC ed25519_verify_prepared(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key, const unsigned char *table);
+int ED25519_DECLSPEC ed25519_verify_batch(const unsigned char *const *signatures, const unsigned char *const *messages, const size_t *message_lens, const unsigned char *const *public_keys, size_t count, int *valid);
+void ED25519_DECLSPEC ed25519_hram(unsigned char *h, const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key);
+int ED25519_DECLSPEC ed25519_verify_batch_hram(const unsigned char *const *signatures, const unsigned char *const *hrams, const unsigned char *const *public_keys, size_t count, int *valid);
 void ED25519_DECLSPEC ed25519_add_scalar(unsigned char *public_key, unsigned char *private_key, const unsigned char *scalar);
 void ED25519_DECLSPEC ed25519_key_exchange(unsigned char *shared_secret, const unsigned char *public_key, const unsigned char *private_key);
+void ED25519_DECLSPEC ed25519_x25519(unsigned char *shared_secret, const unsigned char *private_key, const unsigned char *public_key);
+void ED25519_DECLSPEC ed25519_x25519_base(unsigned char *public_key, const unsigned char *private_key);
+void ED25519_DECLSPEC ed25519_x25519_base_batch(unsigned char *const *public_keys, const unsigned char *const *private_keys, size_t count);
 
 
 #ifdef __cplusplus
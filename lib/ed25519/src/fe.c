@@ -1,6 +1,13 @@
 #include "fixedint.h"
 #include "fe.h"
 
+/*
+    The limb-specific routines are replaced by fe51.c when ED25519_FE51 is
+    defined; fe_invert, fe_pow22523, fe_isnegative and fe_isnonzero are
+    written in terms of the other routines and are shared.
+*/
+#ifndef ED25519_FE51
+
 #ifndef ED25519_LOAD_BYTES
 #define ED25519_LOAD_BYTES
 
@@ -363,6 +370,8 @@ void fe_frombytes(fe h, const unsigned char *s) {
 
 
 
+#endif /* ED25519_FE51 */
+
 void fe_invert(fe out, const fe z) {
     fe t0;
     fe t1;
@@ -523,6 +532,8 @@ int fe_isnonzero(const fe f) {
 
 
 
+#ifndef ED25519_FE51
+
 /*
     h = f * g
     Can overlap h with f or g.
@@ -880,6 +891,8 @@ void fe_neg(fe h, const fe f) {
 }
 
 
+#endif /* ED25519_FE51 */
+
 void fe_pow22523(fe out, const fe z) {
     fe t0;
     fe t1;
@@ -966,6 +979,8 @@ void fe_pow22523(fe out, const fe z) {
 }
 
 
+#ifndef ED25519_FE51
+
 /*
 h = f * f
 Can overlap h with f.
@@ -1491,3 +1506,5 @@ void fe_tobytes(unsigned char *s, const fe h) {
     s[30] = (unsigned char) (h9 >> 10);
     s[31] = (unsigned char) (h9 >> 18);
 }
+
+#endif /* ED25519_FE51 */
@@ -0,0 +1,389 @@
+#include "fixedint.h"
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+    Radix 2^51 field arithmetic for 64-bit targets with a 128-bit multiply.
+
+    Limbs are kept "loose": fe_add does not carry, and the outputs of
+    fe_mul/fe_sq/fe_sub are only weakly reduced (each limb a little above
+    2^51). Every consumer of these functions in ge.c and x25519.c keeps the
+    inputs to fe_mul/fe_sq below 2^54 per limb, which keeps the 128-bit
+    accumulators comfortably below 2^115.
+*/
+
+typedef unsigned __int128 fe_uint128;
+
+#define FE51_MASK ((uint64_t) 0x7ffffffffffff)
+
+static uint64_t fe51_load_8(const unsigned char *in) {
+    uint64_t result;
+
+    result = (uint64_t) in[0];
+    result |= ((uint64_t) in[1]) << 8;
+    result |= ((uint64_t) in[2]) << 16;
+    result |= ((uint64_t) in[3]) << 24;
+    result |= ((uint64_t) in[4]) << 32;
+    result |= ((uint64_t) in[5]) << 40;
+    result |= ((uint64_t) in[6]) << 48;
+    result |= ((uint64_t) in[7]) << 56;
+
+    return result;
+}
+
+static void fe51_store_8(unsigned char *out, uint64_t in) {
+    out[0] = (unsigned char) in;
+    out[1] = (unsigned char) (in >> 8);
+    out[2] = (unsigned char) (in >> 16);
+    out[3] = (unsigned char) (in >> 24);
+    out[4] = (unsigned char) (in >> 32);
+    out[5] = (unsigned char) (in >> 40);
+    out[6] = (unsigned char) (in >> 48);
+    out[7] = (unsigned char) (in >> 56);
+}
+
+/*
+    Carry the 128-bit column sums r0..r4 into h.
+*/
+static void fe51_carry_wide(
+    fe h, fe_uint128 r0, fe_uint128 r1, fe_uint128 r2, fe_uint128 r3, fe_uint128 r4
+) {
+    uint64_t h0, h1, h2, h3, h4;
+
+    r1 += (uint64_t) (r0 >> 51); h0 = (uint64_t) r0 & FE51_MASK;
+    r2 += (uint64_t) (r1 >> 51); h1 = (uint64_t) r1 & FE51_MASK;
+    r3 += (uint64_t) (r2 >> 51); h2 = (uint64_t) r2 & FE51_MASK;
+    r4 += (uint64_t) (r3 >> 51); h3 = (uint64_t) r3 & FE51_MASK;
+    h0 += (uint64_t) (r4 >> 51) * 19; h4 = (uint64_t) r4 & FE51_MASK;
+    h1 += h0 >> 51; h0 &= FE51_MASK;
+
+    h[0] = h0;
+    h[1] = h1;
+    h[2] = h2;
+    h[3] = h3;
+    h[4] = h4;
+}
+
+/*
+    h = 0
+*/
+
+void fe_0(fe h) {
+    h[0] = 0;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+
+
+/*
+    h = 1
+*/
+
+void fe_1(fe h) {
+    h[0] = 1;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+
+
+/*
+    h = f + g
+    Can overlap h with f or g.
+
+    No carries are performed; the result is only used as an input to
+    fe_mul, fe_sq or fe_sub.
+*/
+
+void fe_add(fe h, const fe f, const fe g) {
+    h[0] = f[0] + g[0];
+    h[1] = f[1] + g[1];
+    h[2] = f[2] + g[2];
+    h[3] = f[3] + g[3];
+    h[4] = f[4] + g[4];
+}
+
+
+
+/*
+    Replace (f,g) with (g,g) if b == 1;
+    replace (f,g) with (f,g) if b == 0.
+
+    Preconditions: b in {0,1}.
+*/
+
+void fe_cmov(fe f, const fe g, unsigned int b) {
+    uint64_t mask = (uint64_t) 0 - (uint64_t) b;
+
+    f[0] ^= mask & (f[0] ^ g[0]);
+    f[1] ^= mask & (f[1] ^ g[1]);
+    f[2] ^= mask & (f[2] ^ g[2]);
+    f[3] ^= mask & (f[3] ^ g[3]);
+    f[4] ^= mask & (f[4] ^ g[4]);
+}
+
+
+
+/*
+    Replace (f,g) with (g,f) if b == 1;
+    replace (f,g) with (f,g) if b == 0.
+
+    Preconditions: b in {0,1}.
+*/
+
+void fe_cswap(fe f, fe g, unsigned int b) {
+    uint64_t mask = (uint64_t) 0 - (uint64_t) b;
+    uint64_t x0 = mask & (f[0] ^ g[0]);
+    uint64_t x1 = mask & (f[1] ^ g[1]);
+    uint64_t x2 = mask & (f[2] ^ g[2]);
+    uint64_t x3 = mask & (f[3] ^ g[3]);
+    uint64_t x4 = mask & (f[4] ^ g[4]);
+
+    f[0] ^= x0;
+    f[1] ^= x1;
+    f[2] ^= x2;
+    f[3] ^= x3;
+    f[4] ^= x4;
+    g[0] ^= x0;
+    g[1] ^= x1;
+    g[2] ^= x2;
+    g[3] ^= x3;
+    g[4] ^= x4;
+}
+
+
+
+/*
+    h = f
+*/
+
+void fe_copy(fe h, const fe f) {
+    h[0] = f[0];
+    h[1] = f[1];
+    h[2] = f[2];
+    h[3] = f[3];
+    h[4] = f[4];
+}
+
+
+
+/*
+    Ignores top bit of s.
+*/
+
+void fe_frombytes(fe h, const unsigned char *s) {
+    h[0] = fe51_load_8(s) & FE51_MASK;
+    h[1] = (fe51_load_8(s + 6) >> 3) & FE51_MASK;
+    h[2] = (fe51_load_8(s + 12) >> 6) & FE51_MASK;
+    h[3] = (fe51_load_8(s + 19) >> 1) & FE51_MASK;
+    h[4] = (fe51_load_8(s + 24) >> 12) & FE51_MASK;
+}
+
+
+
+/*
+    h = f * g
+    Can overlap h with f or g.
+*/
+
+void fe_mul(fe h, const fe f, const fe g) {
+    uint64_t f0 = f[0];
+    uint64_t f1 = f[1];
+    uint64_t f2 = f[2];
+    uint64_t f3 = f[3];
+    uint64_t f4 = f[4];
+    uint64_t g0 = g[0];
+    uint64_t g1 = g[1];
+    uint64_t g2 = g[2];
+    uint64_t g3 = g[3];
+    uint64_t g4 = g[4];
+    uint64_t g1_19 = 19 * g1;
+    uint64_t g2_19 = 19 * g2;
+    uint64_t g3_19 = 19 * g3;
+    uint64_t g4_19 = 19 * g4;
+    fe_uint128 r0, r1, r2, r3, r4;
+
+    r0 = (fe_uint128) f0 * g0 + (fe_uint128) f1 * g4_19 + (fe_uint128) f2 * g3_19
+       + (fe_uint128) f3 * g2_19 + (fe_uint128) f4 * g1_19;
+    r1 = (fe_uint128) f0 * g1 + (fe_uint128) f1 * g0 + (fe_uint128) f2 * g4_19
+       + (fe_uint128) f3 * g3_19 + (fe_uint128) f4 * g2_19;
+    r2 = (fe_uint128) f0 * g2 + (fe_uint128) f1 * g1 + (fe_uint128) f2 * g0
+       + (fe_uint128) f3 * g4_19 + (fe_uint128) f4 * g3_19;
+    r3 = (fe_uint128) f0 * g3 + (fe_uint128) f1 * g2 + (fe_uint128) f2 * g1
+       + (fe_uint128) f3 * g0 + (fe_uint128) f4 * g4_19;
+    r4 = (fe_uint128) f0 * g4 + (fe_uint128) f1 * g3 + (fe_uint128) f2 * g2
+       + (fe_uint128) f3 * g1 + (fe_uint128) f4 * g0;
+
+    fe51_carry_wide(h, r0, r1, r2, r3, r4);
+}
+
+
+
+/*
+    h = f * 121666
+    Can overlap h with f.
+*/
+
+void fe_mul121666(fe h, fe f) {
+    fe51_carry_wide(
+        h,
+        (fe_uint128) f[0] * 121666,
+        (fe_uint128) f[1] * 121666,
+        (fe_uint128) f[2] * 121666,
+        (fe_uint128) f[3] * 121666,
+        (fe_uint128) f[4] * 121666
+    );
+}
+
+
+
+/*
+    h = -f
+*/
+
+void fe_neg(fe h, const fe f) {
+    fe zero;
+
+    fe_0(zero);
+    fe_sub(h, zero, f);
+}
+
+
+
+/*
+    Column sums for f * f, shared by fe_sq and fe_sq2.
+*/
+
+#define FE51_SQUARE_COLUMNS(f) \
+    uint64_t f0 = f[0]; \
+    uint64_t f1 = f[1]; \
+    uint64_t f2 = f[2]; \
+    uint64_t f3 = f[3]; \
+    uint64_t f4 = f[4]; \
+    uint64_t f0_2 = 2 * f0; \
+    uint64_t f1_2 = 2 * f1; \
+    uint64_t f3_19 = 19 * f3; \
+    uint64_t f4_19 = 19 * f4; \
+    uint64_t f3_38 = 38 * f3; \
+    uint64_t f4_38 = 38 * f4; \
+    fe_uint128 r0 = (fe_uint128) f0 * f0 + (fe_uint128) f1 * f4_38 + (fe_uint128) f2 * f3_38; \
+    fe_uint128 r1 = (fe_uint128) f0_2 * f1 + (fe_uint128) f2 * f4_38 + (fe_uint128) f3 * f3_19; \
+    fe_uint128 r2 = (fe_uint128) f0_2 * f2 + (fe_uint128) f1 * f1 + (fe_uint128) f3 * f4_38; \
+    fe_uint128 r3 = (fe_uint128) f0_2 * f3 + (fe_uint128) f1_2 * f2 + (fe_uint128) f4 * f4_19; \
+    fe_uint128 r4 = (fe_uint128) f0_2 * f4 + (fe_uint128) f1_2 * f3 + (fe_uint128) f2 * f2
+
+
+
+/*
+    h = f * f
+    Can overlap h with f.
+*/
+
+void fe_sq(fe h, const fe f) {
+    FE51_SQUARE_COLUMNS(f);
+
+    fe51_carry_wide(h, r0, r1, r2, r3, r4);
+}
+
+
+
+/*
+    h = 2 * f * f
+    Can overlap h with f.
+*/
+
+void fe_sq2(fe h, const fe f) {
+    FE51_SQUARE_COLUMNS(f);
+
+    fe51_carry_wide(h, r0 << 1, r1 << 1, r2 << 1, r3 << 1, r4 << 1);
+}
+
+#undef FE51_SQUARE_COLUMNS
+
+
+
+/*
+    h = f - g
+    Can overlap h with f or g.
+
+    g is carried first so that adding 2*p to f is enough to keep every
+    limb non-negative.
+*/
+
+void fe_sub(fe h, const fe f, const fe g) {
+    uint64_t g0 = g[0];
+    uint64_t g1 = g[1];
+    uint64_t g2 = g[2];
+    uint64_t g3 = g[3];
+    uint64_t g4 = g[4];
+
+    g1 += g0 >> 51; g0 &= FE51_MASK;
+    g2 += g1 >> 51; g1 &= FE51_MASK;
+    g3 += g2 >> 51; g2 &= FE51_MASK;
+    g4 += g3 >> 51; g3 &= FE51_MASK;
+    g0 += (g4 >> 51) * 19; g4 &= FE51_MASK;
+
+    h[0] = (f[0] + (uint64_t) 0xfffffffffffda) - g0;
+    h[1] = (f[1] + (uint64_t) 0xffffffffffffe) - g1;
+    h[2] = (f[2] + (uint64_t) 0xffffffffffffe) - g2;
+    h[3] = (f[3] + (uint64_t) 0xffffffffffffe) - g3;
+    h[4] = (f[4] + (uint64_t) 0xffffffffffffe) - g4;
+}
+
+
+
+/*
+    Fully reduce h mod 2^255 - 19 and write it out little-endian.
+*/
+
+void fe_tobytes(unsigned char *s, const fe h) {
+    uint64_t t0 = h[0];
+    uint64_t t1 = h[1];
+    uint64_t t2 = h[2];
+    uint64_t t3 = h[3];
+    uint64_t t4 = h[4];
+    uint64_t q;
+
+    /* two carry passes leave t < 2^255 + 19 */
+    t1 += t0 >> 51; t0 &= FE51_MASK;
+    t2 += t1 >> 51; t1 &= FE51_MASK;
+    t3 += t2 >> 51; t2 &= FE51_MASK;
+    t4 += t3 >> 51; t3 &= FE51_MASK;
+    t0 += (t4 >> 51) * 19; t4 &= FE51_MASK;
+
+    t1 += t0 >> 51; t0 &= FE51_MASK;
+    t2 += t1 >> 51; t1 &= FE51_MASK;
+    t3 += t2 >> 51; t2 &= FE51_MASK;
+    t4 += t3 >> 51; t3 &= FE51_MASK;
+    t0 += (t4 >> 51) * 19; t4 &= FE51_MASK;
+
+    /* q = 1 if t >= p, else 0 */
+    q = (t0 + 19) >> 51;
+    q = (t1 + q) >> 51;
+    q = (t2 + q) >> 51;
+    q = (t3 + q) >> 51;
+    q = (t4 + q) >> 51;
+
+    /* t - q*p = t + 19*q - q*2^255 */
+    t0 += 19 * q;
+    t1 += t0 >> 51; t0 &= FE51_MASK;
+    t2 += t1 >> 51; t1 &= FE51_MASK;
+    t3 += t2 >> 51; t2 &= FE51_MASK;
+    t4 += t3 >> 51; t3 &= FE51_MASK;
+    t4 &= FE51_MASK;
+
+    fe51_store_8(s, t0 | (t1 << 51));
+    fe51_store_8(s + 8, (t1 >> 13) | (t2 << 38));
+    fe51_store_8(s + 16, (t2 >> 26) | (t3 << 25));
+    fe51_store_8(s + 24, (t3 >> 39) | (t4 << 12));
+}
+
+#undef FE51_MASK
+
+#endif
@@ -1,5 +1,9 @@
 #include "ge.h"
+#ifdef ED25519_FE51
+#include "precomp_data_51.h"
+#else
 #include "precomp_data.h"
+#endif
 
 
 /*
@@ -57,6 +61,27 @@ static void slide(signed char *r, const unsigned char *a) {
         }
 }
 
+/*
+Ai = A,3A,5A,7A,9A,11A,13A,15A
+*/
+
+void ge_p3_to_cached_odd_multiples(ge_cached *Ai, const ge_p3 *A) {
+    ge_p1p1 t;
+    ge_p3 u;
+    ge_p3 A2;
+    int i;
+
+    ge_p3_to_cached(&Ai[0], A);
+    ge_p3_dbl(&t, A);
+    ge_p1p1_to_p3(&A2, &t);
+
+    for (i = 1; i < 8; ++i) {
+        ge_add(&t, &A2, &Ai[i - 1]);
+        ge_p1p1_to_p3(&u, &t);
+        ge_p3_to_cached(&Ai[i], &u);
+    }
+}
+
 /*
 r = a * A + b * B
 where a = a[0]+256*a[1]+...+256^31 a[31].
@@ -65,39 +90,25 @@ B is the Ed25519 base point (x,4/5) with x positive.
 */
 
 void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+
+    ge_p3_to_cached_odd_multiples(Ai, A);
+    ge_double_scalarmult_cached_vartime(r, a, Ai, b);
+}
+
+/*
+As ge_double_scalarmult_vartime, with A given by the table
+Ai = A,3A,5A,7A,9A,11A,13A,15A from ge_p3_to_cached_odd_multiples.
+*/
+
+void ge_double_scalarmult_cached_vartime(ge_p2 *r, const unsigned char *a, const ge_cached *Ai, const unsigned char *b) {
     signed char aslide[256];
     signed char bslide[256];
-    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
     ge_p1p1 t;
     ge_p3 u;
-    ge_p3 A2;
     int i;
     slide(aslide, a);
     slide(bslide, b);
-    ge_p3_to_cached(&Ai[0], A);
-    ge_p3_dbl(&t, A);
-    ge_p1p1_to_p3(&A2, &t);
-    ge_add(&t, &A2, &Ai[0]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[1], &u);
-    ge_add(&t, &A2, &Ai[1]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[2], &u);
-    ge_add(&t, &A2, &Ai[2]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[3], &u);
-    ge_add(&t, &A2, &Ai[3]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[4], &u);
-    ge_add(&t, &A2, &Ai[4]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[5], &u);
-    ge_add(&t, &A2, &Ai[5]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[6], &u);
-    ge_add(&t, &A2, &Ai[6]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[7], &u);
     ge_p2_0(r);
 
     for (i = 255; i >= 0; --i) {
@@ -130,6 +141,80 @@ void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3
 }
 
 
+/*
+r = b * B + a[0] * A[0] + ... + a[count-1] * A[count-1]
+where each scalar is 32 little-endian bytes, count <= GE_MULTI_SCALARMULT_MAX,
+and B is the Ed25519 base point.
+
+Straus' method: all the scalars share one chain of doublings.
+*/
+
+void ge_multi_scalarmult_vartime(ge_p2 *r, const unsigned char *b, size_t count, const unsigned char (*a)[32], const ge_p3 *A) {
+    signed char aslide[GE_MULTI_SCALARMULT_MAX][256];
+    signed char bslide[256];
+    ge_cached Ai[GE_MULTI_SCALARMULT_MAX][8];
+    ge_p1p1 t;
+    ge_p3 u;
+    size_t j;
+    int i;
+    int top = -1;
+
+    slide(bslide, b);
+
+    for (i = 255; i > top; --i) {
+        if (bslide[i]) {
+            top = i;
+        }
+    }
+
+    for (j = 0; j < count; ++j) {
+        slide(aslide[j], a[j]);
+        ge_p3_to_cached_odd_multiples(Ai[j], &A[j]);
+
+        for (i = 255; i > top; --i) {
+            if (aslide[j][i]) {
+                top = i;
+            }
+        }
+    }
+
+    ge_p2_0(r);
+
+    for (i = top; i >= 0; --i) {
+        ge_p2_dbl(&t, r);
+
+        for (j = 0; j < count; ++j) {
+            if (aslide[j][i] > 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_add(&t, &u, &Ai[j][aslide[j][i] / 2]);
+            } else if (aslide[j][i] < 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_sub(&t, &u, &Ai[j][(-aslide[j][i]) / 2]);
+            }
+        }
+
+        if (bslide[i] > 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_madd(&t, &u, &Bi[bslide[i] / 2]);
+        } else if (bslide[i] < 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+        }
+
+        ge_p1p1_to_p2(r, &t);
+    }
+}
+
+
+#ifdef ED25519_FE51
+static const fe d = {
+    0x34dca135978a3, 0x1a8283b156ebd, 0x5e7a26001c029, 0x739c663a03cbb, 0x52036cee2b6ff
+};
+
+static const fe sqrtm1 = {
+    0x61b274a0ea0b0, 0x0d5a5fc8f189d, 0x7ef5e9cbd0c60, 0x78595a6804c9e, 0x2b8324804fc1d
+};
+#else
 static const fe d = {
     -10913610, 13857413, -15372611, 6949391, 114729, -8787816, -6275908, -3247719, -18696448, -12055116
 };
@@ -137,6 +222,7 @@ static const fe d = {
 static const fe sqrtm1 = {
     -32595792, -7943725, 9377950, 3500415, 12389472, -272473, -25146209, -2005654, 326686, 11406482
 };
+#endif
 
 int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s) {
     fe u;
@@ -295,9 +381,15 @@ void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p) {
 r = p
 */
 
+#ifdef ED25519_FE51
+static const fe d2 = {
+    0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052, 0x6738cc7407977, 0x2406d9dc56dff
+};
+#else
 static const fe d2 = {
     -21827239, -5839606, -30745221, 13898782, 229458, 15978800, -12551817, -6495438, 29715968, 9444199
 };
+#endif
 
 void ge_p3_to_cached(ge_cached *r, const ge_p3 *p) {
     fe_add(r->YplusX, p->Y, p->X);
@@ -374,6 +466,192 @@ static void select(ge_precomp *t, int pos, signed char b) {
     cmov(t, &minust, bnegative);
 }
 
+#ifdef ED25519_BASE_WINDOW
+
+/*
+Optional wide-window table for ge_scalarmult_base.
+
+With a window of w bits the scalar is recoded into GE_BASE_DIGITS signed
+digits e[i] in [-2^(w-1), 2^(w-1)], and
+
+  base_wide[i][j] = (j+1) * 2^(w*i) * B
+
+so a * B = sum e[i] * 2^(w*i) * B needs one addition per digit and no
+doublings, at the price of scanning 2^(w-1) entries per digit in constant
+time. The table is filled in by ge_scalarmult_base_init_table; until then
+ge_scalarmult_base uses the fixed radix-16 tables.
+*/
+
+#if ED25519_BASE_WINDOW < 5 || ED25519_BASE_WINDOW > 8
+#error "ED25519_BASE_WINDOW must be between 5 and 8"
+#endif
+
+#define GE_BASE_ENTRIES (1 << (ED25519_BASE_WINDOW - 1))
+#define GE_BASE_DIGITS ((256 + ED25519_BASE_WINDOW - 1) / ED25519_BASE_WINDOW)
+
+static ge_precomp base_wide[GE_BASE_DIGITS][GE_BASE_ENTRIES];
+static volatile int base_wide_ready = 0;
+
+static void fe_canonical(fe h, const fe f) {
+    unsigned char s[32];
+
+    fe_tobytes(s, f);
+    fe_frombytes(h, s);
+}
+
+void ge_scalarmult_base_init_table(void) {
+    ge_p3 row_base;
+    ge_p3 multiples[GE_BASE_ENTRIES];
+    fe inverses[GE_BASE_ENTRIES];
+    ge_cached cached;
+    ge_p1p1 t;
+    ge_p2 s;
+    fe x;
+    fe y;
+    fe acc;
+    int i;
+    int j;
+
+    if (base_wide_ready) {
+        return;
+    }
+
+    /* B, from the existing table */
+    ge_p3_0(&row_base);
+    ge_madd(&t, &row_base, &Bi[0]);
+    ge_p1p1_to_p3(&row_base, &t);
+
+    for (i = 0; i < GE_BASE_DIGITS; ++i) {
+        /* multiples[j] = (j+1) * row_base */
+        multiples[0] = row_base;
+        ge_p3_to_cached(&cached, &row_base);
+        for (j = 1; j < GE_BASE_ENTRIES; ++j) {
+            ge_add(&t, &multiples[j - 1], &cached);
+            ge_p1p1_to_p3(&multiples[j], &t);
+        }
+
+        /* invert all the Z coordinates with one inversion */
+        fe_copy(acc, multiples[0].Z);
+        fe_copy(inverses[0], acc);
+        for (j = 1; j < GE_BASE_ENTRIES; ++j) {
+            fe_mul(acc, acc, multiples[j].Z);
+            fe_copy(inverses[j], acc);
+        }
+        fe_invert(acc, acc);
+        for (j = GE_BASE_ENTRIES - 1; j > 0; --j) {
+            fe_mul(inverses[j], acc, inverses[j - 1]);
+            fe_mul(acc, acc, multiples[j].Z);
+        }
+        fe_copy(inverses[0], acc);
+
+        for (j = 0; j < GE_BASE_ENTRIES; ++j) {
+            ge_precomp *entry = &base_wide[i][j];
+
+            fe_mul(x, multiples[j].X, inverses[j]);
+            fe_mul(y, multiples[j].Y, inverses[j]);
+            fe_add(entry->yplusx, y, x);
+            fe_sub(entry->yminusx, y, x);
+            fe_mul(entry->xy2d, x, y);
+            fe_mul(entry->xy2d, entry->xy2d, d2);
+            fe_canonical(entry->yplusx, entry->yplusx);
+            fe_canonical(entry->yminusx, entry->yminusx);
+            fe_canonical(entry->xy2d, entry->xy2d);
+        }
+
+        /* row_base *= 2^w */
+        ge_p3_to_p2(&s, &row_base);
+        for (j = 0; j < ED25519_BASE_WINDOW - 1; ++j) {
+            ge_p2_dbl(&t, &s);
+            ge_p1p1_to_p2(&s, &t);
+        }
+        ge_p2_dbl(&t, &s);
+        ge_p1p1_to_p3(&row_base, &t);
+    }
+
+    base_wide_ready = 1;
+}
+
+static void select_limbs(ge_precomp *t, const ge_precomp *u, unsigned int b) {
+#ifdef ED25519_FE51
+    const uint64_t mask = (uint64_t) 0 - (uint64_t) b;
+    const int limbs = 5;
+#else
+    const int32_t mask = -(int32_t) b;
+    const int limbs = 10;
+#endif
+    int k;
+
+    for (k = 0; k < limbs; ++k) {
+        t->yplusx[k] ^= mask & (t->yplusx[k] ^ u->yplusx[k]);
+        t->yminusx[k] ^= mask & (t->yminusx[k] ^ u->yminusx[k]);
+        t->xy2d[k] ^= mask & (t->xy2d[k] ^ u->xy2d[k]);
+    }
+}
+
+static void select_wide(ge_precomp *t, int pos, int b) {
+    ge_precomp minust;
+    unsigned int bnegative = ((unsigned int) b) >> (sizeof(int) * 8 - 1);
+    unsigned int babs = (((unsigned int) b) ^ (0U - bnegative)) + bnegative;
+    unsigned int x;
+    int j;
+
+    fe_1(t->yplusx);
+    fe_1(t->yminusx);
+    fe_0(t->xy2d);
+
+    /* the scan dominates for wide windows, so mask whole limbs at once and
+       let the compiler vectorise it rather than calling fe_cmov per field */
+    for (j = 0; j < GE_BASE_ENTRIES; ++j) {
+        x = babs ^ (unsigned int) (j + 1); /* 0: yes */
+        x = (x - 1) >> (sizeof(int) * 8 - 1); /* 1: yes, as x < 2^31 */
+        select_limbs(t, &base_wide[pos][j], x);
+    }
+
+    fe_copy(minust.yplusx, t->yminusx);
+    fe_copy(minust.yminusx, t->yplusx);
+    fe_neg(minust.xy2d, t->xy2d);
+    cmov(t, &minust, (unsigned char) bnegative);
+}
+
+static void ge_scalarmult_base_wide(ge_p3 *h, const unsigned char *a) {
+    int e[GE_BASE_DIGITS];
+    ge_p1p1 r;
+    ge_precomp t;
+    int carry = 0;
+    int bit;
+    int i;
+    int k;
+
+    for (i = 0; i < GE_BASE_DIGITS; ++i) {
+        e[i] = 0;
+        for (k = 0; k < ED25519_BASE_WINDOW; ++k) {
+            bit = i * ED25519_BASE_WINDOW + k;
+            if (bit < 256) {
+                e[i] |= ((a[bit >> 3] >> (bit & 7)) & 1) << k;
+            }
+        }
+    }
+
+    /* each e[i] is between 0 and 2^w - 1; recode them to be between
+       -2^(w-1) and 2^(w-1), leaving the carry in the last digit */
+    for (i = 0; i < GE_BASE_DIGITS - 1; ++i) {
+        e[i] += carry;
+        carry = (e[i] + GE_BASE_ENTRIES) >> ED25519_BASE_WINDOW;
+        e[i] -= carry << ED25519_BASE_WINDOW;
+    }
+    e[GE_BASE_DIGITS - 1] += carry;
+
+    ge_p3_0(h);
+
+    for (i = 0; i < GE_BASE_DIGITS; ++i) {
+        select_wide(&t, i, e[i]);
+        ge_madd(&r, h, &t);
+        ge_p1p1_to_p3(h, &r);
+    }
+}
+
+#endif
+
 /*
 h = a * B
 where a = a[0]+256*a[1]+...+256^31 a[31]
@@ -391,6 +669,13 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
     ge_precomp t;
     int i;
 
+#ifdef ED25519_BASE_WINDOW
+    if (base_wide_ready) {
+        ge_scalarmult_base_wide(h, a);
+        return;
+    }
+#endif
+
     for (i = 0; i < 32; ++i) {
         e[2 * i + 0] = (a[i] >> 0) & 15;
         e[2 * i + 1] = (a[i] >> 4) & 15;
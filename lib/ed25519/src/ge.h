@@ -51,6 +51,9 @@ typedef struct {
   fe T2d;
 } ge_cached;
 
+/* largest number of variable points ge_multi_scalarmult_vartime accepts */
+#define GE_MULTI_SCALARMULT_MAX 16
+
 void ge_p3_tobytes(unsigned char *s, const ge_p3 *h);
 void ge_tobytes(unsigned char *s, const ge_p2 *h);
 int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s);
@@ -58,9 +61,14 @@ int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s);
 void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b);
+void ge_double_scalarmult_cached_vartime(ge_p2 *r, const unsigned char *a, const ge_cached *Ai, const unsigned char *b);
+void ge_multi_scalarmult_vartime(ge_p2 *r, const unsigned char *b, size_t count, const unsigned char (*a)[32], const ge_p3 *A);
 void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q);
 void ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q);
 void ge_scalarmult_base(ge_p3 *h, const unsigned char *a);
+#ifdef ED25519_BASE_WINDOW
+void ge_scalarmult_base_init_table(void);
+#endif
 
 void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p);
 void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p);
@@ -69,6 +77,7 @@ void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p);
 void ge_p3_0(ge_p3 *h);
 void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p);
 void ge_p3_to_cached(ge_cached *r, const ge_p3 *p);
+void ge_p3_to_cached_odd_multiples(ge_cached *Ai, const ge_p3 *A);
 void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p);
 
 #endif
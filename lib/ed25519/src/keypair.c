@@ -14,3 +14,14 @@ void ed25519_create_keypair(unsigned char *public_key, unsigned char *private_ke
     ge_scalarmult_base(&A, private_key);
     ge_p3_tobytes(public_key, &A);
 }
+
+#ifdef ED25519_BASE_WINDOW
+/*
+    Build the wide fixed-base table used by ed25519_create_keypair and
+    ed25519_sign. Not thread safe: the caller must make sure it runs once
+    before any other thread generates keys or signs.
+*/
+void ed25519_init_base_table(void) {
+    ge_scalarmult_base_init_table();
+}
+#endif
@@ -3,6 +3,17 @@
 #include "ge.h"
 #include "sc.h"
 
+#include <string.h>
+
+/* signatures per multi-scalar multiplication: 2 * ED25519_BATCH_MAX must not
+   exceed GE_MULTI_SCALARMULT_MAX */
+#define ED25519_BATCH_MAX 8
+
+/* ED25519_PREPARED_TABLE_SIZE must match the table it describes */
+typedef char ed25519_prepared_table_size_check[
+    sizeof(ge_cached) * 8 == ED25519_PREPARED_TABLE_SIZE ? 1 : -1
+];
+
 static int consttime_equal(const unsigned char *x, const unsigned char *y) {
     unsigned char r = 0;
 
@@ -44,10 +55,26 @@ static int consttime_equal(const unsigned char *x, const unsigned char *y) {
     return !r;
 }
 
-int ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
-    unsigned char h[64];
-    unsigned char checker[32];
+/*
+    h = SHA512(R || A || M) mod l, the only part of a verification that reads
+    the message. The first 32 bytes of h are written.
+*/
+void ed25519_hram(unsigned char *h, const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
+    unsigned char digest[64];
     sha512_context hash;
+
+    sha512_init(&hash);
+    sha512_update(&hash, signature, 32);
+    sha512_update(&hash, public_key, 32);
+    sha512_update(&hash, message, message_len);
+    sha512_final(&hash, digest);
+
+    sc_reduce(digest);
+    memcpy(h, digest, 32);
+}
+
+static int verify_hram(const unsigned char *signature, const unsigned char *h, const unsigned char *public_key) {
+    unsigned char checker[32];
     ge_p3 A;
     ge_p2 R;
 
@@ -59,13 +86,6 @@ int ed25519_verify(const unsigned char *signature, const unsigned char *message,
         return 0;
     }
 
-    sha512_init(&hash);
-    sha512_update(&hash, signature, 32);
-    sha512_update(&hash, public_key, 32);
-    sha512_update(&hash, message, message_len);
-    sha512_final(&hash, h);
-    
-    sc_reduce(h);
     ge_double_scalarmult_vartime(&R, h, &A, signature + 32);
     ge_tobytes(checker, &R);
 
@@ -75,3 +95,292 @@ int ed25519_verify(const unsigned char *signature, const unsigned char *message,
 
     return 1;
 }
+
+int ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
+    unsigned char h[32];
+
+    if (signature[63] & 224) {
+        return 0;
+    }
+
+    ed25519_hram(h, signature, message, message_len, public_key);
+    return verify_hram(signature, h, public_key);
+}
+
+/*
+    Decompress public_key and fill table with its odd multiples for
+    ed25519_verify_prepared. Returns 0 if public_key is not a valid point.
+*/
+int ed25519_prepare_public_key(unsigned char *table, const unsigned char *public_key) {
+    ge_p3 A;
+    ge_cached Ai[8];
+
+    if (ge_frombytes_negate_vartime(&A, public_key) != 0) {
+        return 0;
+    }
+
+    ge_p3_to_cached_odd_multiples(Ai, &A);
+    memcpy(table, Ai, sizeof(Ai));
+
+    return 1;
+}
+
+/*
+    As ed25519_verify, for a key that went through ed25519_prepare_public_key.
+    The table is copied rather than cast so that callers can keep it in plain
+    byte storage.
+*/
+int ed25519_verify_prepared(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key, const unsigned char *table) {
+    unsigned char h[32];
+    unsigned char checker[32];
+    ge_cached Ai[8];
+    ge_p2 R;
+
+    if (signature[63] & 224) {
+        return 0;
+    }
+
+    memcpy(Ai, table, sizeof(Ai));
+
+    ed25519_hram(h, signature, message, message_len, public_key);
+    ge_double_scalarmult_cached_vartime(&R, h, Ai, signature + 32);
+    ge_tobytes(checker, &R);
+
+    if (!consttime_equal(checker, signature)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+    Reject R encodings that ed25519_verify could never match: the y
+    coordinate must be below p, and (0, 1) and (0, -1) must not have the
+    sign bit set.
+*/
+static int is_canonical_point(const unsigned char *s) {
+    unsigned char c;
+    int i;
+
+    c = (s[31] & 0x7f) ^ 0x7f;
+    for (i = 30; i > 0; --i) {
+        c |= s[i] ^ 0xff;
+    }
+    if (c == 0 && s[0] >= 0xed) {
+        return 0;
+    }
+
+    if (s[31] & 0x80) {
+        c = s[31] ^ 0x80;
+        for (i = 30; i > 0; --i) {
+            c |= s[i];
+        }
+        if (c == 0 && s[0] == 1) {
+            return 0;
+        }
+        c = s[31] ^ 0xff;
+        for (i = 30; i > 0; --i) {
+            c |= s[i] ^ 0xff;
+        }
+        if (c == 0 && s[0] == 0xec) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+    Checks up to ED25519_BATCH_MAX signatures with a single multi-scalar
+    multiplication:
+
+        (sum z_i S_i) B - sum z_i R_i - sum (z_i h_i) A_i == 0
+
+    The 128-bit coefficients z_i are derived from a hash of every input in
+    the batch, so they are fixed only after all the signatures are. If the
+    combined check fails each signature is verified on its own.
+
+    As with any batch verifier, a signature that differs from a valid one
+    only by a small-order point may pass the combined check even though
+    ed25519_verify rejects it; only the holder of the signing key can
+    produce one.
+*/
+static const unsigned char identity[32] = { 1 };
+
+static void verify_batch_chunk(const unsigned char *const *signatures, const unsigned char *const *h, const unsigned char *const *public_keys, size_t count, int *valid) {
+    unsigned char key_index[ED25519_BATCH_MAX];
+    unsigned char has_key[ED25519_BATCH_MAX];
+    unsigned char scalars[2 * ED25519_BATCH_MAX][32];
+    ge_p3 points[2 * ED25519_BATCH_MAX];
+    unsigned char seed[64];
+    unsigned char z[64];
+    unsigned char b[32];
+    unsigned char checker[32];
+    unsigned char index;
+    size_t candidates = 0;
+    size_t keys = 0;
+    size_t npoints;
+    size_t i;
+    size_t j;
+    sha512_context hash;
+    ge_p3 A[ED25519_BATCH_MAX];
+    ge_p2 check;
+
+    sha512_init(&hash);
+
+    for (i = 0; i < count; ++i) {
+        valid[i] = 0;
+        has_key[i] = 0;
+
+        /* anything ed25519_verify rejects before the scalar multiplication
+           is left out of the batch */
+        if (signatures[i][63] & 224) {
+            continue;
+        }
+        if (!is_canonical_point(signatures[i])) {
+            continue;
+        }
+
+        /* megolm sessions sign many messages with one key, so each
+           distinct key is decoded once and its scalars are summed */
+        for (j = 0; j < i; ++j) {
+            if (has_key[j] && memcmp(public_keys[j], public_keys[i], 32) == 0) {
+                break;
+            }
+        }
+        if (j < i) {
+            key_index[i] = key_index[j];
+        } else {
+            if (ge_frombytes_negate_vartime(&A[keys], public_keys[i]) != 0) {
+                continue;
+            }
+            key_index[i] = (unsigned char) keys++;
+        }
+        has_key[i] = 1;
+
+        if (ge_frombytes_negate_vartime(&points[candidates], signatures[i]) != 0) {
+            continue;
+        }
+
+        sha512_update(&hash, signatures[i], 64);
+        sha512_update(&hash, public_keys[i], 32);
+        sha512_update(&hash, h[i], 32);
+
+        /* provisionally valid; cleared again if the batch fails */
+        valid[i] = 1;
+        candidates++;
+    }
+
+    if (candidates == 0) {
+        return;
+    }
+
+    sha512_final(&hash, seed);
+
+    /* points[0..candidates) hold -R_i, points[candidates..) hold -A_k */
+    npoints = candidates + keys;
+    memset(scalars, 0, sizeof(scalars));
+    memset(b, 0, sizeof(b));
+
+    for (i = 0, j = 0; i < count; ++i) {
+        if (!valid[i]) {
+            continue;
+        }
+
+        index = (unsigned char) i;
+        sha512_init(&hash);
+        sha512_update(&hash, seed, 64);
+        sha512_update(&hash, &index, 1);
+        sha512_final(&hash, z);
+        memset(z + 16, 0, 16);
+
+        memcpy(scalars[j], z, 32);
+        sc_muladd(
+            scalars[candidates + key_index[i]], z, h[i],
+            scalars[candidates + key_index[i]]
+        );
+        sc_muladd(b, z, signatures[i] + 32, b);
+        j++;
+    }
+
+    for (i = 0; i < keys; ++i) {
+        points[candidates + i] = A[i];
+    }
+
+    ge_multi_scalarmult_vartime(&check, b, npoints, scalars, points);
+    ge_tobytes(checker, &check);
+
+    if (consttime_equal(checker, identity)) {
+        return;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (valid[i]) {
+            valid[i] = verify_hram(signatures[i], h[i], public_keys[i]);
+        }
+    }
+}
+
+int ed25519_verify_batch(const unsigned char *const *signatures, const unsigned char *const *messages, const size_t *message_lens, const unsigned char *const *public_keys, size_t count, int *valid) {
+    unsigned char h[ED25519_BATCH_MAX][32];
+    const unsigned char *hrams[ED25519_BATCH_MAX];
+    size_t start;
+    size_t chunk;
+    size_t i;
+    int all_valid = 1;
+
+    for (start = 0; start < count; start += chunk) {
+        chunk = count - start;
+        if (chunk > ED25519_BATCH_MAX) {
+            chunk = ED25519_BATCH_MAX;
+        }
+
+        for (i = 0; i < chunk; ++i) {
+            ed25519_hram(
+                h[i], signatures[start + i], messages[start + i],
+                message_lens[start + i], public_keys[start + i]
+            );
+            hrams[i] = h[i];
+        }
+
+        verify_batch_chunk(
+            signatures + start, hrams, public_keys + start, chunk,
+            valid + start
+        );
+
+        for (i = start; i < start + chunk; ++i) {
+            all_valid &= valid[i];
+        }
+    }
+
+    return all_valid;
+}
+
+/*
+    As ed25519_verify_batch, with h = ed25519_hram(...) for each signature
+    computed beforehand, so that the messages need not be kept.
+*/
+int ed25519_verify_batch_hram(const unsigned char *const *signatures, const unsigned char *const *hrams, const unsigned char *const *public_keys, size_t count, int *valid) {
+    size_t start;
+    size_t chunk;
+    size_t i;
+    int all_valid = 1;
+
+    for (start = 0; start < count; start += chunk) {
+        chunk = count - start;
+        if (chunk > ED25519_BATCH_MAX) {
+            chunk = ED25519_BATCH_MAX;
+        }
+
+        verify_batch_chunk(
+            signatures + start, hrams + start, public_keys + start, chunk,
+            valid + start
+        );
+
+        for (i = start; i < start + chunk; ++i) {
+            all_valid &= valid[i];
+        }
+    }
+
+    return all_valid;
+}
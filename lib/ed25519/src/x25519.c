@@ -0,0 +1,190 @@
+#include "ed25519.h"
+#include "fe.h"
+#include "ge.h"
+
+/*
+    X25519 (RFC 7748) on top of the fe_* field arithmetic, so that it shares
+    the radix 2^51 backend with the signature code on 64-bit targets.
+
+    Unlike ed25519_key_exchange the public key is a Montgomery u-coordinate,
+    and the scalar is clamped as in curve25519-donna.
+*/
+
+/*
+    Zero the clamped copy of a private key. The stores go through a volatile
+    pointer so that they aren't dropped as dead, as in _olm_unset.
+*/
+static void wipe_scalar(unsigned char *e) {
+    volatile unsigned char *p = e;
+    unsigned int i;
+
+    for (i = 0; i < 32; ++i) {
+        p[i] = 0;
+    }
+}
+
+void ed25519_x25519(unsigned char *shared_secret, const unsigned char *private_key, const unsigned char *public_key) {
+    unsigned char e[32];
+    unsigned int i;
+
+    fe x1;
+    fe x2;
+    fe z2;
+    fe x3;
+    fe z3;
+    fe tmp0;
+    fe tmp1;
+
+    int pos;
+    unsigned int swap;
+    unsigned int b;
+
+    /* copy the private key and clamp it */
+    for (i = 0; i < 32; ++i) {
+        e[i] = private_key[i];
+    }
+
+    e[0] &= 248;
+    e[31] &= 127;
+    e[31] |= 64;
+
+    /* fe_frombytes ignores the top bit of the u-coordinate */
+    fe_frombytes(x1, public_key);
+
+    fe_1(x2);
+    fe_0(z2);
+    fe_copy(x3, x1);
+    fe_1(z3);
+
+    swap = 0;
+    for (pos = 254; pos >= 0; --pos) {
+        b = e[pos / 8] >> (pos & 7);
+        b &= 1;
+        swap ^= b;
+        fe_cswap(x2, x3, swap);
+        fe_cswap(z2, z3, swap);
+        swap = b;
+
+        /* from montgomery.h */
+        fe_sub(tmp0, x3, z3);
+        fe_sub(tmp1, x2, z2);
+        fe_add(x2, x2, z2);
+        fe_add(z2, x3, z3);
+        fe_mul(z3, tmp0, x2);
+        fe_mul(z2, z2, tmp1);
+        fe_sq(tmp0, tmp1);
+        fe_sq(tmp1, x2);
+        fe_add(x3, z3, z2);
+        fe_sub(z2, z3, z2);
+        fe_mul(x2, tmp1, tmp0);
+        fe_sub(tmp1, tmp1, tmp0);
+        fe_sq(z2, z2);
+        fe_mul121666(z3, tmp1);
+        fe_sq(x3, x3);
+        fe_add(tmp0, tmp0, z3);
+        fe_mul(z3, x1, z2);
+        fe_mul(z2, tmp1, tmp0);
+    }
+
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+    wipe_scalar(e);
+
+    fe_invert(z2, z2);
+    fe_mul(x2, x2, z2);
+    fe_tobytes(shared_secret, x2);
+}
+
+
+/*
+    X25519 with the base point u = 9, computed as a fixed-base multiplication
+    on the birationally equivalent Edwards curve and mapped back with
+    u = (1 + y) / (1 - y) = (Z + Y) / (Z - Y). This gives the same output as
+    ed25519_x25519(public_key, private_key, basepoint) in a fraction of the
+    time, because it uses the precomputed table of multiples of B.
+
+    The clamped scalar is a multiple of 8 below 8 * l, so the point is never
+    the identity and Z - Y is never zero.
+*/
+
+static void x25519_base_point(ge_p3 *A, fe zplusy, fe zminusy, const unsigned char *private_key) {
+    unsigned char e[32];
+    unsigned int i;
+
+    for (i = 0; i < 32; ++i) {
+        e[i] = private_key[i];
+    }
+
+    e[0] &= 248;
+    e[31] &= 127;
+    e[31] |= 64;
+
+    ge_scalarmult_base(A, e);
+    wipe_scalar(e);
+
+    fe_add(zplusy, A->Z, A->Y);
+    fe_sub(zminusy, A->Z, A->Y);
+}
+
+void ed25519_x25519_base(unsigned char *public_key, const unsigned char *private_key) {
+    ge_p3 A;
+    fe zplusy;
+    fe zminusy;
+
+    x25519_base_point(&A, zplusy, zminusy, private_key);
+
+    fe_invert(zminusy, zminusy);
+    fe_mul(zplusy, zplusy, zminusy);
+    fe_tobytes(public_key, zplusy);
+}
+
+/*
+    ed25519_x25519_base for several keys at once. The divisions share one
+    field inversion per ED25519_X25519_BATCH keys using Montgomery's trick:
+    invert the product of the denominators, then peel each inverse off with
+    the running products.
+*/
+
+#define ED25519_X25519_BATCH 16
+
+void ed25519_x25519_base_batch(unsigned char *const *public_keys, const unsigned char *const *private_keys, size_t count) {
+    ge_p3 A;
+    fe zplusy[ED25519_X25519_BATCH];
+    fe zminusy[ED25519_X25519_BATCH];
+    fe products[ED25519_X25519_BATCH];
+    fe inverse;
+    fe t;
+    size_t n;
+    size_t i;
+
+    while (count) {
+        n = count < ED25519_X25519_BATCH ? count : ED25519_X25519_BATCH;
+
+        for (i = 0; i < n; ++i) {
+            x25519_base_point(&A, zplusy[i], zminusy[i], private_keys[i]);
+            if (i == 0) {
+                fe_copy(products[0], zminusy[0]);
+            } else {
+                fe_mul(products[i], products[i - 1], zminusy[i]);
+            }
+        }
+
+        fe_invert(inverse, products[n - 1]);
+
+        for (i = n; i-- > 0;) {
+            if (i == 0) {
+                fe_copy(t, inverse);
+            } else {
+                /* 1 / zminusy[i] = (1 / products[i]) * products[i - 1] */
+                fe_mul(t, inverse, products[i - 1]);
+                fe_mul(inverse, inverse, zminusy[i]);
+            }
+            fe_mul(t, zplusy[i], t);
+            fe_tobytes(public_keys[i], t);
+        }
+
+        public_keys += n;
+        private_keys += n;
+        count -= n;
+    }
+}
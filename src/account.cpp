@@ -17,36 +17,48 @@
 #include "olm/pickle.h"
 #include "olm/pickle.hh"
 #include "olm/memory.hh"
+#include "olm/parallel.hh"
+
+#include <algorithm>
+#include <cstring>
+
+olm::Account::Account(
+) : next_one_time_key_id(0),
+    last_error(OlmErrorCode::OLM_SUCCESS) {
+    one_time_keys.init(default_storage, MAX_ONE_TIME_KEYS);
+    reset_journal(*this);
+}
+
 
 olm::Account::Account(
+    void * storage, std::size_t capacity
 ) : next_one_time_key_id(0),
     last_error(OlmErrorCode::OLM_SUCCESS) {
+    if (capacity > MAX_ONE_TIME_KEYS) {
+        one_time_keys.init(storage, capacity);
+    } else {
+        one_time_keys.init(default_storage, MAX_ONE_TIME_KEYS);
+    }
+    reset_journal(*this);
 }
 
 
 olm::OneTimeKey const * olm::Account::lookup_key(
     _olm_curve25519_public_key const & public_key
 ) {
-    for (olm::OneTimeKey const & key : one_time_keys) {
-        if (olm::array_equal(key.key.public_key.public_key, public_key.public_key)) {
-            return &key;
-        }
-    }
-    return 0;
+    return one_time_keys.find(public_key);
 }
 
 std::size_t olm::Account::remove_key(
     _olm_curve25519_public_key const & public_key
 ) {
-    OneTimeKey * i;
-    for (i = one_time_keys.begin(); i != one_time_keys.end(); ++i) {
-        if (olm::array_equal(i->key.public_key.public_key, public_key.public_key)) {
-            std::uint32_t id = i->id;
-            one_time_keys.erase(i);
-            return id;
-        }
+    OneTimeKey const * key = one_time_keys.find(public_key);
+    if (!key) {
+        return std::size_t(-1);
     }
-    return std::size_t(-1);
+    std::uint32_t id = key->id;
+    one_time_keys.erase(key);
+    return id;
 }
 
 std::size_t olm::Account::new_account_random_length() {
@@ -162,7 +174,7 @@ std::size_t olm::Account::get_one_time_keys_json_length(
     std::size_t length = 0;
     bool is_empty = true;
     for (auto const & key : one_time_keys) {
-        if (key.published) {
+        if (one_time_keys.is_published(&key)) {
             continue;
         }
         is_empty = false;
@@ -193,7 +205,7 @@ std::size_t olm::Account::get_one_time_keys_json(
     pos = write_string(pos, KEY_JSON_CURVE25519);
     std::uint8_t sep = '{';
     for (auto const & key : one_time_keys) {
-        if (key.published) {
+        if (one_time_keys.is_published(&key)) {
             continue;
         }
         *(pos++) = sep;
@@ -221,9 +233,9 @@ std::size_t olm::Account::get_one_time_keys_json(
 std::size_t olm::Account::mark_keys_as_published(
 ) {
     std::size_t count = 0;
-    for (auto & key : one_time_keys) {
-        if (!key.published) {
-            key.published = true;
+    for (auto const & key : one_time_keys) {
+        if (!one_time_keys.is_published(&key)) {
+            one_time_keys.set_published(&key, true);
             count++;
         }
     }
@@ -233,7 +245,7 @@ std::size_t olm::Account::mark_keys_as_published(
 
 std::size_t olm::Account::max_number_of_one_time_keys(
 ) {
-    return olm::MAX_ONE_TIME_KEYS;
+    return one_time_keys.capacity();
 }
 
 std::size_t olm::Account::generate_one_time_keys_random_length(
@@ -245,17 +257,74 @@ std::size_t olm::Account::generate_one_time_keys_random_length(
 std::size_t olm::Account::generate_one_time_keys(
     std::size_t number_of_keys,
     std::uint8_t const * random, std::size_t random_length
+) {
+    return generate_one_time_keys(number_of_keys, random, random_length, 1);
+}
+
+namespace {
+
+/* Keys are generated in blocks of this many, so that the slots for a block
+ * fit in a stack buffer */
+static std::size_t const ONE_TIME_KEY_BLOCK = 256;
+
+struct GenerateOneTimeKeys {
+    olm::OneTimeKey * const * keys;
+    std::uint8_t const * random;
+};
+
+void generate_one_time_keys_range(
+    std::size_t begin, std::size_t end, void * context
+) {
+    GenerateOneTimeKeys const & job = *static_cast<GenerateOneTimeKeys *>(context);
+    _olm_curve25519_key_pair * key_pairs[16];
+    while (begin != end) {
+        std::size_t count = std::min<std::size_t>(end - begin, 16);
+        for (std::size_t i = 0; i < count; ++i) {
+            key_pairs[i] = &job.keys[begin + i]->key;
+        }
+        _olm_crypto_curve25519_generate_keys(
+            count, job.random + begin * CURVE25519_RANDOM_LENGTH, key_pairs
+        );
+        begin += count;
+    }
+}
+
+} // namespace
+
+std::size_t olm::Account::generate_one_time_keys(
+    std::size_t number_of_keys,
+    std::uint8_t const * random, std::size_t random_length,
+    unsigned threads
 ) {
     if (random_length < generate_one_time_keys_random_length(number_of_keys)) {
         last_error = OlmErrorCode::OLM_NOT_ENOUGH_RANDOM;
         return std::size_t(-1);
     }
-    for (unsigned i = 0; i < number_of_keys; ++i) {
-        OneTimeKey & key = *one_time_keys.insert(one_time_keys.begin());
-        key.id = ++next_one_time_key_id;
-        key.published = false;
-        _olm_crypto_curve25519_generate_key(random, &key.key);
-        random += CURVE25519_RANDOM_LENGTH;
+    /* Only the newest capacity() keys fit in the store, so the older ones
+     * would be discarded as soon as they were made. Skip over their ids and
+     * random bytes instead of generating them. */
+    std::size_t skipped = 0;
+    if (number_of_keys > one_time_keys.capacity()) {
+        skipped = number_of_keys - one_time_keys.capacity();
+    }
+    next_one_time_key_id += skipped;
+    random += skipped * CURVE25519_RANDOM_LENGTH;
+
+    OneTimeKey * keys[ONE_TIME_KEY_BLOCK];
+    std::size_t remaining = number_of_keys - skipped;
+    while (remaining) {
+        std::size_t count = std::min(remaining, ONE_TIME_KEY_BLOCK);
+        for (std::size_t i = 0; i < count; ++i) {
+            keys[i] = one_time_keys.push_newest();
+            keys[i]->id = ++next_one_time_key_id;
+        }
+        GenerateOneTimeKeys job = {keys, random};
+        olm::parallel_for(count, threads, generate_one_time_keys_range, &job);
+        for (std::size_t i = 0; i < count; ++i) {
+            one_time_keys.add_to_index(keys[i]);
+        }
+        random += count * CURVE25519_RANDOM_LENGTH;
+        remaining -= count;
     }
     return number_of_keys;
 }
@@ -293,34 +362,53 @@ static std::uint8_t const * unpickle(
 
 
 static std::size_t pickle_length(
-    olm::OneTimeKey const & value
+    olm::OneTimeKeyStore const & value
 ) {
-    std::size_t length = 0;
-    length += olm::pickle_length(value.id);
-    length += olm::pickle_length(value.published);
-    length += olm::pickle_length(value.key);
+    std::size_t length = olm::pickle_length(std::uint32_t(value.size()));
+    for (auto const & key : value) {
+        length += olm::pickle_length(key.id);
+        length += olm::pickle_length(value.is_published(&key));
+        length += olm::pickle_length(key.key);
+    }
     return length;
 }
 
 
 static std::uint8_t * pickle(
     std::uint8_t * pos,
-    olm::OneTimeKey const & value
+    olm::OneTimeKeyStore const & value
 ) {
-    pos = olm::pickle(pos, value.id);
-    pos = olm::pickle(pos, value.published);
-    pos = olm::pickle(pos, value.key);
+    pos = olm::pickle(pos, std::uint32_t(value.size()));
+    for (auto const & key : value) {
+        pos = olm::pickle(pos, key.id);
+        pos = olm::pickle(pos, value.is_published(&key));
+        pos = olm::pickle(pos, key.key);
+    }
     return pos;
 }
 
 
+/* The keys are pickled from newest to oldest */
 static std::uint8_t const * unpickle(
     std::uint8_t const * pos, std::uint8_t const * end,
-    olm::OneTimeKey & value
+    olm::OneTimeKeyStore & value, OlmErrorCode & last_error
 ) {
-    pos = olm::unpickle(pos, end, value.id);
-    pos = olm::unpickle(pos, end, value.published);
-    pos = olm::unpickle(pos, end, value.key);
+    std::uint32_t size = 0;
+    pos = olm::unpickle(pos, end, size);
+    if (size > value.capacity()) {
+        last_error = OlmErrorCode::OLM_KEY_STORE_TOO_SMALL;
+        return end;
+    }
+    value.clear();
+    while (size-- && pos != end) {
+        olm::OneTimeKey * key = value.push_oldest();
+        bool published;
+        pos = olm::unpickle(pos, end, key->id);
+        pos = olm::unpickle(pos, end, published);
+        pos = olm::unpickle(pos, end, key->key);
+        value.set_published(key, published);
+        value.add_to_index(key);
+    }
     return pos;
 }
 
@@ -329,7 +417,9 @@ static std::uint8_t const * unpickle(
 namespace {
 // pickle version 1 used only 32 bytes for the ed25519 private key.
 // Any keys thus used should be considered compromised.
-static const std::uint32_t ACCOUNT_PICKLE_VERSION = 2;
+// pickle version 2 held at most MAX_ONE_TIME_KEYS one time keys; version 3
+// has the same layout but may hold more, so older readers must reject it.
+static const std::uint32_t ACCOUNT_PICKLE_VERSION = 3;
 }
 
 
@@ -365,6 +455,7 @@ std::uint8_t const * olm::unpickle(
     pos = olm::unpickle(pos, end, pickle_version);
     switch (pickle_version) {
         case ACCOUNT_PICKLE_VERSION:
+        case 2:
             break;
         case 1:
             value.last_error = OlmErrorCode::OLM_BAD_LEGACY_ACCOUNT_PICKLE;
@@ -374,7 +465,268 @@ std::uint8_t const * olm::unpickle(
             return end;
     }
     pos = olm::unpickle(pos, end, value.identity_keys);
-    pos = olm::unpickle(pos, end, value.one_time_keys);
+    pos = olm::unpickle(pos, end, value.one_time_keys, value.last_error);
     pos = olm::unpickle(pos, end, value.next_one_time_key_id);
     return pos;
 }
+
+
+namespace {
+
+static const std::uint32_t ACCOUNT_DELTA_PICKLE_VERSION = 1;
+
+/* Deltas carry this much of the SHA-256 of the journal they were taken
+ * against, so that they aren't applied to another account */
+static const std::size_t SNAPSHOT_DIGEST_LENGTH = 8;
+
+static void record_journal(
+    olm::Account & value, std::uint32_t sequence
+) {
+    olm::AccountJournal & journal = value.journal;
+    std::uint8_t * pos = journal.identity_keys;
+    pos = olm::store_array(
+        pos, value.identity_keys.ed25519_key.public_key.public_key
+    );
+    pos = olm::store_array(
+        pos, value.identity_keys.curve25519_key.public_key.public_key
+    );
+    journal.sequence = sequence;
+    journal.next_one_time_key_id = value.next_one_time_key_id;
+}
+
+static bool identity_keys_changed(
+    olm::Account const & value
+) {
+    std::uint8_t const * keys = value.journal.identity_keys;
+    return !olm::is_equal(
+            value.identity_keys.ed25519_key.public_key.public_key,
+            keys, ED25519_PUBLIC_KEY_LENGTH
+        ) || !olm::is_equal(
+            value.identity_keys.curve25519_key.public_key.public_key,
+            keys + ED25519_PUBLIC_KEY_LENGTH, CURVE25519_KEY_LENGTH
+        );
+}
+
+static void snapshot_digest(
+    olm::AccountJournal const & journal,
+    std::uint8_t * digest
+) {
+    std::uint8_t snapshot[sizeof(journal.identity_keys) + 4];
+    std::uint8_t * pos = olm::store_array(snapshot, journal.identity_keys);
+    olm::pickle(pos, journal.next_one_time_key_id);
+    std::uint8_t hash[SHA256_OUTPUT_LENGTH];
+    _olm_crypto_sha256(snapshot, sizeof(snapshot), hash);
+    std::memcpy(digest, hash, SNAPSHOT_DIGEST_LENGTH);
+    olm::unset(hash);
+}
+
+/* The keys made since the journal was recorded */
+static bool is_new_key(
+    olm::Account const & value, olm::OneTimeKey const & key
+) {
+    return key.id >= value.journal.next_one_time_key_id;
+}
+
+} // namespace
+
+
+void olm::reset_journal(
+    olm::Account & value
+) {
+    record_journal(value, 0);
+}
+
+
+/* The delta holds the ids and published flags of the keys that are left from
+ * before, newest first, and then the keys made since, oldest first. */
+std::size_t olm::pickle_delta_length(
+    olm::Account const & value
+) {
+    std::size_t length = 0;
+    length += olm::pickle_length(ACCOUNT_DELTA_PICKLE_VERSION);
+    length += olm::pickle_length(value.journal.sequence);
+    length += SNAPSHOT_DIGEST_LENGTH;
+    length += olm::pickle_length(value.next_one_time_key_id);
+    length += olm::pickle_length(true);
+    if (identity_keys_changed(value)) {
+        length += pickle_length(value.identity_keys);
+    }
+    length += 2 * olm::pickle_length(std::uint32_t(0));
+    for (auto const & key : value.one_time_keys) {
+        length += olm::pickle_length(key.id);
+        length += olm::pickle_length(true);
+        if (is_new_key(value, key)) {
+            length += olm::pickle_length(key.key);
+        }
+    }
+    return length;
+}
+
+
+std::uint8_t * olm::pickle_delta(
+    std::uint8_t * pos,
+    olm::Account & value
+) {
+    std::uint32_t sequence = value.journal.sequence + 1;
+    bool changed = identity_keys_changed(value);
+    pos = olm::pickle(pos, ACCOUNT_DELTA_PICKLE_VERSION);
+    pos = olm::pickle(pos, sequence);
+    snapshot_digest(value.journal, pos);
+    pos += SNAPSHOT_DIGEST_LENGTH;
+    pos = olm::pickle(pos, value.next_one_time_key_id);
+    pos = olm::pickle(pos, changed);
+    if (changed) {
+        pos = pickle(pos, value.identity_keys);
+    }
+
+    olm::OneTimeKeyStore const & keys = value.one_time_keys;
+    std::uint32_t new_keys = 0;
+    for (auto const & key : keys) {
+        if (is_new_key(value, key)) {
+            ++new_keys;
+        }
+    }
+    std::size_t new_key_length = olm::pickle_length(std::uint32_t(0))
+        + olm::pickle_length(true)
+        + olm::pickle_length(_olm_curve25519_key_pair());
+
+    /* the store runs from newest to oldest, so the new keys are written from
+     * the end of their part of the pickle */
+    pos = olm::pickle(pos, new_keys);
+    std::uint8_t * new_key_pos = pos + new_keys * new_key_length;
+    pos = olm::pickle(new_key_pos, std::uint32_t(keys.size() - new_keys));
+    for (auto const & key : keys) {
+        if (is_new_key(value, key)) {
+            new_key_pos -= new_key_length;
+            std::uint8_t * key_pos = new_key_pos;
+            key_pos = olm::pickle(key_pos, key.id);
+            key_pos = olm::pickle(key_pos, keys.is_published(&key));
+            key_pos = olm::pickle(key_pos, key.key);
+        } else {
+            pos = olm::pickle(pos, key.id);
+            pos = olm::pickle(pos, keys.is_published(&key));
+        }
+    }
+    record_journal(value, sequence);
+    return pos;
+}
+
+
+std::uint8_t const * olm::unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    olm::Account & value
+) {
+    std::uint32_t pickle_version = 0;
+    pos = olm::unpickle(pos, end, pickle_version);
+    if (pickle_version != ACCOUNT_DELTA_PICKLE_VERSION) {
+        value.last_error = OlmErrorCode::OLM_UNKNOWN_PICKLE_VERSION;
+        return end;
+    }
+
+    std::uint32_t sequence = 0;
+    std::uint8_t digest[SNAPSHOT_DIGEST_LENGTH];
+    std::uint8_t expected_digest[SNAPSHOT_DIGEST_LENGTH];
+    pos = olm::unpickle(pos, end, sequence);
+    pos = olm::unpickle_bytes(pos, end, digest, sizeof(digest));
+    snapshot_digest(value.journal, expected_digest);
+    if (sequence != value.journal.sequence + 1
+            || !olm::array_equal(digest, expected_digest)) {
+        value.last_error = OlmErrorCode::OLM_BAD_PICKLE_DELTA;
+        return end;
+    }
+
+    /* Read and check the whole delta before changing the account, so that a
+     * bad one leaves it as it was */
+    std::uint32_t next_one_time_key_id = 0;
+    bool changed = false;
+    olm::IdentityKeys identity_keys;
+    pos = olm::unpickle(pos, end, next_one_time_key_id);
+    pos = olm::unpickle(pos, end, changed);
+    if (changed) {
+        pos = unpickle(pos, end, identity_keys);
+    }
+
+    olm::OneTimeKeyStore & keys = value.one_time_keys;
+    std::uint32_t new_keys = 0;
+    std::uint32_t old_keys = 0;
+    pos = olm::unpickle(pos, end, new_keys);
+    std::uint8_t const * new_key_pos = pos;
+    std::size_t new_key_length = olm::pickle_length(std::uint32_t(0))
+        + olm::pickle_length(true)
+        + olm::pickle_length(_olm_curve25519_key_pair());
+    if (std::size_t(end - pos) < new_keys * new_key_length) {
+        olm::unset(identity_keys);
+        return end;
+    }
+    pos += new_keys * new_key_length;
+    pos = olm::unpickle(pos, end, old_keys);
+    if (std::size_t(old_keys) + new_keys > keys.capacity()) {
+        olm::unset(identity_keys);
+        value.last_error = OlmErrorCode::OLM_KEY_STORE_TOO_SMALL;
+        return end;
+    }
+
+    /* The old keys must be ones the account has, in the order it has them */
+    std::uint8_t const * old_key_pos = pos;
+    auto key = keys.begin();
+    for (std::uint32_t i = 0; i < old_keys && pos != end; ++i) {
+        std::uint32_t id = 0;
+        bool published = false;
+        pos = olm::unpickle(pos, end, id);
+        pos = olm::unpickle(pos, end, published);
+        while (key != keys.end() && key->id != id) {
+            ++key;
+        }
+        if (!(key != keys.end())) {
+            olm::unset(identity_keys);
+            value.last_error = OlmErrorCode::OLM_BAD_PICKLE_DELTA;
+            return end;
+        }
+        ++key;
+    }
+    if (pos == end) {
+        olm::unset(identity_keys);
+        return end;
+    }
+
+    value.next_one_time_key_id = next_one_time_key_id;
+    if (changed) {
+        value.identity_keys = identity_keys;
+    }
+    olm::unset(identity_keys);
+
+    /* Keep the old keys that are listed, in the order they were in, and
+     * drop the rest. */
+    key = keys.begin();
+    while (old_keys--) {
+        std::uint32_t id = 0;
+        bool published = false;
+        old_key_pos = olm::unpickle(old_key_pos, end, id);
+        old_key_pos = olm::unpickle(old_key_pos, end, published);
+        while (key->id != id) {
+            olm::OneTimeKey const * dropped = &*key;
+            ++key;
+            keys.erase(dropped);
+        }
+        keys.set_published(&*key, published);
+        ++key;
+    }
+    while (key != keys.end()) {
+        olm::OneTimeKey const * dropped = &*key;
+        ++key;
+        keys.erase(dropped);
+    }
+
+    while (new_keys--) {
+        olm::OneTimeKey * new_key = keys.push_newest();
+        bool published = false;
+        new_key_pos = olm::unpickle(new_key_pos, end, new_key->id);
+        new_key_pos = olm::unpickle(new_key_pos, end, published);
+        new_key_pos = olm::unpickle(new_key_pos, end, new_key->key);
+        keys.set_published(new_key, published);
+        keys.add_to_index(new_key);
+    }
+
+    record_journal(value, sequence);
+    return pos;
+}
@@ -0,0 +1,401 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "olm/aes_ni.h"
+#include "olm/cpu.h"
+#include "olm/memory.h"
+
+#include <string.h>
+
+#if OLM_CPU_X86
+
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+/* The rest of the library is built for the baseline architecture, so the
+ * functions that use AES-NI are compiled for it individually and only
+ * reached after checking the CPU. */
+#ifdef _MSC_VER
+#define AES_NI_TARGET
+#else
+#define AES_NI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
+#ifdef _MSC_VER
+#define GHASH_TARGET
+#else
+#define GHASH_TARGET __attribute__((target("pclmul,ssse3,sse2")))
+#endif
+
+/* Number of blocks decrypted in parallel. CBC decryption has no dependency
+ * between blocks, so this hides the latency of AESDEC. */
+#define DECRYPT_INTERLEAVE 8
+
+/* Number of counter blocks encrypted in parallel, for the same reason */
+#define CTR_INTERLEAVE 8
+
+int _olm_aes_ni_supported(void) {
+    return (_olm_cpu_features() & OLM_CPU_AESNI) != 0;
+}
+
+AES_NI_TARGET
+static __m128i expand_key_even(__m128i key, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+AES_NI_TARGET
+static __m128i expand_key_odd(__m128i key, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, 0xaa);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+/* _mm_aeskeygenassist_si128 needs the round constant as an immediate */
+#define EXPAND_ROUND(k, i, rcon) \
+    k[i] = expand_key_even(k[i - 2], _mm_aeskeygenassist_si128(k[i - 1], rcon)); \
+    k[i + 1] = expand_key_odd(k[i - 1], _mm_aeskeygenassist_si128(k[i], 0x00))
+
+AES_NI_TARGET
+void _olm_aes_ni_key_setup(
+    uint8_t const * key,
+    struct _olm_aes_ni_key * expanded_key
+) {
+    __m128i k[AES_NI_ROUND_KEYS];
+    int i;
+    k[0] = _mm_loadu_si128((const __m128i *) key);
+    k[1] = _mm_loadu_si128((const __m128i *) (key + 16));
+    EXPAND_ROUND(k, 2, 0x01);
+    EXPAND_ROUND(k, 4, 0x02);
+    EXPAND_ROUND(k, 6, 0x04);
+    EXPAND_ROUND(k, 8, 0x08);
+    EXPAND_ROUND(k, 10, 0x10);
+    EXPAND_ROUND(k, 12, 0x20);
+    /* the last round only needs the even half */
+    k[14] = expand_key_even(k[12], _mm_aeskeygenassist_si128(k[13], 0x40));
+
+    for (i = 0; i < AES_NI_ROUND_KEYS; ++i) {
+        _mm_storeu_si128((__m128i *) expanded_key->encrypt[i], k[i]);
+    }
+    /* The equivalent inverse cipher uses the round keys in reverse order,
+     * with InvMixColumns applied to all but the first and last. */
+    _mm_storeu_si128((__m128i *) expanded_key->decrypt[0], k[14]);
+    for (i = 1; i < AES_NI_ROUND_KEYS - 1; ++i) {
+        _mm_storeu_si128(
+            (__m128i *) expanded_key->decrypt[i], _mm_aesimc_si128(k[14 - i])
+        );
+    }
+    _mm_storeu_si128((__m128i *) expanded_key->decrypt[14], k[0]);
+    _olm_unset(k, sizeof(k));
+}
+
+AES_NI_TARGET
+void _olm_aes_ni_encrypt_cbc(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t * iv,
+    uint8_t const * input, size_t blocks,
+    uint8_t * output
+) {
+    __m128i rk[AES_NI_ROUND_KEYS];
+    __m128i state;
+    int i;
+    for (i = 0; i < AES_NI_ROUND_KEYS; ++i) {
+        rk[i] = _mm_loadu_si128((const __m128i *) expanded_key->encrypt[i]);
+    }
+    state = _mm_loadu_si128((const __m128i *) iv);
+    while (blocks--) {
+        state = _mm_xor_si128(state, _mm_loadu_si128((const __m128i *) input));
+        state = _mm_xor_si128(state, rk[0]);
+        for (i = 1; i < AES_NI_ROUND_KEYS - 1; ++i) {
+            state = _mm_aesenc_si128(state, rk[i]);
+        }
+        state = _mm_aesenclast_si128(state, rk[AES_NI_ROUND_KEYS - 1]);
+        _mm_storeu_si128((__m128i *) output, state);
+        input += AES_NI_BLOCK_LENGTH;
+        output += AES_NI_BLOCK_LENGTH;
+    }
+    _mm_storeu_si128((__m128i *) iv, state);
+    _olm_unset(rk, sizeof(rk));
+}
+
+AES_NI_TARGET
+void _olm_aes_ni_decrypt_cbc(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t const * iv,
+    uint8_t const * input, size_t blocks,
+    uint8_t * output
+) {
+    __m128i rk[AES_NI_ROUND_KEYS];
+    __m128i previous, ciphertext[DECRYPT_INTERLEAVE], state[DECRYPT_INTERLEAVE];
+    int i, j;
+    for (i = 0; i < AES_NI_ROUND_KEYS; ++i) {
+        rk[i] = _mm_loadu_si128((const __m128i *) expanded_key->decrypt[i]);
+    }
+    previous = _mm_loadu_si128((const __m128i *) iv);
+
+    while (blocks >= DECRYPT_INTERLEAVE) {
+        /* all of the ciphertext is read before any output is written, so
+         * decrypting in place works */
+        for (j = 0; j < DECRYPT_INTERLEAVE; ++j) {
+            ciphertext[j] = _mm_loadu_si128(
+                (const __m128i *) (input + j * AES_NI_BLOCK_LENGTH)
+            );
+            state[j] = _mm_xor_si128(ciphertext[j], rk[0]);
+        }
+        for (i = 1; i < AES_NI_ROUND_KEYS - 1; ++i) {
+            for (j = 0; j < DECRYPT_INTERLEAVE; ++j) {
+                state[j] = _mm_aesdec_si128(state[j], rk[i]);
+            }
+        }
+        for (j = 0; j < DECRYPT_INTERLEAVE; ++j) {
+            state[j] = _mm_aesdeclast_si128(state[j], rk[AES_NI_ROUND_KEYS - 1]);
+        }
+        state[0] = _mm_xor_si128(state[0], previous);
+        for (j = 1; j < DECRYPT_INTERLEAVE; ++j) {
+            state[j] = _mm_xor_si128(state[j], ciphertext[j - 1]);
+        }
+        previous = ciphertext[DECRYPT_INTERLEAVE - 1];
+        for (j = 0; j < DECRYPT_INTERLEAVE; ++j) {
+            _mm_storeu_si128(
+                (__m128i *) (output + j * AES_NI_BLOCK_LENGTH), state[j]
+            );
+        }
+        input += DECRYPT_INTERLEAVE * AES_NI_BLOCK_LENGTH;
+        output += DECRYPT_INTERLEAVE * AES_NI_BLOCK_LENGTH;
+        blocks -= DECRYPT_INTERLEAVE;
+    }
+
+    while (blocks--) {
+        ciphertext[0] = _mm_loadu_si128((const __m128i *) input);
+        state[0] = _mm_xor_si128(ciphertext[0], rk[0]);
+        for (i = 1; i < AES_NI_ROUND_KEYS - 1; ++i) {
+            state[0] = _mm_aesdec_si128(state[0], rk[i]);
+        }
+        state[0] = _mm_aesdeclast_si128(state[0], rk[AES_NI_ROUND_KEYS - 1]);
+        state[0] = _mm_xor_si128(state[0], previous);
+        previous = ciphertext[0];
+        _mm_storeu_si128((__m128i *) output, state[0]);
+        input += AES_NI_BLOCK_LENGTH;
+        output += AES_NI_BLOCK_LENGTH;
+    }
+    _olm_unset(rk, sizeof(rk));
+    _olm_unset(state, sizeof(state));
+}
+
+static uint32_t load_be32(uint8_t const * bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16)
+        | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static void store_be32(uint8_t * bytes, uint32_t value) {
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+AES_NI_TARGET
+void _olm_aes_ni_encrypt_ctr32(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t * counter,
+    uint8_t const * input, size_t length,
+    uint8_t * output
+) {
+    __m128i rk[AES_NI_ROUND_KEYS];
+    __m128i state[CTR_INTERLEAVE];
+    uint8_t block[AES_NI_BLOCK_LENGTH];
+    uint32_t count = load_be32(counter + 12);
+    size_t n;
+    int i, j;
+    for (i = 0; i < AES_NI_ROUND_KEYS; ++i) {
+        rk[i] = _mm_loadu_si128((const __m128i *) expanded_key->encrypt[i]);
+    }
+    memcpy(block, counter, AES_NI_BLOCK_LENGTH);
+
+    while (length) {
+        n = (length + AES_NI_BLOCK_LENGTH - 1) / AES_NI_BLOCK_LENGTH;
+        if (n > CTR_INTERLEAVE) {
+            n = CTR_INTERLEAVE;
+        }
+        for (j = 0; j < (int)n; ++j) {
+            store_be32(block + 12, count++);
+            state[j] = _mm_xor_si128(
+                _mm_loadu_si128((const __m128i *) block), rk[0]
+            );
+        }
+        for (i = 1; i < AES_NI_ROUND_KEYS - 1; ++i) {
+            for (j = 0; j < (int)n; ++j) {
+                state[j] = _mm_aesenc_si128(state[j], rk[i]);
+            }
+        }
+        for (j = 0; j < (int)n; ++j) {
+            state[j] = _mm_aesenclast_si128(state[j], rk[AES_NI_ROUND_KEYS - 1]);
+        }
+        for (j = 0; j < (int)n; ++j) {
+            if (length >= AES_NI_BLOCK_LENGTH) {
+                _mm_storeu_si128((__m128i *) output, _mm_xor_si128(
+                    state[j], _mm_loadu_si128((const __m128i *) input)
+                ));
+                input += AES_NI_BLOCK_LENGTH;
+                output += AES_NI_BLOCK_LENGTH;
+                length -= AES_NI_BLOCK_LENGTH;
+            } else {
+                size_t k;
+                _mm_storeu_si128((__m128i *) block, state[j]);
+                for (k = 0; k < length; ++k) {
+                    output[k] = input[k] ^ block[k];
+                }
+                length = 0;
+            }
+        }
+    }
+
+    store_be32(counter + 12, count);
+    _olm_unset(rk, sizeof(rk));
+    _olm_unset(state, sizeof(state));
+    _olm_unset(block, sizeof(block));
+}
+
+int _olm_aes_ni_ghash_supported(void) {
+    unsigned int needed = OLM_CPU_PCLMUL | OLM_CPU_SSSE3;
+    return (_olm_cpu_features() & needed) == needed;
+}
+
+/* Multiplies two elements of GF(2^128) given with their bytes reversed, so
+ * that the bit order matches PCLMULQDQ, as in Intel's "Carry-Less
+ * Multiplication and Its Usage for Computing the GCM Mode". The product is
+ * shifted left by one bit to undo the bit reflection and then reduced
+ * modulo x^128 + x^7 + x^2 + x + 1. */
+GHASH_TARGET
+static __m128i ghash_multiply(__m128i a, __m128i b) {
+    __m128i low, middle, high, carry_low, carry_high, carry_out, reduce, t;
+
+    low = _mm_clmulepi64_si128(a, b, 0x00);
+    middle = _mm_xor_si128(
+        _mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01)
+    );
+    high = _mm_clmulepi64_si128(a, b, 0x11);
+    low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+    high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+
+    /* shift the 256 bit product high:low left by one */
+    carry_low = _mm_srli_epi32(low, 31);
+    carry_high = _mm_srli_epi32(high, 31);
+    low = _mm_slli_epi32(low, 1);
+    high = _mm_slli_epi32(high, 1);
+    carry_out = _mm_srli_si128(carry_low, 12);
+    carry_high = _mm_slli_si128(carry_high, 4);
+    carry_low = _mm_slli_si128(carry_low, 4);
+    low = _mm_or_si128(low, carry_low);
+    high = _mm_or_si128(high, carry_high);
+    high = _mm_or_si128(high, carry_out);
+
+    /* first phase of the reduction */
+    reduce = _mm_xor_si128(
+        _mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30)),
+        _mm_slli_epi32(low, 25)
+    );
+    t = _mm_srli_si128(reduce, 4);
+    low = _mm_xor_si128(low, _mm_slli_si128(reduce, 12));
+
+    /* second phase */
+    reduce = _mm_xor_si128(
+        _mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2)),
+        _mm_srli_epi32(low, 7)
+    );
+    reduce = _mm_xor_si128(reduce, t);
+    low = _mm_xor_si128(low, reduce);
+    return _mm_xor_si128(high, low);
+}
+
+GHASH_TARGET
+void _olm_aes_ni_ghash(
+    uint8_t const * hash_key,
+    uint8_t * state,
+    uint8_t const * input, size_t blocks
+) {
+    const __m128i reverse = _mm_set_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    );
+    __m128i h = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *) hash_key), reverse
+    );
+    __m128i y = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *) state), reverse
+    );
+    while (blocks--) {
+        y = _mm_xor_si128(y, _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i *) input), reverse
+        ));
+        y = ghash_multiply(y, h);
+        input += AES_NI_BLOCK_LENGTH;
+    }
+    _mm_storeu_si128((__m128i *) state, _mm_shuffle_epi8(y, reverse));
+}
+
+#else /* !OLM_CPU_X86 */
+
+int _olm_aes_ni_supported(void) {
+    return 0;
+}
+
+void _olm_aes_ni_key_setup(
+    uint8_t const * key,
+    struct _olm_aes_ni_key * expanded_key
+) {
+}
+
+void _olm_aes_ni_encrypt_cbc(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t * iv,
+    uint8_t const * input, size_t blocks,
+    uint8_t * output
+) {
+}
+
+void _olm_aes_ni_decrypt_cbc(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t const * iv,
+    uint8_t const * input, size_t blocks,
+    uint8_t * output
+) {
+}
+
+void _olm_aes_ni_encrypt_ctr32(
+    struct _olm_aes_ni_key const * expanded_key,
+    uint8_t * counter,
+    uint8_t const * input, size_t length,
+    uint8_t * output
+) {
+}
+
+int _olm_aes_ni_ghash_supported(void) {
+    return 0;
+}
+
+void _olm_aes_ni_ghash(
+    uint8_t const * hash_key,
+    uint8_t * state,
+    uint8_t const * input, size_t blocks
+) {
+}
+
+#endif /* OLM_CPU_X86 */
@@ -103,6 +103,40 @@ size_t aes_sha_256_cipher_decrypt_max_plaintext_length(
     return ciphertext_length;
 }
 
+static const std::size_t DERIVED_KEYS_LENGTH =
+    AES256_KEY_LENGTH + HMAC_KEY_LENGTH + AES256_IV_LENGTH;
+
+static_assert(
+    DERIVED_KEYS_LENGTH <= OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH,
+    "OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH is too small"
+);
+
+static size_t decrypt_with_keys(
+    DerivedKeys & keys,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t * plaintext
+) {
+    std::uint8_t mac[SHA256_OUTPUT_LENGTH];
+
+    _olm_crypto_hmac_sha256(
+        keys.mac_key, HMAC_KEY_LENGTH, input, input_length - MAC_LENGTH, mac
+    );
+
+    std::uint8_t const * input_mac = input + input_length - MAC_LENGTH;
+    if (!olm::is_equal(input_mac, mac, MAC_LENGTH)) {
+        olm::unset(keys);
+        return std::size_t(-1);
+    }
+
+    std::size_t plaintext_length = _olm_crypto_aes_decrypt_cbc(
+        &keys.aes_key, &keys.aes_iv, ciphertext, ciphertext_length, plaintext
+    );
+
+    olm::unset(keys);
+    return plaintext_length;
+}
+
 size_t aes_sha_256_cipher_decrypt(
     const struct _olm_cipher *cipher,
     uint8_t const * key, size_t key_length,
@@ -119,34 +153,342 @@ size_t aes_sha_256_cipher_decrypt(
     auto *c = reinterpret_cast<const _olm_cipher_aes_sha_256 *>(cipher);
 
     DerivedKeys keys;
-    std::uint8_t mac[SHA256_OUTPUT_LENGTH];
+    derive_keys(c->kdf_info, c->kdf_info_length, key, key_length, keys);
+
+    return decrypt_with_keys(
+        keys, input, input_length, ciphertext, ciphertext_length, plaintext
+    );
+}
 
+size_t aes_sha_256_cipher_derived_keys_length(
+    const struct _olm_cipher *
+) {
+    return DERIVED_KEYS_LENGTH;
+}
+
+void aes_sha_256_cipher_derive_keys(
+    const struct _olm_cipher *cipher,
+    uint8_t const * key, size_t key_length,
+    uint8_t * derived_keys
+) {
+    auto *c = reinterpret_cast<const _olm_cipher_aes_sha_256 *>(cipher);
+
+    DerivedKeys keys;
     derive_keys(c->kdf_info, c->kdf_info_length, key, key_length, keys);
 
+    std::uint8_t * pos = derived_keys;
+    pos = olm::store_array(pos, keys.aes_key.key);
+    pos = olm::store_array(pos, keys.mac_key);
+    pos = olm::store_array(pos, keys.aes_iv.iv);
+    olm::unset(keys);
+}
+
+size_t aes_sha_256_cipher_decrypt_derived(
+    const struct _olm_cipher *cipher,
+    uint8_t const * derived_keys,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t * plaintext, size_t max_plaintext_length
+) {
+    if (max_plaintext_length
+            < aes_sha_256_cipher_decrypt_max_plaintext_length(cipher, ciphertext_length)
+            || input_length < MAC_LENGTH) {
+        return std::size_t(-1);
+    }
+
+    DerivedKeys keys;
+    std::uint8_t const * pos = derived_keys;
+    pos = olm::load_array(keys.aes_key.key, pos);
+    pos = olm::load_array(keys.mac_key, pos);
+    pos = olm::load_array(keys.aes_iv.iv, pos);
+
+    return decrypt_with_keys(
+        keys, input, input_length, ciphertext, ciphertext_length, plaintext
+    );
+}
+
+
+static const std::size_t GCM_NONCE_KEY_LENGTH = 32;
+
+static const std::size_t GCM_MAC_LENGTH = AES_GCM_IV_LENGTH + AES_GCM_TAG_LENGTH;
+
+static const std::size_t GCM_DERIVED_KEYS_LENGTH =
+    AES256_KEY_LENGTH + GCM_NONCE_KEY_LENGTH;
+
+static_assert(
+    GCM_DERIVED_KEYS_LENGTH <= OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH,
+    "OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH is too small"
+);
+
+struct GcmDerivedKeys {
+    _olm_aes256_key aes_key;
+    std::uint8_t nonce_key[GCM_NONCE_KEY_LENGTH];
+};
+
+static void gcm_derive_keys(
+    std::uint8_t const * kdf_info, std::size_t kdf_info_length,
+    std::uint8_t const * key, std::size_t key_length,
+    GcmDerivedKeys & keys
+) {
+    std::uint8_t derived_secrets[GCM_DERIVED_KEYS_LENGTH];
+    _olm_crypto_hkdf_sha256(
+        key, key_length,
+        nullptr, 0,
+        kdf_info, kdf_info_length,
+        derived_secrets, sizeof(derived_secrets)
+    );
+    std::uint8_t const * pos = derived_secrets;
+    pos = olm::load_array(keys.aes_key.key, pos);
+    pos = olm::load_array(keys.nonce_key, pos);
+    olm::unset(derived_secrets);
+}
+
+size_t aes_gcm_cipher_mac_length(const struct _olm_cipher *) {
+    return GCM_MAC_LENGTH;
+}
+
+size_t aes_gcm_cipher_encrypt_ciphertext_length(
+        const struct _olm_cipher *, size_t plaintext_length
+) {
+    return plaintext_length;
+}
+
+static bool aes_gcm_check_output(
+    size_t plaintext_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t const * output, size_t output_length
+) {
+    return ciphertext_length == plaintext_length
+        && output_length >= GCM_MAC_LENGTH
+        && ciphertext >= output
+        && ciphertext + ciphertext_length
+            == output + output_length - GCM_MAC_LENGTH;
+}
+
+size_t aes_gcm_cipher_encrypt(
+    const struct _olm_cipher *cipher,
+    uint8_t const * key, size_t key_length,
+    uint8_t const * plaintext, size_t plaintext_length,
+    uint8_t * ciphertext, size_t ciphertext_length,
+    uint8_t * output, size_t output_length
+) {
+    auto *c = reinterpret_cast<const _olm_cipher_aes_gcm *>(cipher);
+
+    if (!aes_gcm_check_output(
+            plaintext_length, ciphertext, ciphertext_length,
+            output, output_length
+    )) {
+        return std::size_t(-1);
+    }
+
+    GcmDerivedKeys keys;
+    gcm_derive_keys(c->kdf_info, c->kdf_info_length, key, key_length, keys);
+
+    std::uint8_t data_key[SHA256_OUTPUT_LENGTH];
     _olm_crypto_hmac_sha256(
-        keys.mac_key, HMAC_KEY_LENGTH, input, input_length - MAC_LENGTH, mac
+        keys.nonce_key, GCM_NONCE_KEY_LENGTH,
+        output, ciphertext - output, data_key
     );
+    _olm_hmac_sha256_key prepared_data_key;
+    _olm_crypto_hmac_sha256_prepare(
+        data_key, sizeof(data_key), &prepared_data_key
+    );
+    _olm_aes256_gcm_key gcm_key;
+    _olm_crypto_aes_gcm_prepare_key(&keys.aes_key, &gcm_key);
 
-    std::uint8_t const * input_mac = input + input_length - MAC_LENGTH;
-    if (!olm::is_equal(input_mac, mac, MAC_LENGTH)) {
-        olm::unset(keys);
+    std::size_t result = _olm_cipher_aes_gcm_encrypt_prepared(
+        &gcm_key, &prepared_data_key,
+        plaintext, plaintext_length,
+        ciphertext, ciphertext_length,
+        output, output_length
+    );
+
+    olm::unset(keys);
+    olm::unset(data_key);
+    olm::unset(prepared_data_key);
+    olm::unset(gcm_key);
+    return result;
+}
+
+size_t aes_gcm_cipher_decrypt_max_plaintext_length(
+    const struct _olm_cipher *,
+    size_t ciphertext_length
+) {
+    return ciphertext_length;
+}
+
+static size_t aes_gcm_decrypt_with_key(
+    _olm_aes256_key const & aes_key,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t * plaintext
+) {
+    _olm_aes256_gcm_key gcm_key;
+    _olm_crypto_aes_gcm_prepare_key(&aes_key, &gcm_key);
+    std::size_t result = _olm_cipher_aes_gcm_decrypt_prepared(
+        &gcm_key, input, input_length, ciphertext, ciphertext_length,
+        plaintext, ciphertext_length
+    );
+    olm::unset(gcm_key);
+    return result;
+}
+
+static bool aes_gcm_check_input(
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    size_t max_plaintext_length
+) {
+    return max_plaintext_length >= ciphertext_length
+        && input_length >= GCM_MAC_LENGTH
+        && ciphertext >= input
+        && ciphertext + ciphertext_length
+            == input + input_length - GCM_MAC_LENGTH;
+}
+
+size_t aes_gcm_cipher_decrypt(
+    const struct _olm_cipher *cipher,
+    uint8_t const * key, size_t key_length,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t * plaintext, size_t max_plaintext_length
+) {
+    if (!aes_gcm_check_input(
+            input, input_length, ciphertext, ciphertext_length,
+            max_plaintext_length
+    )) {
         return std::size_t(-1);
     }
 
-    std::size_t plaintext_length = _olm_crypto_aes_decrypt_cbc(
-        &keys.aes_key, &keys.aes_iv, ciphertext, ciphertext_length, plaintext
+    auto *c = reinterpret_cast<const _olm_cipher_aes_gcm *>(cipher);
+
+    GcmDerivedKeys keys;
+    gcm_derive_keys(c->kdf_info, c->kdf_info_length, key, key_length, keys);
+    std::size_t result = aes_gcm_decrypt_with_key(
+        keys.aes_key, input, input_length, ciphertext, ciphertext_length,
+        plaintext
     );
+    olm::unset(keys);
+    return result;
+}
+
+size_t aes_gcm_cipher_derived_keys_length(
+    const struct _olm_cipher *
+) {
+    return GCM_DERIVED_KEYS_LENGTH;
+}
+
+void aes_gcm_cipher_derive_keys(
+    const struct _olm_cipher *cipher,
+    uint8_t const * key, size_t key_length,
+    uint8_t * derived_keys
+) {
+    auto *c = reinterpret_cast<const _olm_cipher_aes_gcm *>(cipher);
+
+    GcmDerivedKeys keys;
+    gcm_derive_keys(c->kdf_info, c->kdf_info_length, key, key_length, keys);
 
+    std::uint8_t * pos = derived_keys;
+    pos = olm::store_array(pos, keys.aes_key.key);
+    pos = olm::store_array(pos, keys.nonce_key);
     olm::unset(keys);
-    return plaintext_length;
+}
+
+size_t aes_gcm_cipher_decrypt_derived(
+    const struct _olm_cipher *,
+    uint8_t const * derived_keys,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t * plaintext, size_t max_plaintext_length
+) {
+    if (!aes_gcm_check_input(
+            input, input_length, ciphertext, ciphertext_length,
+            max_plaintext_length
+    )) {
+        return std::size_t(-1);
+    }
+
+    _olm_aes256_key aes_key;
+    olm::load_array(aes_key.key, derived_keys);
+    std::size_t result = aes_gcm_decrypt_with_key(
+        aes_key, input, input_length, ciphertext, ciphertext_length,
+        plaintext
+    );
+    olm::unset(aes_key);
+    return result;
 }
 
 } // namespace
 
+size_t _olm_cipher_aes_gcm_encrypt_prepared(
+    const struct _olm_aes256_gcm_key *gcm_key,
+    const struct _olm_hmac_sha256_key *data_key,
+    uint8_t const * plaintext, size_t plaintext_length,
+    uint8_t * ciphertext, size_t ciphertext_length,
+    uint8_t * output, size_t output_length
+) {
+    if (!aes_gcm_check_output(
+            plaintext_length, ciphertext, ciphertext_length,
+            output, output_length
+    )) {
+        return std::size_t(-1);
+    }
+
+    /* the nonce has to be taken before an in-place encryption overwrites the
+     * plain-text */
+    std::uint8_t nonce[SHA256_OUTPUT_LENGTH];
+    _olm_crypto_hmac_sha256_prepared(
+        data_key, plaintext, plaintext_length, nonce
+    );
+    std::uint8_t * mac = output + output_length - GCM_MAC_LENGTH;
+    std::memcpy(mac, nonce, AES_GCM_IV_LENGTH);
+
+    _olm_crypto_aes_gcm_encrypt(
+        gcm_key, mac, output, ciphertext - output,
+        plaintext, plaintext_length, ciphertext, mac + AES_GCM_IV_LENGTH
+    );
+    olm::unset(nonce);
+    return output_length;
+}
+
+size_t _olm_cipher_aes_gcm_decrypt_prepared(
+    const struct _olm_aes256_gcm_key *gcm_key,
+    uint8_t const * input, size_t input_length,
+    uint8_t const * ciphertext, size_t ciphertext_length,
+    uint8_t * plaintext, size_t max_plaintext_length
+) {
+    if (!aes_gcm_check_input(
+            input, input_length, ciphertext, ciphertext_length,
+            max_plaintext_length
+    )) {
+        return std::size_t(-1);
+    }
+
+    std::uint8_t const * mac = input + input_length - GCM_MAC_LENGTH;
+    int valid = _olm_crypto_aes_gcm_decrypt(
+        gcm_key, mac, input, ciphertext - input,
+        ciphertext, ciphertext_length, mac + AES_GCM_IV_LENGTH, plaintext
+    );
+    return valid ? ciphertext_length : std::size_t(-1);
+}
+
 const struct _olm_cipher_ops _olm_cipher_aes_sha_256_ops = {
   aes_sha_256_cipher_mac_length,
   aes_sha_256_cipher_encrypt_ciphertext_length,
   aes_sha_256_cipher_encrypt,
   aes_sha_256_cipher_decrypt_max_plaintext_length,
   aes_sha_256_cipher_decrypt,
+  aes_sha_256_cipher_derived_keys_length,
+  aes_sha_256_cipher_derive_keys,
+  aes_sha_256_cipher_decrypt_derived,
+};
+
+const struct _olm_cipher_ops _olm_cipher_aes_gcm_ops = {
+  aes_gcm_cipher_mac_length,
+  aes_gcm_cipher_encrypt_ciphertext_length,
+  aes_gcm_cipher_encrypt,
+  aes_gcm_cipher_decrypt_max_plaintext_length,
+  aes_gcm_cipher_decrypt,
+  aes_gcm_cipher_derived_keys_length,
+  aes_gcm_cipher_derive_keys,
+  aes_gcm_cipher_decrypt_derived,
 };
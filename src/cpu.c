@@ -0,0 +1,102 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "olm/cpu.h"
+
+#if OLM_CPU_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <stdint.h>
+
+static void cpuid(
+    unsigned int leaf, unsigned int subleaf, unsigned int regs[4]
+) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, (int)leaf, (int)subleaf);
+    regs[0] = info[0]; regs[1] = info[1];
+    regs[2] = info[2]; regs[3] = info[3];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/* The XCR0 register, which tells us which register sets the OS saves on a
+ * context switch. Only valid if CPUID reports OSXSAVE. */
+static uint64_t xgetbv(void) {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile (".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static unsigned int detect_features(void) {
+    unsigned int regs[4];
+    unsigned int max_leaf;
+    unsigned int features = 0;
+
+    cpuid(0, 0, regs);
+    max_leaf = regs[0];
+    if (max_leaf < 1) {
+        return 0;
+    }
+
+    cpuid(1, 0, regs);
+    if (regs[2] & (1u << 25)) features |= OLM_CPU_AESNI;
+    if (regs[2] & (1u << 1)) features |= OLM_CPU_PCLMUL;
+    if (regs[2] & (1u << 9)) features |= OLM_CPU_SSSE3;
+    if (regs[2] & (1u << 19)) features |= OLM_CPU_SSE41;
+    int avx_usable = (regs[2] & (1u << 27)) /* OSXSAVE */
+        && (regs[2] & (1u << 28)) /* AVX */
+        && (xgetbv() & 0x6) == 0x6; /* XMM and YMM state */
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, regs);
+        if (regs[1] & (1u << 29)) features |= OLM_CPU_SHA;
+        if (avx_usable && (regs[1] & (1u << 5))) features |= OLM_CPU_AVX2;
+        if (regs[1] & (1u << 8)) features |= OLM_CPU_BMI2;
+    }
+    return features;
+}
+
+#endif /* OLM_CPU_X86 */
+
+/* Bit 31 marks the value as initialised, so that a CPU with none of the
+ * features doesn't get queried on every call. Detection is idempotent, so two
+ * threads racing to fill this in will store the same value. */
+#define FEATURES_DETECTED 0x80000000u
+
+static volatile unsigned int cached_features = 0;
+
+unsigned int _olm_cpu_features(void) {
+    unsigned int features = cached_features;
+    if (!(features & FEATURES_DETECTED)) {
+#if OLM_CPU_X86
+        features = detect_features() | FEATURES_DETECTED;
+#else
+        features = FEATURES_DETECTED;
+#endif
+        cached_features = features;
+    }
+    return features & ~FEATURES_DETECTED;
+}
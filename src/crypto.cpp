@@ -13,8 +13,10 @@
  * limitations under the License.
  */
 #include "olm/crypto.h"
+#include "olm/aes_ni.h"
 #include "olm/memory.hh"
 
+#include <algorithm>
 #include <cstring>
 
 extern "C" {
@@ -29,8 +31,7 @@ extern "C" {
 
 namespace {
 
-static const std::uint8_t CURVE25519_BASEPOINT[32] = {9};
-static const std::size_t AES_KEY_SCHEDULE_LENGTH = 60;
+static const std::size_t AES_KEY_SCHEDULE_LENGTH = AES256_KEY_SCHEDULE_LENGTH;
 static const std::size_t AES_KEY_BITS = 8 * AES256_KEY_LENGTH;
 static const std::size_t AES_BLOCK_LENGTH = 16;
 static const std::size_t SHA256_BLOCK_LENGTH = 64;
@@ -64,40 +65,273 @@ inline static void hmac_sha256_key(
 }
 
 
-inline static void hmac_sha256_init(
-    ::SHA256_CTX * context,
-    std::uint8_t const * hmac_key
+/* Compresses a padded key block and keeps the resulting midstate */
+inline static void hmac_sha256_absorb_pad(
+    std::uint8_t const * hmac_key,
+    std::uint8_t pad_byte,
+    std::uint32_t * state
 ) {
-    std::uint8_t i_pad[SHA256_BLOCK_LENGTH];
-    std::memcpy(i_pad, hmac_key, SHA256_BLOCK_LENGTH);
+    std::uint8_t pad[SHA256_BLOCK_LENGTH];
+    std::memcpy(pad, hmac_key, SHA256_BLOCK_LENGTH);
     for (std::size_t i = 0; i < SHA256_BLOCK_LENGTH; ++i) {
-        i_pad[i] ^= 0x36;
+        pad[i] ^= pad_byte;
     }
-    ::sha256_init(context);
-    ::sha256_update(context, i_pad, SHA256_BLOCK_LENGTH);
-    olm::unset(i_pad);
+    ::SHA256_CTX context;
+    ::sha256_init(&context);
+    ::sha256_update(&context, pad, SHA256_BLOCK_LENGTH);
+    std::memcpy(state, context.state, sizeof(context.state));
+    olm::unset(context);
+    olm::unset(pad);
+}
+
+
+/* Starts a SHA-256 context from a midstate taken after one block */
+inline static void sha256_resume(
+    ::SHA256_CTX * context,
+    std::uint32_t const * state
+) {
+    std::memcpy(context->state, state, sizeof(context->state));
+    context->datalen = 0;
+    context->bitlen = 8 * SHA256_BLOCK_LENGTH;
+}
+
+
+inline static void hmac_sha256_init(
+    ::SHA256_CTX * context,
+    _olm_hmac_sha256_key const * prepared_key
+) {
+    sha256_resume(context, prepared_key->inner_state);
 }
 
 
 inline static void hmac_sha256_final(
     ::SHA256_CTX * context,
-    std::uint8_t const * hmac_key,
+    _olm_hmac_sha256_key const * prepared_key,
     std::uint8_t * output
 ) {
-    std::uint8_t o_pad[SHA256_BLOCK_LENGTH + SHA256_OUTPUT_LENGTH];
-    std::memcpy(o_pad, hmac_key, SHA256_BLOCK_LENGTH);
-    for (std::size_t i = 0; i < SHA256_BLOCK_LENGTH; ++i) {
-        o_pad[i] ^= 0x5C;
-    }
-    ::sha256_final(context, o_pad + SHA256_BLOCK_LENGTH);
+    std::uint8_t inner_hash[SHA256_OUTPUT_LENGTH];
+    ::sha256_final(context, inner_hash);
     ::SHA256_CTX final_context;
-    ::sha256_init(&final_context);
-    ::sha256_update(&final_context, o_pad, sizeof(o_pad));
+    sha256_resume(&final_context, prepared_key->outer_state);
+    ::sha256_update(&final_context, inner_hash, sizeof(inner_hash));
     ::sha256_final(&final_context, output);
     olm::unset(final_context);
-    olm::unset(o_pad);
+    olm::unset(inner_hash);
 }
 
+
+/* AES-256-CBC with PKCS#7 padding, using AES-NI for the blocks. The round
+ * keys belong to the caller's prepared key, which is unset by its owner */
+static void aes_ni_encrypt_cbc(
+    ::_olm_aes_ni_key const & ni_key,
+    _olm_aes256_iv const *iv,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    std::uint8_t chain[AES_BLOCK_LENGTH];
+    std::memcpy(chain, iv->iv, AES_BLOCK_LENGTH);
+    std::size_t full_blocks = input_length / AES_BLOCK_LENGTH;
+    ::_olm_aes_ni_encrypt_cbc(&ni_key, chain, input, full_blocks, output);
+    input += full_blocks * AES_BLOCK_LENGTH;
+    output += full_blocks * AES_BLOCK_LENGTH;
+    input_length -= full_blocks * AES_BLOCK_LENGTH;
+
+    std::uint8_t final_block[AES_BLOCK_LENGTH];
+    std::memcpy(final_block, input, input_length);
+    std::memset(
+        final_block + input_length, AES_BLOCK_LENGTH - input_length,
+        AES_BLOCK_LENGTH - input_length
+    );
+    ::_olm_aes_ni_encrypt_cbc(&ni_key, chain, final_block, 1, output);
+    olm::unset(chain);
+    olm::unset(final_block);
+}
+
+
+/* Encrypts a single block with a prepared key */
+static void aes_encrypt_block(
+    _olm_aes256_prepared_key const & prepared_key,
+    std::uint8_t const * input,
+    std::uint8_t * output
+) {
+    if (prepared_key.use_aes_ni) {
+        std::uint8_t chain[AES_BLOCK_LENGTH] = {};
+        ::_olm_aes_ni_encrypt_cbc(
+            &prepared_key.round_keys.aes_ni_key, chain, input, 1, output
+        );
+        olm::unset(chain);
+    } else {
+        ::aes_encrypt(
+            input, output, prepared_key.round_keys.key_schedule, AES_KEY_BITS
+        );
+    }
+}
+
+
+/* AES in the counter mode used by GCM, see _olm_aes_ni_encrypt_ctr32 */
+static void aes_encrypt_ctr32(
+    _olm_aes256_prepared_key const & prepared_key,
+    std::uint8_t * counter,
+    std::uint8_t const * input, std::size_t length,
+    std::uint8_t * output
+) {
+    if (prepared_key.use_aes_ni) {
+        ::_olm_aes_ni_encrypt_ctr32(
+            &prepared_key.round_keys.aes_ni_key, counter, input, length, output
+        );
+        return;
+    }
+    std::uint8_t key_stream[AES_BLOCK_LENGTH];
+    while (length) {
+        aes_encrypt_block(prepared_key, counter, key_stream);
+        /* increment the last 4 bytes as a big-endian number */
+        for (std::size_t i = AES_BLOCK_LENGTH; i-- > AES_BLOCK_LENGTH - 4;) {
+            if (++counter[i]) {
+                break;
+            }
+        }
+        std::size_t n = std::min(length, AES_BLOCK_LENGTH);
+        for (std::size_t i = 0; i < n; ++i) {
+            output[i] = input[i] ^ key_stream[i];
+        }
+        input += n;
+        output += n;
+        length -= n;
+    }
+    olm::unset(key_stream);
+}
+
+
+static std::uint64_t load_be64(std::uint8_t const * bytes) {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+
+static void store_be64(std::uint8_t * bytes, std::uint64_t value) {
+    for (std::size_t i = 8; i-- > 0;) {
+        bytes[i] = std::uint8_t(value);
+        value >>= 8;
+    }
+}
+
+
+static void store_be32(std::uint8_t * bytes, std::uint32_t value) {
+    for (std::size_t i = 4; i-- > 0;) {
+        bytes[i] = std::uint8_t(value);
+        value >>= 8;
+    }
+}
+
+
+/* Multiplies the GHASH state by H in GF(2^128) one bit at a time, as in
+ * algorithm 1 of NIST SP 800-38D. It uses masks rather than branches so that
+ * the time taken does not depend on the data. This is only used when the CPU
+ * has no carry-less multiplication. */
+static void ghash_multiply(
+    std::uint8_t * state,
+    std::uint8_t const * hash_key
+) {
+    std::uint64_t x[2] = { load_be64(state), load_be64(state + 8) };
+    std::uint64_t v_high = load_be64(hash_key);
+    std::uint64_t v_low = load_be64(hash_key + 8);
+    std::uint64_t z_high = 0, z_low = 0;
+    for (std::size_t i = 0; i < 128; ++i) {
+        std::uint64_t bit = (x[i / 64] >> (63 - i % 64)) & 1;
+        z_high ^= v_high & (0 - bit);
+        z_low ^= v_low & (0 - bit);
+        std::uint64_t carry = v_low & 1;
+        v_low = (v_low >> 1) | (v_high << 63);
+        v_high = (v_high >> 1) ^ (UINT64_C(0xe100000000000000) & (0 - carry));
+    }
+    store_be64(state, z_high);
+    store_be64(state + 8, z_low);
+}
+
+
+/* Adds input to the GHASH state, padding the last block with zeros */
+static void ghash_update(
+    _olm_aes256_gcm_key const & gcm_key,
+    std::uint8_t * state,
+    std::uint8_t const * input, std::size_t length
+) {
+    std::size_t blocks = length / AES_BLOCK_LENGTH;
+    if (gcm_key.use_pclmul) {
+        ::_olm_aes_ni_ghash(gcm_key.hash_key, state, input, blocks);
+    } else {
+        for (std::size_t i = 0; i < blocks; ++i) {
+            xor_block<AES_BLOCK_LENGTH>(state, input + i * AES_BLOCK_LENGTH);
+            ghash_multiply(state, gcm_key.hash_key);
+        }
+    }
+    std::size_t remainder = length % AES_BLOCK_LENGTH;
+    if (remainder) {
+        std::uint8_t block[AES_BLOCK_LENGTH] = {};
+        std::memcpy(block, input + blocks * AES_BLOCK_LENGTH, remainder);
+        if (gcm_key.use_pclmul) {
+            ::_olm_aes_ni_ghash(gcm_key.hash_key, state, block, 1);
+        } else {
+            xor_block<AES_BLOCK_LENGTH>(state, block);
+            ghash_multiply(state, gcm_key.hash_key);
+        }
+        olm::unset(block);
+    }
+}
+
+
+/* Computes the GCM tag for the additional data and ciphertext */
+static void gcm_tag(
+    _olm_aes256_gcm_key const & gcm_key,
+    std::uint8_t const * iv,
+    std::uint8_t const * additional_data, std::size_t additional_data_length,
+    std::uint8_t const * ciphertext, std::size_t ciphertext_length,
+    std::uint8_t * tag
+) {
+    std::uint8_t state[AES_BLOCK_LENGTH] = {};
+    std::uint8_t block[AES_BLOCK_LENGTH];
+    ghash_update(gcm_key, state, additional_data, additional_data_length);
+    ghash_update(gcm_key, state, ciphertext, ciphertext_length);
+    store_be64(block, std::uint64_t(additional_data_length) * 8);
+    store_be64(block + 8, std::uint64_t(ciphertext_length) * 8);
+    ghash_update(gcm_key, state, block, AES_BLOCK_LENGTH);
+
+    /* the tag is the hash encrypted with the first counter block, J0 */
+    std::memcpy(block, iv, AES_GCM_IV_LENGTH);
+    store_be32(block + AES_GCM_IV_LENGTH, 1);
+    aes_encrypt_block(gcm_key.aes_key, block, block);
+    for (std::size_t i = 0; i < AES_GCM_TAG_LENGTH; ++i) {
+        tag[i] = state[i] ^ block[i];
+    }
+    olm::unset(state);
+    olm::unset(block);
+}
+
+/* Use the ed25519 field arithmetic for X25519 when it has the 64-bit
+ * radix 2^51 backend; otherwise curve25519-donna is the faster choice. */
+inline void curve25519_scalarmult(
+    std::uint8_t * output,
+    std::uint8_t const * secret,
+    std::uint8_t const * point
+) {
+#ifdef ED25519_FE51
+    ::ed25519_x25519(output, secret, point);
+#else
+    ::curve25519_donna(output, secret, point);
+#endif
+}
+
+#ifdef ED25519_BASE_WINDOW
+/* Build the wide Ed25519 fixed-base table on first use. Function-local
+ * statics are initialised exactly once even with concurrent callers. */
+inline void ed25519_base_table() {
+    static bool const ready = (::ed25519_init_base_table(), true);
+    (void) ready;
+}
+#endif
+
 } // namespace
 
 void _olm_crypto_curve25519_generate_key(
@@ -108,20 +342,54 @@ void _olm_crypto_curve25519_generate_key(
         key_pair->private_key.private_key, random_32_bytes,
         CURVE25519_KEY_LENGTH
     );
-    ::curve25519_donna(
+#ifdef ED25519_BASE_WINDOW
+    ed25519_base_table();
+#endif
+    /* Same result as a ladder against the base point u = 9, but uses the
+     * ed25519 fixed-base tables */
+    ::ed25519_x25519_base(
         key_pair->public_key.public_key,
-        key_pair->private_key.private_key,
-        CURVE25519_BASEPOINT
+        key_pair->private_key.private_key
     );
 }
 
 
+void _olm_crypto_curve25519_generate_keys(
+    std::size_t count, std::uint8_t const * random,
+    struct _olm_curve25519_key_pair * const * key_pairs
+) {
+#ifdef ED25519_BASE_WINDOW
+    ed25519_base_table();
+#endif
+    const std::size_t chunk = 64;
+    std::uint8_t * public_keys[chunk];
+    std::uint8_t const * private_keys[chunk];
+    while (count) {
+        std::size_t n = count < chunk ? count : chunk;
+        for (std::size_t i = 0; i < n; ++i) {
+            std::memcpy(
+                key_pairs[i]->private_key.private_key, random,
+                CURVE25519_KEY_LENGTH
+            );
+            random += CURVE25519_RANDOM_LENGTH;
+            public_keys[i] = key_pairs[i]->public_key.public_key;
+            private_keys[i] = key_pairs[i]->private_key.private_key;
+        }
+        ::ed25519_x25519_base_batch(public_keys, private_keys, n);
+        key_pairs += n;
+        count -= n;
+    }
+}
+
+
 void _olm_crypto_curve25519_shared_secret(
     const struct _olm_curve25519_key_pair *our_key,
     const struct _olm_curve25519_public_key * their_key,
     std::uint8_t * output
 ) {
-    ::curve25519_donna(output, our_key->private_key.private_key, their_key->public_key);
+    curve25519_scalarmult(
+        output, our_key->private_key.private_key, their_key->public_key
+    );
 }
 
 
@@ -129,6 +397,9 @@ void _olm_crypto_ed25519_generate_key(
     std::uint8_t const * random_32_bytes,
     struct _olm_ed25519_key_pair *key_pair
 ) {
+#ifdef ED25519_BASE_WINDOW
+    ed25519_base_table();
+#endif
     ::ed25519_create_keypair(
         key_pair->public_key.public_key, key_pair->private_key.private_key,
         random_32_bytes
@@ -141,6 +412,9 @@ void _olm_crypto_ed25519_sign(
     std::uint8_t const * message, std::size_t message_length,
     std::uint8_t * output
 ) {
+#ifdef ED25519_BASE_WINDOW
+    ed25519_base_table();
+#endif
     ::ed25519_sign(
         output,
         message, message_length,
@@ -163,6 +437,97 @@ int _olm_crypto_ed25519_verify(
 }
 
 
+static_assert(
+    ED25519_PREPARED_TABLE_LENGTH == ED25519_PREPARED_TABLE_SIZE,
+    "prepared key table length must match lib/ed25519"
+);
+
+void _olm_crypto_ed25519_prepare_public_key(
+    const struct _olm_ed25519_public_key *key,
+    struct _olm_ed25519_prepared_public_key *prepared
+) {
+    prepared->public_key = *key;
+    prepared->is_valid = ::ed25519_prepare_public_key(
+        prepared->table, key->public_key
+    ) ? 1 : 0;
+}
+
+
+int _olm_crypto_ed25519_verify_prepared(
+    const struct _olm_ed25519_prepared_public_key *their_key,
+    std::uint8_t const * message, std::size_t message_length,
+    std::uint8_t const * signature
+) {
+    if (!their_key->is_valid) {
+        return 0;
+    }
+    return 0 != ::ed25519_verify_prepared(
+        signature,
+        message, message_length,
+        their_key->public_key.public_key, their_key->table
+    );
+}
+
+
+int _olm_crypto_ed25519_verify_batch(
+    std::size_t count,
+    const struct _olm_ed25519_public_key * const * their_keys,
+    std::uint8_t const * const * messages, std::size_t const * message_lengths,
+    std::uint8_t const * const * signatures,
+    int * results
+) {
+    /* ed25519_verify_batch wants the raw key bytes */
+    std::uint8_t const * keys[64];
+    int all_valid = 1;
+    for (std::size_t start = 0; start < count; start += 64) {
+        std::size_t chunk = std::min<std::size_t>(count - start, 64);
+        for (std::size_t i = 0; i < chunk; ++i) {
+            keys[i] = their_keys[start + i]->public_key;
+        }
+        all_valid &= ::ed25519_verify_batch(
+            signatures + start,
+            messages + start, message_lengths + start,
+            keys, chunk, results + start
+        );
+    }
+    return all_valid;
+}
+
+
+void _olm_crypto_ed25519_digest(
+    const struct _olm_ed25519_public_key *their_key,
+    std::uint8_t const * message, std::size_t message_length,
+    std::uint8_t const * signature,
+    std::uint8_t * digest
+) {
+    ::ed25519_hram(
+        digest, signature, message, message_length, their_key->public_key
+    );
+}
+
+
+int _olm_crypto_ed25519_verify_digest_batch(
+    std::size_t count,
+    const struct _olm_ed25519_public_key * const * their_keys,
+    std::uint8_t const * const * digests,
+    std::uint8_t const * const * signatures,
+    int * results
+) {
+    std::uint8_t const * keys[64];
+    int all_valid = 1;
+    for (std::size_t start = 0; start < count; start += 64) {
+        std::size_t chunk = std::min<std::size_t>(count - start, 64);
+        for (std::size_t i = 0; i < chunk; ++i) {
+            keys[i] = their_keys[start + i]->public_key;
+        }
+        all_valid &= ::ed25519_verify_batch_hram(
+            signatures + start, digests + start, keys, chunk, results + start
+        );
+    }
+    return all_valid;
+}
+
+
 std::size_t _olm_crypto_aes_encrypt_cbc_length(
     std::size_t input_length
 ) {
@@ -176,8 +541,59 @@ void _olm_crypto_aes_encrypt_cbc(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * output
 ) {
-    std::uint32_t key_schedule[AES_KEY_SCHEDULE_LENGTH];
-    ::aes_key_setup(key->key, key_schedule, AES_KEY_BITS);
+    _olm_aes256_prepared_key prepared_key;
+    _olm_crypto_aes_prepare_key(key, &prepared_key);
+    _olm_crypto_aes_encrypt_cbc_prepared(
+        &prepared_key, iv, input, input_length, output
+    );
+    olm::unset(prepared_key);
+}
+
+
+std::size_t _olm_crypto_aes_decrypt_cbc(
+    _olm_aes256_key const *key,
+    _olm_aes256_iv const *iv,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    _olm_aes256_prepared_key prepared_key;
+    _olm_crypto_aes_prepare_key(key, &prepared_key);
+    std::size_t result = _olm_crypto_aes_decrypt_cbc_prepared(
+        &prepared_key, iv, input, input_length, output
+    );
+    olm::unset(prepared_key);
+    return result;
+}
+
+
+void _olm_crypto_aes_prepare_key(
+    _olm_aes256_key const *key,
+    _olm_aes256_prepared_key *prepared_key
+) {
+    prepared_key->use_aes_ni = _olm_aes_ni_supported() ? 1 : 0;
+    if (prepared_key->use_aes_ni) {
+        ::_olm_aes_ni_key_setup(key->key, &prepared_key->round_keys.aes_ni_key);
+    } else {
+        ::aes_key_setup(
+            key->key, prepared_key->round_keys.key_schedule, AES_KEY_BITS
+        );
+    }
+}
+
+
+void _olm_crypto_aes_encrypt_cbc_prepared(
+    _olm_aes256_prepared_key const *prepared_key,
+    _olm_aes256_iv const *iv,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    if (prepared_key->use_aes_ni) {
+        aes_ni_encrypt_cbc(
+            prepared_key->round_keys.aes_ni_key, iv, input, input_length, output
+        );
+        return;
+    }
+    std::uint32_t const * key_schedule = prepared_key->round_keys.key_schedule;
     std::uint8_t input_block[AES_BLOCK_LENGTH];
     std::memcpy(input_block, iv->iv, AES_BLOCK_LENGTH);
     while (input_length >= AES_BLOCK_LENGTH) {
@@ -196,19 +612,25 @@ void _olm_crypto_aes_encrypt_cbc(
         input_block[i] ^= AES_BLOCK_LENGTH - input_length;
     }
     ::aes_encrypt(input_block, output, key_schedule, AES_KEY_BITS);
-    olm::unset(key_schedule);
     olm::unset(input_block);
 }
 
 
-std::size_t _olm_crypto_aes_decrypt_cbc(
-    _olm_aes256_key const *key,
+std::size_t _olm_crypto_aes_decrypt_cbc_prepared(
+    _olm_aes256_prepared_key const *prepared_key,
     _olm_aes256_iv const *iv,
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * output
 ) {
-    std::uint32_t key_schedule[AES_KEY_SCHEDULE_LENGTH];
-    ::aes_key_setup(key->key, key_schedule, AES_KEY_BITS);
+    if (prepared_key->use_aes_ni) {
+        ::_olm_aes_ni_decrypt_cbc(
+            &prepared_key->round_keys.aes_ni_key, iv->iv,
+            input, input_length / AES_BLOCK_LENGTH, output
+        );
+        std::size_t padding = output[input_length - 1];
+        return (padding > input_length) ? std::size_t(-1) : (input_length - padding);
+    }
+    std::uint32_t const * key_schedule = prepared_key->round_keys.key_schedule;
     std::uint8_t block1[AES_BLOCK_LENGTH];
     std::uint8_t block2[AES_BLOCK_LENGTH];
     std::memcpy(block1, iv->iv, AES_BLOCK_LENGTH);
@@ -218,7 +640,6 @@ std::size_t _olm_crypto_aes_decrypt_cbc(
         xor_block<AES_BLOCK_LENGTH>(&output[i], block1);
         std::memcpy(block1, block2, AES_BLOCK_LENGTH);
     }
-    olm::unset(key_schedule);
     olm::unset(block1);
     olm::unset(block2);
     std::size_t padding = output[input_length - 1];
@@ -226,6 +647,63 @@ std::size_t _olm_crypto_aes_decrypt_cbc(
 }
 
 
+void _olm_crypto_aes_gcm_prepare_key(
+    _olm_aes256_key const *key,
+    _olm_aes256_gcm_key *gcm_key
+) {
+    _olm_crypto_aes_prepare_key(key, &gcm_key->aes_key);
+    gcm_key->use_pclmul = gcm_key->aes_key.use_aes_ni
+        && _olm_aes_ni_ghash_supported();
+    std::uint8_t zero[AES_BLOCK_LENGTH] = {};
+    aes_encrypt_block(gcm_key->aes_key, zero, gcm_key->hash_key);
+}
+
+
+void _olm_crypto_aes_gcm_encrypt(
+    _olm_aes256_gcm_key const *gcm_key,
+    std::uint8_t const * iv,
+    std::uint8_t const * additional_data, std::size_t additional_data_length,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output, std::uint8_t * tag
+) {
+    /* J0 is used for the tag, so the data starts at the counter after it */
+    std::uint8_t counter[AES_BLOCK_LENGTH];
+    std::memcpy(counter, iv, AES_GCM_IV_LENGTH);
+    store_be32(counter + AES_GCM_IV_LENGTH, 2);
+    aes_encrypt_ctr32(gcm_key->aes_key, counter, input, input_length, output);
+    gcm_tag(
+        *gcm_key, iv, additional_data, additional_data_length,
+        output, input_length, tag
+    );
+    olm::unset(counter);
+}
+
+
+int _olm_crypto_aes_gcm_decrypt(
+    _olm_aes256_gcm_key const *gcm_key,
+    std::uint8_t const * iv,
+    std::uint8_t const * additional_data, std::size_t additional_data_length,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t const * tag,
+    std::uint8_t * output
+) {
+    std::uint8_t expected_tag[AES_GCM_TAG_LENGTH];
+    gcm_tag(
+        *gcm_key, iv, additional_data, additional_data_length,
+        input, input_length, expected_tag
+    );
+    if (!olm::is_equal(expected_tag, tag, AES_GCM_TAG_LENGTH)) {
+        return 0;
+    }
+    std::uint8_t counter[AES_BLOCK_LENGTH];
+    std::memcpy(counter, iv, AES_GCM_IV_LENGTH);
+    store_be32(counter + AES_GCM_IV_LENGTH, 2);
+    aes_encrypt_ctr32(gcm_key->aes_key, counter, input, input_length, output);
+    olm::unset(counter);
+    return 1;
+}
+
+
 void _olm_crypto_sha256(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * output
@@ -238,22 +716,43 @@ void _olm_crypto_sha256(
 }
 
 
-void _olm_crypto_hmac_sha256(
+void _olm_crypto_hmac_sha256_prepare(
     std::uint8_t const * key, std::size_t key_length,
+    _olm_hmac_sha256_key * prepared_key
+) {
+    std::uint8_t hmac_key[SHA256_BLOCK_LENGTH];
+    hmac_sha256_key(key, key_length, hmac_key);
+    hmac_sha256_absorb_pad(hmac_key, 0x36, prepared_key->inner_state);
+    hmac_sha256_absorb_pad(hmac_key, 0x5C, prepared_key->outer_state);
+    olm::unset(hmac_key);
+}
+
+
+void _olm_crypto_hmac_sha256_prepared(
+    _olm_hmac_sha256_key const * prepared_key,
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * output
 ) {
-    std::uint8_t hmac_key[SHA256_BLOCK_LENGTH];
     ::SHA256_CTX context;
-    hmac_sha256_key(key, key_length, hmac_key);
-    hmac_sha256_init(&context, hmac_key);
+    hmac_sha256_init(&context, prepared_key);
     ::sha256_update(&context, input, input_length);
-    hmac_sha256_final(&context, hmac_key, output);
-    olm::unset(hmac_key);
+    hmac_sha256_final(&context, prepared_key, output);
     olm::unset(context);
 }
 
 
+void _olm_crypto_hmac_sha256(
+    std::uint8_t const * key, std::size_t key_length,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    _olm_hmac_sha256_key prepared_key;
+    _olm_crypto_hmac_sha256_prepare(key, key_length, &prepared_key);
+    _olm_crypto_hmac_sha256_prepared(&prepared_key, input, input_length, output);
+    olm::unset(prepared_key);
+}
+
+
 void _olm_crypto_hkdf_sha256(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t const * salt, std::size_t salt_length,
@@ -261,7 +760,7 @@ void _olm_crypto_hkdf_sha256(
     std::uint8_t * output, std::size_t output_length
 ) {
     ::SHA256_CTX context;
-    std::uint8_t hmac_key[SHA256_BLOCK_LENGTH];
+    _olm_hmac_sha256_key prepared_key;
     std::uint8_t step_result[SHA256_OUTPUT_LENGTH];
     std::size_t bytes_remaining = output_length;
     std::uint8_t iteration = 1;
@@ -270,30 +769,29 @@ void _olm_crypto_hkdf_sha256(
         salt_length = sizeof(HKDF_DEFAULT_SALT);
     }
     /* Extract */
-    hmac_sha256_key(salt, salt_length, hmac_key);
-    hmac_sha256_init(&context, hmac_key);
-    ::sha256_update(&context, input, input_length);
-    hmac_sha256_final(&context, hmac_key, step_result);
-    hmac_sha256_key(step_result, SHA256_OUTPUT_LENGTH, hmac_key);
+    _olm_crypto_hmac_sha256(salt, salt_length, input, input_length, step_result);
 
-    /* Expand */
-    hmac_sha256_init(&context, hmac_key);
+    /* Expand. Every step uses the same key, so it is only prepared once. */
+    _olm_crypto_hmac_sha256_prepare(
+        step_result, SHA256_OUTPUT_LENGTH, &prepared_key
+    );
+    hmac_sha256_init(&context, &prepared_key);
     ::sha256_update(&context, info, info_length);
     ::sha256_update(&context, &iteration, 1);
-    hmac_sha256_final(&context, hmac_key, step_result);
+    hmac_sha256_final(&context, &prepared_key, step_result);
     while (bytes_remaining > SHA256_OUTPUT_LENGTH) {
         std::memcpy(output, step_result, SHA256_OUTPUT_LENGTH);
         output += SHA256_OUTPUT_LENGTH;
         bytes_remaining -= SHA256_OUTPUT_LENGTH;
         iteration ++;
-        hmac_sha256_init(&context, hmac_key);
+        hmac_sha256_init(&context, &prepared_key);
         ::sha256_update(&context, step_result, SHA256_OUTPUT_LENGTH);
         ::sha256_update(&context, info, info_length);
         ::sha256_update(&context, &iteration, 1);
-        hmac_sha256_final(&context, hmac_key, step_result);
+        hmac_sha256_final(&context, &prepared_key, step_result);
     }
     std::memcpy(output, step_result, bytes_remaining);
     olm::unset(context);
-    olm::unset(hmac_key);
+    olm::unset(prepared_key);
     olm::unset(step_result);
 }
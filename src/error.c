@@ -32,6 +32,12 @@ static const char * ERRORS[] = {
     "BAD_LEGACY_ACCOUNT_PICKLE",
     "BAD_SIGNATURE",
     "OLM_INPUT_BUFFER_TOO_SMALL",
+    "KEY_STORE_TOO_SMALL",
+    "WORK_BUDGET_EXCEEDED",
+    "VERIFY_QUEUE_FULL",
+    "BAD_PICKLE_DELTA",
+    "BAD_SESSION_ARCHIVE",
+    "UNKNOWN_SESSION_ID",
 };
 
 const char * _olm_error_to_string(enum OlmErrorCode error)
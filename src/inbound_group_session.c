@@ -34,6 +34,25 @@
 #define SESSION_KEY_VERSION      2
 #define SESSION_EXPORT_VERSION   1
 
+/* checkpoints are taken where the ratchet's R(2) part wraps, which also
+ * covers every R(1) and R(0) boundary */
+#define CHECKPOINT_INTERVAL      (1U << 8)
+#define MAX_CHECKPOINTS          (1U << 16)
+#define MAX_CACHED_KEYS          (1U << 10)
+
+/** the cipher keys for one message index, kept by the message key cache */
+struct _OlmCachedMessageKey {
+    uint32_t message_index;
+
+    /** when the entry was last used, or 0 if the slot is empty */
+    uint32_t last_used;
+
+    /** sha256 of the last message with this index that we verified */
+    uint8_t message_hash[SHA256_OUTPUT_LENGTH];
+
+    uint8_t derived_keys[OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH];
+};
+
 struct OlmInboundGroupSession {
     /** our earliest known ratchet value */
     Megolm initial_ratchet;
@@ -44,6 +63,13 @@ struct OlmInboundGroupSession {
     /** The ed25519 signing key */
     struct _olm_ed25519_public_key signing_key;
 
+    /**
+     * signing_key, decompressed so that message signatures can be checked
+     * without decoding the key every time. It is not pickled: it is rebuilt
+     * from signing_key whenever that is set.
+     */
+    struct _olm_ed25519_prepared_public_key prepared_signing_key;
+
     /**
      * Have we ever seen any evidence that this is a valid session?
      * (either because the original session share was signed, or because we
@@ -55,18 +81,96 @@ struct OlmInboundGroupSession {
      */
     int signing_key_verified;
 
+    /**
+     * The most hashes _get_megolm may compute to reach a message's ratchet
+     * value, or 0 for no limit. It is not pickled.
+     */
+    uint32_t work_budget;
+
+    /**
+     * Copies of ratchet values at multiples of CHECKPOINT_INTERVAL that were
+     * passed while advancing, so that older messages can be reached without
+     * starting from initial_ratchet. They are stored after the struct, in a
+     * ring of checkpoint_capacity entries that overwrites the oldest first.
+     * They are not pickled: they are rebuilt as messages are decrypted.
+     */
+    uint32_t checkpoint_capacity;
+    uint32_t checkpoint_count;
+    uint32_t checkpoint_next;
+
+    /**
+     * The cipher keys of recently decrypted messages, so that decrypting the
+     * same message again needs neither the signature check nor the ratchet.
+     * They are stored after the checkpoints, and the least recently used
+     * entry is replaced when they are all in use. They are not pickled.
+     */
+    uint32_t cached_key_capacity;
+    uint32_t cache_clock;
+
     enum OlmErrorCode last_error;
 };
 
+static Megolm *_checkpoints(const OlmInboundGroupSession *session) {
+    return (Megolm *)(session + 1);
+}
+
+static struct _OlmCachedMessageKey *_cached_keys(
+    const OlmInboundGroupSession *session
+) {
+    return (struct _OlmCachedMessageKey *)(
+        _checkpoints(session) + session->checkpoint_capacity
+    );
+}
+
+static size_t _session_size(uint32_t checkpoints, uint32_t cached_keys) {
+    return sizeof(OlmInboundGroupSession) + checkpoints * sizeof(Megolm)
+        + cached_keys * sizeof(struct _OlmCachedMessageKey);
+}
+
+static uint32_t _clamp(size_t count, uint32_t max) {
+    return count < max ? (uint32_t)count : max;
+}
+
 size_t olm_inbound_group_session_size(void) {
     return sizeof(OlmInboundGroupSession);
 }
 
+size_t olm_inbound_group_session_size_with_checkpoints(size_t checkpoints) {
+    return olm_inbound_group_session_size_with_caches(checkpoints, 0);
+}
+
+size_t olm_inbound_group_session_size_with_caches(
+    size_t checkpoints, size_t cached_keys
+) {
+    return _session_size(
+        _clamp(checkpoints, MAX_CHECKPOINTS),
+        _clamp(cached_keys, MAX_CACHED_KEYS)
+    );
+}
+
 OlmInboundGroupSession * olm_inbound_group_session(
     void *memory
+) {
+    return olm_inbound_group_session_with_caches(memory, 0, 0);
+}
+
+OlmInboundGroupSession * olm_inbound_group_session_with_checkpoints(
+    void *memory, size_t checkpoints
+) {
+    return olm_inbound_group_session_with_caches(memory, checkpoints, 0);
+}
+
+OlmInboundGroupSession * olm_inbound_group_session_with_caches(
+    void *memory, size_t checkpoints, size_t cached_keys
 ) {
     OlmInboundGroupSession *session = memory;
-    olm_clear_inbound_group_session(session);
+    uint32_t checkpoint_capacity = _clamp(checkpoints, MAX_CHECKPOINTS);
+    uint32_t cached_key_capacity = _clamp(cached_keys, MAX_CACHED_KEYS);
+    _olm_unset(
+        session, _session_size(checkpoint_capacity, cached_key_capacity)
+    );
+    session->checkpoint_capacity = checkpoint_capacity;
+    session->cached_key_capacity = cached_key_capacity;
     return session;
 }
 
@@ -76,11 +180,201 @@ const char *olm_inbound_group_session_last_error(
     return _olm_error_to_string(session->last_error);
 }
 
+void olm_inbound_group_session_set_work_budget(
+    OlmInboundGroupSession *session, uint32_t max_hash_steps
+) {
+    session->work_budget = max_hash_steps;
+}
+
 size_t olm_clear_inbound_group_session(
     OlmInboundGroupSession *session
 ) {
-    _olm_unset(session, sizeof(OlmInboundGroupSession));
-    return sizeof(OlmInboundGroupSession);
+    uint32_t checkpoint_capacity = session->checkpoint_capacity;
+    uint32_t cached_key_capacity = session->cached_key_capacity;
+    size_t size = _session_size(checkpoint_capacity, cached_key_capacity);
+    _olm_unset(session, size);
+    session->checkpoint_capacity = checkpoint_capacity;
+    session->cached_key_capacity = cached_key_capacity;
+    return size;
+}
+
+/** forget all cached message keys, for when the ratchets are replaced */
+static void _clear_cached_keys(OlmInboundGroupSession *session) {
+    _olm_unset(
+        _cached_keys(session),
+        session->cached_key_capacity * sizeof(struct _OlmCachedMessageKey)
+    );
+    session->cache_clock = 0;
+}
+
+/** find the cached keys for a message index, or NULL */
+static struct _OlmCachedMessageKey *_find_cached_key(
+    const OlmInboundGroupSession *session, uint32_t message_index
+) {
+    struct _OlmCachedMessageKey *entries = _cached_keys(session);
+    uint32_t i;
+
+    for (i = 0; i < session->cached_key_capacity; i++) {
+        if (entries[i].last_used && entries[i].message_index == message_index) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * get the entry to store the keys for a message index in: the one we already
+ * have for it, an empty one, or the least recently used one.
+ */
+static struct _OlmCachedMessageKey *_cache_slot(
+    OlmInboundGroupSession *session, uint32_t message_index
+) {
+    struct _OlmCachedMessageKey *entries = _cached_keys(session);
+    struct _OlmCachedMessageKey *oldest = &entries[0];
+    uint32_t i;
+
+    for (i = 0; i < session->cached_key_capacity; i++) {
+        if (!entries[i].last_used
+                || entries[i].message_index == message_index) {
+            return &entries[i];
+        }
+        if (entries[i].last_used < oldest->last_used) {
+            oldest = &entries[i];
+        }
+    }
+    return oldest;
+}
+
+/** mark a cache entry as the most recently used */
+static void _touch_cached_key(
+    OlmInboundGroupSession *session, struct _OlmCachedMessageKey *entry
+) {
+    if (++session->cache_clock == 0) {
+        /* start the clock again rather than compare wrapped timestamps */
+        struct _OlmCachedMessageKey *entries = _cached_keys(session);
+        uint32_t i;
+        for (i = 0; i < session->cached_key_capacity; i++) {
+            if (entries[i].last_used) {
+                entries[i].last_used = 1;
+            }
+        }
+        session->cache_clock = 2;
+    }
+    entry->last_used = session->cache_clock;
+}
+
+/** forget all checkpoints, for when the ratchets are replaced */
+static void _clear_checkpoints(OlmInboundGroupSession *session) {
+    _olm_unset(
+        _checkpoints(session), session->checkpoint_count * sizeof(Megolm)
+    );
+    session->checkpoint_count = 0;
+    session->checkpoint_next = 0;
+}
+
+/** remember a ratchet value, unless we already have it */
+static void _add_checkpoint(
+    OlmInboundGroupSession *session, const Megolm *megolm
+) {
+    Megolm *checkpoints = _checkpoints(session);
+    uint32_t i;
+
+    for (i = 0; i < session->checkpoint_count; i++) {
+        if (checkpoints[i].counter == megolm->counter) {
+            return;
+        }
+    }
+    checkpoints[session->checkpoint_next] = *megolm;
+    if (++session->checkpoint_next == session->checkpoint_capacity) {
+        session->checkpoint_next = 0;
+    }
+    if (session->checkpoint_count < session->checkpoint_capacity) {
+        session->checkpoint_count++;
+    }
+}
+
+/**
+ * advance a ratchet to the given index, taking checkpoints at the multiples
+ * of CHECKPOINT_INTERVAL on the way. Only the last checkpoint_capacity of
+ * those are taken, since the ring would drop any earlier ones. Each one
+ * costs extra hashes over going straight to the index, so with a work budget
+ * no more are taken once the next would leave too little of it to reach the
+ * index. Going by way of a checkpoint never costs less than going straight
+ * there, which _check_work_budget has already checked fits.
+ */
+static void _advance_with_checkpoints(
+    OlmInboundGroupSession *session, Megolm *megolm, uint32_t message_index
+) {
+    if (session->checkpoint_capacity) {
+        uint32_t distance = message_index - megolm->counter;
+        uint32_t first = (megolm->counter | (CHECKPOINT_INTERVAL - 1)) + 1;
+        uint32_t last = message_index & ~(CHECKPOINT_INTERVAL - 1);
+        uint32_t spent = 0;
+
+        if (first - megolm->counter <= distance) {
+            uint32_t count = (last - first) / CHECKPOINT_INTERVAL + 1;
+            if (count > session->checkpoint_capacity) {
+                first = last - (session->checkpoint_capacity - 1)
+                    * CHECKPOINT_INTERVAL;
+            }
+            for (;;) {
+                if (session->work_budget) {
+                    uint32_t step = megolm_advance_cost(megolm, first);
+                    if (step + megolm_advance_cost_from(first, message_index)
+                            > session->work_budget - spent) {
+                        break;
+                    }
+                    spent += step;
+                }
+                megolm_advance_to(megolm, first);
+                _add_checkpoint(session, megolm);
+                if (first == last) {
+                    break;
+                }
+                first += CHECKPOINT_INTERVAL;
+            }
+        }
+    }
+    megolm_advance_to(megolm, message_index);
+}
+
+/**
+ * whether candidate is a ratchet value at or before the index, and closer to
+ * it than current, which must itself be at or before it.
+ */
+static int _is_closer(
+    const OlmInboundGroupSession *session, uint32_t message_index,
+    const Megolm *candidate, const Megolm *current
+) {
+    uint32_t offset = message_index - session->initial_ratchet.counter;
+    uint32_t start = candidate->counter - session->initial_ratchet.counter;
+    return start <= offset
+        && message_index - candidate->counter
+            < message_index - current->counter;
+}
+
+/**
+ * find the ratchet value to start from to reach an index before the latest
+ * ratchet: the closest of the checkpoints and hint (if not NULL) at or before
+ * the index, or failing that the initial ratchet.
+ */
+static const Megolm *_nearest_megolm(
+    const OlmInboundGroupSession *session, uint32_t message_index,
+    const Megolm *hint
+) {
+    const Megolm *checkpoints = _checkpoints(session);
+    const Megolm *best = &session->initial_ratchet;
+    uint32_t i;
+
+    for (i = 0; i < session->checkpoint_count; i++) {
+        if (_is_closer(session, message_index, &checkpoints[i], best)) {
+            best = &checkpoints[i];
+        }
+    }
+    if (hint && _is_closer(session, message_index, hint, best)) {
+        best = hint;
+    }
+    return best;
 }
 
 #define SESSION_EXPORT_RAW_LENGTH \
@@ -113,16 +407,22 @@ static size_t _init_group_session_keys(
 
     megolm_init(&session->initial_ratchet, ptr, counter);
     megolm_init(&session->latest_ratchet, ptr, counter);
+    _clear_checkpoints(session);
+    _clear_cached_keys(session);
 
     ptr += MEGOLM_RATCHET_LENGTH;
     memcpy(
         session->signing_key.public_key, ptr, ED25519_PUBLIC_KEY_LENGTH
     );
     ptr += ED25519_PUBLIC_KEY_LENGTH;
+    _olm_crypto_ed25519_prepare_public_key(
+        &session->signing_key, &session->prepared_signing_key
+    );
 
     if (!export_format) {
-        if (!_olm_crypto_ed25519_verify(&session->signing_key, key_buf,
-                                        ptr - key_buf, ptr)) {
+        if (!_olm_crypto_ed25519_verify_prepared(
+                &session->prepared_signing_key, key_buf, ptr - key_buf, ptr
+        )) {
             session->last_error = OLM_BAD_SIGNATURE;
             return (size_t)-1;
         }
@@ -199,41 +499,96 @@ size_t olm_pickle_inbound_group_session_length(
     return _olm_enc_output_length(raw_pickle_length(session));
 }
 
-size_t olm_pickle_inbound_group_session(
+size_t olm_pickle_inbound_group_session_with_key_length(
+    const OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key
+) {
+    return _olm_enc_output_length_with_key(
+        pickle_key, raw_pickle_length(session)
+    );
+}
+
+/**
+ * Writes the pickle of the session where _olm_enc_output expects it, or
+ * _olm_enc_binary_output if binary is set, or _olm_enc_output_with_key if
+ * pickle_key is non-NULL, or _olm_enc_binary_output_with_key if both are.
+ * Returns its length, or olm_error() if the output buffer is too small.
+ */
+static size_t _pickle_raw(
     OlmInboundGroupSession *session,
-    void const * key, size_t key_length,
-    void * pickled, size_t pickled_length
+    void * pickled, size_t pickled_length,
+    int binary, const OlmPickleKey * pickle_key
 ) {
     size_t raw_length = raw_pickle_length(session);
+    size_t output_length = binary
+        ? pickle_key
+            ? _olm_enc_binary_output_length_with_key(pickle_key, raw_length)
+            : _olm_enc_binary_output_length(raw_length)
+        : pickle_key
+        ? _olm_enc_output_length_with_key(pickle_key, raw_length)
+        : _olm_enc_output_length(raw_length);
     uint8_t *pos;
 
-    if (pickled_length < _olm_enc_output_length(raw_length)) {
+    if (pickled_length < output_length) {
         session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
         return (size_t)-1;
     }
 
-    pos = _olm_enc_output_pos(pickled, raw_length);
+    pos = binary
+        ? pickle_key
+            ? _olm_enc_binary_output_pos_with_key(pickle_key, pickled)
+            : pickled
+        : pickle_key
+        ? _olm_enc_output_pos_with_key(pickle_key, pickled, raw_length)
+        : _olm_enc_output_pos(pickled, raw_length);
     pos = _olm_pickle_uint32(pos, PICKLE_VERSION);
     pos = megolm_pickle(&session->initial_ratchet, pos);
     pos = megolm_pickle(&session->latest_ratchet, pos);
     pos = _olm_pickle_ed25519_public_key(pos, &session->signing_key);
     pos = _olm_pickle_bool(pos, session->signing_key_verified);
 
-    return _olm_enc_output(key, key_length, pickled, raw_length);
+    return raw_length;
 }
 
-size_t olm_unpickle_inbound_group_session(
+size_t olm_pickle_inbound_group_session(
     OlmInboundGroupSession *session,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _pickle_raw(session, pickled, pickled_length, 0, NULL);
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+    return _olm_enc_output(key, key_length, pickled, raw_length);
+}
+
+size_t olm_pickle_inbound_group_session_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _pickle_raw(
+        session, pickled, pickled_length, 0, pickle_key
+    );
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+    return _olm_enc_output_with_key(pickle_key, pickled, raw_length);
+}
+
+/**
+ * Loads the session from the raw_length bytes at pickled that _olm_enc_input
+ * decrypted, passing on its failure if raw_length is olm_error().
+ */
+static size_t _unpickle_raw(
+    OlmInboundGroupSession *session,
+    void * pickled, size_t raw_length,
+    size_t pickled_length
 ) {
     const uint8_t *pos;
     const uint8_t *end;
     uint32_t pickle_version;
 
-    size_t raw_length = _olm_enc_input(
-        key, key_length, pickled, pickled_length, &(session->last_error)
-    );
     if (raw_length == (size_t)-1) {
         return raw_length;
     }
@@ -245,6 +600,8 @@ size_t olm_unpickle_inbound_group_session(
         session->last_error = OLM_UNKNOWN_PICKLE_VERSION;
         return (size_t)-1;
     }
+    _clear_checkpoints(session);
+    _clear_cached_keys(session);
     pos = megolm_unpickle(&session->initial_ratchet, pos, end);
     pos = megolm_unpickle(&session->latest_ratchet, pos, end);
     pos = _olm_unpickle_ed25519_public_key(pos, end, &session->signing_key);
@@ -263,9 +620,108 @@ size_t olm_unpickle_inbound_group_session(
         return (size_t)-1;
     }
 
+    _olm_crypto_ed25519_prepare_public_key(
+        &session->signing_key, &session->prepared_signing_key
+    );
+
     return pickled_length;
 }
 
+size_t olm_unpickle_inbound_group_session(
+    OlmInboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_input(
+        key, key_length, pickled, pickled_length, &(session->last_error)
+    );
+    return _unpickle_raw(session, pickled, raw_length, pickled_length);
+}
+
+size_t olm_unpickle_inbound_group_session_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_input_with_key(
+        pickle_key, pickled, pickled_length, &(session->last_error)
+    );
+    return _unpickle_raw(session, pickled, raw_length, pickled_length);
+}
+
+size_t olm_pickle_inbound_group_session_binary_length(
+    const OlmInboundGroupSession *session
+) {
+    return _olm_enc_binary_output_length(raw_pickle_length(session));
+}
+
+size_t olm_pickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _pickle_raw(session, pickled, pickled_length, 1, NULL);
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+    return _olm_enc_binary_output(key, key_length, pickled, raw_length);
+}
+
+size_t olm_unpickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_binary_input(
+        key, key_length, pickled, pickled_length, &(session->last_error)
+    );
+    return _unpickle_raw(session, pickled, raw_length, pickled_length);
+}
+
+size_t olm_pickle_inbound_group_session_binary_with_key_length(
+    const OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key
+) {
+    return _olm_enc_binary_output_length_with_key(
+        pickle_key, raw_pickle_length(session)
+    );
+}
+
+size_t olm_pickle_inbound_group_session_binary_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _pickle_raw(
+        session, pickled, pickled_length, 1, pickle_key
+    );
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+    return _olm_enc_binary_output_with_key(pickle_key, pickled, raw_length);
+}
+
+size_t olm_unpickle_inbound_group_session_binary_with_key(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void const * pickled, size_t pickled_length,
+    void * scratch, size_t scratch_length
+) {
+    size_t raw_length;
+    size_t result;
+
+    if (scratch_length < pickled_length) {
+        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+    raw_length = _olm_enc_binary_input_with_key(
+        pickle_key, pickled, pickled_length, scratch, &(session->last_error)
+    );
+    result = _unpickle_raw(session, scratch, raw_length, pickled_length);
+    _olm_unset(scratch, pickled_length);
+    return result;
+}
+
 /**
  * get the max plaintext length in an un-base64-ed message
  */
@@ -313,43 +769,292 @@ size_t olm_group_decrypt_max_plaintext_length(
 }
 
 /**
- * get a copy of the megolm ratchet, advanced
- * to the relevant index. Returns 0 on success, -1 on error
+ * fail if advancing a ratchet to the given index would go over the work
+ * budget. Returns 0 if it fits, -1 if not, with the reason in last_error.
  */
-static size_t _get_megolm(
-    OlmInboundGroupSession *session, uint32_t message_index, Megolm *result
+static size_t _check_work_budget(
+    const OlmInboundGroupSession *session, const Megolm *megolm,
+    uint32_t message_index, enum OlmErrorCode *last_error
+) {
+    if (session->work_budget
+            && megolm_advance_cost(megolm, message_index)
+                > session->work_budget) {
+        *last_error = OLM_WORK_BUDGET_EXCEEDED;
+        return (size_t)-1;
+    }
+    return 0;
+}
+
+/**
+ * find the ratchet value to advance from to reach the given index: the latest
+ * ratchet for indexes at or beyond it, and otherwise the nearest checkpoint
+ * or the initial ratchet. If hint is not NULL it is a ratchet value that is
+ * used instead when it is closer. Returns NULL if the index is before the
+ * initial ratchet or reaching it would go over the work budget, with the
+ * reason in last_error.
+ */
+static const Megolm *_start_megolm(
+    const OlmInboundGroupSession *session, uint32_t message_index,
+    const Megolm *hint, enum OlmErrorCode *last_error
 ) {
-    /* pick a megolm instance to use. If we're at or beyond the latest ratchet
-     * value, use that */
+    const Megolm *start;
+
     if ((message_index - session->latest_ratchet.counter) < (1U << 31)) {
-        megolm_advance_to(&session->latest_ratchet, message_index);
-        *result = session->latest_ratchet;
-        return 0;
+        start = &session->latest_ratchet;
+        if (hint && _is_closer(session, message_index, hint, start)) {
+            start = hint;
+        }
     } else if ((message_index - session->initial_ratchet.counter) >= (1U << 31)) {
         /* the counter is before our intial ratchet - we can't decode this. */
-        session->last_error = OLM_UNKNOWN_MESSAGE_INDEX;
+        *last_error = OLM_UNKNOWN_MESSAGE_INDEX;
+        return NULL;
+    } else {
+        start = _nearest_megolm(session, message_index, hint);
+    }
+
+    if (_check_work_budget(session, start, message_index, last_error)
+            == (size_t)-1) {
+        return NULL;
+    }
+    return start;
+}
+
+/**
+ * get a copy of the megolm ratchet, advanced
+ * to the relevant index. If hint is not NULL it is a ratchet value that may
+ * be advanced from for indexes before the latest one; result may be the
+ * same as hint. Returns 0 on success, -1 on error
+ */
+static size_t _get_megolm(
+    OlmInboundGroupSession *session, uint32_t message_index, Megolm *result,
+    const Megolm *hint
+) {
+    const Megolm *start = _start_megolm(
+        session, message_index, hint, &session->last_error
+    );
+    if (!start) {
         return (size_t)-1;
+    }
+
+    /* If we're at or beyond the latest ratchet value, move that on.
+     * Otherwise take a copy so that we don't overwrite it */
+    if (start == &session->latest_ratchet) {
+        _advance_with_checkpoints(
+            session, &session->latest_ratchet, message_index
+        );
+        *result = session->latest_ratchet;
     } else {
-        /* otherwise, start from the initial megolm. Take a copy so that we
-         * don't overwrite the initial megolm */
-        *result = session->initial_ratchet;
-        megolm_advance_to(result, message_index);
+        *result = *start;
+        _advance_with_checkpoints(session, result, message_index);
+    }
+    return 0;
+}
+
+/**
+ * check that an un-base64-ed message has a version and format we can
+ * decrypt. Returns 0 if so, -1 if not, with the reason in last_error.
+ */
+static size_t _check_decoded_message(
+    const struct _OlmDecodeGroupMessageResults *decoded_results,
+    enum OlmErrorCode *last_error
+) {
+    if (decoded_results->version != OLM_PROTOCOL_VERSION) {
+        *last_error = OLM_BAD_MESSAGE_VERSION;
+        return (size_t)-1;
+    }
+
+    if (!decoded_results->has_message_index || !decoded_results->ciphertext) {
+        *last_error = OLM_BAD_MESSAGE_FORMAT;
+        return (size_t)-1;
+    }
+    return 0;
+}
+
+struct OlmGroupDecryptScratch {
+    /** the furthest ratchet value reached by a successful decrypt */
+    Megolm ratchet;
+    int has_ratchet;
+
+    /** the signing key of the session that ratchet belongs to */
+    struct _olm_ed25519_public_key signing_key;
+
+    /** the number of signature checks olm_group_decrypt_deferred has queued
+     * for messages decrypted with this scratch space, which the flush has not
+     * passed yet */
+    size_t unverified;
+    /** whether the flush has failed any of those checks */
+    int bad_signature;
+
+    enum OlmErrorCode last_error;
+};
+
+/** whether the scratch ratchet value belongs to this session */
+static int _scratch_matches(
+    const OlmInboundGroupSession *session,
+    const OlmGroupDecryptScratch *scratch
+) {
+    return scratch->has_ratchet && memcmp(
+        scratch->signing_key.public_key, session->signing_key.public_key,
+        ED25519_PUBLIC_KEY_LENGTH
+    ) == 0;
+}
+
+/**
+ * decrypt an un-base64-ed message, with the cached keys for its index if
+ * there are any. message_length excludes the signature. signature_checked
+ * says whether the signature has been checked yet: if so, message_hash is
+ * remembered as verified when the cache is enabled. If working is not NULL
+ * it is used as the ratchet value to advance for the message, and may start
+ * from where it was for an earlier message.
+ *
+ * If scratch is not NULL the session is only read, as for
+ * olm_group_decrypt_read_only(): errors go in the scratch space, and the
+ * ratchet is advanced from a copy, starting from the one in the scratch
+ * space if that is closer. The furthest value reached is kept there.
+ */
+static size_t _decrypt_decoded(
+    OlmInboundGroupSession *session, OlmGroupDecryptScratch *scratch,
+    uint8_t * message, size_t message_length,
+    const struct _OlmDecodeGroupMessageResults *decoded_results,
+    int signature_checked, const uint8_t *message_hash,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    Megolm *working
+) {
+    enum OlmErrorCode *last_error =
+        scratch ? &scratch->last_error : &session->last_error;
+    uint32_t index = decoded_results->message_index;
+    size_t max_length, r;
+    Megolm megolm;
+    Megolm *ratchet = working ? working : &megolm;
+    struct _OlmCachedMessageKey *cached = NULL;
+    uint8_t derived_keys[OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH];
+    const uint8_t *keys;
+
+    max_length = megolm_cipher->ops->decrypt_max_plaintext_length(
+        megolm_cipher,
+        decoded_results->ciphertext_length
+    );
+    if (max_plaintext_length < max_length) {
+        *last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+
+    if (session->cached_key_capacity) {
+        cached = _find_cached_key(session, index);
+    }
+
+    if (cached) {
+        keys = cached->derived_keys;
+    } else {
+        if (scratch) {
+            const Megolm *start = _start_megolm(
+                session, index,
+                _scratch_matches(session, scratch) ? &scratch->ratchet : NULL,
+                last_error
+            );
+            if (!start) {
+                return (size_t)-1;
+            }
+            *ratchet = *start;
+            megolm_advance_to(ratchet, index);
+        } else {
+            r = _get_megolm(session, index, ratchet, working);
+            if (r == (size_t)-1) {
+                return r;
+            }
+        }
+        megolm_cipher->ops->derive_keys(
+            megolm_cipher,
+            megolm_get_data(ratchet), MEGOLM_RATCHET_LENGTH,
+            derived_keys
+        );
+        keys = derived_keys;
+    }
+
+    /* now try checking the mac, and decrypting */
+    r = megolm_cipher->ops->decrypt_derived(
+        megolm_cipher, keys,
+        message, message_length,
+        decoded_results->ciphertext, decoded_results->ciphertext_length,
+        plaintext, max_plaintext_length
+    );
+
+    if (r == (size_t)-1) {
+        _olm_unset(derived_keys, sizeof(derived_keys));
+        _olm_unset(&megolm, sizeof(megolm));
+        *last_error = OLM_BAD_MESSAGE_MAC;
+        return r;
+    }
+
+    if (scratch) {
+        /* keep the furthest ratchet value we have reached, for
+         * olm_inbound_group_session_commit_ratchet */
+        if (!cached && (!_scratch_matches(session, scratch)
+                || (ratchet->counter - scratch->ratchet.counter)
+                    < (1U << 31))) {
+            scratch->ratchet = *ratchet;
+            scratch->has_ratchet = 1;
+            scratch->signing_key = session->signing_key;
+        }
+    } else if (session->cached_key_capacity) {
+        if (!cached) {
+            cached = _cache_slot(session, index);
+            cached->message_index = index;
+            memcpy(cached->derived_keys, derived_keys, sizeof(derived_keys));
+            _olm_unset(cached->message_hash, SHA256_OUTPUT_LENGTH);
+        }
+        if (signature_checked) {
+            memcpy(cached->message_hash, message_hash, SHA256_OUTPUT_LENGTH);
+        }
+        _touch_cached_key(session, cached);
+    }
+    _olm_unset(derived_keys, sizeof(derived_keys));
+    _olm_unset(&megolm, sizeof(megolm));
+
+    /* once we have successfully decrypted a message, set a flag to say the
+     * session appears valid. */
+    if (signature_checked && !scratch) {
+        session->signing_key_verified = 1;
+    }
+
+    return r;
+}
+
+/**
+ * whether we have already checked the signature of this exact message, with
+ * message_hash its sha256. Always false if the cache is disabled.
+ */
+static int _already_verified(
+    const OlmInboundGroupSession *session,
+    const struct _OlmDecodeGroupMessageResults *decoded_results,
+    const uint8_t *message_hash
+) {
+    struct _OlmCachedMessageKey *cached;
+
+    if (!session->cached_key_capacity) {
         return 0;
     }
+    cached = _find_cached_key(session, decoded_results->message_index);
+    return cached && memcmp(
+        cached->message_hash, message_hash, SHA256_OUTPUT_LENGTH
+    ) == 0;
 }
 
 /**
- * decrypt an un-base64-ed message
+ * decrypt an un-base64-ed message. If scratch is not NULL the session is only
+ * read, as for _decrypt_decoded.
  */
 static size_t _decrypt(
-    OlmInboundGroupSession *session,
+    OlmInboundGroupSession *session, OlmGroupDecryptScratch *scratch,
     uint8_t * message, size_t message_length,
     uint8_t * plaintext, size_t max_plaintext_length,
     uint32_t * message_index
 ) {
+    enum OlmErrorCode *last_error =
+        scratch ? &scratch->last_error : &session->last_error;
     struct _OlmDecodeGroupMessageResults decoded_results;
-    size_t max_length, r;
-    Megolm megolm;
+    uint8_t message_hash[SHA256_OUTPUT_LENGTH];
+    size_t r;
 
     _olm_decode_group_message(
         message, message_length,
@@ -357,13 +1062,7 @@ static size_t _decrypt(
         ED25519_SIGNATURE_LENGTH,
         &decoded_results);
 
-    if (decoded_results.version != OLM_PROTOCOL_VERSION) {
-        session->last_error = OLM_BAD_MESSAGE_VERSION;
-        return (size_t)-1;
-    }
-
-    if (!decoded_results.has_message_index || !decoded_results.ciphertext) {
-        session->last_error = OLM_BAD_MESSAGE_FORMAT;
+    if (_check_decoded_message(&decoded_results, last_error) == (size_t)-1) {
         return (size_t)-1;
     }
 
@@ -371,60 +1070,277 @@ static size_t _decrypt(
         *message_index = decoded_results.message_index;
     }
 
+    if (session->cached_key_capacity) {
+        _olm_crypto_sha256(message, message_length, message_hash);
+    }
+
     /* verify the signature. We could do this before decoding the message, but
      * we allow for the possibility of future protocol versions which use a
      * different signing mechanism; we would rather throw "BAD_MESSAGE_VERSION"
-     * than "BAD_SIGNATURE" in this case.
+     * than "BAD_SIGNATURE" in this case. There is no need to check it again
+     * if we have already verified this exact message.
      */
     message_length -= ED25519_SIGNATURE_LENGTH;
-    r = _olm_crypto_ed25519_verify(
-        &session->signing_key,
-        message, message_length,
-        message + message_length
+    if (!_already_verified(session, &decoded_results, message_hash)) {
+        r = _olm_crypto_ed25519_verify_prepared(
+            &session->prepared_signing_key,
+            message, message_length,
+            message + message_length
+        );
+        if (!r) {
+            *last_error = OLM_BAD_SIGNATURE;
+            return (size_t)-1;
+        }
+    }
+
+    return _decrypt_decoded(
+        session, scratch, message, message_length, &decoded_results,
+        1, message_hash, plaintext, max_plaintext_length, NULL
     );
-    if (!r) {
-        session->last_error = OLM_BAD_SIGNATURE;
+}
+
+size_t olm_group_decrypt(
+    OlmInboundGroupSession *session,
+    uint8_t * message, size_t message_length,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index
+) {
+    size_t raw_message_length;
+
+    raw_message_length = _olm_decode_base64(message, message_length, message);
+    if (raw_message_length == (size_t)-1) {
+        session->last_error = OLM_INVALID_BASE64;
         return (size_t)-1;
     }
 
-    max_length = megolm_cipher->ops->decrypt_max_plaintext_length(
-        megolm_cipher,
-        decoded_results.ciphertext_length
+    return _decrypt(
+        session, NULL, message, raw_message_length,
+        plaintext, max_plaintext_length,
+        message_index
     );
-    if (max_plaintext_length < max_length) {
-        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+}
+
+/** a signature check left for olm_group_verify_flush */
+struct _OlmQueuedSignature {
+    /** the scratch space the message was decrypted with */
+    OlmGroupDecryptScratch *scratch;
+    struct _olm_ed25519_public_key signing_key;
+    uint8_t digest[ED25519_DIGEST_LENGTH];
+    uint8_t signature[ED25519_SIGNATURE_LENGTH];
+};
+
+struct OlmGroupVerifyQueue {
+    size_t capacity;
+    size_t length;
+    enum OlmErrorCode last_error;
+};
+
+#define MAX_QUEUED_SIGNATURES ((size_t)1 << 20)
+
+static struct _OlmQueuedSignature *_queued_signatures(
+    OlmGroupVerifyQueue *queue
+) {
+    return (struct _OlmQueuedSignature *)(queue + 1);
+}
+
+static size_t _clamp_queue_capacity(size_t capacity) {
+    return capacity < MAX_QUEUED_SIGNATURES
+        ? capacity : MAX_QUEUED_SIGNATURES;
+}
+
+size_t olm_group_verify_queue_size(size_t capacity) {
+    return sizeof(OlmGroupVerifyQueue)
+        + _clamp_queue_capacity(capacity) * sizeof(struct _OlmQueuedSignature);
+}
+
+OlmGroupVerifyQueue * olm_group_verify_queue(
+    void *memory, size_t capacity
+) {
+    OlmGroupVerifyQueue *queue = memory;
+    _olm_unset(queue, olm_group_verify_queue_size(capacity));
+    queue->capacity = _clamp_queue_capacity(capacity);
+    return queue;
+}
+
+const char *olm_group_verify_queue_last_error(
+    const OlmGroupVerifyQueue *queue
+) {
+    return _olm_error_to_string(queue->last_error);
+}
+
+size_t olm_group_verify_queue_length(
+    const OlmGroupVerifyQueue *queue
+) {
+    return queue->length;
+}
+
+size_t olm_clear_group_verify_queue(
+    OlmGroupVerifyQueue *queue
+) {
+    size_t capacity = queue->capacity;
+    size_t size = olm_group_verify_queue_size(capacity);
+    _olm_unset(queue, size);
+    queue->capacity = capacity;
+    return size;
+}
+
+size_t olm_group_decrypt_deferred(
+    const OlmInboundGroupSession *session,
+    OlmGroupDecryptScratch *scratch,
+    OlmGroupVerifyQueue *queue,
+    uint8_t * message, size_t message_length,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index,
+    size_t * queue_position
+) {
+    struct _OlmDecodeGroupMessageResults decoded_results;
+    uint8_t message_hash[SHA256_OUTPUT_LENGTH];
+    uint8_t digest[ED25519_DIGEST_LENGTH];
+    int verified;
+    size_t r;
+
+    message_length = _olm_decode_base64(message, message_length, message);
+    if (message_length == (size_t)-1) {
+        scratch->last_error = OLM_INVALID_BASE64;
         return (size_t)-1;
     }
 
-    r = _get_megolm(session, decoded_results.message_index, &megolm);
-    if (r == (size_t)-1) {
-        return r;
+    _olm_decode_group_message(
+        message, message_length,
+        megolm_cipher->ops->mac_length(megolm_cipher),
+        ED25519_SIGNATURE_LENGTH,
+        &decoded_results);
+
+    if (_check_decoded_message(&decoded_results, &scratch->last_error)
+            == (size_t)-1) {
+        return (size_t)-1;
     }
 
-    /* now try checking the mac, and decrypting */
-    r = megolm_cipher->ops->decrypt(
-        megolm_cipher,
-        megolm_get_data(&megolm), MEGOLM_RATCHET_LENGTH,
-        message, message_length,
-        decoded_results.ciphertext, decoded_results.ciphertext_length,
-        plaintext, max_plaintext_length
-    );
+    if (message_index != NULL) {
+        *message_index = decoded_results.message_index;
+    }
 
-    _olm_unset(&megolm, sizeof(megolm));
+    if (session->cached_key_capacity) {
+        _olm_crypto_sha256(message, message_length, message_hash);
+    }
+
+    message_length -= ED25519_SIGNATURE_LENGTH;
+    verified = _already_verified(session, &decoded_results, message_hash);
+    if (!verified) {
+        if (queue->length == queue->capacity) {
+            scratch->last_error = OLM_VERIFY_QUEUE_FULL;
+            return (size_t)-1;
+        }
+        _olm_crypto_ed25519_digest(
+            &session->signing_key, message, message_length,
+            message + message_length, digest
+        );
+    }
+
+    /* the signature has not been checked yet, so decrypt as
+     * olm_group_decrypt_read_only does rather than move the session on.
+     * _decrypt_decoded only reads the session when it has scratch space */
+    r = _decrypt_decoded(
+        (OlmInboundGroupSession *)session, scratch,
+        message, message_length, &decoded_results,
+        verified, message_hash, plaintext, max_plaintext_length, NULL
+    );
     if (r == (size_t)-1) {
-        session->last_error = OLM_BAD_MESSAGE_MAC;
         return r;
     }
 
-    /* once we have successfully decrypted a message, set a flag to say the
-     * session appears valid. */
-    session->signing_key_verified = 1;
-
+    if (verified) {
+        *queue_position = (size_t)-1;
+    } else {
+        struct _OlmQueuedSignature *entry =
+            &_queued_signatures(queue)[queue->length];
+        entry->scratch = scratch;
+        scratch->unverified++;
+        entry->signing_key = session->signing_key;
+        memcpy(entry->digest, digest, ED25519_DIGEST_LENGTH);
+        memcpy(
+            entry->signature, message + message_length,
+            ED25519_SIGNATURE_LENGTH
+        );
+        *queue_position = queue->length++;
+    }
     return r;
 }
 
-size_t olm_group_decrypt(
-    OlmInboundGroupSession *session,
+/* the number of signatures olm_group_verify_flush checks at a time */
+#define VERIFY_BATCH 64
+
+size_t olm_group_verify_flush(
+    OlmGroupVerifyQueue *queue,
+    int * results, size_t results_length
+) {
+    const struct _olm_ed25519_public_key *keys[VERIFY_BATCH];
+    const uint8_t *digests[VERIFY_BATCH];
+    const uint8_t *signatures[VERIFY_BATCH];
+    struct _OlmQueuedSignature *entries = _queued_signatures(queue);
+    size_t failures = 0;
+    size_t base, n, i;
+
+    if (results_length < queue->length) {
+        queue->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+
+    for (base = 0; base < queue->length; base += n) {
+        n = queue->length - base < VERIFY_BATCH
+            ? queue->length - base : VERIFY_BATCH;
+        for (i = 0; i < n; i++) {
+            keys[i] = &entries[base + i].signing_key;
+            digests[i] = entries[base + i].digest;
+            signatures[i] = entries[base + i].signature;
+        }
+        _olm_crypto_ed25519_verify_digest_batch(
+            n, keys, digests, signatures, results + base
+        );
+        for (i = 0; i < n; i++) {
+            OlmGroupDecryptScratch *scratch = entries[base + i].scratch;
+            if (results[base + i]) {
+                scratch->unverified--;
+            } else {
+                scratch->bad_signature = 1;
+                failures++;
+            }
+        }
+    }
+
+    _olm_unset(entries, queue->length * sizeof(struct _OlmQueuedSignature));
+    queue->length = 0;
+    return failures;
+}
+
+size_t olm_group_decrypt_scratch_size(void) {
+    return sizeof(OlmGroupDecryptScratch);
+}
+
+OlmGroupDecryptScratch * olm_group_decrypt_scratch(
+    void *memory
+) {
+    OlmGroupDecryptScratch *scratch = memory;
+    olm_clear_group_decrypt_scratch(scratch);
+    return scratch;
+}
+
+const char *olm_group_decrypt_scratch_last_error(
+    const OlmGroupDecryptScratch *scratch
+) {
+    return _olm_error_to_string(scratch->last_error);
+}
+
+size_t olm_clear_group_decrypt_scratch(
+    OlmGroupDecryptScratch *scratch
+) {
+    _olm_unset(scratch, sizeof(OlmGroupDecryptScratch));
+    return sizeof(OlmGroupDecryptScratch);
+}
+
+size_t olm_group_decrypt_read_only(
+    const OlmInboundGroupSession *session,
+    OlmGroupDecryptScratch *scratch,
     uint8_t * message, size_t message_length,
     uint8_t * plaintext, size_t max_plaintext_length,
     uint32_t * message_index
@@ -433,17 +1349,189 @@ size_t olm_group_decrypt(
 
     raw_message_length = _olm_decode_base64(message, message_length, message);
     if (raw_message_length == (size_t)-1) {
-        session->last_error = OLM_INVALID_BASE64;
+        scratch->last_error = OLM_INVALID_BASE64;
         return (size_t)-1;
     }
 
+    /* _decrypt only reads the session when it has scratch space */
     return _decrypt(
-        session, message, raw_message_length,
+        (OlmInboundGroupSession *)session, scratch,
+        message, raw_message_length,
         plaintext, max_plaintext_length,
         message_index
     );
 }
 
+size_t olm_inbound_group_session_commit_ratchet(
+    OlmInboundGroupSession *session,
+    const OlmGroupDecryptScratch *scratch
+) {
+    /* a message decrypted by olm_group_decrypt_deferred may have come from
+     * anyone with the session key until its signature has been checked */
+    if (scratch->unverified || scratch->bad_signature) {
+        session->last_error = OLM_BAD_SIGNATURE;
+        return (size_t)-1;
+    }
+    if (!scratch->has_ratchet) {
+        return 0;
+    }
+    if (!_scratch_matches(session, scratch)) {
+        session->last_error = OLM_BAD_SESSION_KEY;
+        return (size_t)-1;
+    }
+    if ((scratch->ratchet.counter - session->latest_ratchet.counter)
+            < (1U << 31)) {
+        session->latest_ratchet = scratch->ratchet;
+    }
+
+    /* the scratch space only holds a ratchet value after a message has been
+     * decrypted with it, and its signature checked */
+    session->signing_key_verified = 1;
+    return 0;
+}
+
+/* the number of messages olm_group_decrypt_batch works on at a time */
+#define DECRYPT_BATCH 64
+
+size_t olm_group_decrypt_batch(
+    OlmInboundGroupSession *session,
+    size_t count,
+    uint8_t * const * messages, size_t const * message_lengths,
+    uint8_t * const * plaintexts, size_t const * max_plaintext_lengths,
+    size_t * results,
+    uint32_t * message_indexes,
+    const char ** errors
+) {
+    struct _OlmDecodeGroupMessageResults decoded[DECRYPT_BATCH];
+    size_t lengths[DECRYPT_BATCH];
+    uint8_t hashes[DECRYPT_BATCH][SHA256_OUTPUT_LENGTH];
+    enum OlmErrorCode codes[DECRYPT_BATCH];
+    size_t order[DECRYPT_BATCH];
+
+    /* the signatures left to check */
+    const struct _olm_ed25519_public_key *keys[DECRYPT_BATCH];
+    const uint8_t *signed_messages[DECRYPT_BATCH];
+    size_t signed_lengths[DECRYPT_BATCH];
+    const uint8_t *signatures[DECRYPT_BATCH];
+    int valid[DECRYPT_BATCH];
+    size_t to_verify[DECRYPT_BATCH];
+
+    Megolm working;
+    size_t decrypted = 0;
+    size_t base, n, i, j, pending, verify_count;
+    enum OlmErrorCode last_error = OLM_SUCCESS;
+
+    for (base = 0; base < count; base += n) {
+        n = count - base < DECRYPT_BATCH ? count - base : DECRYPT_BATCH;
+        pending = 0;
+        verify_count = 0;
+
+        /* decode every message, and collect the signatures to check */
+        for (i = 0; i < n; i++) {
+            uint8_t *message = messages[base + i];
+
+            codes[i] = OLM_SUCCESS;
+            lengths[i] = _olm_decode_base64(
+                message, message_lengths[base + i], message
+            );
+            if (lengths[i] == (size_t)-1) {
+                codes[i] = OLM_INVALID_BASE64;
+                continue;
+            }
+            _olm_decode_group_message(
+                message, lengths[i],
+                megolm_cipher->ops->mac_length(megolm_cipher),
+                ED25519_SIGNATURE_LENGTH,
+                &decoded[i]
+            );
+            if (_check_decoded_message(&decoded[i], &codes[i])
+                    == (size_t)-1) {
+                continue;
+            }
+            if (message_indexes != NULL) {
+                message_indexes[base + i] = decoded[i].message_index;
+            }
+            if (session->cached_key_capacity) {
+                _olm_crypto_sha256(message, lengths[i], hashes[i]);
+            }
+
+            lengths[i] -= ED25519_SIGNATURE_LENGTH;
+            if (!_already_verified(session, &decoded[i], hashes[i])) {
+                keys[verify_count] = &session->signing_key;
+                signed_messages[verify_count] = message;
+                signed_lengths[verify_count] = lengths[i];
+                signatures[verify_count] = message + lengths[i];
+                to_verify[verify_count++] = i;
+            }
+        }
+
+        if (verify_count) {
+            _olm_crypto_ed25519_verify_batch(
+                verify_count, keys, signed_messages, signed_lengths,
+                signatures, valid
+            );
+            for (j = 0; j < verify_count; j++) {
+                if (!valid[j]) {
+                    codes[to_verify[j]] = OLM_BAD_SIGNATURE;
+                }
+            }
+        }
+
+        /* sort what is left by index, from the initial ratchet on, so that
+         * the messages before the latest ratchet value share one walk */
+        for (i = 0; i < n; i++) {
+            uint32_t offset;
+            if (codes[i] != OLM_SUCCESS) {
+                continue;
+            }
+            offset = decoded[i].message_index
+                - session->initial_ratchet.counter;
+            for (j = pending; j > 0; j--) {
+                if (decoded[order[j - 1]].message_index
+                        - session->initial_ratchet.counter <= offset) {
+                    break;
+                }
+                order[j] = order[j - 1];
+            }
+            order[j] = i;
+            pending++;
+        }
+
+        working = session->initial_ratchet;
+        for (j = 0; j < pending; j++) {
+            i = order[j];
+            results[base + i] = _decrypt_decoded(
+                session, NULL, messages[base + i], lengths[i], &decoded[i],
+                1, hashes[i], plaintexts[base + i],
+                max_plaintext_lengths[base + i], &working
+            );
+            if (results[base + i] == (size_t)-1) {
+                codes[i] = session->last_error;
+            } else {
+                decrypted++;
+            }
+        }
+        _olm_unset(&working, sizeof(working));
+
+        for (i = 0; i < n; i++) {
+            if (codes[i] != OLM_SUCCESS) {
+                results[base + i] = (size_t)-1;
+                last_error = codes[i];
+            }
+            if (errors != NULL) {
+                errors[base + i] = codes[i] == OLM_SUCCESS
+                    ? NULL : _olm_error_to_string(codes[i]);
+            }
+        }
+    }
+    _olm_unset(hashes, sizeof(hashes));
+
+    if (last_error != OLM_SUCCESS) {
+        session->last_error = last_error;
+    }
+    return decrypted;
+}
+
 size_t olm_inbound_group_session_id_length(
     const OlmInboundGroupSession *session
 ) {
@@ -497,7 +1585,7 @@ size_t olm_export_inbound_group_session(
         return (size_t)-1;
     }
 
-    r = _get_megolm(session, message_index, &megolm);
+    r = _get_megolm(session, message_index, &megolm, NULL);
     if (r == (size_t)-1) {
         return r;
     }
@@ -0,0 +1,176 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/key_store.hh"
+#include "olm/memory.hh"
+
+namespace {
+
+/* Public keys are uniformly distributed, so their first bytes make a good
+ * enough hash. */
+std::uint32_t hash(_olm_curve25519_public_key const & public_key) {
+    std::uint8_t const * bytes = public_key.public_key;
+    return std::uint32_t(bytes[0])
+        | std::uint32_t(bytes[1]) << 8
+        | std::uint32_t(bytes[2]) << 16
+        | std::uint32_t(bytes[3]) << 24;
+}
+
+} // namespace
+
+std::uint32_t const olm::SlotIndex::NONE;
+std::size_t const olm::OneTimeKeyStore::MAX_CAPACITY;
+std::uint32_t const olm::OneTimeKeyStore::NONE;
+
+
+std::uint32_t olm::OneTimeKeyStore::Home::operator()(
+    std::uint32_t slot
+) const {
+    return hash(store->_keys[slot].key.public_key);
+}
+
+
+void olm::OneTimeKeyStore::init(
+    void * storage, std::size_t capacity
+) {
+    std::uint8_t * pos = static_cast<std::uint8_t *>(storage);
+    _keys = reinterpret_cast<OneTimeKey *>(pos);
+    pos += capacity * sizeof(OneTimeKey);
+    _links = reinterpret_cast<std::uint32_t *>(pos);
+    pos += capacity * 2 * sizeof(std::uint32_t);
+    _index.init(
+        reinterpret_cast<std::uint32_t *>(pos), slot_index_size(capacity)
+    );
+    pos += slot_index_size(capacity) * sizeof(std::uint32_t);
+    _published = reinterpret_cast<std::uint32_t *>(pos);
+    _capacity = capacity;
+    clear();
+}
+
+
+void olm::OneTimeKeyStore::clear() {
+    olm::unset(_keys, storage_size(_capacity));
+    for (std::uint32_t slot = 0; slot != _capacity; ++slot) {
+        _links[2 * slot + 1] = slot + 1 == _capacity ? NONE : slot + 1;
+    }
+    _size = 0;
+    _newest = NONE;
+    _oldest = NONE;
+    _free = _capacity ? 0 : NONE;
+}
+
+
+void olm::OneTimeKeyStore::unlink(std::uint32_t slot) {
+    std::uint32_t older = _links[2 * slot];
+    std::uint32_t newer = _links[2 * slot + 1];
+    if (older == NONE) {
+        _oldest = newer;
+    } else {
+        _links[2 * older + 1] = newer;
+    }
+    if (newer == NONE) {
+        _newest = older;
+    } else {
+        _links[2 * newer] = older;
+    }
+    olm::unset(_keys[slot]);
+    _published[slot / 32] &= ~(std::uint32_t(1) << (slot % 32));
+    _links[2 * slot + 1] = _free;
+    _free = slot;
+    --_size;
+}
+
+
+olm::OneTimeKey * olm::OneTimeKeyStore::push_newest() {
+    if (_free == NONE) {
+        _index.remove(_oldest, Home{this});
+        unlink(_oldest);
+    }
+    std::uint32_t slot = _free;
+    _free = _links[2 * slot + 1];
+    _links[2 * slot] = _newest;
+    _links[2 * slot + 1] = NONE;
+    if (_newest == NONE) {
+        _oldest = slot;
+    } else {
+        _links[2 * _newest + 1] = slot;
+    }
+    _newest = slot;
+    ++_size;
+    return &_keys[slot];
+}
+
+
+olm::OneTimeKey * olm::OneTimeKeyStore::push_oldest() {
+    if (_free == NONE) {
+        return 0;
+    }
+    std::uint32_t slot = _free;
+    _free = _links[2 * slot + 1];
+    _links[2 * slot] = NONE;
+    _links[2 * slot + 1] = _oldest;
+    if (_oldest == NONE) {
+        _newest = slot;
+    } else {
+        _links[2 * _oldest] = slot;
+    }
+    _oldest = slot;
+    ++_size;
+    return &_keys[slot];
+}
+
+
+void olm::OneTimeKeyStore::add_to_index(OneTimeKey const * key) {
+    _index.insert(slot_of(key), Home{this});
+}
+
+
+olm::OneTimeKey const * olm::OneTimeKeyStore::find(
+    _olm_curve25519_public_key const & public_key
+) const {
+    std::uint32_t slot = _index.find(
+        hash(public_key), [&](std::uint32_t slot) {
+            return olm::array_equal(
+                _keys[slot].key.public_key.public_key, public_key.public_key
+            );
+        }
+    );
+    return slot == SlotIndex::NONE ? 0 : &_keys[slot];
+}
+
+
+void olm::OneTimeKeyStore::erase(OneTimeKey const * key) {
+    std::uint32_t slot = slot_of(key);
+    _index.remove(slot, Home{this});
+    unlink(slot);
+}
+
+
+bool olm::OneTimeKeyStore::is_published(OneTimeKey const * key) const {
+    std::uint32_t slot = slot_of(key);
+    return (_published[slot / 32] >> (slot % 32)) & 1;
+}
+
+
+void olm::OneTimeKeyStore::set_published(
+    OneTimeKey const * key, bool published
+) {
+    std::uint32_t slot = slot_of(key);
+    std::uint32_t bit = std::uint32_t(1) << (slot % 32);
+    if (published) {
+        _published[slot / 32] |= bit;
+    } else {
+        _published[slot / 32] &= ~bit;
+    }
+}
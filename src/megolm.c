@@ -20,6 +20,7 @@
 
 #include "olm/cipher.h"
 #include "olm/crypto.h"
+#include "olm/memory.h"
 #include "olm/pickle.h"
 
 static const struct _olm_cipher_aes_sha_256 MEGOLM_CIPHER =
@@ -48,6 +49,28 @@ static void rehash_part(
     );
 }
 
+/* update R(rehash_from_part)...R(3) based on R(rehash_from_part). The HMAC
+ * key is the same for each of them, so it is only prepared once.
+ */
+static void rehash_parts_from(
+    uint8_t data[MEGOLM_RATCHET_PARTS][MEGOLM_RATCHET_PART_LENGTH],
+    int rehash_from_part
+) {
+    struct _olm_hmac_sha256_key key;
+    int i;
+
+    _olm_crypto_hmac_sha256_prepare(
+        data[rehash_from_part], MEGOLM_RATCHET_PART_LENGTH, &key
+    );
+    /* R(rehash_from_part) is the key, so it has to be updated last */
+    for (i = MEGOLM_RATCHET_PARTS-1; i >= rehash_from_part; i--) {
+        _olm_crypto_hmac_sha256_prepared(
+            &key, HASH_KEY_SEEDS[i], HASH_KEY_SEED_LENGTH, data[i]
+        );
+    }
+    _olm_unset(&key, sizeof(key));
+}
+
 
 
 void megolm_init(Megolm *megolm, uint8_t const *random_data, uint32_t counter) {
@@ -81,7 +104,6 @@ const uint8_t * megolm_unpickle(Megolm *megolm, const uint8_t *pos,
 void megolm_advance(Megolm *megolm) {
     uint32_t mask = 0x00FFFFFF;
     int h = 0;
-    int i;
 
     megolm->counter++;
 
@@ -94,9 +116,7 @@ void megolm_advance(Megolm *megolm) {
     }
 
     /* now update R(h)...R(3) based on R(h) */
-    for (i = MEGOLM_RATCHET_PARTS-1; i >= h; i--) {
-        rehash_part(megolm->data, h, i);
-    }
+    rehash_parts_from(megolm->data, h);
 }
 
 void megolm_advance_to(Megolm *megolm, uint32_t advance_to) {
@@ -106,7 +126,6 @@ void megolm_advance_to(Megolm *megolm, uint32_t advance_to) {
     for (j = 0; j < (int)MEGOLM_RATCHET_PARTS; j++) {
         int shift = (MEGOLM_RATCHET_PARTS-j-1) * 8;
         uint32_t mask = (~(uint32_t)0) << shift;
-        int k;
 
         /* how many times do we need to rehash this part?
          *
@@ -142,9 +161,37 @@ void megolm_advance_to(Megolm *megolm, uint32_t advance_to) {
          * R(j+1) again, but the code to figure that out is a bit baroque and
          * doesn't save us much).
          */
-        for (k = 3; k >= j; k--) {
-            rehash_part(megolm->data, j, k);
-        }
+        rehash_parts_from(megolm->data, j);
         megolm->counter = advance_to & mask;
     }
 }
+
+uint32_t megolm_advance_cost(const Megolm *megolm, uint32_t advance_to) {
+    return megolm_advance_cost_from(megolm->counter, advance_to);
+}
+
+uint32_t megolm_advance_cost_from(uint32_t counter, uint32_t advance_to) {
+    uint32_t cost = 0;
+    int j;
+
+    /* the same walk as megolm_advance_to, counting the hashes instead */
+    for (j = 0; j < (int)MEGOLM_RATCHET_PARTS; j++) {
+        int shift = (MEGOLM_RATCHET_PARTS-j-1) * 8;
+        uint32_t mask = (~(uint32_t)0) << shift;
+        unsigned int steps =
+            ((advance_to >> shift) - (counter >> shift)) & 0xff;
+
+        if (steps == 0) {
+            if (advance_to < counter) {
+                steps = 0x100;
+            } else {
+                continue;
+            }
+        }
+
+        /* steps - 1 rehashes of R(j), then R(j)...R(3) are rehashed */
+        cost += steps - 1 + (MEGOLM_RATCHET_PARTS - j);
+        counter = advance_to & mask;
+    }
+    return cost;
+}
@@ -21,6 +21,16 @@ void _olm_unset(
     olm::unset(buffer, buffer_length);
 }
 
+int _olm_is_equal(
+    void const * buffer_a, void const * buffer_b, size_t length
+) {
+    return olm::is_equal(
+        reinterpret_cast<std::uint8_t const *>(buffer_a),
+        reinterpret_cast<std::uint8_t const *>(buffer_b),
+        length
+    );
+}
+
 void olm::unset(
     void volatile * buffer, std::size_t buffer_length
 ) {
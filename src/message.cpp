@@ -141,6 +141,26 @@ static std::uint8_t const * decode(
     return pos;
 }
 
+/* As decode() for a string, but a string cut short by the end of the input
+ * is read up to the end rather than skipped */
+static std::uint8_t const * decode_truncated(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    std::uint8_t tag,
+    std::uint8_t const * & value, std::size_t & value_length
+) {
+    if (pos != end && *pos == tag) {
+        ++pos;
+        std::uint8_t const * len_start = pos;
+        pos = varint_skip(pos, end);
+        std::size_t len = varint_decode<std::size_t>(len_start, pos);
+        if (len > std::size_t(end - pos)) len = end - pos;
+        value = pos;
+        value_length = len;
+        pos += len;
+    }
+    return pos;
+}
+
 static std::uint8_t const * skip_unknown(
     std::uint8_t const * pos, std::uint8_t const * end
 ) {
@@ -283,9 +303,10 @@ void olm::encode_one_time_key_message(
 }
 
 
-void olm::decode_one_time_key_message(
-    PreKeyMessageReader & reader,
-    std::uint8_t const * input, std::size_t input_length
+static void decode_one_time_key_message(
+    olm::PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length,
+    bool header_only
 ) {
     std::uint8_t const * pos = input;
     std::uint8_t const * end = input + input_length;
@@ -317,10 +338,17 @@ void olm::decode_one_time_key_message(
             pos, end, IDENTITY_KEY_TAG,
             reader.identity_key, reader.identity_key_length
         );
-        pos = decode(
-            pos, end, MESSAGE_TAG,
-            reader.message, reader.message_length
-        );
+        if (header_only) {
+            pos = decode_truncated(
+                pos, end, MESSAGE_TAG,
+                reader.message, reader.message_length
+            );
+        } else {
+            pos = decode(
+                pos, end, MESSAGE_TAG,
+                reader.message, reader.message_length
+            );
+        }
         if (unknown == pos) {
             pos = skip_unknown(pos, end);
         }
@@ -328,6 +356,22 @@ void olm::decode_one_time_key_message(
 }
 
 
+void olm::decode_one_time_key_message(
+    PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length
+) {
+    ::decode_one_time_key_message(reader, input, input_length, false);
+}
+
+
+void olm::decode_one_time_key_message_header(
+    PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length
+) {
+    ::decode_one_time_key_message(reader, input, input_length, true);
+}
+
+
 
 static const std::uint8_t GROUP_MESSAGE_INDEX_TAG = 010;
 static const std::uint8_t GROUP_CIPHERTEXT_TAG = 022;
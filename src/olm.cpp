@@ -21,6 +21,7 @@
 #include "olm/base64.hh"
 #include "olm/memory.hh"
 
+#include <algorithm>
 #include <new>
 #include <cstring>
 
@@ -50,6 +51,20 @@ static olm::Utility * from_c(OlmUtility * utility) {
     return reinterpret_cast<olm::Utility *>(utility);
 }
 
+static OlmEd25519PreparedKey * to_c(_olm_ed25519_prepared_public_key * key) {
+    return reinterpret_cast<OlmEd25519PreparedKey *>(key);
+}
+
+static _olm_ed25519_prepared_public_key * from_c(OlmEd25519PreparedKey * key) {
+    return reinterpret_cast<_olm_ed25519_prepared_public_key *>(key);
+}
+
+static _olm_ed25519_prepared_public_key const * from_c(
+    OlmEd25519PreparedKey const * key
+) {
+    return reinterpret_cast<_olm_ed25519_prepared_public_key const *>(key);
+}
+
 static std::uint8_t * from_c(void * bytes) {
     return reinterpret_cast<std::uint8_t *>(bytes);
 }
@@ -93,6 +108,175 @@ std::size_t b64_input(
     return raw_length;
 }
 
+/* Writes the pickle of an object where _olm_enc_output expects it, or
+ * _olm_enc_binary_output if binary is set, or _olm_enc_output_with_key if
+ * pickle_key is set. Returns its length, or std::size_t(-1) if the output
+ * buffer is too small. */
+template<typename T>
+std::size_t pickle_raw(
+    T & object,
+    void * pickled, std::size_t pickled_length,
+    bool binary = false,
+    OlmPickleKey const * pickle_key = nullptr
+) {
+    std::size_t raw_length = pickle_length(object);
+    std::size_t output_length = binary
+        ? _olm_enc_binary_output_length(raw_length)
+        : pickle_key
+        ? _olm_enc_output_length_with_key(pickle_key, raw_length)
+        : _olm_enc_output_length(raw_length);
+    if (pickled_length < output_length) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return std::size_t(-1);
+    }
+    pickle(
+        binary ? from_c(pickled)
+        : pickle_key
+        ? _olm_enc_output_pos_with_key(pickle_key, from_c(pickled), raw_length)
+        : _olm_enc_output_pos(from_c(pickled), raw_length),
+        object
+    );
+    reset_journal(object);
+    return raw_length;
+}
+
+/* Loads an object from the raw_length bytes at pos that _olm_enc_input
+ * decrypted, passing on its failure if raw_length is std::size_t(-1). */
+template<typename T>
+std::size_t unpickle_raw(
+    T & object,
+    std::uint8_t * pos, std::size_t raw_length,
+    std::size_t pickled_length
+) {
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+    std::uint8_t * const end = pos + raw_length;
+    /* On success unpickle will return (pos + raw_length). If unpickling
+     * terminates too soon then it will return a pointer before
+     * (pos + raw_length). On error unpickle will return (pos + raw_length + 1).
+     */
+    if (end != unpickle(pos, end + 1, object)) {
+        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
+            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
+        }
+        return std::size_t(-1);
+    }
+    reset_journal(object);
+    return pickled_length;
+}
+
+/* Writes the delta pickle of an object where _olm_enc_output expects it.
+ * Returns its length, or std::size_t(-1) if the output buffer is too small. */
+template<typename T>
+std::size_t pickle_delta_raw(
+    T & object,
+    void * pickled, std::size_t pickled_length
+) {
+    std::size_t raw_length = pickle_delta_length(object);
+    if (pickled_length < _olm_enc_output_length(raw_length)) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return std::size_t(-1);
+    }
+    pickle_delta(_olm_enc_output_pos(from_c(pickled), raw_length), object);
+    return raw_length;
+}
+
+/* As unpickle_raw, for a delta pickle */
+template<typename T>
+std::size_t unpickle_delta_raw(
+    T & object,
+    std::uint8_t * pos, std::size_t raw_length,
+    std::size_t pickled_length
+) {
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+    std::uint8_t * const end = pos + raw_length;
+    if (end != unpickle_delta(pos, end + 1, object)) {
+        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
+            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
+        }
+        return std::size_t(-1);
+    }
+    return pickled_length;
+}
+
+/* Loads an object from a full pickle and the delta pickles that follow it */
+template<typename T>
+std::size_t unpickle_journal(
+    T & object,
+    std::uint8_t const * key, std::size_t key_length,
+    void * pickled, std::size_t pickled_length,
+    void * const * deltas, std::size_t const * delta_lengths,
+    std::size_t delta_count
+) {
+    std::size_t raw_length = _olm_enc_input(
+        key, key_length, from_c(pickled), pickled_length, &object.last_error
+    );
+    if (std::size_t(-1) == unpickle_raw(
+            object, from_c(pickled), raw_length, pickled_length
+    )) {
+        return std::size_t(-1);
+    }
+    for (std::size_t i = 0; i < delta_count; ++i) {
+        std::uint8_t * delta = from_c(deltas[i]);
+        raw_length = _olm_enc_input(
+            key, key_length, delta, delta_lengths[i], &object.last_error
+        );
+        if (std::size_t(-1) == unpickle_delta_raw(
+                object, delta, raw_length, delta_lengths[i]
+        )) {
+            return std::size_t(-1);
+        }
+    }
+    return pickled_length;
+}
+
+/* Enough decoded bytes for the headers of any message: a pre-key message's
+ * keys and the ratchet key and counter of the message inside it */
+static const std::size_t MESSAGE_HEADER_LENGTH = 192;
+
+/* Accounts with room for more than the default number of one time keys keep
+ * them in storage straight after the account object */
+std::size_t clamp_account_capacity(
+    std::size_t capacity
+) {
+    return std::min(
+        std::max(capacity, olm::MAX_ONE_TIME_KEYS),
+        olm::OneTimeKeyStore::MAX_CAPACITY
+    );
+}
+
+std::size_t account_size(
+    std::size_t capacity
+) {
+    std::size_t size = sizeof(olm::Account);
+    if (capacity > olm::MAX_ONE_TIME_KEYS) {
+        size += olm::OneTimeKeyStore::storage_size(capacity);
+    }
+    return size;
+}
+
+std::size_t clamp_session_capacity(
+    std::size_t capacity
+) {
+    return std::min(
+        std::max(capacity, olm::MAX_SKIPPED_MESSAGE_KEYS),
+        olm::SkippedMessageKeyStore::MAX_CAPACITY
+    );
+}
+
+std::size_t session_size(
+    std::size_t capacity
+) {
+    std::size_t size = sizeof(olm::Session);
+    if (capacity > olm::MAX_SKIPPED_MESSAGE_KEYS) {
+        size += olm::SkippedMessageKeyStore::storage_size(capacity);
+    }
+    return size;
+}
+
 } // namespace
 
 
@@ -136,10 +320,25 @@ size_t olm_account_size(void) {
 }
 
 
+size_t olm_account_size_with_capacity(
+    size_t capacity
+) {
+    return account_size(clamp_account_capacity(capacity));
+}
+
+
 size_t olm_session_size(void) {
     return sizeof(olm::Session);
 }
 
+
+size_t olm_session_size_with_capacity(
+    size_t capacity
+) {
+    return session_size(clamp_session_capacity(capacity));
+}
+
+
 size_t olm_utility_size(void) {
     return sizeof(olm::Utility);
 }
@@ -152,6 +351,18 @@ OlmAccount * olm_account(
 }
 
 
+OlmAccount * olm_account_with_capacity(
+    void * memory,
+    size_t capacity
+) {
+    capacity = clamp_account_capacity(capacity);
+    olm::unset(memory, account_size(capacity));
+    return to_c(new(memory) olm::Account(
+        from_c(memory) + sizeof(olm::Account), capacity
+    ));
+}
+
+
 OlmSession * olm_session(
     void * memory
 ) {
@@ -160,6 +371,18 @@ OlmSession * olm_session(
 }
 
 
+OlmSession * olm_session_with_capacity(
+    void * memory,
+    size_t capacity
+) {
+    capacity = clamp_session_capacity(capacity);
+    olm::unset(memory, session_size(capacity));
+    return to_c(new(memory) olm::Session(
+        from_c(memory) + sizeof(olm::Session), capacity
+    ));
+}
+
+
 OlmUtility * olm_utility(
     void * memory
 ) {
@@ -171,22 +394,31 @@ OlmUtility * olm_utility(
 size_t olm_clear_account(
     OlmAccount * account
 ) {
+    std::size_t capacity = from_c(account)->max_number_of_one_time_keys();
+    std::size_t size = account_size(capacity);
     /* Clear the memory backing the account  */
-    olm::unset(account, sizeof(olm::Account));
+    olm::unset(account, size);
     /* Initialise a fresh account object in case someone tries to use it */
-    new(account) olm::Account();
-    return sizeof(olm::Account);
+    new(account) olm::Account(
+        from_c(static_cast<void *>(account)) + sizeof(olm::Account), capacity
+    );
+    return size;
 }
 
 
 size_t olm_clear_session(
     OlmSession * session
 ) {
+    std::size_t capacity =
+        from_c(session)->ratchet.skipped_message_keys.capacity();
+    std::size_t size = session_size(capacity);
     /* Clear the memory backing the session */
-    olm::unset(session, sizeof(olm::Session));
+    olm::unset(session, size);
     /* Initialise a fresh session object in case someone tries to use it */
-    new(session) olm::Session();
-    return sizeof(olm::Session);
+    new(session) olm::Session(
+        from_c(static_cast<void *>(session)) + sizeof(olm::Session), capacity
+    );
+    return size;
 }
 
 
@@ -208,6 +440,16 @@ size_t olm_pickle_account_length(
 }
 
 
+size_t olm_pickle_account_with_key_length(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key
+) {
+    return _olm_enc_output_length_with_key(
+        pickle_key, pickle_length(*from_c(account))
+    );
+}
+
+
 size_t olm_pickle_session_length(
     OlmSession * session
 ) {
@@ -215,92 +457,297 @@ size_t olm_pickle_session_length(
 }
 
 
+size_t olm_pickle_session_with_key_length(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key
+) {
+    return _olm_enc_output_length_with_key(
+        pickle_key, pickle_length(*from_c(session))
+    );
+}
+
+
 size_t olm_pickle_account(
     OlmAccount * account,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
 ) {
-    olm::Account & object = *from_c(account);
-    std::size_t raw_length = pickle_length(object);
-    if (pickled_length < _olm_enc_output_length(raw_length)) {
-        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
-        return size_t(-1);
+    std::size_t raw_length = pickle_raw(*from_c(account), pickled, pickled_length);
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
     }
-    pickle(_olm_enc_output_pos(from_c(pickled), raw_length), object);
     return _olm_enc_output(from_c(key), key_length, from_c(pickled), raw_length);
 }
 
 
+size_t olm_pickle_account_with_key(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_raw(
+        *from_c(account), pickled, pickled_length, false, pickle_key
+    );
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+    return _olm_enc_output_with_key(pickle_key, from_c(pickled), raw_length);
+}
+
+
 size_t olm_pickle_session(
     OlmSession * session,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
 ) {
-    olm::Session & object = *from_c(session);
-    std::size_t raw_length = pickle_length(object);
-    if (pickled_length < _olm_enc_output_length(raw_length)) {
-        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
-        return size_t(-1);
+    std::size_t raw_length = pickle_raw(*from_c(session), pickled, pickled_length);
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
     }
-    pickle(_olm_enc_output_pos(from_c(pickled), raw_length), object);
     return _olm_enc_output(from_c(key), key_length, from_c(pickled), raw_length);
 }
 
 
+size_t olm_pickle_session_with_key(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_raw(
+        *from_c(session), pickled, pickled_length, false, pickle_key
+    );
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+    return _olm_enc_output_with_key(pickle_key, from_c(pickled), raw_length);
+}
+
+
 size_t olm_unpickle_account(
     OlmAccount * account,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
 ) {
     olm::Account & object = *from_c(account);
-    std::uint8_t * const pos = from_c(pickled);
     std::size_t raw_length = _olm_enc_input(
-        from_c(key), key_length, pos, pickled_length, &object.last_error
+        from_c(key), key_length, from_c(pickled), pickled_length,
+        &object.last_error
+    );
+    return unpickle_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_unpickle_account_with_key(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    olm::Account & object = *from_c(account);
+    std::size_t raw_length = _olm_enc_input_with_key(
+        pickle_key, from_c(pickled), pickled_length, &object.last_error
+    );
+    return unpickle_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_unpickle_session(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    olm::Session & object = *from_c(session);
+    std::size_t raw_length = _olm_enc_input(
+        from_c(key), key_length, from_c(pickled), pickled_length,
+        &object.last_error
+    );
+    return unpickle_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_unpickle_session_with_key(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    olm::Session & object = *from_c(session);
+    std::size_t raw_length = _olm_enc_input_with_key(
+        pickle_key, from_c(pickled), pickled_length, &object.last_error
+    );
+    return unpickle_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_pickle_account_binary_length(
+    OlmAccount * account
+) {
+    return _olm_enc_binary_output_length(pickle_length(*from_c(account)));
+}
+
+
+size_t olm_pickle_account_binary(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_raw(
+        *from_c(account), pickled, pickled_length, true
     );
     if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
-    std::uint8_t * const end = pos + raw_length;
-    /* On success unpickle will return (pos + raw_length). If unpickling
-     * terminates too soon then it will return a pointer before
-     * (pos + raw_length). On error unpickle will return (pos + raw_length + 1).
-     */
-    if (end != unpickle(pos, end + 1, object)) {
-        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
-            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
-        }
+    return _olm_enc_binary_output(
+        from_c(key), key_length, from_c(pickled), raw_length
+    );
+}
+
+
+size_t olm_unpickle_account_binary(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    olm::Account & object = *from_c(account);
+    std::size_t raw_length = _olm_enc_binary_input(
+        from_c(key), key_length, from_c(pickled), pickled_length,
+        &object.last_error
+    );
+    return unpickle_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_pickle_session_binary_length(
+    OlmSession * session
+) {
+    return _olm_enc_binary_output_length(pickle_length(*from_c(session)));
+}
+
+
+size_t olm_pickle_session_binary(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_raw(
+        *from_c(session), pickled, pickled_length, true
+    );
+    if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
-    return pickled_length;
+    return _olm_enc_binary_output(
+        from_c(key), key_length, from_c(pickled), raw_length
+    );
 }
 
 
-size_t olm_unpickle_session(
+size_t olm_unpickle_session_binary(
     OlmSession * session,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
 ) {
     olm::Session & object = *from_c(session);
-    std::uint8_t * const pos = from_c(pickled);
-    std::size_t raw_length = _olm_enc_input(
-        from_c(key), key_length, pos, pickled_length, &object.last_error
+    std::size_t raw_length = _olm_enc_binary_input(
+        from_c(key), key_length, from_c(pickled), pickled_length,
+        &object.last_error
+    );
+    return unpickle_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_pickle_account_delta_length(
+    OlmAccount * account
+) {
+    return _olm_enc_output_length(pickle_delta_length(*from_c(account)));
+}
+
+
+size_t olm_pickle_account_delta(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_delta_raw(
+        *from_c(account), pickled, pickled_length
     );
     if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
+    return _olm_enc_output(from_c(key), key_length, from_c(pickled), raw_length);
+}
 
-    std::uint8_t * const end = pos + raw_length;
-    /* On success unpickle will return (pos + raw_length). If unpickling
-     * terminates too soon then it will return a pointer before
-     * (pos + raw_length). On error unpickle will return (pos + raw_length + 1).
-     */
-    if (end != unpickle(pos, end + 1, object)) {
-        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
-            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
-        }
+
+size_t olm_unpickle_account_delta(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    olm::Account & object = *from_c(account);
+    std::size_t raw_length = _olm_enc_input(
+        from_c(key), key_length, from_c(pickled), pickled_length,
+        &object.last_error
+    );
+    return unpickle_delta_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_unpickle_account_journal(
+    OlmAccount * account,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length,
+    void * const * deltas, size_t const * delta_lengths, size_t delta_count
+) {
+    return unpickle_journal(
+        *from_c(account), from_c(key), key_length, pickled, pickled_length,
+        deltas, delta_lengths, delta_count
+    );
+}
+
+
+size_t olm_pickle_session_delta_length(
+    OlmSession * session
+) {
+    return _olm_enc_output_length(pickle_delta_length(*from_c(session)));
+}
+
+
+size_t olm_pickle_session_delta(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_delta_raw(
+        *from_c(session), pickled, pickled_length
+    );
+    if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
-    return pickled_length;
+    return _olm_enc_output(from_c(key), key_length, from_c(pickled), raw_length);
+}
+
+
+size_t olm_unpickle_session_delta(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    olm::Session & object = *from_c(session);
+    std::size_t raw_length = _olm_enc_input(
+        from_c(key), key_length, from_c(pickled), pickled_length,
+        &object.last_error
+    );
+    return unpickle_delta_raw(object, from_c(pickled), raw_length, pickled_length);
+}
+
+
+size_t olm_unpickle_session_journal(
+    OlmSession * session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length,
+    void * const * deltas, size_t const * delta_lengths, size_t delta_count
+) {
+    return unpickle_journal(
+        *from_c(session), from_c(key), key_length, pickled, pickled_length,
+        deltas, delta_lengths, delta_count
+    );
 }
 
 
@@ -417,6 +864,22 @@ size_t olm_account_generate_one_time_keys(
 }
 
 
+size_t olm_account_generate_one_time_keys_parallel(
+    OlmAccount * account,
+    size_t number_of_keys,
+    void * random, size_t random_length,
+    unsigned threads
+) {
+    size_t result = from_c(account)->generate_one_time_keys(
+        number_of_keys,
+        from_c(random), random_length,
+        threads
+    );
+    olm::unset(random, random_length);
+    return result;
+}
+
+
 size_t olm_create_outbound_session_random_length(
     OlmSession * session
 ) {
@@ -668,6 +1131,39 @@ size_t olm_decrypt_max_plaintext_length(
 }
 
 
+void olm_session_set_work_budget(
+    OlmSession * session,
+    uint32_t max_hash_steps
+) {
+    from_c(session)->ratchet.work_budget = max_hash_steps;
+}
+
+
+size_t olm_session_can_decrypt_hint(
+    OlmSession * session,
+    size_t message_type,
+    void const * message, size_t message_length
+) {
+    /* Only decode as much of the message as holds the headers, so that the
+     * message is left intact and long messages cost no more */
+    std::size_t b64_length = std::min(
+        message_length, olm::encode_base64_length(MESSAGE_HEADER_LENGTH)
+    );
+    std::size_t raw_length = olm::decode_base64_length(b64_length);
+    if (raw_length == std::size_t(-1)) {
+        from_c(session)->last_error = OlmErrorCode::OLM_INVALID_BASE64;
+        return std::size_t(-1);
+    }
+    std::uint8_t header[MESSAGE_HEADER_LENGTH];
+    olm::decode_base64(from_c(message), b64_length, header);
+    std::size_t hint = std::size_t(from_c(session)->decrypt_hint(
+        olm::MessageType(message_type), header, raw_length
+    ));
+    olm::unset(header);
+    return hint;
+}
+
+
 size_t olm_decrypt(
     OlmSession * session,
     size_t message_type,
@@ -741,4 +1237,124 @@ size_t olm_ed25519_verify(
     );
 }
 
+
+size_t olm_ed25519_prepared_key_size(void) {
+    return sizeof(_olm_ed25519_prepared_public_key);
+}
+
+
+OlmEd25519PreparedKey * olm_ed25519_prepared_key(
+    void * memory
+) {
+    olm::unset(memory, sizeof(_olm_ed25519_prepared_public_key));
+    return to_c(reinterpret_cast<_olm_ed25519_prepared_public_key *>(memory));
+}
+
+
+size_t olm_clear_ed25519_prepared_key(
+    OlmEd25519PreparedKey * key
+) {
+    olm::unset(key, sizeof(_olm_ed25519_prepared_public_key));
+    return sizeof(_olm_ed25519_prepared_public_key);
+}
+
+
+size_t olm_ed25519_prepare_key(
+    OlmUtility * utility,
+    OlmEd25519PreparedKey * prepared_key,
+    void const * key, size_t key_length
+) {
+    if (olm::decode_base64_length(key_length) != CURVE25519_KEY_LENGTH) {
+        from_c(utility)->last_error = OlmErrorCode::OLM_INVALID_BASE64;
+        return std::size_t(-1);
+    }
+    _olm_ed25519_public_key verify_key;
+    olm::decode_base64(from_c(key), key_length, verify_key.public_key);
+    _olm_crypto_ed25519_prepare_public_key(&verify_key, from_c(prepared_key));
+    return std::size_t(0);
+}
+
+
+size_t olm_ed25519_verify_prepared(
+    OlmUtility * utility,
+    OlmEd25519PreparedKey const * prepared_key,
+    void const * message, size_t message_length,
+    void * signature, size_t signature_length
+) {
+    std::size_t raw_signature_length = b64_input(
+        from_c(signature), signature_length, from_c(utility)->last_error
+    );
+    if (raw_signature_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+    return from_c(utility)->ed25519_verify_prepared(
+        *from_c(prepared_key),
+        from_c(message), message_length,
+        from_c(signature), raw_signature_length
+    );
+}
+
+
+size_t olm_ed25519_verify_batch(
+    OlmUtility * utility,
+    size_t count,
+    void const * const * keys, size_t const * key_lengths,
+    void const * const * messages, size_t const * message_lengths,
+    void * const * signatures, size_t const * signature_lengths,
+    int * results
+) {
+    const std::size_t group_size = 64;
+    _olm_ed25519_public_key verify_keys[group_size];
+    _olm_ed25519_public_key const * key_pointers[group_size];
+    std::uint8_t const * message_pointers[group_size];
+    std::uint8_t const * signature_pointers[group_size];
+    std::size_t raw_signature_lengths[group_size];
+
+    bool bad_base64 = false;
+    bool all_valid = true;
+    for (std::size_t start = 0; start < count; start += group_size) {
+        std::size_t n = std::min(count - start, group_size);
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t j = start + i;
+            key_pointers[i] = &verify_keys[i];
+            message_pointers[i] = from_c(messages[j]);
+            signature_pointers[i] = from_c(signatures[j]);
+            /* a zero length makes the utility reject the entry */
+            raw_signature_lengths[i] = 0;
+            if (olm::decode_base64_length(key_lengths[j])
+                    != CURVE25519_KEY_LENGTH) {
+                bad_base64 = true;
+                continue;
+            }
+            std::size_t raw_length = olm::decode_base64_length(
+                signature_lengths[j]
+            );
+            if (raw_length == std::size_t(-1)) {
+                bad_base64 = true;
+                continue;
+            }
+            olm::decode_base64(
+                from_c(keys[j]), key_lengths[j], verify_keys[i].public_key
+            );
+            olm::decode_base64(
+                from_c(signatures[j]), signature_lengths[j],
+                from_c(signatures[j])
+            );
+            raw_signature_lengths[i] = raw_length;
+        }
+        if (from_c(utility)->ed25519_verify_batch(
+            n, key_pointers,
+            message_pointers, message_lengths + start,
+            signature_pointers, raw_signature_lengths,
+            results + start
+        ) == std::size_t(-1)) {
+            all_valid = false;
+        }
+    }
+    if (bad_base64) {
+        from_c(utility)->last_error = OlmErrorCode::OLM_INVALID_BASE64;
+    }
+    return all_valid ? std::size_t(0) : std::size_t(-1);
+}
+
 }
@@ -24,6 +24,7 @@
 #include "olm/megolm.h"
 #include "olm/memory.h"
 #include "olm/message.h"
+#include "olm/parallel.h"
 #include "olm/pickle.h"
 #include "olm/pickle_encoding.h"
 
@@ -84,39 +85,89 @@ size_t olm_pickle_outbound_group_session_length(
     return _olm_enc_output_length(raw_pickle_length(session));
 }
 
-size_t olm_pickle_outbound_group_session(
+size_t olm_pickle_outbound_group_session_with_key_length(
+    const OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key
+) {
+    return _olm_enc_output_length_with_key(
+        pickle_key, raw_pickle_length(session)
+    );
+}
+
+/**
+ * Writes the pickle of the session where _olm_enc_output expects it, or
+ * _olm_enc_binary_output if binary is set, or _olm_enc_output_with_key if
+ * pickle_key is non-NULL. Returns its length, or olm_error() if the output
+ * buffer is too small.
+ */
+static size_t _pickle_raw(
     OlmOutboundGroupSession *session,
-    void const * key, size_t key_length,
-    void * pickled, size_t pickled_length
+    void * pickled, size_t pickled_length,
+    int binary, const OlmPickleKey * pickle_key
 ) {
     size_t raw_length = raw_pickle_length(session);
+    size_t output_length = binary
+        ? _olm_enc_binary_output_length(raw_length)
+        : pickle_key
+        ? _olm_enc_output_length_with_key(pickle_key, raw_length)
+        : _olm_enc_output_length(raw_length);
     uint8_t *pos;
 
-    if (pickled_length < _olm_enc_output_length(raw_length)) {
+    if (pickled_length < output_length) {
         session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
         return (size_t)-1;
     }
 
-    pos = _olm_enc_output_pos(pickled, raw_length);
+    pos = binary ? pickled
+        : pickle_key
+        ? _olm_enc_output_pos_with_key(pickle_key, pickled, raw_length)
+        : _olm_enc_output_pos(pickled, raw_length);
     pos = _olm_pickle_uint32(pos, PICKLE_VERSION);
     pos = megolm_pickle(&(session->ratchet), pos);
     pos = _olm_pickle_ed25519_key_pair(pos, &(session->signing_key));
 
-    return _olm_enc_output(key, key_length, pickled, raw_length);
+    return raw_length;
 }
 
-size_t olm_unpickle_outbound_group_session(
+size_t olm_pickle_outbound_group_session(
     OlmOutboundGroupSession *session,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _pickle_raw(session, pickled, pickled_length, 0, NULL);
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+    return _olm_enc_output(key, key_length, pickled, raw_length);
+}
+
+size_t olm_pickle_outbound_group_session_with_key(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _pickle_raw(
+        session, pickled, pickled_length, 0, pickle_key
+    );
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+    return _olm_enc_output_with_key(pickle_key, pickled, raw_length);
+}
+
+/**
+ * Loads the session from the raw_length bytes at pickled that _olm_enc_input
+ * decrypted, passing on its failure if raw_length is olm_error().
+ */
+static size_t _unpickle_raw(
+    OlmOutboundGroupSession *session,
+    void * pickled, size_t raw_length,
+    size_t pickled_length
 ) {
     const uint8_t *pos;
     const uint8_t *end;
     uint32_t pickle_version;
 
-    size_t raw_length = _olm_enc_input(
-        key, key_length, pickled, pickled_length, &(session->last_error)
-    );
     if (raw_length == (size_t)-1) {
         return raw_length;
     }
@@ -140,6 +191,57 @@ size_t olm_unpickle_outbound_group_session(
     return pickled_length;
 }
 
+size_t olm_unpickle_outbound_group_session(
+    OlmOutboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_input(
+        key, key_length, pickled, pickled_length, &(session->last_error)
+    );
+    return _unpickle_raw(session, pickled, raw_length, pickled_length);
+}
+
+size_t olm_unpickle_outbound_group_session_with_key(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_input_with_key(
+        pickle_key, pickled, pickled_length, &(session->last_error)
+    );
+    return _unpickle_raw(session, pickled, raw_length, pickled_length);
+}
+
+size_t olm_pickle_outbound_group_session_binary_length(
+    const OlmOutboundGroupSession *session
+) {
+    return _olm_enc_binary_output_length(raw_pickle_length(session));
+}
+
+size_t olm_pickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _pickle_raw(session, pickled, pickled_length, 1, NULL);
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+    return _olm_enc_binary_output(key, key_length, pickled, raw_length);
+}
+
+size_t olm_unpickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_binary_input(
+        key, key_length, pickled, pickled_length, &(session->last_error)
+    );
+    return _unpickle_raw(session, pickled, raw_length, pickled_length);
+}
+
 
 size_t olm_init_outbound_group_session_random_length(
     const OlmOutboundGroupSession *session
@@ -174,7 +276,7 @@ size_t olm_init_outbound_group_session(
 }
 
 static size_t raw_message_length(
-    OlmOutboundGroupSession *session,
+    uint32_t message_index,
     size_t plaintext_length)
 {
     size_t ciphertext_length, mac_length;
@@ -186,7 +288,7 @@ static size_t raw_message_length(
     mac_length = megolm_cipher->ops->mac_length(megolm_cipher);
 
     return _olm_encode_group_message_length(
-        session->ratchet.counter,
+        message_index,
         ciphertext_length, mac_length, ED25519_SIGNATURE_LENGTH
     );
 }
@@ -195,13 +297,19 @@ size_t olm_group_encrypt_message_length(
     OlmOutboundGroupSession *session,
     size_t plaintext_length
 ) {
-    size_t message_length = raw_message_length(session, plaintext_length);
+    size_t message_length = raw_message_length(
+        session->ratchet.counter, plaintext_length
+    );
     return _olm_encode_base64_length(message_length);
 }
 
-/** write an un-base64-ed message to the buffer */
+/**
+ * write an un-base64-ed message to the buffer, encrypted with the given
+ * ratchet value and signed with the session's key
+ */
 static size_t _encrypt(
-    OlmOutboundGroupSession *session, uint8_t const * plaintext, size_t plaintext_length,
+    const OlmOutboundGroupSession *session, const Megolm *ratchet,
+    uint8_t const * plaintext, size_t plaintext_length,
     uint8_t * buffer
 ) {
     size_t ciphertext_length, mac_length, message_length;
@@ -220,7 +328,7 @@ static size_t _encrypt(
      */
     message_length = _olm_encode_group_message(
         OLM_PROTOCOL_VERSION,
-        session->ratchet.counter,
+        ratchet->counter,
         ciphertext_length,
         buffer,
         &ciphertext_ptr);
@@ -229,7 +337,7 @@ static size_t _encrypt(
 
     result = megolm_cipher->ops->encrypt(
         megolm_cipher,
-        megolm_get_data(&(session->ratchet)), MEGOLM_RATCHET_LENGTH,
+        megolm_get_data(ratchet), MEGOLM_RATCHET_LENGTH,
         plaintext, plaintext_length,
         ciphertext_ptr, ciphertext_length,
         buffer, message_length
@@ -239,8 +347,6 @@ static size_t _encrypt(
         return result;
     }
 
-    megolm_advance(&(session->ratchet));
-
     /* sign the whole thing with the ed25519 key. */
     _olm_crypto_ed25519_sign(
         &(session->signing_key),
@@ -251,21 +357,20 @@ static size_t _encrypt(
     return result;
 }
 
-size_t olm_group_encrypt(
-    OlmOutboundGroupSession *session,
+/**
+ * encrypt a message with the given ratchet value into a buffer of at least
+ * the message length, and base64-encode it
+ */
+static size_t _encrypt_and_encode(
+    const OlmOutboundGroupSession *session, const Megolm *ratchet,
     uint8_t const * plaintext, size_t plaintext_length,
-    uint8_t * message, size_t max_message_length
+    uint8_t * message
 ) {
     size_t rawmsglen;
     size_t result;
     uint8_t *message_pos;
 
-    rawmsglen = raw_message_length(session, plaintext_length);
-
-    if (max_message_length < _olm_encode_base64_length(rawmsglen)) {
-        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
-        return (size_t)-1;
-    }
+    rawmsglen = raw_message_length(ratchet->counter, plaintext_length);
 
     /* we construct the message at the end of the buffer, so that
      * we have room to base64-encode it once we're done.
@@ -273,7 +378,9 @@ size_t olm_group_encrypt(
     message_pos = message + _olm_encode_base64_length(rawmsglen) - rawmsglen;
 
     /* write the message, and encrypt it, at message_pos */
-    result = _encrypt(session, plaintext, plaintext_length, message_pos);
+    result = _encrypt(
+        session, ratchet, plaintext, plaintext_length, message_pos
+    );
     if (result == (size_t)-1) {
         return result;
     }
@@ -284,6 +391,179 @@ size_t olm_group_encrypt(
     );
 }
 
+size_t olm_group_encrypt(
+    OlmOutboundGroupSession *session,
+    uint8_t const * plaintext, size_t plaintext_length,
+    uint8_t * message, size_t max_message_length
+) {
+    size_t result;
+
+    if (max_message_length
+            < olm_group_encrypt_message_length(session, plaintext_length)) {
+        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+
+    result = _encrypt_and_encode(
+        session, &session->ratchet, plaintext, plaintext_length, message
+    );
+    if (result == (size_t)-1) {
+        return result;
+    }
+
+    megolm_advance(&(session->ratchet));
+    return result;
+}
+
+/* the number of messages olm_group_encrypt_batch_parallel takes the ratchet
+ * values for at a time */
+#define ENCRYPT_BATCH 64
+
+/** the messages for _encrypt_batch_range to encrypt */
+struct _OlmEncryptBatch {
+    const OlmOutboundGroupSession *session;
+    const Megolm *ratchets;
+    uint8_t const * const * plaintexts;
+    size_t const * plaintext_lengths;
+    uint8_t * const * messages;
+    size_t * message_lengths;
+};
+
+/** encrypt messages begin to end of a batch, each with its own ratchet */
+static void _encrypt_batch_range(size_t begin, size_t end, void * context) {
+    const struct _OlmEncryptBatch *batch = context;
+    size_t i;
+
+    for (i = begin; i < end; i++) {
+        batch->message_lengths[i] = _encrypt_and_encode(
+            batch->session, &batch->ratchets[i],
+            batch->plaintexts[i], batch->plaintext_lengths[i],
+            batch->messages[i]
+        );
+    }
+}
+
+size_t olm_group_encrypt_batch(
+    OlmOutboundGroupSession *session,
+    size_t count,
+    uint8_t const * const * plaintexts, size_t const * plaintext_lengths,
+    uint8_t * const * messages, size_t const * max_message_lengths,
+    size_t * message_lengths
+) {
+    return olm_group_encrypt_batch_parallel(
+        session, count, plaintexts, plaintext_lengths,
+        messages, max_message_lengths, message_lengths, 1
+    );
+}
+
+size_t olm_group_encrypt_batch_parallel(
+    OlmOutboundGroupSession *session,
+    size_t count,
+    uint8_t const * const * plaintexts, size_t const * plaintext_lengths,
+    uint8_t * const * messages, size_t const * max_message_lengths,
+    size_t * message_lengths,
+    unsigned threads
+) {
+    Megolm ratchets[ENCRYPT_BATCH];
+    struct _OlmEncryptBatch batch;
+    size_t base, n, i;
+
+    /* check every buffer first, so that we either encrypt all the messages
+     * or none of them */
+    for (i = 0; i < count; i++) {
+        size_t length = _olm_encode_base64_length(raw_message_length(
+            session->ratchet.counter + (uint32_t)i, plaintext_lengths[i]
+        ));
+        if (max_message_lengths[i] < length) {
+            session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+            return (size_t)-1;
+        }
+    }
+
+    /* take the ratchet values in order, as olm_group_encrypt_reserve does,
+     * and then encrypt with them independently */
+    batch.session = session;
+    batch.ratchets = ratchets;
+    for (base = 0; base < count; base += n) {
+        n = count - base < ENCRYPT_BATCH ? count - base : ENCRYPT_BATCH;
+        for (i = 0; i < n; i++) {
+            ratchets[i] = session->ratchet;
+            megolm_advance(&(session->ratchet));
+        }
+        batch.plaintexts = plaintexts + base;
+        batch.plaintext_lengths = plaintext_lengths + base;
+        batch.messages = messages + base;
+        batch.message_lengths = message_lengths + base;
+        _olm_parallel_for(n, threads, _encrypt_batch_range, &batch);
+    }
+    _olm_unset(ratchets, sizeof(ratchets));
+    return count;
+}
+
+size_t olm_group_encrypt_reservation_size(void) {
+    return sizeof(Megolm);
+}
+
+size_t olm_group_encrypt_reserve(
+    OlmOutboundGroupSession *session,
+    size_t count,
+    void * reservations, size_t reservations_length
+) {
+    uint8_t *pos = reservations;
+    size_t i;
+
+    if (reservations_length / sizeof(Megolm) < count) {
+        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+
+    for (i = 0; i < count; i++) {
+        memcpy(pos, &session->ratchet, sizeof(Megolm));
+        pos += sizeof(Megolm);
+        megolm_advance(&(session->ratchet));
+    }
+    return count;
+}
+
+size_t olm_group_encrypt_reserved_message_length(
+    void const * reservation,
+    size_t plaintext_length
+) {
+    Megolm ratchet;
+    size_t length;
+
+    memcpy(&ratchet, reservation, sizeof(Megolm));
+    length = _olm_encode_base64_length(
+        raw_message_length(ratchet.counter, plaintext_length)
+    );
+    _olm_unset(&ratchet, sizeof(Megolm));
+    return length;
+}
+
+size_t olm_group_encrypt_reserved(
+    const OlmOutboundGroupSession *session,
+    void * reservation,
+    uint8_t const * plaintext, size_t plaintext_length,
+    uint8_t * message, size_t max_message_length
+) {
+    Megolm ratchet;
+    size_t result = (size_t)-1;
+
+    memcpy(&ratchet, reservation, sizeof(Megolm));
+    if (max_message_length >= _olm_encode_base64_length(
+            raw_message_length(ratchet.counter, plaintext_length)
+    )) {
+        result = _encrypt_and_encode(
+            session, &ratchet, plaintext, plaintext_length, message
+        );
+    }
+    if (result != (size_t)-1) {
+        _olm_unset(reservation, sizeof(Megolm));
+    }
+    _olm_unset(&ratchet, sizeof(Megolm));
+    return result;
+}
+
 
 size_t olm_outbound_group_session_id_length(
     const OlmOutboundGroupSession *session
@@ -0,0 +1,70 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/parallel.hh"
+#include "olm/parallel.h"
+
+#ifdef OLM_THREADS
+#include <system_error>
+#include <thread>
+#endif
+
+void olm::parallel_for(
+    std::size_t count, unsigned threads,
+    void (*function)(std::size_t begin, std::size_t end, void * context),
+    void * context
+) {
+#ifdef OLM_THREADS
+    if (threads > count) {
+        threads = unsigned(count);
+    }
+    if (threads >= 2) {
+        std::thread workers[64];
+        if (threads > 64) {
+            threads = 64;
+        }
+        unsigned started = 0;
+        std::size_t begin = 0;
+        /* the calling thread takes the last range */
+        for (unsigned i = 0; i + 1 < threads; ++i) {
+            std::size_t end = count * (i + 1) / threads;
+            try {
+                workers[i] = std::thread(function, begin, end, context);
+            } catch (std::system_error const &) {
+                break;
+            }
+            ++started;
+            begin = end;
+        }
+        function(begin, count, context);
+        for (unsigned i = 0; i < started; ++i) {
+            workers[i].join();
+        }
+        return;
+    }
+#else
+    (void) threads;
+#endif
+    if (count) {
+        function(0, count, context);
+    }
+}
+
+void _olm_parallel_for(
+    std::size_t count, unsigned threads,
+    void (*function)(std::size_t begin, std::size_t end, void * context),
+    void * context
+) {
+    olm::parallel_for(count, threads, function, context);
+}
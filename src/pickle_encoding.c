@@ -17,31 +17,80 @@
 
 #include "olm/base64.h"
 #include "olm/cipher.h"
+#include "olm/crypto.h"
+#include "olm/memory.h"
 #include "olm/olm.h"
 
+#include <string.h>
+
 static const struct _olm_cipher_aes_sha_256 PICKLE_CIPHER =
     OLM_CIPHER_INIT_AES_SHA_256("Pickle");
 
-size_t _olm_enc_output_length(
+static const struct _olm_cipher_aes_gcm PICKLE_GCM_CIPHER =
+    OLM_CIPHER_INIT_AES_GCM("Pickle GCM");
+
+/** length of the HMAC key that PICKLE_CIPHER derives */
+#define PICKLE_MAC_KEY_LENGTH 32
+
+/** length of the nonce key that PICKLE_GCM_CIPHER derives */
+#define PICKLE_NONCE_KEY_LENGTH 32
+
+/**
+ * First byte of an AES-256-GCM pickle, before the base64 encoding. It is
+ * authenticated as the associated data of PICKLE_GCM_CIPHER. AES-CBC pickles
+ * have no header; one that happens to start with this byte fails the GCM tag
+ * check and is then decrypted as AES-CBC.
+ */
+#define PICKLE_ENVELOPE_AES_GCM 0x01
+
+#define PICKLE_GCM_MAC_LENGTH (AES_GCM_IV_LENGTH + AES_GCM_TAG_LENGTH)
+
+struct OlmPickleKey {
+    /** whether pickles are written with AES-256-GCM rather than AES-CBC */
+    int use_gcm;
+
+    struct _olm_aes256_prepared_key aes_key;
+    struct _olm_hmac_sha256_key mac_key;
+    struct _olm_aes256_iv aes_iv;
+
+    /** only set up if use_gcm is set */
+    struct _olm_aes256_gcm_key gcm_key;
+    /** the HMAC key PICKLE_GCM_CIPHER takes nonces with, for the envelope
+     * byte as associated data */
+    struct _olm_hmac_sha256_key nonce_key;
+};
+
+static int _is_gcm_pickle(
+    uint8_t const * input, size_t length
+) {
+    return length > 1 + PICKLE_GCM_MAC_LENGTH
+        && input[0] == PICKLE_ENVELOPE_AES_GCM;
+}
+
+size_t _olm_enc_binary_output_length(
     size_t raw_length
 ) {
     const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
     size_t length = cipher->ops->encrypt_ciphertext_length(cipher, raw_length);
     length += cipher->ops->mac_length(cipher);
-    return _olm_encode_base64_length(length);
+    return length;
+}
+
+size_t _olm_enc_output_length(
+    size_t raw_length
+) {
+    return _olm_encode_base64_length(_olm_enc_binary_output_length(raw_length));
 }
 
 uint8_t * _olm_enc_output_pos(
     uint8_t * output,
     size_t raw_length
 ) {
-    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
-    size_t length = cipher->ops->encrypt_ciphertext_length(cipher, raw_length);
-    length += cipher->ops->mac_length(cipher);
+    size_t length = _olm_enc_binary_output_length(raw_length);
     return output + _olm_encode_base64_length(length) - length;
 }
 
-size_t _olm_enc_output(
+size_t _olm_enc_binary_output(
     uint8_t const * key, size_t key_length,
     uint8_t * output, size_t raw_length
 ) {
@@ -50,20 +99,69 @@ size_t _olm_enc_output(
         cipher, raw_length
     );
     size_t length = ciphertext_length + cipher->ops->mac_length(cipher);
-    size_t base64_length = _olm_encode_base64_length(length);
-    uint8_t * raw_output = output + base64_length - length;
     cipher->ops->encrypt(
         cipher,
         key, key_length,
-        raw_output, raw_length,
-        raw_output, ciphertext_length,
-        raw_output, length
+        output, raw_length,
+        output, ciphertext_length,
+        output, length
     );
+    return length;
+}
+
+size_t _olm_enc_output(
+    uint8_t const * key, size_t key_length,
+    uint8_t * output, size_t raw_length
+) {
+    size_t length = _olm_enc_binary_output_length(raw_length);
+    size_t base64_length = _olm_encode_base64_length(length);
+    uint8_t * raw_output = output + base64_length - length;
+    _olm_enc_binary_output(key, key_length, raw_output, raw_length);
     _olm_encode_base64(raw_output, length, output);
     return base64_length;
 }
 
 
+size_t _olm_enc_binary_input(
+    uint8_t const * key, size_t key_length,
+    uint8_t * input, size_t length,
+    enum OlmErrorCode * last_error
+) {
+    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
+    size_t mac_length = cipher->ops->mac_length(cipher);
+    size_t raw_length = length - mac_length;
+    size_t result = (size_t)-1;
+    if (_is_gcm_pickle(input, length)) {
+        const struct _olm_cipher *gcm_cipher =
+            OLM_CIPHER_BASE(&PICKLE_GCM_CIPHER);
+        size_t gcm_raw_length = length - 1 - PICKLE_GCM_MAC_LENGTH;
+        result = gcm_cipher->ops->decrypt(
+            gcm_cipher,
+            key, key_length,
+            input, length,
+            input + 1, gcm_raw_length,
+            input + 1, gcm_raw_length
+        );
+        if (result != (size_t)-1) {
+            memmove(input, input + 1, result);
+            return result;
+        }
+    }
+    if (length > mac_length) {
+        result = cipher->ops->decrypt(
+            cipher,
+            key, key_length,
+            input, length,
+            input, raw_length,
+            input, raw_length
+        );
+    }
+    if (result == (size_t)-1 && last_error) {
+        *last_error = OLM_BAD_ACCOUNT_KEY;
+    }
+    return result;
+}
+
 size_t _olm_enc_input(uint8_t const * key, size_t key_length,
                       uint8_t * input, size_t b64_length,
                       enum OlmErrorCode * last_error
@@ -76,17 +174,234 @@ size_t _olm_enc_input(uint8_t const * key, size_t key_length,
         return (size_t)-1;
     }
     _olm_decode_base64(input, b64_length, input);
+    return _olm_enc_binary_input(
+        key, key_length, input, enc_length, last_error
+    );
+}
+
+size_t olm_pickle_key_size(void) {
+    return sizeof(OlmPickleKey);
+}
+
+OlmPickleKey * olm_pickle_key(
+    void * memory,
+    void const * key, size_t key_length
+) {
     const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
-    size_t raw_length = enc_length - cipher->ops->mac_length(cipher);
-    size_t result = cipher->ops->decrypt(
-        cipher,
-        key, key_length,
-        input, enc_length,
-        input, raw_length,
-        input, raw_length
+    OlmPickleKey *pickle_key = memory;
+    uint8_t derived_keys[OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH];
+    struct _olm_aes256_key aes_key;
+
+    _olm_unset(pickle_key, sizeof(OlmPickleKey));
+
+    cipher->ops->derive_keys(cipher, key, key_length, derived_keys);
+    memcpy(aes_key.key, derived_keys, AES256_KEY_LENGTH);
+    _olm_crypto_aes_prepare_key(&aes_key, &pickle_key->aes_key);
+    _olm_crypto_hmac_sha256_prepare(
+        derived_keys + AES256_KEY_LENGTH, PICKLE_MAC_KEY_LENGTH,
+        &pickle_key->mac_key
+    );
+    memcpy(
+        pickle_key->aes_iv.iv,
+        derived_keys + AES256_KEY_LENGTH + PICKLE_MAC_KEY_LENGTH,
+        AES256_IV_LENGTH
+    );
+
+    _olm_unset(derived_keys, sizeof(derived_keys));
+    _olm_unset(&aes_key, sizeof(aes_key));
+    return pickle_key;
+}
+
+OlmPickleKey * olm_pickle_key_aes_gcm(
+    void * memory,
+    void const * key, size_t key_length
+) {
+    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_GCM_CIPHER);
+    OlmPickleKey *pickle_key = olm_pickle_key(memory, key, key_length);
+    uint8_t derived_keys[OLM_CIPHER_MAX_DERIVED_KEYS_LENGTH];
+    struct _olm_aes256_key aes_key;
+    uint8_t envelope = PICKLE_ENVELOPE_AES_GCM;
+    uint8_t data_key[SHA256_OUTPUT_LENGTH];
+
+    /* the AES-CBC keys are kept too, so that older pickles can be read */
+    pickle_key->use_gcm = 1;
+    cipher->ops->derive_keys(cipher, key, key_length, derived_keys);
+    memcpy(aes_key.key, derived_keys, AES256_KEY_LENGTH);
+    _olm_crypto_aes_gcm_prepare_key(&aes_key, &pickle_key->gcm_key);
+    _olm_crypto_hmac_sha256(
+        derived_keys + AES256_KEY_LENGTH, PICKLE_NONCE_KEY_LENGTH,
+        &envelope, 1, data_key
+    );
+    _olm_crypto_hmac_sha256_prepare(
+        data_key, sizeof(data_key), &pickle_key->nonce_key
+    );
+
+    _olm_unset(derived_keys, sizeof(derived_keys));
+    _olm_unset(&aes_key, sizeof(aes_key));
+    _olm_unset(data_key, sizeof(data_key));
+    return pickle_key;
+}
+
+size_t olm_clear_pickle_key(
+    OlmPickleKey * pickle_key
+) {
+    _olm_unset(pickle_key, sizeof(OlmPickleKey));
+    return sizeof(OlmPickleKey);
+}
+
+size_t _olm_enc_binary_output_length_with_key(
+    const OlmPickleKey * pickle_key,
+    size_t raw_length
+) {
+    if (pickle_key->use_gcm) {
+        return 1 + raw_length + PICKLE_GCM_MAC_LENGTH;
+    }
+    return _olm_enc_binary_output_length(raw_length);
+}
+
+uint8_t * _olm_enc_binary_output_pos_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * output
+) {
+    return pickle_key->use_gcm ? output + 1 : output;
+}
+
+size_t _olm_enc_output_length_with_key(
+    const OlmPickleKey * pickle_key,
+    size_t raw_length
+) {
+    return _olm_encode_base64_length(
+        _olm_enc_binary_output_length_with_key(pickle_key, raw_length)
+    );
+}
+
+uint8_t * _olm_enc_output_pos_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * output, size_t raw_length
+) {
+    size_t length = _olm_enc_binary_output_length_with_key(
+        pickle_key, raw_length
+    );
+    return _olm_enc_binary_output_pos_with_key(
+        pickle_key, output + _olm_encode_base64_length(length) - length
+    );
+}
+
+static size_t _enc_binary_output_gcm(
+    const OlmPickleKey * pickle_key,
+    uint8_t * output, size_t raw_length
+) {
+    output[0] = PICKLE_ENVELOPE_AES_GCM;
+    return _olm_cipher_aes_gcm_encrypt_prepared(
+        &pickle_key->gcm_key, &pickle_key->nonce_key,
+        output + 1, raw_length,
+        output + 1, raw_length,
+        output, 1 + raw_length + PICKLE_GCM_MAC_LENGTH
+    );
+}
+
+size_t _olm_enc_binary_output_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * output, size_t raw_length
+) {
+    if (pickle_key->use_gcm) {
+        return _enc_binary_output_gcm(pickle_key, output, raw_length);
+    }
+
+    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
+    size_t ciphertext_length = cipher->ops->encrypt_ciphertext_length(
+        cipher, raw_length
+    );
+    size_t mac_length = cipher->ops->mac_length(cipher);
+    uint8_t mac[SHA256_OUTPUT_LENGTH];
+
+    _olm_crypto_aes_encrypt_cbc_prepared(
+        &pickle_key->aes_key, &pickle_key->aes_iv,
+        output, raw_length, output
+    );
+    _olm_crypto_hmac_sha256_prepared(
+        &pickle_key->mac_key, output, ciphertext_length, mac
     );
+    memcpy(output + ciphertext_length, mac, mac_length);
+    return ciphertext_length + mac_length;
+}
+
+size_t _olm_enc_output_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * output, size_t raw_length
+) {
+    size_t length = _olm_enc_binary_output_length_with_key(
+        pickle_key, raw_length
+    );
+    size_t base64_length = _olm_encode_base64_length(length);
+    uint8_t * raw_output = output + base64_length - length;
+
+    _olm_enc_binary_output_with_key(pickle_key, raw_output, raw_length);
+    _olm_encode_base64(raw_output, length, output);
+    return base64_length;
+}
+
+size_t _olm_enc_binary_input_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t const * input, size_t length,
+    uint8_t * output,
+    enum OlmErrorCode * last_error
+) {
+    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
+    size_t mac_length = cipher->ops->mac_length(cipher);
+    size_t raw_length;
+    size_t result = (size_t)-1;
+    uint8_t mac[SHA256_OUTPUT_LENGTH];
+
+    if (pickle_key->use_gcm && _is_gcm_pickle(input, length)) {
+        /* decrypting in place leaves the plaintext after the envelope byte,
+         * so it is moved down afterwards */
+        uint8_t * plaintext = output == input ? output + 1 : output;
+        raw_length = length - 1 - PICKLE_GCM_MAC_LENGTH;
+        if (_olm_cipher_aes_gcm_decrypt_prepared(
+                &pickle_key->gcm_key, input, length,
+                input + 1, raw_length, plaintext, raw_length
+        ) != (size_t)-1) {
+            if (plaintext != output) {
+                memmove(output, plaintext, raw_length);
+            }
+            return raw_length;
+        }
+    }
+
+    if (length > mac_length) {
+        raw_length = length - mac_length;
+        _olm_crypto_hmac_sha256_prepared(
+            &pickle_key->mac_key, input, raw_length, mac
+        );
+        if (_olm_is_equal(input + raw_length, mac, mac_length)) {
+            result = _olm_crypto_aes_decrypt_cbc_prepared(
+                &pickle_key->aes_key, &pickle_key->aes_iv,
+                input, raw_length, output
+            );
+        }
+    }
     if (result == (size_t)-1 && last_error) {
         *last_error = OLM_BAD_ACCOUNT_KEY;
     }
     return result;
 }
+
+size_t _olm_enc_input_with_key(
+    const OlmPickleKey * pickle_key,
+    uint8_t * input, size_t b64_length,
+    enum OlmErrorCode * last_error
+) {
+    size_t enc_length = _olm_decode_base64_length(b64_length);
+
+    if (enc_length == (size_t)-1) {
+        if (last_error) {
+            *last_error = OLM_INVALID_BASE64;
+        }
+        return (size_t)-1;
+    }
+    _olm_decode_base64(input, b64_length, input);
+    return _olm_enc_binary_input_with_key(
+        pickle_key, input, enc_length, input, last_error
+    );
+}
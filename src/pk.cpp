@@ -274,6 +274,69 @@ namespace {
         pos = olm::unpickle(pos, end, value.key_pair);
         return pos;
     }
+
+    /* Writes the pickle of the object where _olm_enc_output expects it, or
+     * _olm_enc_binary_output if binary is set, or _olm_enc_output_with_key
+     * if pickle_key is set. Returns its length, or std::size_t(-1) if the
+     * buffer is too small. */
+    static std::size_t pickle_raw(
+        OlmPkDecryption & object,
+        void * pickled, std::size_t pickled_length,
+        bool binary = false,
+        OlmPickleKey const * pickle_key = nullptr
+    ) {
+        std::uint8_t * output = reinterpret_cast<std::uint8_t *>(pickled);
+        std::size_t raw_length = pickle_length(object);
+        std::size_t output_length = binary
+            ? _olm_enc_binary_output_length(raw_length)
+            : pickle_key
+            ? _olm_enc_output_length_with_key(pickle_key, raw_length)
+            : _olm_enc_output_length(raw_length);
+        if (pickled_length < output_length) {
+            object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+            return std::size_t(-1);
+        }
+        pickle(
+            binary ? output
+            : pickle_key
+            ? _olm_enc_output_pos_with_key(pickle_key, output, raw_length)
+            : _olm_enc_output_pos(output, raw_length),
+            object
+        );
+        return raw_length;
+    }
+
+    /* Loads the object from the raw_length bytes at pos that _olm_enc_input
+     * decrypted, passing on its failure if raw_length is std::size_t(-1). */
+    static std::size_t unpickle_raw(
+        OlmPkDecryption & object,
+        std::uint8_t * pos, std::size_t raw_length,
+        std::size_t pickled_length,
+        void * pubkey
+    ) {
+        if (raw_length == std::size_t(-1)) {
+            return std::size_t(-1);
+        }
+        std::uint8_t * const end = pos + raw_length;
+        /* On success unpickle will return (pos + raw_length). If unpickling
+         * terminates too soon then it will return a pointer before
+         * (pos + raw_length). On error unpickle will return (pos + raw_length + 1).
+         */
+        if (end != unpickle(pos, end + 1, object)) {
+            if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
+                object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
+            }
+            return std::size_t(-1);
+        }
+        if (pubkey != NULL) {
+            olm::encode_base64(
+                (const uint8_t *)object.key_pair.public_key.public_key,
+                CURVE25519_KEY_LENGTH,
+                (uint8_t *)pubkey
+            );
+        }
+        return pickled_length;
+    }
 }
 
 size_t olm_pickle_pk_decryption_length(
@@ -282,24 +345,46 @@ size_t olm_pickle_pk_decryption_length(
     return _olm_enc_output_length(pickle_length(*decryption));
 }
 
+size_t olm_pickle_pk_decryption_with_key_length(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key
+) {
+    return _olm_enc_output_length_with_key(
+        pickle_key, pickle_length(*decryption)
+    );
+}
+
 size_t olm_pickle_pk_decryption(
     OlmPkDecryption * decryption,
     void const * key, size_t key_length,
     void *pickled, size_t pickled_length
 ) {
-    OlmPkDecryption & object = *decryption;
-    std::size_t raw_length = pickle_length(object);
-    if (pickled_length < _olm_enc_output_length(raw_length)) {
-        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+    std::size_t raw_length = pickle_raw(*decryption, pickled, pickled_length);
+    if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
-    pickle(_olm_enc_output_pos(reinterpret_cast<std::uint8_t *>(pickled), raw_length), object);
     return _olm_enc_output(
         reinterpret_cast<std::uint8_t const *>(key), key_length,
         reinterpret_cast<std::uint8_t *>(pickled), raw_length
     );
 }
 
+size_t olm_pickle_pk_decryption_with_key(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_raw(
+        *decryption, pickled, pickled_length, false, pickle_key
+    );
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+    return _olm_enc_output_with_key(
+        pickle_key, reinterpret_cast<std::uint8_t *>(pickled), raw_length
+    );
+}
+
 size_t olm_unpickle_pk_decryption(
     OlmPkDecryption * decryption,
     void const * key, size_t key_length,
@@ -316,28 +401,67 @@ size_t olm_unpickle_pk_decryption(
         reinterpret_cast<std::uint8_t const *>(key), key_length,
         pos, pickled_length, &object.last_error
     );
-    if (raw_length == std::size_t(-1)) {
+    return unpickle_raw(object, pos, raw_length, pickled_length, pubkey);
+}
+
+size_t olm_unpickle_pk_decryption_with_key(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
+) {
+    OlmPkDecryption & object = *decryption;
+    if (pubkey != NULL && pubkey_length < olm_pk_key_length()) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
         return std::size_t(-1);
     }
-    std::uint8_t * const end = pos + raw_length;
-    /* On success unpickle will return (pos + raw_length). If unpickling
-     * terminates too soon then it will return a pointer before
-     * (pos + raw_length). On error unpickle will return (pos + raw_length + 1).
-     */
-    if (end != unpickle(pos, end + 1, object)) {
-        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
-            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
-        }
+    std::uint8_t * const pos = reinterpret_cast<std::uint8_t *>(pickled);
+    std::size_t raw_length = _olm_enc_input_with_key(
+        pickle_key, pos, pickled_length, &object.last_error
+    );
+    return unpickle_raw(object, pos, raw_length, pickled_length, pubkey);
+}
+
+size_t olm_pickle_pk_decryption_binary_length(
+    OlmPkDecryption * decryption
+) {
+    return _olm_enc_binary_output_length(pickle_length(*decryption));
+}
+
+size_t olm_pickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    void const * key, size_t key_length,
+    void *pickled, size_t pickled_length
+) {
+    std::size_t raw_length = pickle_raw(
+        *decryption, pickled, pickled_length, true
+    );
+    if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
-    if (pubkey != NULL) {
-        olm::encode_base64(
-            (const uint8_t *)object.key_pair.public_key.public_key,
-            CURVE25519_KEY_LENGTH,
-            (uint8_t *)pubkey
-        );
+    return _olm_enc_binary_output(
+        reinterpret_cast<std::uint8_t const *>(key), key_length,
+        reinterpret_cast<std::uint8_t *>(pickled), raw_length
+    );
+}
+
+size_t olm_unpickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    void const * key, size_t key_length,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
+) {
+    OlmPkDecryption & object = *decryption;
+    if (pubkey != NULL && pubkey_length < olm_pk_key_length()) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return std::size_t(-1);
     }
-    return pickled_length;
+    std::uint8_t * const pos = reinterpret_cast<std::uint8_t *>(pickled);
+    std::size_t raw_length = _olm_enc_binary_input(
+        reinterpret_cast<std::uint8_t const *>(key), key_length,
+        pos, pickled_length, &object.last_error
+    );
+    return unpickle_raw(object, pos, raw_length, pickled_length, pubkey);
 }
 
 size_t olm_pk_max_plaintext_length(
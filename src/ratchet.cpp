@@ -91,6 +91,32 @@ static void create_message_keys(
 }
 
 
+/**
+ * Create the message keys for the current chain key, then advance the chain.
+ * Both are HMACs with the chain key, so the HMAC key is only prepared once.
+ */
+static void create_message_keys_and_advance(
+    olm::ChainKey & chain_key,
+    olm::MessageKey & message_key
+) {
+    _olm_hmac_sha256_key hmac_key;
+    _olm_crypto_hmac_sha256_prepare(
+        chain_key.key, sizeof(chain_key.key), &hmac_key
+    );
+    _olm_crypto_hmac_sha256_prepared(
+        &hmac_key, MESSAGE_KEY_SEED, sizeof(MESSAGE_KEY_SEED),
+        message_key.key
+    );
+    message_key.index = chain_key.index;
+    _olm_crypto_hmac_sha256_prepared(
+        &hmac_key, CHAIN_KEY_SEED, sizeof(CHAIN_KEY_SEED),
+        chain_key.key
+    );
+    chain_key.index++;
+    olm::unset(hmac_key);
+}
+
+
 static std::size_t verify_mac_and_decrypt(
     _olm_cipher const *cipher,
     olm::MessageKey const & message_key,
@@ -141,49 +167,257 @@ static std::size_t verify_mac_and_decrypt_for_existing_chain(
 }
 
 
-static std::size_t verify_mac_and_decrypt_for_new_chain(
-    olm::Ratchet const & session,
-    olm::MessageReader const & reader,
-    std::uint8_t * plaintext, std::size_t max_plaintext_length
+/**
+ * Find the chain for a new ratchet key in the pending chains, or derive it
+ * and add it to them. Returns nullptr if the message can't start a new chain.
+ */
+static olm::PendingChain const * derive_new_chain(
+    olm::Ratchet & session,
+    olm::MessageReader const & reader
 ) {
-    olm::SharedKey new_root_key;
-    olm::ReceiverChain new_chain;
-
     /* They shouldn't move to a new chain until we've sent them a message
      * acknowledging the last one */
     if (session.sender_chain.empty()) {
-        return std::size_t(-1);
+        return nullptr;
     }
 
     /* Limit the number of hashes we're prepared to compute */
     if (reader.counter > MAX_MESSAGE_GAP) {
-        return std::size_t(-1);
+        return nullptr;
     }
-    olm::load_array(new_chain.ratchet_key.public_key, reader.ratchet_key);
 
+    for (olm::PendingChain const & pending : session.pending_chains) {
+        if (0 == std::memcmp(
+                pending.chain.ratchet_key.public_key, reader.ratchet_key,
+                CURVE25519_KEY_LENGTH
+        )) {
+            return &pending;
+        }
+    }
+
+    olm::PendingChain & pending = *session.pending_chains.insert();
+    olm::load_array(pending.chain.ratchet_key.public_key, reader.ratchet_key);
     create_chain_key(
         session.root_key, session.sender_chain[0].ratchet_key,
-        new_chain.ratchet_key, session.kdf_info,
-        new_root_key, new_chain.chain_key
-    );
-    std::size_t result = verify_mac_and_decrypt_for_existing_chain(
-        session, new_chain.chain_key, reader,
-        plaintext, max_plaintext_length
+        pending.chain.ratchet_key, session.kdf_info,
+        pending.root_key, pending.chain.chain_key
     );
-    olm::unset(new_root_key);
-    olm::unset(new_chain);
-    return result;
+    return &pending;
+}
+
+
+static void clear_pending_chains(
+    olm::Ratchet & session
+) {
+    for (olm::PendingChain & pending : session.pending_chains) {
+        olm::unset(pending);
+    }
+    session.pending_chains.clear();
 }
 
 } // namespace
 
 
+namespace {
+
+/* Ratchet keys are uniformly distributed, so their first bytes make a good
+ * enough hash. Mixing in the message index spreads the keys of one chain. */
+std::uint32_t skipped_key_hash(
+    std::uint8_t const * ratchet_key, std::uint32_t index
+) {
+    return (std::uint32_t(ratchet_key[0])
+        | std::uint32_t(ratchet_key[1]) << 8
+        | std::uint32_t(ratchet_key[2]) << 16
+        | std::uint32_t(ratchet_key[3]) << 24) ^ (index * 0x9E3779B1u);
+}
+
+} // namespace
+
+std::size_t const olm::SkippedMessageKeyStore::MAX_CAPACITY;
+
+
+std::uint32_t olm::SkippedMessageKeyStore::Home::operator()(
+    std::uint32_t slot
+) const {
+    SkippedMessageKey const & key = store->_keys[slot];
+    return skipped_key_hash(
+        key.ratchet_key.public_key, key.message_key.index
+    );
+}
+
+
+void olm::SkippedMessageKeyStore::init(
+    void * storage, std::size_t capacity
+) {
+    std::uint8_t * pos = static_cast<std::uint8_t *>(storage);
+    _keys = reinterpret_cast<SkippedMessageKey *>(pos);
+    pos += capacity * sizeof(SkippedMessageKey);
+    _index.init(
+        reinterpret_cast<std::uint32_t *>(pos), slot_index_size(capacity)
+    );
+    pos += slot_index_size(capacity) * sizeof(std::uint32_t);
+    _live = reinterpret_cast<std::uint32_t *>(pos);
+    _capacity = std::uint32_t(capacity);
+    _version = 0;
+    clear();
+}
+
+
+void olm::SkippedMessageKeyStore::clear() {
+    olm::unset(_keys, storage_size(_capacity));
+    _head = 0;
+    _span = 0;
+    _size = 0;
+    ++_version;
+}
+
+
+void olm::SkippedMessageKeyStore::set_live(std::uint32_t slot, bool live) {
+    std::uint32_t bit = std::uint32_t(1) << (slot % 32);
+    if (live) {
+        _live[slot / 32] |= bit;
+    } else {
+        _live[slot / 32] &= ~bit;
+    }
+}
+
+
+void olm::SkippedMessageKeyStore::remove(std::uint32_t slot) {
+    _index.remove(slot, Home{this});
+    olm::unset(_keys[slot]);
+    set_live(slot, false);
+    --_size;
+}
+
+
+/* Drop the holes at either end of the ring */
+void olm::SkippedMessageKeyStore::trim() {
+    while (_span && !is_live(slot_at(0))) {
+        _head = (_head + _capacity - 1) % _capacity;
+        --_span;
+    }
+    while (_span && !is_live(slot_at(_span - 1))) {
+        --_span;
+    }
+}
+
+
+/* Close up the holes that erase() left in the middle of the ring, keeping
+ * the keys in order, so that they don't count against the capacity. The
+ * keys move, so the index is rebuilt. */
+void olm::SkippedMessageKeyStore::compact() {
+    std::uint32_t next = slot_at(_span - 1);
+    for (std::uint32_t pos = _span; pos-- > 0;) {
+        std::uint32_t slot = slot_at(pos);
+        if (!is_live(slot)) {
+            continue;
+        }
+        if (slot != next) {
+            _keys[next] = _keys[slot];
+            olm::unset(_keys[slot]);
+            set_live(next, true);
+            set_live(slot, false);
+        }
+        next = (next + 1) % _capacity;
+    }
+    _head = next;
+    _span = _size;
+    _index.clear();
+    for (std::uint32_t pos = 0; pos != _span; ++pos) {
+        _index.insert(slot_at(pos), Home{this});
+    }
+}
+
+
+olm::SkippedMessageKey * olm::SkippedMessageKeyStore::push_newest() {
+    if (_span == _capacity && _size != _capacity) {
+        compact();
+    }
+    if (_span == _capacity) {
+        remove(slot_at(_span - 1));
+        --_span;
+        trim();
+    }
+    std::uint32_t slot = _head;
+    _head = (_head + 1) % _capacity;
+    ++_span;
+    ++_size;
+    ++_version;
+    set_live(slot, true);
+    return &_keys[slot];
+}
+
+
+olm::SkippedMessageKey * olm::SkippedMessageKeyStore::push_oldest() {
+    if (_span == _capacity && _size != _capacity) {
+        compact();
+    }
+    if (_span == _capacity) {
+        return 0;
+    }
+    std::uint32_t slot = slot_at(_span);
+    ++_span;
+    ++_size;
+    ++_version;
+    set_live(slot, true);
+    return &_keys[slot];
+}
+
+
+void olm::SkippedMessageKeyStore::add_to_index(
+    SkippedMessageKey const * key
+) {
+    _index.insert(slot_of(key), Home{this});
+}
+
+
+olm::SkippedMessageKey * olm::SkippedMessageKeyStore::find(
+    std::uint8_t const * ratchet_key, std::uint32_t index
+) {
+    std::uint32_t slot = _index.find(
+        skipped_key_hash(ratchet_key, index), [&](std::uint32_t slot) {
+            return _keys[slot].message_key.index == index
+                && 0 == std::memcmp(
+                    _keys[slot].ratchet_key.public_key, ratchet_key,
+                    CURVE25519_KEY_LENGTH
+                );
+        }
+    );
+    return slot == SlotIndex::NONE ? 0 : &_keys[slot];
+}
+
+
+void olm::SkippedMessageKeyStore::erase(SkippedMessageKey * key) {
+    remove(slot_of(key));
+    trim();
+    ++_version;
+}
+
+
 olm::Ratchet::Ratchet(
     olm::KdfInfo const & kdf_info,
     _olm_cipher const * ratchet_cipher
 ) : kdf_info(kdf_info),
     ratchet_cipher(ratchet_cipher),
-    last_error(OlmErrorCode::OLM_SUCCESS) {
+    last_error(OlmErrorCode::OLM_SUCCESS),
+    work_budget(0) {
+    skipped_message_keys.init(default_storage, MAX_SKIPPED_MESSAGE_KEYS);
+}
+
+
+olm::Ratchet::Ratchet(
+    olm::KdfInfo const & kdf_info,
+    _olm_cipher const * ratchet_cipher,
+    void * storage, std::size_t capacity
+) : kdf_info(kdf_info),
+    ratchet_cipher(ratchet_cipher),
+    last_error(OlmErrorCode::OLM_SUCCESS),
+    work_budget(0) {
+    if (capacity > MAX_SKIPPED_MESSAGE_KEYS) {
+        skipped_message_keys.init(storage, capacity);
+    } else {
+        skipped_message_keys.init(default_storage, MAX_SKIPPED_MESSAGE_KEYS);
+    }
 }
 
 
@@ -352,6 +586,55 @@ static std::uint8_t const * unpickle(
 }
 
 
+/* The skipped keys are pickled in the same way as the list that used to hold
+ * them: a count followed by the keys from newest to oldest. */
+static std::size_t pickle_length(
+    olm::SkippedMessageKeyStore const & value
+) {
+    std::size_t length = olm::pickle_length(std::uint32_t(value.size()));
+    for (olm::SkippedMessageKey const & key : value) {
+        length += pickle_length(key);
+    }
+    return length;
+}
+
+
+static std::uint8_t * pickle(
+    std::uint8_t * pos,
+    olm::SkippedMessageKeyStore const & value
+) {
+    pos = olm::pickle(pos, std::uint32_t(value.size()));
+    for (olm::SkippedMessageKey const & key : value) {
+        pos = pickle(pos, key);
+    }
+    return pos;
+}
+
+
+/* If the pickle has more keys than the store can hold then the oldest are
+ * read and dropped. */
+static std::uint8_t const * unpickle(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    olm::SkippedMessageKeyStore & value
+) {
+    std::uint32_t size = 0;
+    pos = olm::unpickle(pos, end, size);
+    value.clear();
+    olm::SkippedMessageKey dropped;
+    while (size-- && pos != end) {
+        olm::SkippedMessageKey * key = value.push_oldest();
+        if (key) {
+            pos = unpickle(pos, end, *key);
+            value.add_to_index(key);
+        } else {
+            pos = unpickle(pos, end, dropped);
+        }
+    }
+    olm::unset(dropped);
+    return pos;
+}
+
+
 } // namespace olm
 
 
@@ -387,6 +670,7 @@ std::uint8_t const * olm::unpickle(
     pos = unpickle(pos, end, value.sender_chain);
     pos = unpickle(pos, end, value.receiver_chains);
     pos = unpickle(pos, end, value.skipped_message_keys);
+    clear_pending_chains(value);
 
     // pickle v 0x80000001 includes a chain index; pickle v1 does not.
     if (includes_chain_index) {
@@ -397,6 +681,212 @@ std::uint8_t const * olm::unpickle(
 }
 
 
+namespace {
+
+static const std::size_t SENDER_CHAIN_SNAPSHOT_LENGTH =
+    4 + 2 * CURVE25519_KEY_LENGTH + olm::OLM_SHARED_KEY_LENGTH + 4;
+
+static const std::size_t RECEIVER_CHAIN_SNAPSHOT_LENGTH =
+    CURVE25519_KEY_LENGTH + olm::OLM_SHARED_KEY_LENGTH + 4;
+
+/* The parts of the ratchet in a delta pickle. Receiver chain i is
+ * DELTA_RECEIVER_CHAIN << i. */
+static const std::uint32_t DELTA_ROOT_KEY = 1;
+static const std::uint32_t DELTA_SENDER_CHAIN = 2;
+static const std::uint32_t DELTA_SKIPPED_KEYS = 4;
+static const std::uint32_t DELTA_RECEIVER_CHAIN = 8;
+
+/* The parts of the ratchet that differ from the snapshot */
+static std::uint32_t delta_parts(
+    olm::Ratchet const & value,
+    std::uint8_t const * snapshot,
+    bool skipped_keys_changed
+) {
+    std::uint8_t current[olm::RATCHET_SNAPSHOT_LENGTH];
+    olm::take_snapshot(current, value);
+
+    std::uint32_t parts = skipped_keys_changed ? DELTA_SKIPPED_KEYS : 0;
+    std::size_t offset = 0;
+    if (std::memcmp(current, snapshot, olm::OLM_SHARED_KEY_LENGTH)) {
+        parts |= DELTA_ROOT_KEY;
+    }
+    offset += olm::OLM_SHARED_KEY_LENGTH;
+    if (std::memcmp(
+            current + offset, snapshot + offset, SENDER_CHAIN_SNAPSHOT_LENGTH
+    )) {
+        parts |= DELTA_SENDER_CHAIN;
+    }
+    /* the number of receiver chains is always pickled */
+    offset += SENDER_CHAIN_SNAPSHOT_LENGTH + 4;
+    for (std::size_t i = 0; i < value.receiver_chains.size(); ++i) {
+        if (std::memcmp(
+                current + offset, snapshot + offset,
+                RECEIVER_CHAIN_SNAPSHOT_LENGTH
+        )) {
+            parts |= DELTA_RECEIVER_CHAIN << i;
+        }
+        offset += RECEIVER_CHAIN_SNAPSHOT_LENGTH;
+    }
+
+    olm::unset(current);
+    return parts;
+}
+
+} // namespace
+
+
+void olm::take_snapshot(
+    std::uint8_t * snapshot,
+    olm::Ratchet const & value
+) {
+    static_assert(
+        olm::RATCHET_SNAPSHOT_LENGTH == olm::OLM_SHARED_KEY_LENGTH
+            + SENDER_CHAIN_SNAPSHOT_LENGTH + 4
+            + olm::MAX_RECEIVER_CHAINS * RECEIVER_CHAIN_SNAPSHOT_LENGTH,
+        "RATCHET_SNAPSHOT_LENGTH doesn't match the snapshot layout"
+    );
+    std::memset(snapshot, 0, olm::RATCHET_SNAPSHOT_LENGTH);
+    std::uint8_t * pos = snapshot;
+    pickle(pos, value.root_key);
+    pos += olm::OLM_SHARED_KEY_LENGTH;
+    pickle(pos, value.sender_chain);
+    pos += SENDER_CHAIN_SNAPSHOT_LENGTH;
+    pos = olm::pickle(pos, std::uint32_t(value.receiver_chains.size()));
+    for (olm::ReceiverChain const & chain : value.receiver_chains) {
+        pickle(pos, chain);
+        pos += RECEIVER_CHAIN_SNAPSHOT_LENGTH;
+    }
+}
+
+
+std::size_t olm::pickle_delta_length(
+    olm::Ratchet const & value,
+    std::uint8_t const * snapshot,
+    bool skipped_keys_changed
+) {
+    std::uint32_t parts = delta_parts(value, snapshot, skipped_keys_changed);
+    std::size_t length = 0;
+    length += olm::pickle_length(parts);
+    length += olm::pickle_length(std::uint32_t(value.receiver_chains.size()));
+    if (parts & DELTA_ROOT_KEY) {
+        length += olm::OLM_SHARED_KEY_LENGTH;
+    }
+    if (parts & DELTA_SENDER_CHAIN) {
+        length += olm::pickle_length(value.sender_chain);
+    }
+    for (std::size_t i = 0; i < value.receiver_chains.size(); ++i) {
+        if (parts & (DELTA_RECEIVER_CHAIN << i)) {
+            length += pickle_length(value.receiver_chains[i]);
+        }
+    }
+    if (parts & DELTA_SKIPPED_KEYS) {
+        length += pickle_length(value.skipped_message_keys);
+    }
+    return length;
+}
+
+
+std::uint8_t * olm::pickle_delta(
+    std::uint8_t * pos,
+    olm::Ratchet const & value,
+    std::uint8_t const * snapshot,
+    bool skipped_keys_changed
+) {
+    std::uint32_t parts = delta_parts(value, snapshot, skipped_keys_changed);
+    pos = olm::pickle(pos, parts);
+    pos = olm::pickle(pos, std::uint32_t(value.receiver_chains.size()));
+    if (parts & DELTA_ROOT_KEY) {
+        pos = pickle(pos, value.root_key);
+    }
+    if (parts & DELTA_SENDER_CHAIN) {
+        pos = pickle(pos, value.sender_chain);
+    }
+    for (std::size_t i = 0; i < value.receiver_chains.size(); ++i) {
+        if (parts & (DELTA_RECEIVER_CHAIN << i)) {
+            pos = pickle(pos, value.receiver_chains[i]);
+        }
+    }
+    if (parts & DELTA_SKIPPED_KEYS) {
+        pos = pickle(pos, value.skipped_message_keys);
+    }
+    return pos;
+}
+
+
+std::uint8_t const * olm::unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    olm::Ratchet & value
+) {
+    std::uint32_t parts = 0;
+    std::uint32_t receiver_chains = 0;
+    pos = olm::unpickle(pos, end, parts);
+    pos = olm::unpickle(pos, end, receiver_chains);
+    if (receiver_chains > olm::MAX_RECEIVER_CHAINS) {
+        return end;
+    }
+
+    /* Read the delta into copies first, so that a truncated one leaves the
+     * ratchet as it was */
+    olm::SharedKey root_key;
+    olm::List<olm::SenderChain, 1> sender_chain;
+    olm::List<olm::ReceiverChain, olm::MAX_RECEIVER_CHAINS> chains;
+    if (parts & DELTA_ROOT_KEY) {
+        pos = unpickle(pos, end, root_key);
+    }
+    if (parts & DELTA_SENDER_CHAIN) {
+        pos = unpickle(pos, end, sender_chain);
+    }
+    /* the chains that aren't in the delta keep their place in the list */
+    for (std::uint32_t i = 0; i < receiver_chains; ++i) {
+        olm::ReceiverChain * chain = chains.insert(chains.end());
+        if (i < value.receiver_chains.size()) {
+            *chain = value.receiver_chains[i];
+        }
+        if (parts & (DELTA_RECEIVER_CHAIN << i)) {
+            pos = unpickle(pos, end, *chain);
+        }
+    }
+    /* the skipped keys are too many to copy, so only their length is
+     * checked until the rest of the delta has been taken */
+    std::uint8_t const * skipped_keys_pos = pos;
+    if (parts & DELTA_SKIPPED_KEYS) {
+        std::uint32_t size = 0;
+        pos = olm::unpickle(pos, end, size);
+        std::size_t length = size * pickle_length(olm::SkippedMessageKey());
+        pos = std::size_t(end - pos) < length ? end : pos + length;
+    }
+
+    if (pos != end) {
+        if (parts & DELTA_ROOT_KEY) {
+            std::memcpy(value.root_key, root_key, sizeof(root_key));
+        }
+        if (parts & DELTA_SENDER_CHAIN) {
+            value.sender_chain.clear();
+            for (olm::SenderChain const & chain : sender_chain) {
+                value.sender_chain.insert(value.sender_chain.end(), chain);
+            }
+        }
+        value.receiver_chains.clear();
+        for (olm::ReceiverChain const & chain : chains) {
+            value.receiver_chains.insert(value.receiver_chains.end(), chain);
+        }
+        if (parts & DELTA_SKIPPED_KEYS) {
+            unpickle(skipped_keys_pos, end, value.skipped_message_keys);
+        }
+        clear_pending_chains(value);
+    }
+
+    olm::unset(root_key);
+    for (olm::SenderChain & chain : sender_chain) {
+        olm::unset(chain);
+    }
+    for (olm::ReceiverChain & chain : chains) {
+        olm::unset(chain);
+    }
+    return pos;
+}
+
+
 std::size_t olm::Ratchet::encrypt_output_length(
     std::size_t plaintext_length
 ) {
@@ -445,11 +935,11 @@ std::size_t olm::Ratchet::encrypt(
             kdf_info,
             root_key, sender_chain[0].chain_key
         );
+        clear_pending_chains(*this);
     }
 
     MessageKey keys;
-    create_message_keys(sender_chain[0].chain_key, kdf_info, keys);
-    advance_chain_key(sender_chain[0].chain_key, sender_chain[0].chain_key);
+    create_message_keys_and_advance(sender_chain[0].chain_key, keys);
 
     std::size_t ciphertext_length = ratchet_cipher->ops->encrypt_ciphertext_length(
         ratchet_cipher,
@@ -501,6 +991,43 @@ std::size_t olm::Ratchet::decrypt_max_plaintext_length(
 }
 
 
+olm::DecryptHint olm::Ratchet::decrypt_hint(
+    std::uint8_t const * input, std::size_t input_length
+) {
+    olm::MessageReader reader;
+    olm::decode_message(reader, input, input_length, 0);
+
+    if (reader.version != PROTOCOL_VERSION
+            || !reader.has_counter || !reader.ratchet_key
+            || reader.ratchet_key_length != CURVE25519_KEY_LENGTH) {
+        return DecryptHint::IMPOSSIBLE;
+    }
+
+    for (olm::ReceiverChain const & chain : receiver_chains) {
+        if (0 == std::memcmp(
+                chain.ratchet_key.public_key, reader.ratchet_key,
+                CURVE25519_KEY_LENGTH
+        )) {
+            /* The same checks as decrypt makes before it computes anything */
+            if (chain.chain_key.index > reader.counter) {
+                return skipped_message_keys.find(
+                    reader.ratchet_key, reader.counter
+                ) ? DecryptHint::KNOWN_CHAIN : DecryptHint::IMPOSSIBLE;
+            }
+            if (reader.counter - chain.chain_key.index > MAX_MESSAGE_GAP) {
+                return DecryptHint::IMPOSSIBLE;
+            }
+            return DecryptHint::KNOWN_CHAIN;
+        }
+    }
+
+    if (sender_chain.empty() || reader.counter > MAX_MESSAGE_GAP) {
+        return DecryptHint::IMPOSSIBLE;
+    }
+    return DecryptHint::NEW_CHAIN;
+}
+
+
 std::size_t olm::Ratchet::decrypt(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * plaintext, std::size_t max_plaintext_length
@@ -548,36 +1075,53 @@ std::size_t olm::Ratchet::decrypt(
         }
     }
 
+    /* Fail fast if reaching the message key would take more steps than the
+     * budget allows. Messages beyond the maximum gap fail the MAC check
+     * below as before. */
+    std::uint32_t steps = 0;
+    if (!chain) {
+        if (!sender_chain.empty() && reader.counter <= MAX_MESSAGE_GAP) {
+            steps = reader.counter;
+        }
+    } else if (reader.counter >= chain->chain_key.index
+            && reader.counter - chain->chain_key.index <= MAX_MESSAGE_GAP) {
+        steps = reader.counter - chain->chain_key.index;
+    }
+    if (work_budget && steps > work_budget) {
+        last_error = OlmErrorCode::OLM_WORK_BUDGET_EXCEEDED;
+        return std::size_t(-1);
+    }
+
     std::size_t result = std::size_t(-1);
+    PendingChain const * new_chain = nullptr;
 
     if (!chain) {
-        result = verify_mac_and_decrypt_for_new_chain(
-            *this, reader, plaintext, max_plaintext_length
-        );
+        new_chain = derive_new_chain(*this, reader);
+        if (new_chain) {
+            result = verify_mac_and_decrypt_for_existing_chain(
+                *this, new_chain->chain.chain_key,
+                reader, plaintext, max_plaintext_length
+            );
+        }
     } else if (chain->chain_key.index > reader.counter) {
         /* Chain already advanced beyond the key for this message
          * Check if the message keys are in the skipped key list. */
-        for (olm::SkippedMessageKey & skipped : skipped_message_keys) {
-            if (reader.counter == skipped.message_key.index
-                    && 0 == std::memcmp(
-                        skipped.ratchet_key.public_key, reader.ratchet_key,
-                        CURVE25519_KEY_LENGTH
-                    )
-            ) {
-                /* Found the key for this message. Check the MAC. */
-
-                result = verify_mac_and_decrypt(
-                    ratchet_cipher, skipped.message_key, reader,
-                    plaintext, max_plaintext_length
-                );
-
-                if (result != std::size_t(-1)) {
-                    /* Remove the key from the skipped keys now that we've
-                     * decoded the message it corresponds to. */
-                    olm::unset(skipped);
-                    skipped_message_keys.erase(&skipped);
-                    return result;
-                }
+        olm::SkippedMessageKey * skipped = skipped_message_keys.find(
+            reader.ratchet_key, reader.counter
+        );
+        if (skipped) {
+            /* Found the key for this message. Check the MAC. */
+
+            result = verify_mac_and_decrypt(
+                ratchet_cipher, skipped->message_key, reader,
+                plaintext, max_plaintext_length
+            );
+
+            if (result != std::size_t(-1)) {
+                /* Remove the key from the skipped keys now that we've
+                 * decoded the message it corresponds to. */
+                skipped_message_keys.erase(skipped);
+                return result;
             }
         }
     } else {
@@ -599,24 +1143,19 @@ std::size_t olm::Ratchet::decrypt(
          * We will generate a new key when we send the next message. */
 
         chain = receiver_chains.insert();
-        olm::load_array(chain->ratchet_key.public_key, reader.ratchet_key);
-
-        // TODO: we've already done this once, in
-        // verify_mac_and_decrypt_for_new_chain(). we could reuse the result.
-        create_chain_key(
-            root_key, sender_chain[0].ratchet_key, chain->ratchet_key,
-            kdf_info, root_key, chain->chain_key
-        );
+        *chain = new_chain->chain;
+        olm::load_array(root_key, new_chain->root_key);
+        clear_pending_chains(*this);
 
         olm::unset(sender_chain[0]);
         sender_chain.erase(sender_chain.begin());
     }
 
     while (chain->chain_key.index < reader.counter) {
-        olm::SkippedMessageKey & key = *skipped_message_keys.insert();
-        create_message_keys(chain->chain_key, kdf_info, key.message_key);
+        olm::SkippedMessageKey & key = *skipped_message_keys.push_newest();
+        create_message_keys_and_advance(chain->chain_key, key.message_key);
         key.ratchet_key = chain->ratchet_key;
-        advance_chain_key(chain->chain_key, chain->chain_key);
+        skipped_message_keys.add_to_index(&key);
     }
 
     advance_chain_key(chain->chain_key, chain->chain_key);
@@ -45,7 +45,16 @@ olm::Session::Session(
 ) : ratchet(OLM_KDF_INFO, OLM_CIPHER_BASE(&OLM_CIPHER)),
     last_error(OlmErrorCode::OLM_SUCCESS),
     received_message(false) {
+    reset_journal(*this);
+}
+
 
+olm::Session::Session(
+    void * storage, std::size_t capacity
+) : ratchet(OLM_KDF_INFO, OLM_CIPHER_BASE(&OLM_CIPHER), storage, capacity),
+    last_error(OlmErrorCode::OLM_SUCCESS),
+    received_message(false) {
+    reset_journal(*this);
 }
 
 
@@ -363,6 +372,22 @@ std::size_t olm::Session::decrypt_max_plaintext_length(
 }
 
 
+olm::DecryptHint olm::Session::decrypt_hint(
+    olm::MessageType message_type,
+    std::uint8_t const * message, std::size_t message_length
+) {
+    if (message_type == olm::MessageType::MESSAGE) {
+        return ratchet.decrypt_hint(message, message_length);
+    }
+    olm::PreKeyMessageReader reader;
+    decode_one_time_key_message_header(reader, message, message_length);
+    if (!reader.message) {
+        return DecryptHint::IMPOSSIBLE;
+    }
+    return ratchet.decrypt_hint(reader.message, reader.message_length);
+}
+
+
 std::size_t olm::Session::decrypt(
     olm::MessageType message_type,
     std::uint8_t const * message, std::size_t message_length,
@@ -424,10 +449,10 @@ void olm::Session::describe(char *describe_buffer, size_t buflen) {
 
     size = snprintf(buf_pos, buflen - (buf_pos - describe_buffer), " skipped message keys:");
     if (size >= 0) buf_pos += size;
-    for (size_t i = 0; i < ratchet.skipped_message_keys.size(); ++i) {
+    for (olm::SkippedMessageKey const & key : ratchet.skipped_message_keys) {
         size = snprintf(
             buf_pos, buflen - (buf_pos - describe_buffer),
-            " %d", ratchet.skipped_message_keys[i].message_key.index
+            " %d", key.message_key.index
         );
         if (size > 0) buf_pos += size;
     }
@@ -496,3 +521,174 @@ std::uint8_t const * olm::unpickle(
     pos = olm::unpickle(pos, end, value.ratchet, includes_chain_index);
     return pos;
 }
+
+
+namespace {
+
+static const std::uint32_t SESSION_DELTA_PICKLE_VERSION = 1;
+
+/* Deltas carry this much of the SHA-256 of the snapshot they were taken
+ * against, so that they aren't applied to a session in another state */
+static const std::size_t SNAPSHOT_DIGEST_LENGTH = 8;
+
+/* The received_message flag and the keys come before the ratchet in the
+ * snapshot */
+static const std::size_t KEYS_SNAPSHOT_OFFSET = 1;
+static const std::size_t KEYS_SNAPSHOT_LENGTH = 3 * CURVE25519_KEY_LENGTH;
+static const std::size_t RATCHET_SNAPSHOT_OFFSET =
+    KEYS_SNAPSHOT_OFFSET + KEYS_SNAPSHOT_LENGTH;
+
+static void record_journal(
+    olm::Session & value, std::uint32_t sequence
+) {
+    olm::SessionJournal & journal = value.journal;
+    std::uint8_t * pos = journal.snapshot;
+    pos = olm::pickle(pos, value.received_message);
+    pos = olm::pickle(pos, value.alice_identity_key);
+    pos = olm::pickle(pos, value.alice_base_key);
+    pos = olm::pickle(pos, value.bob_one_time_key);
+    olm::take_snapshot(pos, value.ratchet);
+    journal.sequence = sequence;
+    journal.skipped_keys_version = value.ratchet.skipped_message_keys.version();
+}
+
+static void snapshot_digest(
+    olm::SessionJournal const & journal,
+    std::uint8_t * digest
+) {
+    std::uint8_t hash[SHA256_OUTPUT_LENGTH];
+    _olm_crypto_sha256(journal.snapshot, sizeof(journal.snapshot), hash);
+    std::memcpy(digest, hash, SNAPSHOT_DIGEST_LENGTH);
+    olm::unset(hash);
+}
+
+static bool keys_changed(
+    olm::Session const & value
+) {
+    std::uint8_t keys[KEYS_SNAPSHOT_LENGTH];
+    std::uint8_t * pos = keys;
+    pos = olm::pickle(pos, value.alice_identity_key);
+    pos = olm::pickle(pos, value.alice_base_key);
+    pos = olm::pickle(pos, value.bob_one_time_key);
+    return 0 != std::memcmp(
+        keys, value.journal.snapshot + KEYS_SNAPSHOT_OFFSET, sizeof(keys)
+    );
+}
+
+static bool skipped_keys_changed(
+    olm::Session const & value
+) {
+    return value.journal.skipped_keys_version
+        != value.ratchet.skipped_message_keys.version();
+}
+
+} // namespace
+
+
+void olm::reset_journal(
+    Session & value
+) {
+    record_journal(value, 0);
+}
+
+
+std::size_t olm::pickle_delta_length(
+    Session const & value
+) {
+    std::size_t length = 0;
+    length += olm::pickle_length(SESSION_DELTA_PICKLE_VERSION);
+    length += olm::pickle_length(value.journal.sequence);
+    length += SNAPSHOT_DIGEST_LENGTH;
+    length += olm::pickle_length(value.received_message);
+    length += olm::pickle_length(true);
+    if (keys_changed(value)) {
+        length += olm::pickle_length(value.alice_identity_key);
+        length += olm::pickle_length(value.alice_base_key);
+        length += olm::pickle_length(value.bob_one_time_key);
+    }
+    length += olm::pickle_delta_length(
+        value.ratchet, value.journal.snapshot + RATCHET_SNAPSHOT_OFFSET,
+        skipped_keys_changed(value)
+    );
+    return length;
+}
+
+
+std::uint8_t * olm::pickle_delta(
+    std::uint8_t * pos,
+    Session & value
+) {
+    std::uint32_t sequence = value.journal.sequence + 1;
+    bool changed = keys_changed(value);
+    pos = olm::pickle(pos, SESSION_DELTA_PICKLE_VERSION);
+    pos = olm::pickle(pos, sequence);
+    snapshot_digest(value.journal, pos);
+    pos += SNAPSHOT_DIGEST_LENGTH;
+    pos = olm::pickle(pos, value.received_message);
+    pos = olm::pickle(pos, changed);
+    if (changed) {
+        pos = olm::pickle(pos, value.alice_identity_key);
+        pos = olm::pickle(pos, value.alice_base_key);
+        pos = olm::pickle(pos, value.bob_one_time_key);
+    }
+    pos = olm::pickle_delta(
+        pos, value.ratchet, value.journal.snapshot + RATCHET_SNAPSHOT_OFFSET,
+        skipped_keys_changed(value)
+    );
+    record_journal(value, sequence);
+    return pos;
+}
+
+
+std::uint8_t const * olm::unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    Session & value
+) {
+    std::uint32_t pickle_version = 0;
+    pos = olm::unpickle(pos, end, pickle_version);
+    if (pickle_version != SESSION_DELTA_PICKLE_VERSION) {
+        value.last_error = OlmErrorCode::OLM_UNKNOWN_PICKLE_VERSION;
+        return end;
+    }
+
+    std::uint32_t sequence = 0;
+    std::uint8_t digest[SNAPSHOT_DIGEST_LENGTH];
+    std::uint8_t expected_digest[SNAPSHOT_DIGEST_LENGTH];
+    pos = olm::unpickle(pos, end, sequence);
+    pos = olm::unpickle_bytes(pos, end, digest, sizeof(digest));
+    snapshot_digest(value.journal, expected_digest);
+    if (sequence != value.journal.sequence + 1
+            || !olm::array_equal(digest, expected_digest)) {
+        value.last_error = OlmErrorCode::OLM_BAD_PICKLE_DELTA;
+        return end;
+    }
+
+    /* The ratchet only takes its part of the delta if all of it is there, and
+     * the rest is kept aside until then, so that a truncated delta leaves
+     * the session as it was */
+    bool received_message = false;
+    bool changed = false;
+    _olm_curve25519_public_key alice_identity_key;
+    _olm_curve25519_public_key alice_base_key;
+    _olm_curve25519_public_key bob_one_time_key;
+    pos = olm::unpickle(pos, end, received_message);
+    pos = olm::unpickle(pos, end, changed);
+    if (changed) {
+        pos = olm::unpickle(pos, end, alice_identity_key);
+        pos = olm::unpickle(pos, end, alice_base_key);
+        pos = olm::unpickle(pos, end, bob_one_time_key);
+    }
+    pos = olm::unpickle_delta(pos, end, value.ratchet);
+    if (pos == end) {
+        return end;
+    }
+
+    value.received_message = received_message;
+    if (changed) {
+        value.alice_identity_key = alice_identity_key;
+        value.alice_base_key = alice_base_key;
+        value.bob_one_time_key = bob_one_time_key;
+    }
+    record_journal(value, sequence);
+    return pos;
+}
@@ -0,0 +1,563 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "olm/session_archive.h"
+
+#include <string.h>
+
+#include "olm/error.h"
+#include "olm/memory.h"
+#include "olm/pickle.h"
+
+/*
+ * The archive is laid out as:
+ *
+ *   header:  version, entry count, tag count
+ *   entries: for each session, in order of session id, the offset and
+ *            length of its session id, its room id and its encrypted pickle
+ *   tags:    the entry number of each session with a room id, in order of
+ *            room id then entry number
+ *   data:    the session ids, room ids and pickles that the entries point to
+ *
+ * All numbers are big-endian uint32s, and offsets are from the start of the
+ * archive. Lookups binary search the entries or the tags in place, so opening
+ * an archive doesn't read either.
+ */
+
+#define ARCHIVE_VERSION 1
+#define HEADER_LENGTH   12
+#define ENTRY_LENGTH    24
+#define TAG_LENGTH      4
+
+/* the fields of an entry, as pairs of offset and length */
+#define FIELD_SESSION_ID 0
+#define FIELD_ROOM_ID    1
+#define FIELD_RECORD     2
+
+struct OlmSessionArchive {
+    enum OlmErrorCode last_error;
+
+    uint8_t const * data;
+    size_t length;
+
+    uint32_t entry_count;
+    uint32_t tag_count;
+};
+
+const char * olm_session_archive_last_error(
+    const OlmSessionArchive * archive
+) {
+    return _olm_error_to_string(archive->last_error);
+}
+
+size_t olm_session_archive_size(void) {
+    return sizeof(OlmSessionArchive);
+}
+
+OlmSessionArchive * olm_session_archive(
+    void * memory
+) {
+    _olm_unset(memory, sizeof(OlmSessionArchive));
+    return (OlmSessionArchive *) memory;
+}
+
+size_t olm_clear_session_archive(
+    OlmSessionArchive * archive
+) {
+    _olm_unset(archive, sizeof(OlmSessionArchive));
+    return sizeof(OlmSessionArchive);
+}
+
+static uint32_t _read_uint32(uint8_t const * pos) {
+    uint32_t value;
+    _olm_unpickle_uint32(pos, pos + 4, &value);
+    return value;
+}
+
+static uint8_t const * _entry(
+    const OlmSessionArchive * archive, uint32_t entry
+) {
+    return archive->data + HEADER_LENGTH + (size_t)entry * ENTRY_LENGTH;
+}
+
+static uint8_t const * _tag(
+    const OlmSessionArchive * archive, uint32_t tag
+) {
+    return archive->data + HEADER_LENGTH
+        + (size_t)archive->entry_count * ENTRY_LENGTH
+        + (size_t)tag * TAG_LENGTH;
+}
+
+/**
+ * Finds one of the fields of an entry. Returns 0 if it lies outside the
+ * archive.
+ */
+static int _field(
+    const OlmSessionArchive * archive, uint8_t const * entry, int field,
+    uint8_t const ** value, size_t * value_length
+) {
+    size_t offset = _read_uint32(entry + field * 8);
+    size_t length = _read_uint32(entry + field * 8 + 4);
+    if (offset > archive->length || length > archive->length - offset) {
+        return 0;
+    }
+    *value = archive->data + offset;
+    *value_length = length;
+    return 1;
+}
+
+static int _compare_bytes(
+    uint8_t const * a, size_t a_length,
+    uint8_t const * b, size_t b_length
+) {
+    int result = memcmp(a, b, a_length < b_length ? a_length : b_length);
+    if (result == 0 && a_length != b_length) {
+        result = a_length < b_length ? -1 : 1;
+    }
+    return result;
+}
+
+typedef int (*_compare_fn)(
+    const OlmSessionArchive * archive, uint8_t const * a, uint8_t const * b
+);
+
+static int _compare_entries(
+    const OlmSessionArchive * archive, uint8_t const * a, uint8_t const * b
+) {
+    uint8_t const * a_id = NULL;
+    uint8_t const * b_id = NULL;
+    size_t a_length = 0;
+    size_t b_length = 0;
+    _field(archive, a, FIELD_SESSION_ID, &a_id, &a_length);
+    _field(archive, b, FIELD_SESSION_ID, &b_id, &b_length);
+    return _compare_bytes(a_id, a_length, b_id, b_length);
+}
+
+static int _compare_tags(
+    const OlmSessionArchive * archive, uint8_t const * a, uint8_t const * b
+) {
+    uint32_t a_entry = _read_uint32(a);
+    uint32_t b_entry = _read_uint32(b);
+    uint8_t const * a_room = NULL;
+    uint8_t const * b_room = NULL;
+    size_t a_length = 0;
+    size_t b_length = 0;
+    int result;
+    _field(archive, _entry(archive, a_entry), FIELD_ROOM_ID, &a_room, &a_length);
+    _field(archive, _entry(archive, b_entry), FIELD_ROOM_ID, &b_room, &b_length);
+    result = _compare_bytes(a_room, a_length, b_room, b_length);
+    if (result == 0 && a_entry != b_entry) {
+        result = a_entry < b_entry ? -1 : 1;
+    }
+    return result;
+}
+
+static void _swap(uint8_t * a, uint8_t * b, size_t size) {
+    uint8_t tmp;
+    size_t i;
+    for (i = 0; i < size; ++i) {
+        tmp = a[i];
+        a[i] = b[i];
+        b[i] = tmp;
+    }
+}
+
+static void _sift_down(
+    uint8_t * base, size_t size, size_t root, size_t count,
+    _compare_fn compare, const OlmSessionArchive * archive
+) {
+    size_t child;
+    while ((child = 2 * root + 1) < count) {
+        if (child + 1 < count && compare(
+                archive, base + child * size, base + (child + 1) * size
+        ) < 0) {
+            ++child;
+        }
+        if (compare(archive, base + root * size, base + child * size) >= 0) {
+            return;
+        }
+        _swap(base + root * size, base + child * size, size);
+        root = child;
+    }
+}
+
+/**
+ * Sorts count records of the given size in place. A heap sort, since it
+ * needs no memory besides the records and the archive they point into.
+ */
+static void _sort(
+    uint8_t * base, size_t size, size_t count,
+    _compare_fn compare, const OlmSessionArchive * archive
+) {
+    size_t i;
+    for (i = count / 2; i-- > 0;) {
+        _sift_down(base, size, i, count, compare, archive);
+    }
+    for (i = count; i-- > 1;) {
+        _swap(base, base + i * size, size);
+        _sift_down(base, size, 0, i, compare, archive);
+    }
+}
+
+static size_t _room_id_length(
+    size_t const * room_id_lengths, uint8_t const * const * room_ids, size_t i
+) {
+    return room_ids && room_ids[i] ? room_id_lengths[i] : 0;
+}
+
+size_t olm_session_archive_length(
+    OlmInboundGroupSession * const * sessions,
+    uint8_t const * const * room_ids, size_t const * room_id_lengths,
+    size_t count,
+    const OlmPickleKey * pickle_key
+) {
+    size_t length = HEADER_LENGTH + count * ENTRY_LENGTH;
+    size_t room_id_length;
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        room_id_length = _room_id_length(room_id_lengths, room_ids, i);
+        if (room_id_length) {
+            length += TAG_LENGTH + room_id_length;
+        }
+        length += olm_inbound_group_session_id_length(sessions[i]);
+        length += olm_pickle_inbound_group_session_binary_with_key_length(
+            sessions[i], pickle_key
+        );
+    }
+    return length;
+}
+
+size_t olm_write_session_archive(
+    OlmSessionArchive * archive,
+    OlmInboundGroupSession * const * sessions,
+    uint8_t const * const * room_ids, size_t const * room_id_lengths,
+    size_t count,
+    const OlmPickleKey * pickle_key,
+    void * output, size_t output_length
+) {
+    size_t length = olm_session_archive_length(
+        sessions, room_ids, room_id_lengths, count, pickle_key
+    );
+    uint8_t * out = (uint8_t *) output;
+    uint8_t * entry;
+    uint8_t * tags;
+    uint8_t * pos;
+    uint8_t const * room_id;
+    size_t room_id_length;
+    size_t field_length;
+    uint32_t tag_count = 0;
+    size_t i;
+
+    if (output_length < length) {
+        archive->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+    if (length > 0xffffffffU) {
+        archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+        return (size_t)-1;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (_room_id_length(room_id_lengths, room_ids, i)) {
+            ++tag_count;
+        }
+    }
+    tags = out + HEADER_LENGTH + count * ENTRY_LENGTH;
+    pos = tags + (size_t)tag_count * TAG_LENGTH;
+
+    for (i = 0; i < count; ++i) {
+        entry = out + HEADER_LENGTH + i * ENTRY_LENGTH;
+
+        field_length = olm_inbound_group_session_id_length(sessions[i]);
+        olm_inbound_group_session_id(sessions[i], pos, field_length);
+        entry = _olm_pickle_uint32(entry, (uint32_t)(pos - out));
+        entry = _olm_pickle_uint32(entry, (uint32_t)field_length);
+        pos += field_length;
+
+        room_id_length = _room_id_length(room_id_lengths, room_ids, i);
+        if (room_id_length) {
+            memcpy(pos, room_ids[i], room_id_length);
+        }
+        entry = _olm_pickle_uint32(entry, (uint32_t)(pos - out));
+        entry = _olm_pickle_uint32(entry, (uint32_t)room_id_length);
+        pos += room_id_length;
+
+        field_length = olm_pickle_inbound_group_session_binary_with_key(
+            sessions[i], pickle_key, pos,
+            olm_pickle_inbound_group_session_binary_with_key_length(
+                sessions[i], pickle_key
+            )
+        );
+        entry = _olm_pickle_uint32(entry, (uint32_t)(pos - out));
+        entry = _olm_pickle_uint32(entry, (uint32_t)field_length);
+        pos += field_length;
+    }
+
+    archive->data = out;
+    archive->length = length;
+    archive->entry_count = (uint32_t)count;
+    archive->tag_count = tag_count;
+
+    _sort(
+        out + HEADER_LENGTH, ENTRY_LENGTH, count, _compare_entries, archive
+    );
+    for (i = 1; i < count; ++i) {
+        if (_compare_entries(
+                archive, _entry(archive, i - 1), _entry(archive, i)
+        ) == 0) {
+            archive->data = NULL;
+            archive->length = 0;
+            archive->entry_count = 0;
+            archive->tag_count = 0;
+            archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+            return (size_t)-1;
+        }
+    }
+
+    pos = tags;
+    for (i = 0; i < count; ++i) {
+        _field(archive, _entry(archive, i), FIELD_ROOM_ID, &room_id, &field_length);
+        if (field_length) {
+            pos = _olm_pickle_uint32(pos, (uint32_t)i);
+        }
+    }
+    _sort(tags, TAG_LENGTH, tag_count, _compare_tags, archive);
+
+    pos = _olm_pickle_uint32(out, ARCHIVE_VERSION);
+    pos = _olm_pickle_uint32(pos, (uint32_t)count);
+    pos = _olm_pickle_uint32(pos, tag_count);
+
+    return length;
+}
+
+size_t olm_open_session_archive(
+    OlmSessionArchive * archive,
+    void const * data, size_t data_length
+) {
+    uint8_t const * pos = (uint8_t const *) data;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t tag_count;
+    size_t index_length;
+
+    if (data_length < HEADER_LENGTH) {
+        archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+        return (size_t)-1;
+    }
+    version = _read_uint32(pos);
+    entry_count = _read_uint32(pos + 4);
+    tag_count = _read_uint32(pos + 8);
+    index_length = data_length - HEADER_LENGTH;
+    if (version != ARCHIVE_VERSION
+            || index_length / ENTRY_LENGTH < entry_count
+            || (index_length - (size_t)entry_count * ENTRY_LENGTH) / TAG_LENGTH
+                < tag_count
+            || tag_count > entry_count) {
+        archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+        return (size_t)-1;
+    }
+
+    archive->data = pos;
+    archive->length = data_length;
+    archive->entry_count = entry_count;
+    archive->tag_count = tag_count;
+    return entry_count;
+}
+
+size_t olm_session_archive_entry_count(
+    const OlmSessionArchive * archive
+) {
+    return archive->entry_count;
+}
+
+size_t olm_session_archive_find(
+    OlmSessionArchive * archive,
+    uint8_t const * session_id, size_t session_id_length
+) {
+    uint32_t low = 0;
+    uint32_t high = archive->entry_count;
+    uint32_t middle;
+    uint8_t const * id;
+    size_t id_length;
+    int result;
+
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (!_field(
+                archive, _entry(archive, middle), FIELD_SESSION_ID,
+                &id, &id_length
+        )) {
+            archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+            return (size_t)-1;
+        }
+        result = _compare_bytes(id, id_length, session_id, session_id_length);
+        if (result == 0) {
+            return middle;
+        } else if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    archive->last_error = OLM_UNKNOWN_SESSION_ID;
+    return (size_t)-1;
+}
+
+/**
+ * Finds the room id of a tag. Returns 0 if the tag is invalid.
+ */
+static int _tag_room_id(
+    const OlmSessionArchive * archive, uint32_t tag,
+    uint32_t * entry, uint8_t const ** room_id, size_t * room_id_length
+) {
+    *entry = _read_uint32(_tag(archive, tag));
+    return *entry < archive->entry_count && _field(
+        archive, _entry(archive, *entry), FIELD_ROOM_ID,
+        room_id, room_id_length
+    );
+}
+
+size_t olm_session_archive_find_room(
+    OlmSessionArchive * archive,
+    uint8_t const * room_id, size_t room_id_length,
+    size_t * entries, size_t max_entries
+) {
+    uint32_t low = 0;
+    uint32_t high = archive->tag_count;
+    uint32_t middle;
+    uint32_t entry;
+    uint8_t const * tag_room_id;
+    size_t tag_room_id_length;
+    size_t found = 0;
+
+    /* the first tag that isn't before the room id */
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (!_tag_room_id(
+                archive, middle, &entry, &tag_room_id, &tag_room_id_length
+        )) {
+            archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+            return (size_t)-1;
+        }
+        if (_compare_bytes(
+                tag_room_id, tag_room_id_length, room_id, room_id_length
+        ) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (; low < archive->tag_count; ++low) {
+        if (!_tag_room_id(
+                archive, low, &entry, &tag_room_id, &tag_room_id_length
+        )) {
+            archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+            return (size_t)-1;
+        }
+        if (_compare_bytes(
+                tag_room_id, tag_room_id_length, room_id, room_id_length
+        ) != 0) {
+            break;
+        }
+        if (found < max_entries) {
+            entries[found] = entry;
+        }
+        ++found;
+    }
+    return found;
+}
+
+/**
+ * Finds one of the fields of an entry, setting last_error if the entry
+ * number is out of range or the field lies outside the archive.
+ */
+static int _entry_field(
+    OlmSessionArchive * archive, size_t entry, int field,
+    uint8_t const ** value, size_t * value_length
+) {
+    if (entry >= archive->entry_count || !_field(
+            archive, _entry(archive, (uint32_t)entry), field,
+            value, value_length
+    )) {
+        archive->last_error = OLM_BAD_SESSION_ARCHIVE;
+        return 0;
+    }
+    return 1;
+}
+
+/** Copies one of the fields of an entry to the output buffer */
+static size_t _copy_field(
+    OlmSessionArchive * archive, size_t entry, int field,
+    uint8_t * output, size_t output_length
+) {
+    uint8_t const * value;
+    size_t value_length;
+    if (!_entry_field(archive, entry, field, &value, &value_length)) {
+        return (size_t)-1;
+    }
+    if (output_length < value_length) {
+        archive->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+    memcpy(output, value, value_length);
+    return value_length;
+}
+
+size_t olm_session_archive_session_id(
+    OlmSessionArchive * archive, size_t entry,
+    uint8_t * session_id, size_t session_id_length
+) {
+    return _copy_field(
+        archive, entry, FIELD_SESSION_ID, session_id, session_id_length
+    );
+}
+
+size_t olm_session_archive_room_id(
+    OlmSessionArchive * archive, size_t entry,
+    uint8_t * room_id, size_t room_id_length
+) {
+    return _copy_field(
+        archive, entry, FIELD_ROOM_ID, room_id, room_id_length
+    );
+}
+
+size_t olm_session_archive_scratch_length(
+    OlmSessionArchive * archive, size_t entry
+) {
+    uint8_t const * record;
+    size_t record_length;
+    if (!_entry_field(archive, entry, FIELD_RECORD, &record, &record_length)) {
+        return (size_t)-1;
+    }
+    return record_length;
+}
+
+size_t olm_session_archive_unpickle(
+    OlmSessionArchive * archive, size_t entry,
+    OlmInboundGroupSession * session,
+    const OlmPickleKey * pickle_key,
+    void * scratch, size_t scratch_length
+) {
+    uint8_t const * record;
+    size_t record_length;
+    if (!_entry_field(archive, entry, FIELD_RECORD, &record, &record_length)) {
+        return (size_t)-1;
+    }
+    return olm_unpickle_inbound_group_session_binary_with_key(
+        session, pickle_key, record, record_length, scratch, scratch_length
+    );
+}
@@ -0,0 +1,338 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "olm/sha256_hw.h"
+#include "olm/cpu.h"
+
+#if OLM_CPU_X86
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define SHANI_TARGET
+#define AVX2_TARGET
+#else
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2,bmi2")))
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* SHA extensions */
+
+/* Four rounds using the message words in `cur`. On the way this finishes the
+ * schedule for the next group of four words (sha256msg2) and starts the one
+ * three groups ahead (sha256msg1), so the last few groups skip those steps.
+ */
+#define SHANI_ROUNDS(i, cur, prev, next) \
+    msg = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i *) &K[4 * (i)])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+    if ((i) >= 3 && (i) <= 14) { \
+        next = _mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)); \
+        next = _mm_sha256msg2_epu32(next, cur); \
+    } \
+    msg = _mm_shuffle_epi32(msg, 0x0E); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg); \
+    if ((i) >= 1 && (i) <= 12) { \
+        prev = _mm_sha256msg1_epu32(prev, cur); \
+    }
+
+SHANI_TARGET
+void _olm_sha256_blocks_shani(
+    uint32_t state[8], uint8_t const * data, size_t blocks
+) {
+    const __m128i byte_swap = _mm_set_epi64x(
+        0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL
+    );
+    __m128i state0, state1, msg, tmp;
+    __m128i m0, m1, m2, m3, abef_save, cdgh_save;
+
+    /* the SHA instructions want the state as ABEF and CDGH */
+    tmp = _mm_loadu_si128((const __m128i *) &state[0]);
+    state1 = _mm_loadu_si128((const __m128i *) &state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (blocks--) {
+        abef_save = state0;
+        cdgh_save = state1;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 0)), byte_swap);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16)), byte_swap);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 32)), byte_swap);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 48)), byte_swap);
+
+        SHANI_ROUNDS(0, m0, m3, m1);
+        SHANI_ROUNDS(1, m1, m0, m2);
+        SHANI_ROUNDS(2, m2, m1, m3);
+        SHANI_ROUNDS(3, m3, m2, m0);
+        SHANI_ROUNDS(4, m0, m3, m1);
+        SHANI_ROUNDS(5, m1, m0, m2);
+        SHANI_ROUNDS(6, m2, m1, m3);
+        SHANI_ROUNDS(7, m3, m2, m0);
+        SHANI_ROUNDS(8, m0, m3, m1);
+        SHANI_ROUNDS(9, m1, m0, m2);
+        SHANI_ROUNDS(10, m2, m1, m3);
+        SHANI_ROUNDS(11, m3, m2, m0);
+        SHANI_ROUNDS(12, m0, m3, m1);
+        SHANI_ROUNDS(13, m1, m0, m2);
+        SHANI_ROUNDS(14, m2, m1, m3);
+        SHANI_ROUNDS(15, m3, m2, m0);
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *) &state[0], state0);
+    _mm_storeu_si128((__m128i *) &state[4], state1);
+}
+
+/* AVX2 */
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define ROTR_256(x, n) \
+    _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+AVX2_TARGET
+static __m256i sigma0_256(__m256i x) {
+    return _mm256_xor_si256(
+        _mm256_xor_si256(ROTR_256(x, 7), ROTR_256(x, 18)),
+        _mm256_srli_epi32(x, 3)
+    );
+}
+
+AVX2_TARGET
+static __m256i sigma1_256(__m256i x) {
+    return _mm256_xor_si256(
+        _mm256_xor_si256(ROTR_256(x, 17), ROTR_256(x, 19)),
+        _mm256_srli_epi32(x, 10)
+    );
+}
+
+#define ROTR_128(x, n) \
+    _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - (n)))
+
+AVX2_TARGET
+static __m128i sigma0_128(__m128i x) {
+    return _mm_xor_si128(
+        _mm_xor_si128(ROTR_128(x, 7), ROTR_128(x, 18)), _mm_srli_epi32(x, 3)
+    );
+}
+
+AVX2_TARGET
+static __m128i sigma1_128(__m128i x) {
+    return _mm_xor_si128(
+        _mm_xor_si128(ROTR_128(x, 17), ROTR_128(x, 19)), _mm_srli_epi32(x, 10)
+    );
+}
+
+/* Computes W[t] + K[t] for a single block, four words at a time */
+AVX2_TARGET
+static void avx2_schedule_one(uint8_t const * block, uint32_t wk[64]) {
+    const __m128i byte_swap = _mm_set_epi64x(
+        0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL
+    );
+    const __m128i low_half = _mm_set_epi32(0, 0, -1, -1);
+    __m128i x[4], w, s1;
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        x[i] = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i *) (block + 16 * i)), byte_swap
+        );
+        _mm_storeu_si128(
+            (__m128i *) &wk[4 * i],
+            _mm_add_epi32(x[i], _mm_loadu_si128((const __m128i *) &K[4 * i]))
+        );
+    }
+
+    for (i = 4; i < 16; ++i) {
+        w = _mm_add_epi32(x[0], _mm_add_epi32(
+            sigma0_128(_mm_alignr_epi8(x[1], x[0], 4)),
+            _mm_alignr_epi8(x[3], x[2], 4)
+        ));
+        s1 = sigma1_128(_mm_shuffle_epi32(x[3], 0xEE));
+        w = _mm_add_epi32(w, _mm_and_si128(s1, low_half));
+        s1 = sigma1_128(_mm_shuffle_epi32(w, 0x44));
+        w = _mm_add_epi32(w, _mm_andnot_si128(low_half, s1));
+
+        x[0] = x[1];
+        x[1] = x[2];
+        x[2] = x[3];
+        x[3] = w;
+        _mm_storeu_si128(
+            (__m128i *) &wk[4 * i],
+            _mm_add_epi32(w, _mm_loadu_si128((const __m128i *) &K[4 * i]))
+        );
+    }
+}
+
+/* Computes W[t] + K[t] for two blocks at once, one per 128-bit lane. This
+ * is avx2_schedule_one widened to 256 bits. */
+AVX2_TARGET
+static void avx2_schedule(
+    uint8_t const * block0, uint8_t const * block1,
+    uint32_t wk0[64], uint32_t wk1[64]
+) {
+    const __m256i byte_swap = _mm256_set_epi64x(
+        0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+        0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL
+    );
+    const __m256i low_half = _mm256_set_epi32(0, 0, -1, -1, 0, 0, -1, -1);
+    __m256i x[4], w, k, w15, w7, s1;
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        x[i] = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128((const __m128i *) (block0 + 16 * i))
+            ),
+            _mm_loadu_si128((const __m128i *) (block1 + 16 * i)), 1
+        );
+        x[i] = _mm256_shuffle_epi8(x[i], byte_swap);
+        k = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) &K[4 * i])
+        );
+        w = _mm256_add_epi32(x[i], k);
+        _mm_storeu_si128((__m128i *) &wk0[4 * i], _mm256_castsi256_si128(w));
+        _mm_storeu_si128((__m128i *) &wk1[4 * i], _mm256_extracti128_si256(w, 1));
+    }
+
+    for (i = 4; i < 16; ++i) {
+        /* W[t-15..t-12] and W[t-7..t-4] */
+        w15 = _mm256_alignr_epi8(x[1], x[0], 4);
+        w7 = _mm256_alignr_epi8(x[3], x[2], 4);
+        w = _mm256_add_epi32(x[0], _mm256_add_epi32(sigma0_256(w15), w7));
+        /* W[t] and W[t+1] depend on W[t-2] and W[t-1] */
+        s1 = sigma1_256(_mm256_shuffle_epi32(x[3], 0xEE));
+        w = _mm256_add_epi32(w, _mm256_and_si256(s1, low_half));
+        /* W[t+2] and W[t+3] depend on the W[t] and W[t+1] just computed */
+        s1 = sigma1_256(_mm256_shuffle_epi32(w, 0x44));
+        w = _mm256_add_epi32(w, _mm256_andnot_si256(low_half, s1));
+
+        x[0] = x[1];
+        x[1] = x[2];
+        x[2] = x[3];
+        x[3] = w;
+
+        k = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) &K[4 * i])
+        );
+        w = _mm256_add_epi32(w, k);
+        _mm_storeu_si128((__m128i *) &wk0[4 * i], _mm256_castsi256_si128(w));
+        _mm_storeu_si128((__m128i *) &wk1[4 * i], _mm256_extracti128_si256(w, 1));
+    }
+}
+
+/* One round, with the working variables renamed rather than shuffled */
+#define AVX2_ROUND(a, b, c, d, e, f, g, h, i) \
+    t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) \
+        + ((e & f) ^ (~e & g)) + wk[i]; \
+    d += t1; \
+    h = t1 + (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) \
+        + ((a & b) ^ (a & c) ^ (b & c))
+
+AVX2_TARGET
+static void avx2_rounds(uint32_t state[8], uint32_t const wk[64]) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    uint32_t t1;
+    int i;
+    for (i = 0; i < 64; i += 8) {
+        AVX2_ROUND(a, b, c, d, e, f, g, h, i);
+        AVX2_ROUND(h, a, b, c, d, e, f, g, i + 1);
+        AVX2_ROUND(g, h, a, b, c, d, e, f, i + 2);
+        AVX2_ROUND(f, g, h, a, b, c, d, e, i + 3);
+        AVX2_ROUND(e, f, g, h, a, b, c, d, i + 4);
+        AVX2_ROUND(d, e, f, g, h, a, b, c, i + 5);
+        AVX2_ROUND(c, d, e, f, g, h, a, b, i + 6);
+        AVX2_ROUND(b, c, d, e, f, g, h, a, i + 7);
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+AVX2_TARGET
+void _olm_sha256_blocks_avx2(
+    uint32_t state[8], uint8_t const * data, size_t blocks
+) {
+    uint32_t wk[2][64];
+    while (blocks >= 2) {
+        avx2_schedule(data, data + 64, wk[0], wk[1]);
+        avx2_rounds(state, wk[0]);
+        avx2_rounds(state, wk[1]);
+        data += 128;
+        blocks -= 2;
+    }
+    if (blocks) {
+        avx2_schedule_one(data, wk[0]);
+        avx2_rounds(state, wk[0]);
+    }
+}
+
+_olm_sha256_blocks_function _olm_sha256_hw_blocks(void) {
+    unsigned int features = _olm_cpu_features();
+    if ((features & OLM_CPU_SHA) && (features & OLM_CPU_SSE41)) {
+        return _olm_sha256_blocks_shani;
+    }
+    /* the AVX2 code is also compiled to use BMI2's rotates */
+    if ((features & OLM_CPU_AVX2) && (features & OLM_CPU_BMI2)) {
+        return _olm_sha256_blocks_avx2;
+    }
+    return NULL;
+}
+
+#else /* !OLM_CPU_X86 */
+
+void _olm_sha256_blocks_shani(
+    uint32_t state[8], uint8_t const * data, size_t blocks
+) {
+}
+
+void _olm_sha256_blocks_avx2(
+    uint32_t state[8], uint8_t const * data, size_t blocks
+) {
+}
+
+_olm_sha256_blocks_function _olm_sha256_hw_blocks(void) {
+    return NULL;
+}
+
+#endif /* OLM_CPU_X86 */
@@ -55,3 +55,76 @@ size_t olm::Utility::ed25519_verify(
     }
     return std::size_t(0);
 }
+
+
+size_t olm::Utility::ed25519_verify_prepared(
+    _olm_ed25519_prepared_public_key const & key,
+    std::uint8_t const * message, std::size_t message_length,
+    std::uint8_t const * signature, std::size_t signature_length
+) {
+    if (signature_length < ED25519_SIGNATURE_LENGTH) {
+        last_error = OlmErrorCode::OLM_BAD_MESSAGE_MAC;
+        return std::size_t(-1);
+    }
+    if (!_olm_crypto_ed25519_verify_prepared(
+        &key, message, message_length, signature
+    )) {
+        last_error = OlmErrorCode::OLM_BAD_MESSAGE_MAC;
+        return std::size_t(-1);
+    }
+    return std::size_t(0);
+}
+
+
+size_t olm::Utility::ed25519_verify_batch(
+    std::size_t count,
+    _olm_ed25519_public_key const * const * keys,
+    std::uint8_t const * const * messages,
+    std::size_t const * message_lengths,
+    std::uint8_t const * const * signatures,
+    std::size_t const * signature_lengths,
+    int * results
+) {
+    /* Entries with a usable signature are gathered into fixed size groups
+     * and handed to the crypto layer together. */
+    const std::size_t group_size = 64;
+    _olm_ed25519_public_key const * group_keys[group_size];
+    std::uint8_t const * group_messages[group_size];
+    std::size_t group_message_lengths[group_size];
+    std::uint8_t const * group_signatures[group_size];
+    int group_results[group_size];
+    std::size_t group_index[group_size];
+
+    bool all_valid = true;
+    std::size_t i = 0;
+    while (i < count) {
+        std::size_t n = 0;
+        for (; i < count && n < group_size; ++i) {
+            results[i] = 0;
+            if (signature_lengths[i] < ED25519_SIGNATURE_LENGTH) {
+                all_valid = false;
+                continue;
+            }
+            group_keys[n] = keys[i];
+            group_messages[n] = messages[i];
+            group_message_lengths[n] = message_lengths[i];
+            group_signatures[n] = signatures[i];
+            group_index[n] = i;
+            ++n;
+        }
+        if (!_olm_crypto_ed25519_verify_batch(
+            n, group_keys, group_messages, group_message_lengths,
+            group_signatures, group_results
+        )) {
+            all_valid = false;
+        }
+        for (std::size_t j = 0; j < n; ++j) {
+            results[group_index[j]] = group_results[j] ? 1 : 0;
+        }
+    }
+    if (!all_valid) {
+        last_error = OlmErrorCode::OLM_BAD_MESSAGE_MAC;
+        return std::size_t(-1);
+    }
+    return std::size_t(0);
+}
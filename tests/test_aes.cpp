@@ -0,0 +1,367 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/crypto.h"
+#include "olm/aes_ni.h"
+
+extern "C" {
+#include "crypto-algorithms/aes.h"
+}
+
+#include "unittest.hh"
+
+#include <cstring>
+
+namespace {
+
+/* NIST SP 800-38A, F.2.5 CBC-AES256.Encrypt */
+const std::uint8_t SP800_38A_KEY[32] = {
+    0x60, 0x3D, 0xEB, 0x10, 0x15, 0xCA, 0x71, 0xBE,
+    0x2B, 0x73, 0xAE, 0xF0, 0x85, 0x7D, 0x77, 0x81,
+    0x1F, 0x35, 0x2C, 0x07, 0x3B, 0x61, 0x08, 0xD7,
+    0x2D, 0x98, 0x10, 0xA3, 0x09, 0x14, 0xDF, 0xF4
+};
+
+const std::uint8_t SP800_38A_IV[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+const std::uint8_t SP800_38A_PLAINTEXT[64] = {
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+    0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+    0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+    0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+    0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+};
+
+const std::uint8_t SP800_38A_CIPHERTEXT[64] = {
+    0xF5, 0x8C, 0x4C, 0x04, 0xD6, 0xE5, 0xF1, 0xBA,
+    0x77, 0x9E, 0xAB, 0xFB, 0x5F, 0x7B, 0xFB, 0xD6,
+    0x9C, 0xFC, 0x4E, 0x96, 0x7E, 0xDB, 0x80, 0x8D,
+    0x67, 0x9F, 0x77, 0x7B, 0xC6, 0x70, 0x2C, 0x7D,
+    0x39, 0xF2, 0x33, 0x69, 0xA9, 0xD9, 0xBA, 0xCF,
+    0xA5, 0x30, 0xE2, 0x63, 0x04, 0x23, 0x14, 0x61,
+    0xB2, 0xEB, 0x05, 0xE2, 0xC3, 0x9B, 0xE9, 0xFC,
+    0xDA, 0x6C, 0x19, 0x07, 0x8C, 0x6A, 0x9D, 0x1B
+};
+
+/* McGrew and Viega, "The Galois/Counter Mode of Operation", test case 16 */
+const std::uint8_t GCM_KEY[32] = {
+    0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C,
+    0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08,
+    0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C,
+    0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08
+};
+
+const std::uint8_t GCM_IV[12] = {
+    0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD,
+    0xDE, 0xCA, 0xF8, 0x88
+};
+
+const std::uint8_t GCM_PLAINTEXT[60] = {
+    0xD9, 0x31, 0x32, 0x25, 0xF8, 0x84, 0x06, 0xE5,
+    0xA5, 0x59, 0x09, 0xC5, 0xAF, 0xF5, 0x26, 0x9A,
+    0x86, 0xA7, 0xA9, 0x53, 0x15, 0x34, 0xF7, 0xDA,
+    0x2E, 0x4C, 0x30, 0x3D, 0x8A, 0x31, 0x8A, 0x72,
+    0x1C, 0x3C, 0x0C, 0x95, 0x95, 0x68, 0x09, 0x53,
+    0x2F, 0xCF, 0x0E, 0x24, 0x49, 0xA6, 0xB5, 0x25,
+    0xB1, 0x6A, 0xED, 0xF5, 0xAA, 0x0D, 0xE6, 0x57,
+    0xBA, 0x63, 0x7B, 0x39
+};
+
+const std::uint8_t GCM_ADDITIONAL_DATA[20] = {
+    0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+    0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+    0xAB, 0xAD, 0xDA, 0xD2
+};
+
+const std::uint8_t GCM_CIPHERTEXT[60] = {
+    0x52, 0x2D, 0xC1, 0xF0, 0x99, 0x56, 0x7D, 0x07,
+    0xF4, 0x7F, 0x37, 0xA3, 0x2A, 0x84, 0x42, 0x7D,
+    0x64, 0x3A, 0x8C, 0xDC, 0xBF, 0xE5, 0xC0, 0xC9,
+    0x75, 0x98, 0xA2, 0xBD, 0x25, 0x55, 0xD1, 0xAA,
+    0x8C, 0xB0, 0x8E, 0x48, 0x59, 0x0D, 0xBB, 0x3D,
+    0xA7, 0xB0, 0x8B, 0x10, 0x56, 0x82, 0x88, 0x38,
+    0xC5, 0xF6, 0x1E, 0x63, 0x93, 0xBA, 0x7A, 0x0A,
+    0xBC, 0xC9, 0xF6, 0x62
+};
+
+const std::uint8_t GCM_TAG[16] = {
+    0x76, 0xFC, 0x6E, 0xCE, 0x0F, 0x4E, 0x17, 0x68,
+    0xCD, 0xDF, 0x88, 0x53, 0xBB, 0x2D, 0x55, 0x1B
+};
+
+/* test case 14: an all-zero key, IV and single block of plaintext */
+const std::uint8_t GCM_ZERO_CIPHERTEXT[16] = {
+    0xCE, 0xA7, 0x40, 0x3D, 0x4D, 0x60, 0x6B, 0x6E,
+    0x07, 0x4E, 0xC5, 0xD3, 0xBA, 0xF3, 0x9D, 0x18
+};
+
+const std::uint8_t GCM_ZERO_TAG[16] = {
+    0xD0, 0xD1, 0xC8, 0xA7, 0x99, 0x99, 0x6B, 0xF0,
+    0x26, 0x5B, 0x98, 0xB5, 0xD4, 0x8A, 0xB9, 0x19
+};
+
+/* test case 13: the same with no plaintext */
+const std::uint8_t GCM_EMPTY_TAG[16] = {
+    0x53, 0x0F, 0x8A, 0xFB, 0xC7, 0x45, 0x36, 0xB9,
+    0xA9, 0x63, 0xB4, 0xF1, 0xC4, 0xCB, 0x73, 0x8B
+};
+
+void fill(std::uint8_t * buffer, std::size_t length, std::uint8_t seed) {
+    for (std::size_t i = 0; i < length; ++i) {
+        buffer[i] = std::uint8_t(seed + 31 * i + (i >> 3));
+    }
+}
+
+/* CBC encryption with PKCS#7 padding using the portable AES code */
+void reference_encrypt_cbc(
+    std::uint8_t const * key, std::uint8_t const * iv,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    std::uint32_t key_schedule[60];
+    ::aes_key_setup(key, key_schedule, 256);
+    std::size_t padded_length = _olm_crypto_aes_encrypt_cbc_length(input_length);
+    std::uint8_t padded[512];
+    std::memcpy(padded, input, input_length);
+    std::memset(
+        padded + input_length, int(padded_length - input_length),
+        padded_length - input_length
+    );
+    ::aes_encrypt_cbc(padded, padded_length, output, key_schedule, 256, iv);
+}
+
+/* CBC decryption of whole blocks using the portable AES code */
+void reference_decrypt_cbc(
+    std::uint8_t const * key, std::uint8_t const * iv,
+    std::uint8_t const * input, std::size_t blocks,
+    std::uint8_t * output
+) {
+    std::uint32_t key_schedule[60];
+    ::aes_key_setup(key, key_schedule, 256);
+    std::uint8_t const * previous = iv;
+    for (std::size_t i = 0; i < blocks; ++i) {
+        ::aes_decrypt(input + 16 * i, output + 16 * i, key_schedule, 256);
+        for (std::size_t j = 0; j < 16; ++j) {
+            output[16 * i + j] ^= previous[j];
+        }
+        previous = input + 16 * i;
+    }
+}
+
+/* A GCM key that uses the portable AES and GHASH code */
+void portable_gcm_key(
+    std::uint8_t const * key, _olm_aes256_gcm_key * gcm_key
+) {
+    std::memset(gcm_key, 0, sizeof(*gcm_key));
+    ::aes_key_setup(key, gcm_key->aes_key.round_keys.key_schedule, 256);
+    std::uint8_t zero[16] = {};
+    ::aes_encrypt(
+        zero, gcm_key->hash_key, gcm_key->aes_key.round_keys.key_schedule, 256
+    );
+}
+
+} // namespace
+
+int main() {
+
+{ /* AES-256-CBC SP 800-38A */
+
+TestCase test_case("AES-256-CBC SP 800-38A");
+
+_olm_aes256_key key;
+_olm_aes256_iv iv;
+std::memcpy(key.key, SP800_38A_KEY, sizeof(key.key));
+std::memcpy(iv.iv, SP800_38A_IV, sizeof(iv.iv));
+
+std::size_t length = _olm_crypto_aes_encrypt_cbc_length(64);
+assert_equals(std::size_t(80), length);
+
+std::uint8_t ciphertext[80];
+_olm_crypto_aes_encrypt_cbc(&key, &iv, SP800_38A_PLAINTEXT, 64, ciphertext);
+assert_equals(SP800_38A_CIPHERTEXT, ciphertext, 64);
+
+std::uint8_t plaintext[80];
+length = _olm_crypto_aes_decrypt_cbc(&key, &iv, ciphertext, 80, plaintext);
+assert_equals(std::size_t(64), length);
+assert_equals(SP800_38A_PLAINTEXT, plaintext, 64);
+
+} /* AES-256-CBC SP 800-38A */
+
+{ /* AES-256-CBC against the portable implementation */
+
+TestCase test_case("AES-256-CBC against the portable implementation");
+
+std::uint8_t key_bytes[32], iv_bytes[16];
+fill(key_bytes, sizeof(key_bytes), 1);
+fill(iv_bytes, sizeof(iv_bytes), 2);
+_olm_aes256_key key;
+_olm_aes256_iv iv;
+std::memcpy(key.key, key_bytes, sizeof(key.key));
+std::memcpy(iv.iv, iv_bytes, sizeof(iv.iv));
+
+std::uint8_t input[300];
+std::uint8_t expected[320], actual[320], decrypted[320];
+for (std::size_t input_length = 0; input_length <= sizeof(input); ++input_length) {
+    fill(input, input_length, std::uint8_t(input_length));
+    std::size_t length = _olm_crypto_aes_encrypt_cbc_length(input_length);
+
+    reference_encrypt_cbc(key_bytes, iv_bytes, input, input_length, expected);
+    _olm_crypto_aes_encrypt_cbc(&key, &iv, input, input_length, actual);
+    assert_equals(expected, actual, length);
+
+    std::size_t result = _olm_crypto_aes_decrypt_cbc(
+        &key, &iv, actual, length, decrypted
+    );
+    assert_equals(input_length, result);
+    assert_equals(input, decrypted, input_length);
+}
+
+} /* AES-256-CBC against the portable implementation */
+
+{ /* AES-256-GCM test vectors */
+
+TestCase test_case("AES-256-GCM test vectors");
+
+_olm_aes256_key key;
+std::memcpy(key.key, GCM_KEY, sizeof(key.key));
+_olm_aes256_gcm_key gcm_keys[2];
+_olm_crypto_aes_gcm_prepare_key(&key, &gcm_keys[0]);
+portable_gcm_key(GCM_KEY, &gcm_keys[1]);
+
+_olm_aes256_key zero_key = {};
+_olm_aes256_gcm_key zero_gcm_keys[2];
+_olm_crypto_aes_gcm_prepare_key(&zero_key, &zero_gcm_keys[0]);
+portable_gcm_key(zero_key.key, &zero_gcm_keys[1]);
+std::uint8_t const zero[16] = {};
+
+for (int i = 0; i < 2; ++i) {
+    std::uint8_t buffer[60], tag[16];
+    _olm_crypto_aes_gcm_encrypt(
+        &gcm_keys[i], GCM_IV, GCM_ADDITIONAL_DATA, sizeof(GCM_ADDITIONAL_DATA),
+        GCM_PLAINTEXT, sizeof(GCM_PLAINTEXT), buffer, tag
+    );
+    assert_equals(GCM_CIPHERTEXT, buffer, sizeof(buffer));
+    assert_equals(GCM_TAG, tag, sizeof(tag));
+
+    /* in place */
+    assert_equals(1, _olm_crypto_aes_gcm_decrypt(
+        &gcm_keys[i], GCM_IV, GCM_ADDITIONAL_DATA, sizeof(GCM_ADDITIONAL_DATA),
+        buffer, sizeof(buffer), tag, buffer
+    ));
+    assert_equals(GCM_PLAINTEXT, buffer, sizeof(buffer));
+
+    /* a bad tag leaves the output alone */
+    std::memcpy(buffer, GCM_CIPHERTEXT, sizeof(buffer));
+    tag[15] ^= 1;
+    assert_equals(0, _olm_crypto_aes_gcm_decrypt(
+        &gcm_keys[i], GCM_IV, GCM_ADDITIONAL_DATA, sizeof(GCM_ADDITIONAL_DATA),
+        buffer, sizeof(buffer), tag, buffer
+    ));
+    assert_equals(GCM_CIPHERTEXT, buffer, sizeof(buffer));
+
+    _olm_crypto_aes_gcm_encrypt(
+        &zero_gcm_keys[i], zero, nullptr, 0, zero, 16, buffer, tag
+    );
+    assert_equals(GCM_ZERO_CIPHERTEXT, buffer, 16);
+    assert_equals(GCM_ZERO_TAG, tag, sizeof(tag));
+
+    _olm_crypto_aes_gcm_encrypt(
+        &zero_gcm_keys[i], zero, nullptr, 0, nullptr, 0, buffer, tag
+    );
+    assert_equals(GCM_EMPTY_TAG, tag, sizeof(tag));
+}
+
+} /* AES-256-GCM test vectors */
+
+{ /* AES-256-GCM against the portable implementation */
+
+TestCase test_case("AES-256-GCM against the portable implementation");
+
+std::uint8_t key_bytes[32], iv[12];
+fill(key_bytes, sizeof(key_bytes), 4);
+fill(iv, sizeof(iv), 5);
+_olm_aes256_key key;
+std::memcpy(key.key, key_bytes, sizeof(key.key));
+_olm_aes256_gcm_key gcm_key, portable_key;
+_olm_crypto_aes_gcm_prepare_key(&key, &gcm_key);
+portable_gcm_key(key_bytes, &portable_key);
+
+/* long enough for several rounds of the interleaved counter blocks */
+std::uint8_t input[300], additional_data[40];
+std::uint8_t expected[300], actual[300];
+std::uint8_t expected_tag[16], actual_tag[16];
+for (std::size_t input_length = 0; input_length <= sizeof(input); ++input_length) {
+    std::size_t additional_data_length = input_length % sizeof(additional_data);
+    fill(input, input_length, std::uint8_t(input_length));
+    fill(additional_data, additional_data_length, std::uint8_t(~input_length));
+
+    _olm_crypto_aes_gcm_encrypt(
+        &portable_key, iv, additional_data, additional_data_length,
+        input, input_length, expected, expected_tag
+    );
+    _olm_crypto_aes_gcm_encrypt(
+        &gcm_key, iv, additional_data, additional_data_length,
+        input, input_length, actual, actual_tag
+    );
+    assert_equals(expected, actual, input_length);
+    assert_equals(expected_tag, actual_tag, sizeof(actual_tag));
+
+    assert_equals(1, _olm_crypto_aes_gcm_decrypt(
+        &gcm_key, iv, additional_data, additional_data_length,
+        actual, input_length, actual_tag, actual
+    ));
+    assert_equals(input, actual, input_length);
+}
+
+} /* AES-256-GCM against the portable implementation */
+
+if (_olm_aes_ni_supported()) { /* AES-NI blocks */
+
+TestCase test_case("AES-NI blocks");
+
+_olm_aes_ni_key ni_key;
+_olm_aes_ni_key_setup(SP800_38A_KEY, &ni_key);
+
+std::uint8_t chain[16];
+std::memcpy(chain, SP800_38A_IV, sizeof(chain));
+std::uint8_t buffer[64];
+_olm_aes_ni_encrypt_cbc(&ni_key, chain, SP800_38A_PLAINTEXT, 4, buffer);
+assert_equals(SP800_38A_CIPHERTEXT, buffer, 64);
+assert_equals(SP800_38A_CIPHERTEXT + 48, chain, 16);
+
+/* in place */
+_olm_aes_ni_decrypt_cbc(&ni_key, SP800_38A_IV, buffer, 4, buffer);
+assert_equals(SP800_38A_PLAINTEXT, buffer, 64);
+
+/* cover both the interleaved loop and the tail */
+std::uint8_t ciphertext[16 * 20], expected[16 * 20], actual[16 * 20];
+fill(ciphertext, sizeof(ciphertext), 3);
+for (std::size_t blocks = 1; blocks <= 20; ++blocks) {
+    reference_decrypt_cbc(
+        SP800_38A_KEY, SP800_38A_IV, ciphertext, blocks, expected
+    );
+    std::memcpy(actual, ciphertext, 16 * blocks);
+    _olm_aes_ni_decrypt_cbc(&ni_key, SP800_38A_IV, actual, blocks, actual);
+    assert_equals(expected, actual, 16 * blocks);
+}
+
+} /* AES-NI blocks */
+
+}
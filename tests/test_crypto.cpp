@@ -16,6 +16,8 @@
 
 #include "unittest.hh"
 
+#include <cstring>
+
 int main() {
 
 
@@ -83,6 +85,288 @@ assert_equals(expected_agreement, actual_agreement, 32);
 } /* Curve25529 Test Case 1 */
 
 
+{ /* Curve25519 RFC 7748 Test Case */
+
+TestCase test_case("Curve25519 RFC 7748 Test Case");
+
+std::uint8_t scalar_1[32] = {
+    0xA5, 0x46, 0xE3, 0x6B, 0xF0, 0x52, 0x7C, 0x9D,
+    0x3B, 0x16, 0x15, 0x4B, 0x82, 0x46, 0x5E, 0xDD,
+    0x62, 0x14, 0x4C, 0x0A, 0xC1, 0xFC, 0x5A, 0x18,
+    0x50, 0x6A, 0x22, 0x44, 0xBA, 0x44, 0x9A, 0xC4
+};
+
+std::uint8_t point_1[32] = {
+    0xE6, 0xDB, 0x68, 0x67, 0x58, 0x30, 0x30, 0xDB,
+    0x35, 0x94, 0xC1, 0xA4, 0x24, 0xB1, 0x5F, 0x7C,
+    0x72, 0x66, 0x24, 0xEC, 0x26, 0xB3, 0x35, 0x3B,
+    0x10, 0xA9, 0x03, 0xA6, 0xD0, 0xAB, 0x1C, 0x4C
+};
+
+std::uint8_t expected_1[32] = {
+    0xC3, 0xDA, 0x55, 0x37, 0x9D, 0xE9, 0xC6, 0x90,
+    0x8E, 0x94, 0xEA, 0x4D, 0xF2, 0x8D, 0x08, 0x4F,
+    0x32, 0xEC, 0xCF, 0x03, 0x49, 0x1C, 0x71, 0xF7,
+    0x54, 0xB4, 0x07, 0x55, 0x77, 0xA2, 0x85, 0x52
+};
+
+/* The top bit of this u-coordinate is set and must be ignored */
+std::uint8_t scalar_2[32] = {
+    0x4B, 0x66, 0xE9, 0xD4, 0xD1, 0xB4, 0x67, 0x3C,
+    0x5A, 0xD2, 0x26, 0x91, 0x95, 0x7D, 0x6A, 0xF5,
+    0xC1, 0x1B, 0x64, 0x21, 0xE0, 0xEA, 0x01, 0xD4,
+    0x2C, 0xA4, 0x16, 0x9E, 0x79, 0x18, 0xBA, 0x0D
+};
+
+std::uint8_t point_2[32] = {
+    0xE5, 0x21, 0x0F, 0x12, 0x78, 0x68, 0x11, 0xD3,
+    0xF4, 0xB7, 0x95, 0x9D, 0x05, 0x38, 0xAE, 0x2C,
+    0x31, 0xDB, 0xE7, 0x10, 0x6F, 0xC0, 0x3C, 0x3E,
+    0xFC, 0x4C, 0xD5, 0x49, 0xC7, 0x15, 0xA4, 0x93
+};
+
+std::uint8_t expected_2[32] = {
+    0x95, 0xCB, 0xDE, 0x94, 0x76, 0xE8, 0x90, 0x7D,
+    0x7A, 0xAD, 0xE4, 0x5C, 0xB4, 0xB8, 0x73, 0xF8,
+    0x8B, 0x59, 0x5A, 0x68, 0x79, 0x9F, 0xA1, 0x52,
+    0xE6, 0xF8, 0xF7, 0x64, 0x7A, 0xAC, 0x79, 0x57
+};
+
+std::uint8_t expected_iterated_1[32] = {
+    0x42, 0x2C, 0x8E, 0x7A, 0x62, 0x27, 0xD7, 0xBC,
+    0xA1, 0x35, 0x0B, 0x3E, 0x2B, 0xB7, 0x27, 0x9F,
+    0x78, 0x97, 0xB8, 0x7B, 0xB6, 0x85, 0x4B, 0x78,
+    0x3C, 0x60, 0xE8, 0x03, 0x11, 0xAE, 0x30, 0x79
+};
+
+std::uint8_t expected_iterated_1000[32] = {
+    0x68, 0x4C, 0xF5, 0x9B, 0xA8, 0x33, 0x09, 0x55,
+    0x28, 0x00, 0xEF, 0x56, 0x6F, 0x2F, 0x4D, 0x3C,
+    0x1C, 0x38, 0x87, 0xC4, 0x93, 0x60, 0xE3, 0x87,
+    0x5F, 0x2E, 0xB9, 0x4D, 0x99, 0x53, 0x2C, 0x51
+};
+
+_olm_curve25519_key_pair pair;
+_olm_curve25519_public_key point;
+std::uint8_t actual[CURVE25519_SHARED_SECRET_LENGTH];
+
+std::memcpy(pair.private_key.private_key, scalar_1, 32);
+std::memcpy(point.public_key, point_1, 32);
+_olm_crypto_curve25519_shared_secret(&pair, &point, actual);
+assert_equals(expected_1, actual, 32);
+
+std::memcpy(pair.private_key.private_key, scalar_2, 32);
+std::memcpy(point.public_key, point_2, 32);
+_olm_crypto_curve25519_shared_secret(&pair, &point, actual);
+assert_equals(expected_2, actual, 32);
+
+/* k = u = 9; repeat { k, u = X25519(k, u), k } */
+std::memset(pair.private_key.private_key, 0, 32);
+std::memset(point.public_key, 0, 32);
+pair.private_key.private_key[0] = 9;
+point.public_key[0] = 9;
+
+for (unsigned i = 1; i <= 1000; ++i) {
+    _olm_crypto_curve25519_shared_secret(&pair, &point, actual);
+    std::memcpy(point.public_key, pair.private_key.private_key, 32);
+    std::memcpy(pair.private_key.private_key, actual, 32);
+    if (i == 1) {
+        assert_equals(expected_iterated_1, actual, 32);
+    }
+}
+assert_equals(expected_iterated_1000, actual, 32);
+
+} /* Curve25519 RFC 7748 Test Case */
+
+
+{ /* Curve25519 Base Point Test Case */
+
+TestCase test_case("Curve25519 Base Point Test Case");
+
+/* generate_key takes the Edwards fixed-base path; check that it matches
+ * the ladder against u = 9, including scalars that clamping changes */
+_olm_curve25519_key_pair pair;
+_olm_curve25519_public_key base = {{9}};
+std::uint8_t scalar[32];
+std::uint8_t expected[CURVE25519_SHARED_SECRET_LENGTH];
+
+for (unsigned i = 0; i < 64; ++i) {
+    for (unsigned j = 0; j < 32; ++j) {
+        scalar[j] = std::uint8_t(i * 31 + j * 17 + (i * j >> 3));
+    }
+    if (i == 0) std::memset(scalar, 0, 32);
+    if (i == 1) std::memset(scalar, 0xFF, 32);
+    _olm_crypto_curve25519_generate_key(scalar, &pair);
+    _olm_crypto_curve25519_shared_secret(&pair, &base, expected);
+    assert_equals(expected, pair.public_key.public_key, 32);
+}
+
+} /* Curve25519 Base Point Test Case */
+
+
+{
+TestCase test_case("Ed25519 RFC 8032 Test Case");
+
+std::uint8_t seed[32] = {
+    0x4C, 0xCD, 0x08, 0x9B, 0x28, 0xFF, 0x96, 0xDA,
+    0x9D, 0xB6, 0xC3, 0x46, 0xEC, 0x11, 0x4E, 0x0F,
+    0x5B, 0x8A, 0x31, 0x9F, 0x35, 0xAB, 0xA6, 0x24,
+    0xDA, 0x8C, 0xF6, 0xED, 0x4F, 0xB8, 0xA6, 0xFB
+};
+
+std::uint8_t expected_public[32] = {
+    0x3D, 0x40, 0x17, 0xC3, 0xE8, 0x43, 0x89, 0x5A,
+    0x92, 0xB7, 0x0A, 0xA7, 0x4D, 0x1B, 0x7E, 0xBC,
+    0x9C, 0x98, 0x2C, 0xCF, 0x2E, 0xC4, 0x96, 0x8C,
+    0xC0, 0xCD, 0x55, 0xF1, 0x2A, 0xF4, 0x66, 0x0C
+};
+
+std::uint8_t expected_signature[64] = {
+    0x92, 0xA0, 0x09, 0xA9, 0xF0, 0xD4, 0xCA, 0xB8,
+    0x72, 0x0E, 0x82, 0x0B, 0x5F, 0x64, 0x25, 0x40,
+    0xA2, 0xB2, 0x7B, 0x54, 0x16, 0x50, 0x3F, 0x8F,
+    0xB3, 0x76, 0x22, 0x23, 0xEB, 0xDB, 0x69, 0xDA,
+    0x08, 0x5A, 0xC1, 0xE4, 0x3E, 0x15, 0x99, 0x6E,
+    0x45, 0x8F, 0x36, 0x13, 0xD0, 0xF1, 0x1D, 0x8C,
+    0x38, 0x7B, 0x2E, 0xAE, 0xB4, 0x30, 0x2A, 0xEE,
+    0xB0, 0x0D, 0x29, 0x16, 0x12, 0xBB, 0x0C, 0x00
+};
+
+std::uint8_t message[1] = { 0x72 };
+
+_olm_ed25519_key_pair key_pair;
+_olm_crypto_ed25519_generate_key(seed, &key_pair);
+assert_equals(expected_public, key_pair.public_key.public_key, 32);
+
+std::uint8_t signature[64];
+_olm_crypto_ed25519_sign(&key_pair, message, 1, signature);
+assert_equals(expected_signature, signature, 64);
+
+assert_equals(true, bool(_olm_crypto_ed25519_verify(
+    &key_pair.public_key, message, 1, signature
+)));
+
+signature[0] ^= 1;
+assert_equals(false, bool(_olm_crypto_ed25519_verify(
+    &key_pair.public_key, message, 1, signature
+)));
+}
+
+
+{
+TestCase test_case("Ed25519 Prepared Key Test Case");
+std::uint8_t seed[33] = "Prepared key seed, 32 bytes long";
+std::uint8_t message[] = "Hello, World";
+std::size_t message_length = sizeof(message) - 1;
+
+_olm_ed25519_key_pair key_pair;
+_olm_crypto_ed25519_generate_key(seed, &key_pair);
+
+std::uint8_t signature[64];
+_olm_crypto_ed25519_sign(&key_pair, message, message_length, signature);
+
+_olm_ed25519_prepared_public_key prepared;
+_olm_crypto_ed25519_prepare_public_key(&key_pair.public_key, &prepared);
+assert_equals(1, int(prepared.is_valid));
+assert_equals(true, bool(_olm_crypto_ed25519_verify_prepared(
+    &prepared, message, message_length, signature
+)));
+
+message[0] = 'n';
+assert_equals(false, bool(_olm_crypto_ed25519_verify_prepared(
+    &prepared, message, message_length, signature
+)));
+
+/* y = 2 is not the y coordinate of any curve point */
+_olm_ed25519_public_key not_a_point = {{2}};
+_olm_crypto_ed25519_prepare_public_key(&not_a_point, &prepared);
+assert_equals(0, int(prepared.is_valid));
+assert_equals(false, bool(_olm_crypto_ed25519_verify_prepared(
+    &prepared, message, message_length, signature
+)));
+}
+
+{
+TestCase test_case("Ed25519 Batch Verify Test Case");
+
+/* Three signing keys, with more signatures than fit in one combined check */
+const std::size_t count = 21;
+std::uint8_t seed[33] = "Batch verify seed, 32 bytes long";
+_olm_ed25519_key_pair key_pairs[3];
+for (unsigned k = 0; k < 3; ++k) {
+    seed[0] = std::uint8_t(k);
+    _olm_crypto_ed25519_generate_key(seed, &key_pairs[k]);
+}
+
+std::uint8_t messages[count][32];
+std::uint8_t signatures[count][64];
+_olm_ed25519_public_key const * keys[count];
+std::uint8_t const * message_pointers[count];
+std::size_t message_lengths[count];
+std::uint8_t const * signature_pointers[count];
+int results[count];
+
+for (std::size_t i = 0; i < count; ++i) {
+    std::memset(messages[i], int(i), sizeof(messages[i]));
+    _olm_ed25519_key_pair const & signer = key_pairs[i % 3 == 2 ? 2 : i % 2];
+    _olm_crypto_ed25519_sign(&signer, messages[i], i, signatures[i]);
+    keys[i] = &signer.public_key;
+    message_pointers[i] = messages[i];
+    message_lengths[i] = i;
+    signature_pointers[i] = signatures[i];
+}
+
+assert_equals(1, _olm_crypto_ed25519_verify_batch(
+    count, keys, message_pointers, message_lengths, signature_pointers,
+    results
+));
+for (std::size_t i = 0; i < count; ++i) {
+    assert_equals(1, results[i]);
+}
+
+/* a tampered message, a tampered signature, a signature from the wrong key,
+ * and an unreduced S */
+messages[3][0] ^= 1;
+signatures[10][5] ^= 1;
+keys[12] = &key_pairs[1].public_key;
+signatures[20][63] |= 0x80;
+
+assert_equals(0, _olm_crypto_ed25519_verify_batch(
+    count, keys, message_pointers, message_lengths, signature_pointers,
+    results
+));
+for (std::size_t i = 0; i < count; ++i) {
+    bool bad = i == 3 || i == 10 || i == 12 || i == 20;
+    assert_equals(bad ? 0 : 1, results[i] ? 1 : 0);
+    assert_equals(
+        _olm_crypto_ed25519_verify(
+            keys[i], message_pointers[i], message_lengths[i],
+            signature_pointers[i]
+        ) ? 1 : 0,
+        results[i] ? 1 : 0
+    );
+}
+
+/* the same checks, from digests of the messages */
+std::uint8_t digests[count][ED25519_DIGEST_LENGTH];
+std::uint8_t const * digest_pointers[count];
+int digest_results[count];
+for (std::size_t i = 0; i < count; ++i) {
+    _olm_crypto_ed25519_digest(
+        keys[i], message_pointers[i], message_lengths[i],
+        signature_pointers[i], digests[i]
+    );
+    digest_pointers[i] = digests[i];
+}
+assert_equals(0, _olm_crypto_ed25519_verify_digest_batch(
+    count, keys, digest_pointers, signature_pointers, digest_results
+));
+for (std::size_t i = 0; i < count; ++i) {
+    assert_equals(results[i] ? 1 : 0, digest_results[i] ? 1 : 0);
+}
+}
+
+
 {
 TestCase test_case("Ed25519 Signature Test Case 1");
 std::uint8_t private_key[33] = "This key is a string of 32 bytes";
@@ -190,6 +474,59 @@ assert_equals(expected, actual, 32);
 
 } /* HMAC Test Case 1 */
 
+{ /* HMAC Prepared Key Test Case */
+
+TestCase test_case("HMAC Prepared Key Test Case");
+
+/* RFC 4231 test cases 2 and 6 */
+std::uint8_t short_key[] = "Jefe";
+std::uint8_t short_input[] = "what do ya want for nothing?";
+std::uint8_t short_expected[32] = {
+    0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e,
+    0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+    0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83,
+    0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+};
+
+std::uint8_t long_key[131];
+std::memset(long_key, 0xaa, sizeof(long_key));
+std::uint8_t long_input[] =
+    "Test Using Larger Than Block-Size Key - Hash Key First";
+std::uint8_t long_expected[32] = {
+    0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f,
+    0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+    0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14,
+    0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54
+};
+
+std::uint8_t actual[32];
+_olm_hmac_sha256_key prepared_key;
+
+_olm_crypto_hmac_sha256_prepare(short_key, 4, &prepared_key);
+_olm_crypto_hmac_sha256_prepared(
+    &prepared_key, short_input, sizeof(short_input) - 1, actual
+);
+assert_equals(short_expected, actual, 32);
+
+/* a prepared key can be used more than once */
+_olm_crypto_hmac_sha256_prepared(
+    &prepared_key, short_input, sizeof(short_input) - 1, actual
+);
+assert_equals(short_expected, actual, 32);
+
+_olm_crypto_hmac_sha256_prepare(long_key, sizeof(long_key), &prepared_key);
+_olm_crypto_hmac_sha256_prepared(
+    &prepared_key, long_input, sizeof(long_input) - 1, actual
+);
+assert_equals(long_expected, actual, 32);
+
+_olm_crypto_hmac_sha256(
+    long_key, sizeof(long_key), long_input, sizeof(long_input) - 1, actual
+);
+assert_equals(long_expected, actual, 32);
+
+} /* HMAC Prepared Key Test Case */
+
 { /* HDKF Test Case 1 */
 
 TestCase test_case("HDKF Test Case 1");
@@ -16,6 +16,7 @@
 #include "olm/outbound_group_session.h"
 #include "unittest.hh"
 
+#include <algorithm>
 #include <vector>
 
 int main() {
@@ -84,6 +85,241 @@ int main() {
     assert_equals(pickle1.data(), pickle2.data(), pickle_length);
 }
 
+{
+    TestCase test_case("Pickle group sessions with a prepared key");
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> key_memory(olm_pickle_key_size());
+    OlmPickleKey *pickle_key = olm_pickle_key(
+        key_memory.data(), "secret_key", 10
+    );
+
+    std::vector<uint8_t> outbound_memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound = olm_outbound_group_session(
+        outbound_memory.data()
+    );
+    olm_init_outbound_group_session(
+        outbound, random_bytes, sizeof(random_bytes)
+    );
+    std::vector<uint8_t> session_key(
+        olm_outbound_group_session_key_length(outbound)
+    );
+    olm_outbound_group_session_key(
+        outbound, session_key.data(), session_key.size()
+    );
+
+    std::vector<uint8_t> inbound_memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *inbound = olm_inbound_group_session(
+        inbound_memory.data()
+    );
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        inbound, session_key.data(), session_key.size()
+    ));
+
+    /* the prepared key gives the same pickles as the key it was made from */
+    size_t pickle_length = olm_pickle_outbound_group_session_length(outbound);
+    std::vector<uint8_t> pickle1(pickle_length);
+    std::vector<uint8_t> pickle2(pickle_length);
+    olm_pickle_outbound_group_session(
+        outbound, "secret_key", 10, pickle1.data(), pickle_length
+    );
+    assert_equals(pickle_length, olm_pickle_outbound_group_session_with_key(
+        outbound, pickle_key, pickle2.data(), pickle_length
+    ));
+    assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+    std::vector<uint8_t> outbound_memory2(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound2 = olm_outbound_group_session(
+        outbound_memory2.data()
+    );
+    assert_equals(pickle_length, olm_unpickle_outbound_group_session_with_key(
+        outbound2, pickle_key, pickle2.data(), pickle_length
+    ));
+    olm_pickle_outbound_group_session(
+        outbound2, "secret_key", 10, pickle2.data(), pickle_length
+    );
+    assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+    pickle_length = olm_pickle_inbound_group_session_length(inbound);
+    pickle1.resize(pickle_length);
+    pickle2.resize(pickle_length);
+    olm_pickle_inbound_group_session(
+        inbound, "secret_key", 10, pickle1.data(), pickle_length
+    );
+    assert_equals(pickle_length, olm_pickle_inbound_group_session_with_key(
+        inbound, pickle_key, pickle2.data(), pickle_length
+    ));
+    assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+    std::vector<uint8_t> inbound_memory2(olm_inbound_group_session_size());
+    OlmInboundGroupSession *inbound2 = olm_inbound_group_session(
+        inbound_memory2.data()
+    );
+    assert_equals(pickle_length, olm_unpickle_inbound_group_session_with_key(
+        inbound2, pickle_key, pickle2.data(), pickle_length
+    ));
+    olm_pickle_inbound_group_session(
+        inbound2, "secret_key", 10, pickle2.data(), pickle_length
+    );
+    assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+    /* a prepared key made from another key is rejected */
+    std::vector<uint8_t> wrong_key_memory(olm_pickle_key_size());
+    OlmPickleKey *wrong_key = olm_pickle_key(
+        wrong_key_memory.data(), "secret_kez", 10
+    );
+    assert_equals((size_t)-1, olm_unpickle_inbound_group_session_with_key(
+        inbound2, wrong_key, pickle2.data(), pickle_length
+    ));
+    assert_equals(
+        std::string("BAD_ACCOUNT_KEY"),
+        std::string(olm_inbound_group_session_last_error(inbound2))
+    );
+
+    /* AES-256-GCM pickles of both kinds of session load with the key */
+    std::vector<uint8_t> gcm_key_memory(olm_pickle_key_size());
+    OlmPickleKey *gcm_key = olm_pickle_key_aes_gcm(
+        gcm_key_memory.data(), "secret_key", 10
+    );
+    size_t gcm_length = olm_pickle_outbound_group_session_with_key_length(
+        outbound, gcm_key
+    );
+    std::vector<uint8_t> gcm_pickle(gcm_length);
+    assert_equals(gcm_length, olm_pickle_outbound_group_session_with_key(
+        outbound, gcm_key, gcm_pickle.data(), gcm_length
+    ));
+    assert_equals(gcm_length, olm_unpickle_outbound_group_session(
+        outbound2, "secret_key", 10, gcm_pickle.data(), gcm_length
+    ));
+
+    gcm_length = olm_pickle_inbound_group_session_with_key_length(
+        inbound, gcm_key
+    );
+    gcm_pickle.resize(gcm_length);
+    assert_equals(gcm_length, olm_pickle_inbound_group_session_with_key(
+        inbound, gcm_key, gcm_pickle.data(), gcm_length
+    ));
+    assert_equals(gcm_length, olm_unpickle_inbound_group_session_with_key(
+        inbound2, gcm_key, gcm_pickle.data(), gcm_length
+    ));
+    olm_pickle_inbound_group_session(
+        inbound2, "secret_key", 10, pickle2.data(), pickle_length
+    );
+    assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+    olm_clear_pickle_key(gcm_key);
+    olm_clear_pickle_key(wrong_key);
+    olm_clear_pickle_key(pickle_key);
+}
+
+{
+    TestCase test_case("Binary pickle inbound group session");
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> outbound_memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound = olm_outbound_group_session(
+        outbound_memory.data()
+    );
+    olm_init_outbound_group_session(
+        outbound, random_bytes, sizeof(random_bytes)
+    );
+    std::vector<uint8_t> session_key(
+        olm_outbound_group_session_key_length(outbound)
+    );
+    olm_outbound_group_session_key(
+        outbound, session_key.data(), session_key.size()
+    );
+
+    std::vector<uint8_t> memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *session = olm_inbound_group_session(memory.data());
+    olm_init_inbound_group_session(
+        session, session_key.data(), session_key.size()
+    );
+
+    size_t pickle_length = olm_pickle_inbound_group_session_binary_length(
+        session
+    );
+    assert_equals(
+        olm_pickle_inbound_group_session_length(session),
+        (pickle_length * 4 + 2) / 3
+    );
+
+    std::vector<uint8_t> pickle1(pickle_length);
+    assert_equals((size_t)-1, olm_pickle_inbound_group_session_binary(
+        session, "secret_key", 10, pickle1.data(), pickle_length - 1
+    ));
+    assert_equals(
+        std::string("OUTPUT_BUFFER_TOO_SMALL"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+    assert_equals(pickle_length, olm_pickle_inbound_group_session_binary(
+        session, "secret_key", 10, pickle1.data(), pickle_length
+    ));
+
+    std::vector<uint8_t> pickle2(pickle1);
+    std::vector<uint8_t> memory2(olm_inbound_group_session_size());
+    OlmInboundGroupSession *session2 = olm_inbound_group_session(
+        memory2.data()
+    );
+    assert_equals(pickle_length, olm_unpickle_inbound_group_session_binary(
+        session2, "secret_key", 10, pickle2.data(), pickle_length
+    ));
+    assert_equals(pickle_length, olm_pickle_inbound_group_session_binary(
+        session2, "secret_key", 10, pickle2.data(), pickle_length
+    ));
+    assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+    /* a wrong key or a truncated pickle fails the MAC check */
+    assert_equals((size_t)-1, olm_unpickle_inbound_group_session_binary(
+        session2, "secret_kez", 10, pickle2.data(), pickle_length
+    ));
+    assert_equals(
+        std::string("BAD_ACCOUNT_KEY"),
+        std::string(olm_inbound_group_session_last_error(session2))
+    );
+    pickle2 = pickle1;
+    assert_equals((size_t)-1, olm_unpickle_inbound_group_session_binary(
+        session2, "secret_key", 10, pickle2.data(), pickle_length - 1
+    ));
+    assert_equals(
+        std::string("BAD_ACCOUNT_KEY"),
+        std::string(olm_inbound_group_session_last_error(session2))
+    );
+
+    /* the outbound session round trips too */
+    pickle_length = olm_pickle_outbound_group_session_binary_length(outbound);
+    pickle1.resize(pickle_length);
+    assert_equals(pickle_length, olm_pickle_outbound_group_session_binary(
+        outbound, "secret_key", 10, pickle1.data(), pickle_length
+    ));
+    pickle2 = pickle1;
+    std::vector<uint8_t> outbound_memory2(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound2 = olm_outbound_group_session(
+        outbound_memory2.data()
+    );
+    assert_equals(pickle_length, olm_unpickle_outbound_group_session_binary(
+        outbound2, "secret_key", 10, pickle2.data(), pickle_length
+    ));
+    assert_equals(pickle_length, olm_pickle_outbound_group_session_binary(
+        outbound2, "secret_key", 10, pickle2.data(), pickle_length
+    ));
+    assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+}
+
 {
     TestCase test_case("Group message send/receive");
 
@@ -252,6 +488,212 @@ int main() {
     assert_equals(1, olm_inbound_group_session_is_verified(session2));
 }
 
+{
+    TestCase test_case("Inbound group session work budget");
+
+    uint8_t session_key[] =
+        "AgAAAAAwMTIzNDU2Nzg5QUJERUYwMTIzNDU2Nzg5QUJDREVGMDEyMzQ1Njc4OUFCREVGM"
+        "DEyMzQ1Njc4OUFCQ0RFRjAxMjM0NTY3ODlBQkRFRjAxMjM0NTY3ODlBQkNERUYwMTIzND"
+        "U2Nzg5QUJERUYwMTIzNDU2Nzg5QUJDREVGMDEyMw0bdg1BDq4Px/slBow06q8n/B9WBfw"
+        "WYyNOB8DlUmXGGwrFmaSb9bR/eY8xgERrxmP07hFmD9uqA2p8PMHdnV5ysmgufE6oLZ5+"
+        "8/mWQOW3VVTnDIlnwd8oHUYRuk8TCQ";
+
+    const uint8_t message[] =
+        "AwgAEhAcbh6UpbByoyZxufQ+h2B+8XHMjhR69G8F4+qjMaFlnIXusJZX3r8LnRORG9T3D"
+        "XFdbVuvIWrLyRfm4i8QRbe8VPwGRFG57B1CtmxanuP8bHtnnYqlwPsD";
+    const std::size_t msglen = sizeof(message)-1;
+
+    std::vector<uint8_t> session_memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *session =
+        olm_inbound_group_session(session_memory.data());
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key, sizeof(session_key)-1
+    ));
+    olm_inbound_group_session_set_work_budget(session, 100);
+
+    /* reaching index 255 takes 255 hashes */
+    std::vector<uint8_t> exported(
+        olm_export_inbound_group_session_length(session)
+    );
+    assert_equals((size_t)-1, olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 255
+    ));
+    assert_equals(
+        std::string("WORK_BUDGET_EXCEEDED"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+
+    /* a failed call leaves the ratchet where it was */
+    std::vector<uint8_t> msgcopy(message, message + msglen);
+    std::vector<uint8_t> plaintext_buf(
+        olm_group_decrypt_max_plaintext_length(session, msgcopy.data(), msglen)
+    );
+    uint32_t message_index;
+    memcpy(msgcopy.data(), message, msglen);
+    assert_equals((std::size_t)7, olm_group_decrypt(
+        session, msgcopy.data(), msglen,
+        plaintext_buf.data(), plaintext_buf.size(), &message_index
+    ));
+    assert_equals(uint32_t(0), message_index);
+
+    olm_inbound_group_session_set_work_budget(session, 0);
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 255
+    ));
+
+    /* earlier indexes are reached from the first known index */
+    olm_inbound_group_session_set_work_budget(session, 100);
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 50
+    ));
+    assert_equals((size_t)-1, olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 254
+    ));
+}
+
+{
+    TestCase test_case("Inbound group session checkpoints");
+
+    uint8_t session_key[] =
+        "AgAAAAAwMTIzNDU2Nzg5QUJERUYwMTIzNDU2Nzg5QUJDREVGMDEyMzQ1Njc4OUFCREVGM"
+        "DEyMzQ1Njc4OUFCQ0RFRjAxMjM0NTY3ODlBQkRFRjAxMjM0NTY3ODlBQkNERUYwMTIzND"
+        "U2Nzg5QUJERUYwMTIzNDU2Nzg5QUJDREVGMDEyMw0bdg1BDq4Px/slBow06q8n/B9WBfw"
+        "WYyNOB8DlUmXGGwrFmaSb9bR/eY8xgERrxmP07hFmD9uqA2p8PMHdnV5ysmgufE6oLZ5+"
+        "8/mWQOW3VVTnDIlnwd8oHUYRuk8TCQ";
+
+    std::vector<uint8_t> plain_memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *plain =
+        olm_inbound_group_session(plain_memory.data());
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        plain, session_key, sizeof(session_key)-1
+    ));
+
+    std::size_t size = olm_inbound_group_session_size_with_checkpoints(4);
+    assert_equals(olm_inbound_group_session_size() + 4 * 132, size);
+    std::vector<uint8_t> session_memory(size);
+    OlmInboundGroupSession *session = olm_inbound_group_session_with_checkpoints(
+        session_memory.data(), 4
+    );
+    assert_equals(size, olm_clear_inbound_group_session(session));
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key, sizeof(session_key)-1
+    ));
+
+    std::vector<uint8_t> expected(
+        olm_export_inbound_group_session_length(plain)
+    );
+    std::vector<uint8_t> exported(expected.size());
+
+    /* moving the latest ratchet to 0xff00 passes 0xfc00 to 0xff00 last */
+    assert_equals(expected.size(), olm_export_inbound_group_session(
+        plain, expected.data(), expected.size(), 0xff00
+    ));
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0xff00
+    ));
+
+    /* 0xfeff is 510 hashes from the first known index, but 255 from the
+     * checkpoint at 0xfe00 */
+    assert_equals(expected.size(), olm_export_inbound_group_session(
+        plain, expected.data(), expected.size(), 0xfeff
+    ));
+    olm_inbound_group_session_set_work_budget(plain, 300);
+    olm_inbound_group_session_set_work_budget(session, 300);
+    assert_equals((size_t)-1, olm_export_inbound_group_session(
+        plain, expected.data(), expected.size(), 0xfeff
+    ));
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0xfeff
+    ));
+    assert_equals(expected.data(), exported.data(), exported.size());
+
+    /* unpickling drops the checkpoints */
+    std::vector<uint8_t> pickled(
+        olm_pickle_inbound_group_session_length(session)
+    );
+    assert_equals(pickled.size(), olm_pickle_inbound_group_session(
+        session, "secret_key", 10, pickled.data(), pickled.size()
+    ));
+    assert_equals(pickled.size(), olm_unpickle_inbound_group_session(
+        session, "secret_key", 10, pickled.data(), pickled.size()
+    ));
+    olm_inbound_group_session_set_work_budget(session, 300);
+    assert_equals((size_t)-1, olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0xfeff
+    ));
+
+    /* and they are taken again when an older index is reached */
+    olm_inbound_group_session_set_work_budget(session, 0);
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0xfe01
+    ));
+    olm_inbound_group_session_set_work_budget(session, 300);
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0xfeff
+    ));
+    assert_equals(expected.data(), exported.data(), exported.size());
+}
+
+{
+    TestCase test_case("Inbound group session checkpoints within the work budget");
+
+    uint8_t session_key[] =
+        "AgAAAAAwMTIzNDU2Nzg5QUJERUYwMTIzNDU2Nzg5QUJDREVGMDEyMzQ1Njc4OUFCREVGM"
+        "DEyMzQ1Njc4OUFCQ0RFRjAxMjM0NTY3ODlBQkRFRjAxMjM0NTY3ODlBQkNERUYwMTIzND"
+        "U2Nzg5QUJERUYwMTIzNDU2Nzg5QUJDREVGMDEyMw0bdg1BDq4Px/slBow06q8n/B9WBfw"
+        "WYyNOB8DlUmXGGwrFmaSb9bR/eY8xgERrxmP07hFmD9uqA2p8PMHdnV5ysmgufE6oLZ5+"
+        "8/mWQOW3VVTnDIlnwd8oHUYRuk8TCQ";
+
+    std::vector<uint8_t> session_memory(
+        olm_inbound_group_session_size_with_checkpoints(256)
+    );
+    OlmInboundGroupSession *session = olm_inbound_group_session_with_checkpoints(
+        session_memory.data(), 256
+    );
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key, sizeof(session_key)-1
+    ));
+    std::vector<uint8_t> exported(
+        olm_export_inbound_group_session_length(session)
+    );
+
+    /* 0x10000 is 3 hashes away, but taking all 256 checkpoints on the way
+     * would take over 500, so none fit in the budget */
+    olm_inbound_group_session_set_work_budget(session, 10);
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0x10000
+    ));
+
+    /* so 0xfeff is still 510 hashes from the first known index */
+    olm_inbound_group_session_set_work_budget(session, 300);
+    assert_equals((size_t)-1, olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0xfeff
+    ));
+    assert_equals(
+        std::string("WORK_BUDGET_EXCEEDED"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+
+    /* a budget with room for some of them takes those that fit: going
+     * straight to 0x2000 takes 33 hashes, and each of the checkpoints up to
+     * 0x1100 another one */
+    olm_inbound_group_session_set_work_budget(session, 0);
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key, sizeof(session_key)-1
+    ));
+    olm_inbound_group_session_set_work_budget(session, 50);
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0x2000
+    ));
+    olm_inbound_group_session_set_work_budget(session, 256);
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0x11ff
+    ));
+    assert_equals((size_t)-1, olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0x12ff
+    ));
+}
+
 {
     TestCase test_case("Invalid signature group message");
 
@@ -324,4 +766,674 @@ int main() {
 }
 
 
+{
+    TestCase test_case("Inbound group session message key cache");
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> outbound_memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound =
+        olm_outbound_group_session(outbound_memory.data());
+    assert_equals((size_t)0, olm_init_outbound_group_session(
+        outbound, random_bytes, sizeof(random_bytes)
+    ));
+    std::vector<uint8_t> session_key(
+        olm_outbound_group_session_key_length(outbound)
+    );
+    olm_outbound_group_session_key(
+        outbound, session_key.data(), session_key.size()
+    );
+
+    /* messages 0 to 299 */
+    uint8_t plaintext[] = "Message";
+    std::vector<std::vector<uint8_t>> messages(300);
+    for (auto & message : messages) {
+        message.resize(olm_group_encrypt_message_length(outbound, 7));
+        assert_equals(message.size(), olm_group_encrypt(
+            outbound, plaintext, 7, message.data(), message.size()
+        ));
+    }
+
+    std::size_t size = olm_inbound_group_session_size_with_caches(0, 2);
+    assert_equals(olm_inbound_group_session_size() + 2 * 120, size);
+    std::vector<uint8_t> memory(size);
+    OlmInboundGroupSession *session =
+        olm_inbound_group_session_with_caches(memory.data(), 0, 2);
+    assert_equals(size, olm_clear_inbound_group_session(session));
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key.data(), session_key.size()
+    ));
+
+    std::vector<uint8_t> plaintext_buf(messages[299].size());
+    auto decrypt = [&](std::vector<uint8_t> const & message) {
+        std::vector<uint8_t> copy(message);
+        uint32_t message_index;
+        return olm_group_decrypt(
+            session, copy.data(), copy.size(),
+            plaintext_buf.data(), plaintext_buf.size(), &message_index
+        );
+    };
+
+    /* 255 is 255 hashes from the initial ratchet, once 299 has been seen */
+    assert_equals((size_t)7, decrypt(messages[299]));
+    assert_equals((size_t)7, decrypt(messages[255]));
+    assert_equals(plaintext, plaintext_buf.data(), 7);
+    olm_inbound_group_session_set_work_budget(session, 10);
+    assert_equals((size_t)7, decrypt(messages[255]));
+    assert_equals(plaintext, plaintext_buf.data(), 7);
+    assert_equals((size_t)-1, decrypt(messages[254]));
+    assert_equals(
+        std::string("WORK_BUDGET_EXCEEDED"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+
+    /* a different message with a cached index still has its signature
+     * checked */
+    std::vector<uint8_t> forged(messages[255]);
+    forged[forged.size() - 10] = forged[forged.size() - 10] == 'A' ? 'B' : 'A';
+    assert_equals((size_t)-1, decrypt(forged));
+    assert_equals(
+        std::string("BAD_SIGNATURE"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+
+    /* the least recently used keys are dropped: 299, then 253 */
+    olm_inbound_group_session_set_work_budget(session, 0);
+    assert_equals((size_t)7, decrypt(messages[253]));
+    assert_equals((size_t)7, decrypt(messages[255]));
+    assert_equals((size_t)7, decrypt(messages[254]));
+    olm_inbound_group_session_set_work_budget(session, 10);
+    assert_equals((size_t)7, decrypt(messages[255]));
+    assert_equals((size_t)7, decrypt(messages[254]));
+    assert_equals((size_t)-1, decrypt(messages[253]));
+
+    /* the cache is not pickled */
+    std::vector<uint8_t> pickled(
+        olm_pickle_inbound_group_session_length(session)
+    );
+    assert_equals(pickled.size(), olm_pickle_inbound_group_session(
+        session, "secret_key", 10, pickled.data(), pickled.size()
+    ));
+    assert_equals(pickled.size(), olm_unpickle_inbound_group_session(
+        session, "secret_key", 10, pickled.data(), pickled.size()
+    ));
+    assert_equals((size_t)-1, decrypt(messages[255]));
+}
+
+{
+    TestCase test_case("Group decrypt batch");
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> outbound_memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound =
+        olm_outbound_group_session(outbound_memory.data());
+    assert_equals((size_t)0, olm_init_outbound_group_session(
+        outbound, random_bytes, sizeof(random_bytes)
+    ));
+    std::vector<uint8_t> session_key(
+        olm_outbound_group_session_key_length(outbound)
+    );
+    olm_outbound_group_session_key(
+        outbound, session_key.data(), session_key.size()
+    );
+
+    /* messages 0 to 199, each with its index as the plain-text */
+    std::vector<std::vector<uint8_t>> messages(200);
+    for (std::size_t i = 0; i < messages.size(); i++) {
+        uint8_t plaintext = uint8_t(i);
+        messages[i].resize(olm_group_encrypt_message_length(outbound, 1));
+        assert_equals(messages[i].size(), olm_group_encrypt(
+            outbound, &plaintext, 1, messages[i].data(), messages[i].size()
+        ));
+    }
+
+    std::vector<uint8_t> memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *session =
+        olm_inbound_group_session(memory.data());
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key.data(), session_key.size()
+    ));
+
+    std::vector<uint8_t> latest(messages[199]);
+    std::vector<uint8_t> plaintext_buf(latest.size());
+    uint32_t message_index;
+    assert_equals((size_t)1, olm_group_decrypt(
+        session, latest.data(), latest.size(),
+        plaintext_buf.data(), plaintext_buf.size(), &message_index
+    ));
+
+    /* each of these is up to 170 hashes from the initial ratchet, but at most
+     * 40 from the one before it */
+    const std::size_t wanted[] = {130, 10, 199, 90, 170, 0, 50, 60, 3};
+    const std::size_t count = sizeof(wanted) / sizeof(wanted[0]);
+    std::vector<std::vector<uint8_t>> inputs(count);
+    std::vector<std::vector<uint8_t>> outputs(count);
+    uint8_t * input_pointers[count];
+    std::size_t input_lengths[count];
+    uint8_t * output_pointers[count];
+    std::size_t output_lengths[count];
+    for (std::size_t i = 0; i < count; i++) {
+        inputs[i] = messages[wanted[i]];
+        outputs[i].resize(inputs[i].size());
+        input_pointers[i] = inputs[i].data();
+        input_lengths[i] = inputs[i].size();
+        output_pointers[i] = outputs[i].data();
+        output_lengths[i] = outputs[i].size();
+    }
+    /* the last two have a length that is not valid base64 and a bad
+     * signature */
+    input_lengths[7] = 1;
+    inputs[8][inputs[8].size() - 10] =
+        inputs[8][inputs[8].size() - 10] == 'A' ? 'B' : 'A';
+
+    std::size_t results[count];
+    uint32_t indexes[count];
+    const char * errors[count];
+    olm_inbound_group_session_set_work_budget(session, 45);
+    assert_equals(count - 2, olm_group_decrypt_batch(
+        session, count, input_pointers, input_lengths,
+        output_pointers, output_lengths, results, indexes, errors
+    ));
+    for (std::size_t i = 0; i < count - 2; i++) {
+        assert_equals((size_t)1, results[i]);
+        assert_equals(uint32_t(wanted[i]), indexes[i]);
+        assert_equals(uint8_t(wanted[i]), outputs[i][0]);
+        assert_equals(true, errors[i] == NULL);
+    }
+    assert_equals((size_t)-1, results[7]);
+    assert_equals(std::string("INVALID_BASE64"), std::string(errors[7]));
+    assert_equals((size_t)-1, results[8]);
+    assert_equals(std::string("BAD_SIGNATURE"), std::string(errors[8]));
+    assert_equals(
+        std::string("BAD_SIGNATURE"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+
+    /* on its own, 170 is over the budget */
+    std::vector<uint8_t> single(messages[170]);
+    assert_equals((size_t)-1, olm_group_decrypt(
+        session, single.data(), single.size(),
+        plaintext_buf.data(), plaintext_buf.size(), &message_index
+    ));
+    assert_equals(
+        std::string("WORK_BUDGET_EXCEEDED"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+}
+
+{
+    TestCase test_case("Read-only group decrypt");
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> outbound_memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound =
+        olm_outbound_group_session(outbound_memory.data());
+    assert_equals((size_t)0, olm_init_outbound_group_session(
+        outbound, random_bytes, sizeof(random_bytes)
+    ));
+    std::vector<uint8_t> session_key(
+        olm_outbound_group_session_key_length(outbound)
+    );
+    olm_outbound_group_session_key(
+        outbound, session_key.data(), session_key.size()
+    );
+
+    /* messages 0 to 9, each with its index as the plain-text */
+    std::vector<std::vector<uint8_t>> messages(10);
+    for (std::size_t i = 0; i < messages.size(); i++) {
+        uint8_t plaintext = uint8_t(i);
+        messages[i].resize(olm_group_encrypt_message_length(outbound, 1));
+        assert_equals(messages[i].size(), olm_group_encrypt(
+            outbound, &plaintext, 1, messages[i].data(), messages[i].size()
+        ));
+    }
+
+    /* an unverified session, from an export of the session key */
+    std::vector<uint8_t> memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *session =
+        olm_inbound_group_session(memory.data());
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key.data(), session_key.size()
+    ));
+    std::vector<uint8_t> exported(
+        olm_export_inbound_group_session_length(session)
+    );
+    assert_equals(exported.size(), olm_export_inbound_group_session(
+        session, exported.data(), exported.size(), 0
+    ));
+    session = olm_inbound_group_session(memory.data());
+    assert_equals((size_t)0, olm_import_inbound_group_session(
+        session, exported.data(), exported.size()
+    ));
+    assert_equals(0, olm_inbound_group_session_is_verified(session));
+
+    std::vector<uint8_t> before(
+        olm_pickle_inbound_group_session_length(session)
+    );
+    assert_equals(before.size(), olm_pickle_inbound_group_session(
+        session, "secret_key", 10, before.data(), before.size()
+    ));
+
+    std::vector<uint8_t> scratch_memory(olm_group_decrypt_scratch_size());
+    OlmGroupDecryptScratch *scratch =
+        olm_group_decrypt_scratch(scratch_memory.data());
+
+    /* a commit before anything has been decrypted does nothing */
+    assert_equals((size_t)0, olm_inbound_group_session_commit_ratchet(
+        session, scratch
+    ));
+
+    const std::size_t order[] = {5, 3, 4};
+    for (std::size_t i : order) {
+        std::vector<uint8_t> message(messages[i]);
+        uint8_t plaintext[16];
+        uint32_t message_index;
+        assert_equals((size_t)1, olm_group_decrypt_read_only(
+            session, scratch, message.data(), message.size(),
+            plaintext, sizeof(plaintext), &message_index
+        ));
+        assert_equals(uint32_t(i), message_index);
+        assert_equals(uint8_t(i), plaintext[0]);
+    }
+
+    std::vector<uint8_t> forged(messages[6]);
+    forged[forged.size() - 10] = forged[forged.size() - 10] == 'A' ? 'B' : 'A';
+    uint8_t plaintext[16];
+    uint32_t message_index;
+    assert_equals((size_t)-1, olm_group_decrypt_read_only(
+        session, scratch, forged.data(), forged.size(),
+        plaintext, sizeof(plaintext), &message_index
+    ));
+    assert_equals(
+        std::string("BAD_SIGNATURE"),
+        std::string(olm_group_decrypt_scratch_last_error(scratch))
+    );
+
+    /* none of that changed the session */
+    std::vector<uint8_t> after(before.size());
+    assert_equals(after.size(), olm_pickle_inbound_group_session(
+        session, "secret_key", 10, after.data(), after.size()
+    ));
+    assert_equals(before.data(), after.data(), before.size());
+    assert_equals(0, olm_inbound_group_session_is_verified(session));
+
+    /* committing moves the latest ratchet on to 5, so 6 is one hash away */
+    assert_equals((size_t)0, olm_inbound_group_session_commit_ratchet(
+        session, scratch
+    ));
+    assert_equals(1, olm_inbound_group_session_is_verified(session));
+    olm_inbound_group_session_set_work_budget(session, 1);
+    std::vector<uint8_t> message(messages[6]);
+    assert_equals((size_t)1, olm_group_decrypt(
+        session, message.data(), message.size(),
+        plaintext, sizeof(plaintext), &message_index
+    ));
+    assert_equals(uint8_t(6), plaintext[0]);
+
+    /* the scratch space can't be committed to another session */
+    std::vector<uint8_t> other_outbound_memory(
+        olm_outbound_group_session_size()
+    );
+    OlmOutboundGroupSession *other_outbound =
+        olm_outbound_group_session(other_outbound_memory.data());
+    random_bytes[0] ^= 1;
+    assert_equals((size_t)0, olm_init_outbound_group_session(
+        other_outbound, random_bytes, sizeof(random_bytes)
+    ));
+    std::vector<uint8_t> other_key(
+        olm_outbound_group_session_key_length(other_outbound)
+    );
+    olm_outbound_group_session_key(
+        other_outbound, other_key.data(), other_key.size()
+    );
+    std::vector<uint8_t> other_memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *other =
+        olm_inbound_group_session(other_memory.data());
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        other, other_key.data(), other_key.size()
+    ));
+    assert_equals((size_t)-1, olm_inbound_group_session_commit_ratchet(
+        other, scratch
+    ));
+    assert_equals(
+        std::string("BAD_SESSION_KEY"),
+        std::string(olm_inbound_group_session_last_error(other))
+    );
+
+    assert_equals(
+        olm_group_decrypt_scratch_size(),
+        olm_clear_group_decrypt_scratch(scratch)
+    );
+}
+
+{
+    TestCase test_case("Deferred group signature verification");
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> outbound_memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound =
+        olm_outbound_group_session(outbound_memory.data());
+    assert_equals((size_t)0, olm_init_outbound_group_session(
+        outbound, random_bytes, sizeof(random_bytes)
+    ));
+    std::vector<uint8_t> session_key(
+        olm_outbound_group_session_key_length(outbound)
+    );
+    olm_outbound_group_session_key(
+        outbound, session_key.data(), session_key.size()
+    );
+
+    /* messages 0 to 4, each with its index as the plain-text */
+    std::vector<std::vector<uint8_t>> messages(5);
+    for (std::size_t i = 0; i < messages.size(); i++) {
+        uint8_t plaintext = uint8_t(i);
+        messages[i].resize(olm_group_encrypt_message_length(outbound, 1));
+        assert_equals(messages[i].size(), olm_group_encrypt(
+            outbound, &plaintext, 1, messages[i].data(), messages[i].size()
+        ));
+    }
+    /* message 3 has a bad signature */
+    messages[3][messages[3].size() - 10] =
+        messages[3][messages[3].size() - 10] == 'A' ? 'B' : 'A';
+
+    std::size_t size = olm_inbound_group_session_size_with_caches(0, 4);
+    std::vector<uint8_t> memory(size);
+    OlmInboundGroupSession *session =
+        olm_inbound_group_session_with_caches(memory.data(), 0, 4);
+    assert_equals((size_t)0, olm_init_inbound_group_session(
+        session, session_key.data(), session_key.size()
+    ));
+
+    assert_equals(
+        olm_group_verify_queue_size(0) + 4 * (128 + sizeof(void *)),
+        olm_group_verify_queue_size(4)
+    );
+    std::vector<uint8_t> queue_memory(olm_group_verify_queue_size(4));
+    OlmGroupVerifyQueue *queue =
+        olm_group_verify_queue(queue_memory.data(), 4);
+    std::vector<uint8_t> scratch_memory(olm_group_decrypt_scratch_size());
+    OlmGroupDecryptScratch *scratch =
+        olm_group_decrypt_scratch(scratch_memory.data());
+
+    /* the session is left alone until the checks have passed */
+    auto pickle_session = [](OlmInboundGroupSession *session) {
+        std::vector<uint8_t> pickle(
+            olm_pickle_inbound_group_session_length(session)
+        );
+        olm_pickle_inbound_group_session(
+            session, "", 0, pickle.data(), pickle.size()
+        );
+        return pickle;
+    };
+    std::vector<uint8_t> initial_pickle(pickle_session(session));
+    std::vector<uint8_t> initial_memory(memory);
+
+    uint8_t plaintext[16];
+    uint32_t message_index;
+    std::size_t position;
+    for (std::size_t i = 0; i < 4; i++) {
+        std::vector<uint8_t> message(messages[i]);
+        assert_equals((size_t)1, olm_group_decrypt_deferred(
+            session, scratch, queue, message.data(), message.size(),
+            plaintext, sizeof(plaintext), &message_index, &position
+        ));
+        assert_equals(uint8_t(i), plaintext[0]);
+        assert_equals(i, position);
+    }
+    assert_equals((size_t)4, olm_group_verify_queue_length(queue));
+
+    assert_equals(initial_memory.data(), memory.data(), size);
+
+    /* nor can it be committed before the checks are done */
+    assert_equals((size_t)-1, olm_inbound_group_session_commit_ratchet(
+        session, scratch
+    ));
+    assert_equals(
+        std::string("BAD_SIGNATURE"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+    assert_equals(
+        initial_pickle.data(), pickle_session(session).data(),
+        initial_pickle.size()
+    );
+
+    std::vector<uint8_t> message(messages[4]);
+    assert_equals((size_t)-1, olm_group_decrypt_deferred(
+        session, scratch, queue, message.data(), message.size(),
+        plaintext, sizeof(plaintext), &message_index, &position
+    ));
+    assert_equals(
+        std::string("VERIFY_QUEUE_FULL"),
+        std::string(olm_group_decrypt_scratch_last_error(scratch))
+    );
+
+    int results[4];
+    assert_equals((size_t)-1, olm_group_verify_flush(queue, results, 3));
+    assert_equals(
+        std::string("OUTPUT_BUFFER_TOO_SMALL"),
+        std::string(olm_group_verify_queue_last_error(queue))
+    );
+    assert_equals((size_t)1, olm_group_verify_flush(queue, results, 4));
+    assert_equals(1, results[0] ? 1 : 0);
+    assert_equals(1, results[1] ? 1 : 0);
+    assert_equals(1, results[2] ? 1 : 0);
+    assert_equals(0, results[3] ? 1 : 0);
+    assert_equals((size_t)0, olm_group_verify_queue_length(queue));
+
+    /* the forged message failed, so the scratch space can't be committed and
+     * the session has neither moved on nor cached any keys */
+    assert_equals((size_t)-1, olm_inbound_group_session_commit_ratchet(
+        session, scratch
+    ));
+    assert_equals(
+        std::string("BAD_SIGNATURE"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+    assert_equals(
+        initial_pickle.data(), pickle_session(session).data(),
+        initial_pickle.size()
+    );
+
+    /* nor was the bad signature remembered as checked, so a normal decrypt
+     * still catches it */
+    message = messages[3];
+    assert_equals((size_t)-1, olm_group_decrypt(
+        session, message.data(), message.size(),
+        plaintext, sizeof(plaintext), &message_index
+    ));
+    assert_equals(
+        std::string("BAD_SIGNATURE"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+
+    /* once every check has passed the ratchet can be committed */
+    olm_clear_group_decrypt_scratch(scratch);
+    for (std::size_t i = 0; i < 3; i++) {
+        message = messages[i];
+        assert_equals((size_t)1, olm_group_decrypt_deferred(
+            session, scratch, queue, message.data(), message.size(),
+            plaintext, sizeof(plaintext), &message_index, &position
+        ));
+        assert_equals(i, position);
+    }
+    assert_equals((size_t)0, olm_group_verify_flush(queue, results, 4));
+    assert_equals((size_t)0, olm_inbound_group_session_commit_ratchet(
+        session, scratch
+    ));
+
+    /* a message whose signature has been checked before needs no check */
+    message = messages[0];
+    assert_equals((size_t)1, olm_group_decrypt(
+        session, message.data(), message.size(),
+        plaintext, sizeof(plaintext), &message_index
+    ));
+    message = messages[0];
+    assert_equals((size_t)1, olm_group_decrypt_deferred(
+        session, scratch, queue, message.data(), message.size(),
+        plaintext, sizeof(plaintext), &message_index, &position
+    ));
+    assert_equals((size_t)-1, position);
+    assert_equals((size_t)0, olm_group_verify_queue_length(queue));
+
+    assert_equals(
+        olm_group_verify_queue_size(4), olm_clear_group_verify_queue(queue)
+    );
+}
+
+{
+    TestCase test_case("Group encrypt batch");
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    /* four copies of the same session, at index 126 so that the batch
+     * crosses the index where the message header grows */
+    std::vector<uint8_t> memory[4];
+    OlmOutboundGroupSession *sessions[4];
+    for (int s = 0; s < 4; s++) {
+        memory[s].resize(olm_outbound_group_session_size());
+        sessions[s] = olm_outbound_group_session(memory[s].data());
+        /* olm_init_outbound_group_session clears the random bytes */
+        std::vector<uint8_t> random(
+            random_bytes, random_bytes + sizeof(random_bytes)
+        );
+        assert_equals((size_t)0, olm_init_outbound_group_session(
+            sessions[s], random.data(), random.size()
+        ));
+        for (int i = 0; i < 126; i++) {
+            uint8_t message[256];
+            assert_equals(
+                olm_group_encrypt_message_length(sessions[s], 1),
+                olm_group_encrypt(sessions[s], (uint8_t const *)"x", 1,
+                    message, sizeof(message)
+                )
+            );
+        }
+    }
+
+    const std::size_t count = 4;
+    uint8_t const * plaintexts[count] = {
+        (uint8_t const *)"one", (uint8_t const *)"two",
+        (uint8_t const *)"three, which is longer than a block",
+        (uint8_t const *)"four"
+    };
+    std::size_t plaintext_lengths[count] = {3, 3, 35, 4};
+
+    /* sequential calls */
+    std::vector<uint8_t> expected[count];
+    for (std::size_t i = 0; i < count; i++) {
+        expected[i].resize(olm_group_encrypt_message_length(
+            sessions[0], plaintext_lengths[i]
+        ));
+        assert_equals(expected[i].size(), olm_group_encrypt(
+            sessions[0], plaintexts[i], plaintext_lengths[i],
+            expected[i].data(), expected[i].size()
+        ));
+    }
+
+    /* a batch, which fails as a whole if a buffer is too small */
+    std::vector<uint8_t> outputs[count];
+    uint8_t * output_pointers[count];
+    std::size_t max_lengths[count];
+    std::size_t lengths[count];
+    for (std::size_t i = 0; i < count; i++) {
+        outputs[i].resize(expected[i].size());
+        output_pointers[i] = outputs[i].data();
+        max_lengths[i] = outputs[i].size();
+    }
+    max_lengths[3]--;
+    assert_equals((size_t)-1, olm_group_encrypt_batch(
+        sessions[1], count, plaintexts, plaintext_lengths,
+        output_pointers, max_lengths, lengths
+    ));
+    assert_equals(
+        std::string("OUTPUT_BUFFER_TOO_SMALL"),
+        std::string(olm_outbound_group_session_last_error(sessions[1]))
+    );
+    assert_equals(126U, olm_outbound_group_session_message_index(sessions[1]));
+    max_lengths[3]++;
+    assert_equals(count, olm_group_encrypt_batch(
+        sessions[1], count, plaintexts, plaintext_lengths,
+        output_pointers, max_lengths, lengths
+    ));
+    assert_equals(130U, olm_outbound_group_session_message_index(sessions[1]));
+    for (std::size_t i = 0; i < count; i++) {
+        assert_equals(expected[i].size(), lengths[i]);
+        assert_equals(expected[i].data(), outputs[i].data(), lengths[i]);
+    }
+
+    /* the same batch split across threads */
+    for (std::size_t i = 0; i < count; i++) {
+        std::fill(outputs[i].begin(), outputs[i].end(), 0);
+    }
+    assert_equals(count, olm_group_encrypt_batch_parallel(
+        sessions[3], count, plaintexts, plaintext_lengths,
+        output_pointers, max_lengths, lengths, 3
+    ));
+    assert_equals(130U, olm_outbound_group_session_message_index(sessions[3]));
+    for (std::size_t i = 0; i < count; i++) {
+        assert_equals(expected[i].size(), lengths[i]);
+        assert_equals(expected[i].data(), outputs[i].data(), lengths[i]);
+    }
+
+    /* reservations, used in reverse order */
+    std::size_t reservation_size = olm_group_encrypt_reservation_size();
+    std::vector<uint8_t> reservations(count * reservation_size);
+    assert_equals(count, olm_group_encrypt_reserve(
+        sessions[2], count, reservations.data(), reservations.size()
+    ));
+    assert_equals(130U, olm_outbound_group_session_message_index(sessions[2]));
+    for (std::size_t i = count; i-- > 0;) {
+        uint8_t * reservation = reservations.data() + i * reservation_size;
+        std::size_t length = olm_group_encrypt_reserved_message_length(
+            reservation, plaintext_lengths[i]
+        );
+        assert_equals(expected[i].size(), length);
+        std::vector<uint8_t> output(length);
+        assert_equals((size_t)-1, olm_group_encrypt_reserved(
+            sessions[2], reservation, plaintexts[i], plaintext_lengths[i],
+            output.data(), length - 1
+        ));
+        assert_equals(length, olm_group_encrypt_reserved(
+            sessions[2], reservation, plaintexts[i], plaintext_lengths[i],
+            output.data(), length
+        ));
+        assert_equals(expected[i].data(), output.data(), length);
+    }
+    std::vector<uint8_t> cleared(reservations.size());
+    assert_equals(cleared.data(), reservations.data(), reservations.size());
+}
+
 }
@@ -0,0 +1,249 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/key_store.hh"
+#include "olm/ratchet.hh"
+#include "unittest.hh"
+
+#include <vector>
+
+namespace {
+
+/* A distinct public key for each n. Keys with the same n % 8 share their
+ * first four bytes, and so their place in the index. */
+_olm_curve25519_public_key make_key(std::uint32_t n, bool collide) {
+    _olm_curve25519_public_key key = {};
+    std::uint32_t head = collide ? n % 8 : n * 2654435761u;
+    for (unsigned i = 0; i < 4; ++i) {
+        key.public_key[i] = std::uint8_t(head >> (8 * i));
+        key.public_key[4 + i] = std::uint8_t(n >> (8 * i));
+    }
+    return key;
+}
+
+void add_key(olm::OneTimeKeyStore & store, std::uint32_t n, bool collide) {
+    olm::OneTimeKey * key = store.push_newest();
+    key->id = n;
+    key->key.public_key = make_key(n, collide);
+    store.add_to_index(key);
+}
+
+void add_skipped_key(
+    olm::SkippedMessageKeyStore & store, std::uint32_t n, bool collide
+) {
+    olm::SkippedMessageKey * key = store.push_newest();
+    key->ratchet_key = make_key(n / 10, collide);
+    key->message_key.index = n;
+    store.add_to_index(key);
+}
+
+bool has_skipped_key(
+    olm::SkippedMessageKeyStore & store, std::uint32_t n, bool collide
+) {
+    return store.find(make_key(n / 10, collide).public_key, n) != nullptr;
+}
+
+} // namespace
+
+int main() {
+
+for (bool collide : {false, true}) {
+
+TestCase test_case(
+    collide ? "One time key store with collisions" : "One time key store"
+);
+
+std::size_t const capacity = 300;
+std::vector<std::uint32_t> storage(
+    olm::OneTimeKeyStore::storage_size(capacity) / sizeof(std::uint32_t)
+);
+olm::OneTimeKeyStore store;
+store.init(storage.data(), capacity);
+assert_equals(capacity, store.capacity());
+assert_equals(std::size_t(0), store.size());
+
+/* the oldest keys are discarded once the store is full */
+for (std::uint32_t n = 0; n < 1000; ++n) {
+    add_key(store, n, collide);
+}
+assert_equals(capacity, store.size());
+for (std::uint32_t n = 0; n < 1000; ++n) {
+    olm::OneTimeKey const * key = store.find(make_key(n, collide));
+    assert_equals(n >= 700, key != nullptr);
+    if (key) {
+        assert_equals(n, key->id);
+    }
+}
+
+/* newest first */
+std::uint32_t expected = 1000;
+for (olm::OneTimeKey const & key : store) {
+    assert_equals(--expected, key.id);
+}
+assert_equals(std::uint32_t(700), expected);
+
+for (std::uint32_t n = 700; n < 1000; n += 2) {
+    store.set_published(store.find(make_key(n, collide)), true);
+}
+for (std::uint32_t n = 700; n < 1000; n += 3) {
+    store.erase(store.find(make_key(n, collide)));
+}
+assert_equals(std::size_t(200), store.size());
+for (std::uint32_t n = 700; n < 1000; ++n) {
+    olm::OneTimeKey const * key = store.find(make_key(n, collide));
+    assert_equals(n % 3 != 700 % 3, key != nullptr);
+    if (key) {
+        assert_equals(n, key->id);
+        assert_equals(n % 2 == 0, store.is_published(key));
+    }
+}
+
+/* erased slots are reused before anything else is discarded, and come
+ * back unpublished */
+for (std::uint32_t n = 1000; n < 1100; ++n) {
+    add_key(store, n, collide);
+}
+assert_equals(capacity, store.size());
+assert_equals(true, store.find(make_key(701, collide)) != nullptr);
+for (std::uint32_t n = 1000; n < 1100; ++n) {
+    assert_equals(false, store.is_published(store.find(make_key(n, collide))));
+}
+
+/* push_oldest appends behind the oldest key until the store is full */
+store.clear();
+assert_equals(std::size_t(0), store.size());
+assert_equals(true, store.find(make_key(1099, collide)) == nullptr);
+for (std::uint32_t n = 0; n < capacity; ++n) {
+    olm::OneTimeKey * key = store.push_oldest();
+    key->id = n;
+    key->key.public_key = make_key(n, collide);
+    store.add_to_index(key);
+}
+assert_equals(true, store.push_oldest() == nullptr);
+expected = 0;
+for (olm::OneTimeKey const & key : store) {
+    assert_equals(expected++, key.id);
+}
+
+}
+
+for (bool collide : {false, true}) {
+
+TestCase test_case(
+    collide ? "Skipped message key store with collisions"
+        : "Skipped message key store"
+);
+
+std::size_t const capacity = 50;
+std::vector<std::uint32_t> storage(
+    olm::SkippedMessageKeyStore::storage_size(capacity) / sizeof(std::uint32_t)
+);
+olm::SkippedMessageKeyStore store;
+store.init(storage.data(), capacity);
+assert_equals(capacity, store.capacity());
+assert_equals(std::size_t(0), store.size());
+
+/* the oldest keys are discarded once the ring is full */
+for (std::uint32_t n = 0; n < 120; ++n) {
+    add_skipped_key(store, n, collide);
+}
+assert_equals(capacity, store.size());
+for (std::uint32_t n = 0; n < 120; ++n) {
+    assert_equals(n >= 70, has_skipped_key(store, n, collide));
+}
+/* the same message index under a different ratchet key isn't found */
+assert_equals(
+    true, store.find(make_key(1000, collide).public_key, 100) == nullptr
+);
+
+/* erasing the ends trims the ring, erasing the middle leaves holes */
+for (std::uint32_t n : {70u, 119u, 80u, 81u, 100u}) {
+    store.erase(store.find(make_key(n / 10, collide).public_key, n));
+}
+assert_equals(capacity - 5, store.size());
+std::uint32_t expected = 119;
+for (olm::SkippedMessageKey const & key : store) {
+    while (--expected == 80 || expected == 81 || expected == 100) {}
+    assert_equals(expected, key.message_key.index);
+}
+assert_equals(std::uint32_t(71), expected);
+
+/* the two slots freed at the ends are used before any key is discarded */
+add_skipped_key(store, 200, collide);
+add_skipped_key(store, 201, collide);
+assert_equals(capacity - 3, store.size());
+assert_equals(true, has_skipped_key(store, 71, collide));
+
+/* the holes are filled before any key is discarded, and then the oldest
+ * keys go first */
+for (std::uint32_t n = 202; n < 205; ++n) {
+    add_skipped_key(store, n, collide);
+}
+assert_equals(capacity, store.size());
+assert_equals(true, has_skipped_key(store, 71, collide));
+for (std::uint32_t n = 205; n < 214; ++n) {
+    add_skipped_key(store, n, collide);
+}
+assert_equals(capacity, store.size());
+assert_equals(false, has_skipped_key(store, 79, collide));
+assert_equals(true, has_skipped_key(store, 82, collide));
+expected = 214;
+for (olm::SkippedMessageKey const & key : store) {
+    while (--expected == 100 || (expected > 118 && expected < 200)) {}
+    assert_equals(expected, key.message_key.index);
+    assert_equals(true, has_skipped_key(store, expected, collide));
+}
+assert_equals(std::uint32_t(82), expected);
+
+/* keys erased from the middle of a full ring don't count against the
+ * capacity */
+store.clear();
+for (std::uint32_t n = 0; n < capacity; ++n) {
+    add_skipped_key(store, n, collide);
+}
+for (std::uint32_t n = 1; n < capacity - 1; ++n) {
+    store.erase(store.find(make_key(n / 10, collide).public_key, n));
+}
+assert_equals(std::size_t(2), store.size());
+for (std::uint32_t n = capacity; n < 2 * capacity - 2; ++n) {
+    add_skipped_key(store, n, collide);
+    assert_equals(true, has_skipped_key(store, 0, collide));
+}
+assert_equals(capacity, store.size());
+add_skipped_key(store, 2 * capacity, collide);
+assert_equals(false, has_skipped_key(store, 0, collide));
+assert_equals(true, has_skipped_key(store, capacity - 1, collide));
+
+/* push_oldest fills the ring from the back */
+store.clear();
+assert_equals(std::size_t(0), store.size());
+assert_equals(false, has_skipped_key(store, 214, collide));
+for (std::uint32_t n = 0; n < capacity; ++n) {
+    olm::SkippedMessageKey * key = store.push_oldest();
+    key->ratchet_key = make_key(n / 10, collide);
+    key->message_key.index = n;
+    store.add_to_index(key);
+}
+assert_equals(true, store.push_oldest() == nullptr);
+expected = 0;
+for (olm::SkippedMessageKey const & key : store) {
+    assert_equals(expected++, key.message_key.index);
+}
+for (std::uint32_t n = 0; n < capacity; ++n) {
+    assert_equals(true, has_skipped_key(store, n, collide));
+}
+
+}
+
+}
@@ -66,6 +66,40 @@ for (auto item : test_list) {
 } /** List insert test **/
 
 
+{ /** List insert many test **/
+
+TestCase test_case("List insert many");
+
+olm::List<int, 6> test_list;
+
+for (int i = 0; i < 3; ++i) {
+    test_list.insert(test_list.end(), i);
+}
+
+/* 0 1 2 -> 0 x x 1 2 */
+assert_equals(std::size_t(2), test_list.insert_many(test_list.begin() + 1, 2));
+assert_equals(std::size_t(5), test_list.size());
+assert_equals(0, test_list[0]);
+assert_equals(1, test_list[3]);
+assert_equals(2, test_list[4]);
+
+/* the end of the list is discarded */
+test_list[1] = 10;
+test_list[2] = 11;
+assert_equals(std::size_t(3), test_list.insert_many(test_list.begin(), 3));
+assert_equals(std::size_t(6), test_list.size());
+assert_equals(0, test_list[3]);
+assert_equals(10, test_list[4]);
+assert_equals(11, test_list[5]);
+
+/* only the space after the position is made */
+assert_equals(std::size_t(2), test_list.insert_many(test_list.begin() + 4, 5));
+assert_equals(std::size_t(6), test_list.size());
+assert_equals(0, test_list[3]);
+
+} /** List insert many test **/
+
+
 { /** List erase test **/
 TestCase test_case("List erase");
 
@@ -82,6 +82,31 @@ std::uint8_t random_bytes[] =
     assert_equals(expected3, megolm_get_data(&mr), MEGOLM_RATCHET_LENGTH);
 }
 
+{
+    TestCase test_case("Megolm::advance_cost");
+
+    Megolm mr;
+    megolm_init(&mr, random_bytes, 0);
+
+    assert_equals(0U, megolm_advance_cost(&mr, 0));
+    assert_equals(1U, megolm_advance_cost(&mr, 1));
+    assert_equals(255U, megolm_advance_cost(&mr, 255));
+    assert_equals(2U, megolm_advance_cost(&mr, 256));
+    assert_equals(4U, megolm_advance_cost(&mr, 0x1000000));
+
+    /* R(1) three more times then R(1)..R(3), R(2) twenty more times then
+     * R(2)..R(3), and R(3) five more times then R(3) */
+    megolm_advance_to(&mr, 0x1000000);
+    assert_equals(34U, megolm_advance_cost(&mr, 0x1041506));
+
+    /* going backwards wraps R(0) all the way round */
+    megolm_advance_to(&mr, 0x1041506);
+    assert_equals(
+        255U + 4U + 3U + 3U + 20U + 2U + 4U + 1U,
+        megolm_advance_cost(&mr, 0x1041505)
+    );
+}
+
 {
     TestCase test_case("Megolm::advance wraparound");
 
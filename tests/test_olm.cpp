@@ -1,4 +1,5 @@
 #include "olm/olm.h"
+#include "olm/pickle_encoding.h"
 #include "unittest.hh"
 
 #include <cstddef>
@@ -68,6 +69,186 @@ assert_equals(pickle1.data(), pickle2.data(), pickle_length);
 }
 
 
+{ /** Pickle account with prepared key test */
+
+TestCase test_case("Pickle account with prepared key test");
+MockRandom mock_random('P');
+
+std::vector<std::uint8_t> account_buffer(::olm_account_size());
+::OlmAccount *account = ::olm_account(account_buffer.data());
+std::vector<std::uint8_t> random(::olm_create_account_random_length(account));
+mock_random(random.data(), random.size());
+::olm_create_account(account, random.data(), random.size());
+
+std::vector<std::uint8_t> key_buffer(::olm_pickle_key_size());
+::OlmPickleKey *pickle_key = ::olm_pickle_key(key_buffer.data(), "secret_key", 10);
+
+std::size_t pickle_length = ::olm_pickle_account_length(account);
+std::vector<std::uint8_t> pickle1(pickle_length);
+std::vector<std::uint8_t> pickle2(pickle_length);
+::olm_pickle_account(account, "secret_key", 10, pickle1.data(), pickle_length);
+std::size_t res = ::olm_pickle_account_with_key(
+    account, pickle_key, pickle2.data(), pickle_length
+);
+assert_equals(pickle_length, res);
+assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+std::vector<std::uint8_t> account_buffer2(::olm_account_size());
+::OlmAccount *account2 = ::olm_account(account_buffer2.data());
+res = ::olm_unpickle_account_with_key(
+    account2, pickle_key, pickle2.data(), pickle_length
+);
+assert_equals(pickle_length, res);
+::olm_pickle_account(account2, "secret_key", 10, pickle2.data(), pickle_length);
+assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+res = ::olm_pickle_account_with_key(account2, pickle_key, pickle2.data(), pickle_length - 1);
+assert_equals(std::size_t(-1), res);
+assert_equals(
+    std::string("OUTPUT_BUFFER_TOO_SMALL"),
+    std::string(::olm_account_last_error(account2))
+);
+
+::olm_clear_pickle_key(pickle_key);
+}
+
+
+{ /** Pickle account with AES-GCM key test */
+
+TestCase test_case("Pickle account with AES-GCM key test");
+MockRandom mock_random('G');
+
+std::vector<std::uint8_t> account_buffer(::olm_account_size());
+::OlmAccount *account = ::olm_account(account_buffer.data());
+std::vector<std::uint8_t> random(::olm_create_account_random_length(account));
+mock_random(random.data(), random.size());
+::olm_create_account(account, random.data(), random.size());
+
+std::vector<std::uint8_t> key_buffer(::olm_pickle_key_size());
+::OlmPickleKey *pickle_key = ::olm_pickle_key_aes_gcm(
+    key_buffer.data(), "secret_key", 10
+);
+
+std::size_t cbc_length = ::olm_pickle_account_length(account);
+std::vector<std::uint8_t> cbc_pickle(cbc_length);
+::olm_pickle_account(account, "secret_key", 10, cbc_pickle.data(), cbc_length);
+
+std::size_t pickle_length = ::olm_pickle_account_with_key_length(account, pickle_key);
+std::vector<std::uint8_t> pickle1(pickle_length);
+std::vector<std::uint8_t> pickle2(pickle_length);
+std::size_t res = ::olm_pickle_account_with_key(
+    account, pickle_key, pickle1.data(), pickle_length - 1
+);
+assert_equals(std::size_t(-1), res);
+assert_equals(
+    std::string("OUTPUT_BUFFER_TOO_SMALL"),
+    std::string(::olm_account_last_error(account))
+);
+res = ::olm_pickle_account_with_key(account, pickle_key, pickle1.data(), pickle_length);
+assert_equals(pickle_length, res);
+/* the nonce is derived from the pickle, so pickling again gives the same */
+::olm_pickle_account_with_key(account, pickle_key, pickle2.data(), pickle_length);
+assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+/* the pickle loads with the key, and with the AES-GCM pickle key */
+std::vector<std::uint8_t> account_buffer2(::olm_account_size());
+::OlmAccount *account2 = ::olm_account(account_buffer2.data());
+std::vector<std::uint8_t> output(cbc_length);
+for (int i = 0; i < 2; ++i) {
+    std::vector<std::uint8_t> copy(pickle1);
+    res = i == 0
+        ? ::olm_unpickle_account(account2, "secret_key", 10, copy.data(), pickle_length)
+        : ::olm_unpickle_account_with_key(
+            account2, pickle_key, copy.data(), pickle_length
+        );
+    assert_equals(pickle_length, res);
+    ::olm_pickle_account(account2, "secret_key", 10, output.data(), cbc_length);
+    assert_equals(cbc_pickle.data(), output.data(), cbc_length);
+}
+
+/* but not with an AES-CBC pickle key, which has no AES-GCM keys */
+std::vector<std::uint8_t> cbc_key_buffer(::olm_pickle_key_size());
+::OlmPickleKey *cbc_pickle_key = ::olm_pickle_key(
+    cbc_key_buffer.data(), "secret_key", 10
+);
+std::vector<std::uint8_t> copy(pickle1);
+res = ::olm_unpickle_account_with_key(account2, cbc_pickle_key, copy.data(), pickle_length);
+assert_equals(std::size_t(-1), res);
+assert_equals(
+    std::string("BAD_ACCOUNT_KEY"),
+    std::string(::olm_account_last_error(account2))
+);
+
+/* pickles written with the key itself load with the AES-GCM pickle key */
+copy = cbc_pickle;
+res = ::olm_unpickle_account_with_key(account2, pickle_key, copy.data(), cbc_length);
+assert_equals(cbc_length, res);
+
+/* a changed pickle is rejected */
+copy = pickle1;
+copy[pickle_length / 2] ^= 1;
+res = ::olm_unpickle_account_with_key(account2, pickle_key, copy.data(), pickle_length);
+assert_equals(std::size_t(-1), res);
+assert_equals(
+    std::string("BAD_ACCOUNT_KEY"),
+    std::string(::olm_account_last_error(account2))
+);
+copy = pickle1;
+res = ::olm_unpickle_account(account2, "wrong_key", 9, copy.data(), pickle_length);
+assert_equals(std::size_t(-1), res);
+assert_equals(
+    std::string("BAD_ACCOUNT_KEY"),
+    std::string(::olm_account_last_error(account2))
+);
+
+::olm_clear_pickle_key(pickle_key);
+::olm_clear_pickle_key(cbc_pickle_key);
+}
+
+
+{ /** Parallel one time keys test */
+
+TestCase test_case("Parallel one time keys test");
+MockRandom mock_random('K');
+
+std::vector<std::uint8_t> account_buffer(::olm_account_size());
+std::vector<std::uint8_t> account_buffer2(::olm_account_size());
+::OlmAccount *account = ::olm_account(account_buffer.data());
+::OlmAccount *account2 = ::olm_account(account_buffer2.data());
+std::vector<std::uint8_t> random(::olm_create_account_random_length(account));
+mock_random(random.data(), random.size());
+std::vector<std::uint8_t> random2(random);
+::olm_create_account(account, random.data(), random.size());
+::olm_create_account(account2, random2.data(), random2.size());
+
+/* the second batch overflows the account, discarding the older keys */
+std::size_t const batches[2] = {30, 150};
+for (std::size_t batch : batches) {
+    std::vector<std::uint8_t> ot_random(
+        ::olm_account_generate_one_time_keys_random_length(account, batch)
+    );
+    mock_random(ot_random.data(), ot_random.size());
+    std::vector<std::uint8_t> ot_random2(ot_random);
+    for (std::size_t i = 0; i < batch; ++i) {
+        assert_equals(std::size_t(1), ::olm_account_generate_one_time_keys(
+            account, 1, ot_random.data() + 32 * i, 32
+        ));
+    }
+    assert_equals(batch, ::olm_account_generate_one_time_keys_parallel(
+        account2, batch, ot_random2.data(), ot_random2.size(), 4
+    ));
+}
+
+std::size_t pickle_length = ::olm_pickle_account_length(account);
+assert_equals(pickle_length, ::olm_pickle_account_length(account2));
+std::vector<std::uint8_t> pickle1(pickle_length);
+std::vector<std::uint8_t> pickle2(pickle_length);
+::olm_pickle_account(account, "secret_key", 10, pickle1.data(), pickle_length);
+::olm_pickle_account(account2, "secret_key", 10, pickle2.data(), pickle_length);
+assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+}
+
+
 {
     TestCase test_case("Old account unpickle test");
 
@@ -94,6 +275,126 @@ assert_equals(pickle1.data(), pickle2.data(), pickle_length);
 }
 
 
+{
+    TestCase test_case("Version 2 account unpickle test");
+
+    // an account with one unpublished and three published one time keys,
+    // pickled before the one time key store could hold more than 100 keys
+    std::uint8_t pickle[] =
+        "cav+4KuWz4FvDAvRM1cMzkFJfpdmESR7dUNGh3c2zH2++agQDpxGnQuQvrqtCJfa"
+        "KrZKtcKkXT6GIalfgzcIfxLCjcWjUreL4IXihIO9OYlcqY8qzKilt/SwWsihiq0O"
+        "T4xF+Oq4fgTxygI6S2BsThcVti0BfC1nt6F4LwfNKwiKCKpbMdK252TAHMQtIp71"
+        "nkNad2JCoSNEmxh1+qQU2bhWzxw+Qic0CShW3CqvbC/TPUz8sREzipa+dnmBydVO"
+        "WNTerKKuydnznfyw4Fafi4sSm29KFSPGqi8gDcTo7JbVzmUzg1RqDXR4g95ITFjr"
+        "NjUlKMv7oxMRZv3sGh/cCuii5RcyhKD3A99OpFGSmXCMYweuJMMWNOxCBbxiKwQ9"
+        "ffi+jVtaAuKtlpH9+1X8RTOuRjYmJmmiIHk8T1Zs3sFDZIfcJHl+PuSR77tgXmaC"
+        "IQTib92zpzJ6bwoyh5eES0yjbAtcY6lRNGe+Z+RA2kvGA9p+aLHU20kchjNoTz+M"
+        "O6hg3k2OuGOf0XqNAg6tGP3gwj1Ujai0uZfEtxAg2neZXNYObF1VqYRMERQTnR2l"
+        "ebNQATYxXyRXuhBS3ENLoHZJoZelWQ37UsPzgYiB1WNUm3zOYjN4vQ";
+
+    std::vector<std::uint8_t> account_buffer(::olm_account_size());
+    ::OlmAccount *account = ::olm_account(account_buffer.data());
+    assert_equals(
+        sizeof(pickle) - 1,
+        ::olm_unpickle_account(account, "", 0, pickle, sizeof(pickle) - 1)
+    );
+
+    std::string expected_keys =
+        "{\"curve25519\":{\"AAAABA\":"
+        "\"u1D/noKldM+/gg6X9g+5wUPsdBXPUU+M/Zjv9Z4FlhQ\"}}";
+    std::vector<std::uint8_t> keys(::olm_account_one_time_keys_length(account));
+    ::olm_account_one_time_keys(account, keys.data(), keys.size());
+    assert_equals(expected_keys, std::string(keys.begin(), keys.end()));
+    assert_equals(std::size_t(1), ::olm_account_mark_keys_as_published(account));
+}
+
+
+{ /** Account capacity test */
+
+TestCase test_case("Account capacity test");
+MockRandom mock_random('C');
+
+std::size_t const capacity = 1000;
+assert_equals(::olm_account_size(), ::olm_account_size_with_capacity(10));
+std::vector<std::uint8_t> account_buffer(
+    ::olm_account_size_with_capacity(capacity)
+);
+::OlmAccount *account = ::olm_account_with_capacity(
+    account_buffer.data(), capacity
+);
+assert_equals(capacity, ::olm_account_max_number_of_one_time_keys(account));
+std::vector<std::uint8_t> random(::olm_create_account_random_length(account));
+mock_random(random.data(), random.size());
+::olm_create_account(account, random.data(), random.size());
+
+std::vector<std::uint8_t> ot_random(
+    ::olm_account_generate_one_time_keys_random_length(account, 1200)
+);
+mock_random(ot_random.data(), ot_random.size());
+::olm_account_generate_one_time_keys(
+    account, 1200, ot_random.data(), ot_random.size()
+);
+assert_equals(capacity, ::olm_account_mark_keys_as_published(account));
+
+std::size_t pickle_length = ::olm_pickle_account_length(account);
+std::vector<std::uint8_t> pickle1(pickle_length);
+::olm_pickle_account(account, "secret_key", 10, pickle1.data(), pickle_length);
+
+/* the keys don't fit in a default account */
+std::vector<std::uint8_t> pickle2(pickle1);
+std::vector<std::uint8_t> small_buffer(::olm_account_size());
+::OlmAccount *small_account = ::olm_account(small_buffer.data());
+assert_equals(std::size_t(-1), ::olm_unpickle_account(
+    small_account, "secret_key", 10, pickle2.data(), pickle_length
+));
+assert_equals(
+    std::string("KEY_STORE_TOO_SMALL"),
+    std::string(::olm_account_last_error(small_account))
+);
+
+pickle2 = pickle1;
+std::vector<std::uint8_t> account_buffer2(
+    ::olm_account_size_with_capacity(capacity)
+);
+::OlmAccount *account2 = ::olm_account_with_capacity(
+    account_buffer2.data(), capacity
+);
+assert_equals(pickle_length, ::olm_unpickle_account(
+    account2, "secret_key", 10, pickle2.data(), pickle_length
+));
+::olm_pickle_account(account2, "secret_key", 10, pickle2.data(), pickle_length);
+assert_equals(pickle1.data(), pickle2.data(), pickle_length);
+
+assert_equals(
+    ::olm_account_size_with_capacity(capacity),
+    ::olm_clear_account(account)
+);
+assert_equals(capacity, ::olm_account_max_number_of_one_time_keys(account));
+}
+
+
+{ /** Session capacity test */
+
+TestCase test_case("Session capacity test");
+
+std::size_t const capacity = 1000;
+assert_equals(::olm_session_size(), ::olm_session_size_with_capacity(10));
+assert_equals(true, ::olm_session_size_with_capacity(capacity) > ::olm_session_size());
+std::vector<std::uint8_t> session_buffer(
+    ::olm_session_size_with_capacity(capacity)
+);
+::OlmSession *session = ::olm_session_with_capacity(
+    session_buffer.data(), capacity
+);
+assert_equals(
+    ::olm_session_size_with_capacity(capacity), ::olm_clear_session(session)
+);
+assert_equals(
+    ::olm_session_size_with_capacity(capacity), ::olm_clear_session(session)
+);
+}
+
+
 { /** Pickle session test */
 
 TestCase test_case("Pickle session test");
@@ -227,8 +528,21 @@ assert_equals(std::size_t(0), ::olm_matches_inbound_session_from(
     tmp_message_1.data(), message_1.size()
 ));
 
-// Check that we can decrypt the message.
+// Check that the session expects the message, without changing it.
 std::memcpy(tmp_message_1.data(), message_1.data(), message_1.size());
+assert_equals(OLM_DECRYPT_HINT_KNOWN_CHAIN, ::olm_session_can_decrypt_hint(
+    b_session, 0, tmp_message_1.data(), message_1.size()
+));
+assert_equals(message_1.data(), tmp_message_1.data(), message_1.size());
+assert_equals(std::size_t(-1), ::olm_session_can_decrypt_hint(
+    b_session, 0, tmp_message_1.data(), 1
+));
+assert_equals(
+    std::string("INVALID_BASE64"),
+    std::string(::olm_session_last_error(b_session))
+);
+
+// Check that we can decrypt the message.
 std::vector<std::uint8_t> plaintext_1(::olm_decrypt_max_plaintext_length(
     b_session, 0, tmp_message_1.data(), message_1.size()
 ));
@@ -241,6 +555,26 @@ assert_equals(std::size_t(12), ::olm_decrypt(
 
 assert_equals(plaintext, plaintext_1.data(), 12);
 
+// The key for the message has been used up.
+assert_equals(OLM_DECRYPT_HINT_IMPOSSIBLE, ::olm_session_can_decrypt_hint(
+    b_session, 0, message_1.data(), message_1.size()
+));
+
+// Only the headers of a long message are looked at.
+std::vector<std::uint8_t> long_plaintext(1000, 'x');
+std::vector<std::uint8_t> long_message(
+    ::olm_encrypt_message_length(a_session, long_plaintext.size())
+);
+assert_not_equals(std::size_t(-1), ::olm_encrypt(
+    a_session,
+    long_plaintext.data(), long_plaintext.size(),
+    NULL, 0,
+    long_message.data(), long_message.size()
+));
+assert_equals(OLM_DECRYPT_HINT_KNOWN_CHAIN, ::olm_session_can_decrypt_hint(
+    b_session, 0, long_message.data(), long_message.size()
+));
+
 std::vector<std::uint8_t> message_2(::olm_encrypt_message_length(b_session, 12));
 std::vector<std::uint8_t> b_message_random(::olm_encrypt_random_length(b_session));
 mock_random_b(b_message_random.data(), b_message_random.size());
@@ -252,6 +586,10 @@ assert_not_equals(std::size_t(-1), ::olm_encrypt(
     message_2.data(), message_2.size()
 ));
 
+assert_equals(OLM_DECRYPT_HINT_NEW_CHAIN, ::olm_session_can_decrypt_hint(
+    a_session, 1, message_2.data(), message_2.size()
+));
+
 std::vector<std::uint8_t> tmp_message_2(message_2);
 std::vector<std::uint8_t> plaintext_2(::olm_decrypt_max_plaintext_length(
     a_session, 1, tmp_message_2.data(), message_2.size()
@@ -265,6 +603,10 @@ assert_equals(std::size_t(12), ::olm_decrypt(
 
 assert_equals(plaintext, plaintext_2.data(), 12);
 
+assert_equals(OLM_DECRYPT_HINT_IMPOSSIBLE, ::olm_session_can_decrypt_hint(
+    a_session, 1, message_2.data(), message_2.size()
+));
+
 std::memcpy(tmp_message_2.data(), message_2.data(), message_2.size());
 assert_equals(std::size_t(-1), ::olm_decrypt(
     a_session, 1,
@@ -396,4 +738,305 @@ for (unsigned i = 0; i < 8; ++i) {
 }
 }
 
+
+{ /** Delta pickle test */
+
+TestCase test_case("Delta pickle test");
+MockRandom mock_random_a('A', 0x00);
+MockRandom mock_random_b('B', 0x80);
+
+std::vector<std::uint8_t> a_account_buffer(::olm_account_size());
+::OlmAccount *a_account = ::olm_account(a_account_buffer.data());
+std::vector<std::uint8_t> a_random(::olm_create_account_random_length(a_account));
+mock_random_a(a_random.data(), a_random.size());
+::olm_create_account(a_account, a_random.data(), a_random.size());
+
+std::vector<std::uint8_t> b_account_buffer(::olm_account_size());
+::OlmAccount *b_account = ::olm_account(b_account_buffer.data());
+std::vector<std::uint8_t> b_random(::olm_create_account_random_length(b_account));
+mock_random_b(b_random.data(), b_random.size());
+::olm_create_account(b_account, b_random.data(), b_random.size());
+std::vector<std::uint8_t> o_random(::olm_account_generate_one_time_keys_random_length(
+        b_account, 4
+));
+mock_random_b(o_random.data(), o_random.size());
+::olm_account_generate_one_time_keys(b_account, 4, o_random.data(), o_random.size());
+
+std::vector<std::uint8_t> b_id_keys(::olm_account_identity_keys_length(b_account));
+std::vector<std::uint8_t> b_ot_keys(::olm_account_one_time_keys_length(b_account));
+::olm_account_identity_keys(b_account, b_id_keys.data(), b_id_keys.size());
+::olm_account_one_time_keys(b_account, b_ot_keys.data(), b_ot_keys.size());
+::olm_account_mark_keys_as_published(b_account);
+
+std::vector<std::uint8_t> account_base(::olm_pickle_account_length(b_account));
+assert_equals(account_base.size(), ::olm_pickle_account(
+    b_account, "secret_key", 10, account_base.data(), account_base.size()
+));
+
+std::vector<std::uint8_t> a_session_buffer(::olm_session_size());
+::OlmSession *a_session = ::olm_session(a_session_buffer.data());
+std::vector<std::uint8_t> a_rand(::olm_create_outbound_session_random_length(a_session));
+mock_random_a(a_rand.data(), a_rand.size());
+assert_not_equals(std::size_t(-1), ::olm_create_outbound_session(
+    a_session, a_account,
+    b_id_keys.data() + 15, 43,
+    b_ot_keys.data() + 25, 43,
+    a_rand.data(), a_rand.size()
+));
+
+std::uint8_t plaintext[] = "Hello, World";
+std::vector<std::uint8_t> message_1(::olm_encrypt_message_length(a_session, 12));
+std::vector<std::uint8_t> a_message_random(::olm_encrypt_random_length(a_session));
+mock_random_a(a_message_random.data(), a_message_random.size());
+assert_not_equals(std::size_t(-1), ::olm_encrypt(
+    a_session,
+    plaintext, 12,
+    a_message_random.data(), a_message_random.size(),
+    message_1.data(), message_1.size()
+));
+
+std::vector<std::uint8_t> tmp_message_1(message_1);
+std::vector<std::uint8_t> b_session_buffer(::olm_session_size());
+::OlmSession *b_session = ::olm_session(b_session_buffer.data());
+assert_not_equals(std::size_t(-1), ::olm_create_inbound_session(
+    b_session, b_account, tmp_message_1.data(), message_1.size()
+));
+std::memcpy(tmp_message_1.data(), message_1.data(), message_1.size());
+std::vector<std::uint8_t> plaintext_1(::olm_decrypt_max_plaintext_length(
+    b_session, 0, tmp_message_1.data(), message_1.size()
+));
+std::memcpy(tmp_message_1.data(), message_1.data(), message_1.size());
+assert_equals(std::size_t(12), ::olm_decrypt(
+    b_session, 0,
+    tmp_message_1.data(), message_1.size(),
+    plaintext_1.data(), plaintext_1.size()
+));
+
+/* The account deltas: one for the used key, one for two new keys */
+std::vector<std::vector<std::uint8_t>> account_deltas;
+assert_not_equals(std::size_t(-1), ::olm_remove_one_time_keys(b_account, b_session));
+account_deltas.emplace_back(::olm_pickle_account_delta_length(b_account));
+assert_equals(account_deltas.back().size(), ::olm_pickle_account_delta(
+    b_account, "secret_key", 10,
+    account_deltas.back().data(), account_deltas.back().size()
+));
+std::vector<std::uint8_t> o_random_2(::olm_account_generate_one_time_keys_random_length(
+        b_account, 2
+));
+mock_random_b(o_random_2.data(), o_random_2.size());
+::olm_account_generate_one_time_keys(b_account, 2, o_random_2.data(), o_random_2.size());
+account_deltas.emplace_back(::olm_pickle_account_delta_length(b_account));
+assert_equals(account_deltas.back().size(), ::olm_pickle_account_delta(
+    b_account, "secret_key", 10,
+    account_deltas.back().data(), account_deltas.back().size()
+));
+assert_equals(true, account_deltas[0].size() < account_base.size());
+
+std::vector<std::uint8_t> session_base(::olm_pickle_session_length(b_session));
+assert_equals(session_base.size(), ::olm_pickle_session(
+    b_session, "secret_key", 10, session_base.data(), session_base.size()
+));
+
+/* The session deltas: B replies and A answers, then A sends two messages
+ * that B receives out of order */
+std::vector<std::vector<std::uint8_t>> session_deltas;
+for (unsigned i = 0; i < 4; ++i) {
+    ::OlmSession *sender = (i % 2) ? a_session : b_session;
+    ::OlmSession *receiver = (i % 2) ? b_session : a_session;
+    std::size_t count = i == 3 ? 2 : 1;
+    std::vector<std::vector<std::uint8_t>> messages;
+    std::vector<std::size_t> types;
+    for (std::size_t j = 0; j < count; ++j) {
+        messages.emplace_back(::olm_encrypt_message_length(sender, 12));
+        std::vector<std::uint8_t> rnd(::olm_encrypt_random_length(sender));
+        mock_random_a(rnd.data(), rnd.size());
+        types.push_back(::olm_encrypt_message_type(sender));
+        assert_not_equals(std::size_t(-1), ::olm_encrypt(
+            sender, plaintext, 12, rnd.data(), rnd.size(),
+            messages.back().data(), messages.back().size()
+        ));
+    }
+    for (std::size_t j = count; j-- > 0;) {
+        std::vector<std::uint8_t> tmp(messages[j]);
+        std::vector<std::uint8_t> out(::olm_decrypt_max_plaintext_length(
+            receiver, types[j], tmp.data(), tmp.size()
+        ));
+        std::memcpy(tmp.data(), messages[j].data(), messages[j].size());
+        assert_equals(std::size_t(12), ::olm_decrypt(
+            receiver, types[j], tmp.data(), tmp.size(), out.data(), out.size()
+        ));
+        session_deltas.emplace_back(::olm_pickle_session_delta_length(b_session));
+        assert_equals(session_deltas.back().size(), ::olm_pickle_session_delta(
+            b_session, "secret_key", 10,
+            session_deltas.back().data(), session_deltas.back().size()
+        ));
+    }
+}
+assert_equals(std::size_t(5), session_deltas.size());
+assert_equals(true, session_deltas[1].size() < session_base.size());
+
+/* Folding the deltas onto the base pickles gives the current state */
+std::vector<void *> pointers;
+std::vector<std::size_t> lengths;
+std::vector<std::vector<std::uint8_t>> copies(account_deltas);
+for (std::vector<std::uint8_t> & delta : copies) {
+    pointers.push_back(delta.data());
+    lengths.push_back(delta.size());
+}
+std::vector<std::uint8_t> tmp_base(account_base);
+std::vector<std::uint8_t> account_buffer2(::olm_account_size());
+::OlmAccount *account2 = ::olm_account(account_buffer2.data());
+assert_equals(tmp_base.size(), ::olm_unpickle_account_journal(
+    account2, "secret_key", 10, tmp_base.data(), tmp_base.size(),
+    pointers.data(), lengths.data(), pointers.size()
+));
+
+std::vector<std::uint8_t> account_pickle1(::olm_pickle_account_length(b_account));
+std::vector<std::uint8_t> account_pickle2(::olm_pickle_account_length(account2));
+assert_equals(account_pickle1.size(), account_pickle2.size());
+::olm_pickle_account(
+    b_account, "secret_key", 10, account_pickle1.data(), account_pickle1.size()
+);
+::olm_pickle_account(
+    account2, "secret_key", 10, account_pickle2.data(), account_pickle2.size()
+);
+assert_equals(account_pickle1.data(), account_pickle2.data(), account_pickle1.size());
+
+pointers.clear();
+lengths.clear();
+copies = session_deltas;
+for (std::vector<std::uint8_t> & delta : copies) {
+    pointers.push_back(delta.data());
+    lengths.push_back(delta.size());
+}
+tmp_base = session_base;
+std::vector<std::uint8_t> session_buffer2(::olm_session_size());
+::OlmSession *session2 = ::olm_session(session_buffer2.data());
+assert_equals(tmp_base.size(), ::olm_unpickle_session_journal(
+    session2, "secret_key", 10, tmp_base.data(), tmp_base.size(),
+    pointers.data(), lengths.data(), pointers.size()
+));
+
+std::vector<std::uint8_t> session_pickle1(::olm_pickle_session_length(b_session));
+std::vector<std::uint8_t> session_pickle2(::olm_pickle_session_length(session2));
+assert_equals(session_pickle1.size(), session_pickle2.size());
+::olm_pickle_session(
+    b_session, "secret_key", 10, session_pickle1.data(), session_pickle1.size()
+);
+::olm_pickle_session(
+    session2, "secret_key", 10, session_pickle2.data(), session_pickle2.size()
+);
+assert_equals(session_pickle1.data(), session_pickle2.data(), session_pickle1.size());
+
+/* A delta can't be applied out of order */
+tmp_base = session_base;
+std::vector<std::uint8_t> session_buffer3(::olm_session_size());
+::OlmSession *session3 = ::olm_session(session_buffer3.data());
+assert_not_equals(std::size_t(-1), ::olm_unpickle_session(
+    session3, "secret_key", 10, tmp_base.data(), tmp_base.size()
+));
+std::vector<std::uint8_t> tmp_delta(session_deltas[1]);
+assert_equals(std::size_t(-1), ::olm_unpickle_session_delta(
+    session3, "secret_key", 10, tmp_delta.data(), tmp_delta.size()
+));
+assert_equals(
+    std::string("BAD_PICKLE_DELTA"),
+    std::string(::olm_session_last_error(session3))
+);
+
+/* Nor to another account with the same key ids, which it leaves as it was */
+::olm_account_generate_one_time_keys(
+    a_account, 4, o_random.data(), o_random.size()
+);
+::olm_account_mark_keys_as_published(a_account);
+std::vector<std::uint8_t> a_pickle1(::olm_pickle_account_length(a_account));
+std::vector<std::uint8_t> a_pickle2(a_pickle1.size());
+::olm_pickle_account(
+    a_account, "secret_key", 10, a_pickle1.data(), a_pickle1.size()
+);
+tmp_delta = account_deltas[0];
+assert_equals(std::size_t(-1), ::olm_unpickle_account_delta(
+    a_account, "secret_key", 10, tmp_delta.data(), tmp_delta.size()
+));
+assert_equals(
+    std::string("BAD_PICKLE_DELTA"),
+    std::string(::olm_account_last_error(a_account))
+);
+::olm_pickle_account(
+    a_account, "secret_key", 10, a_pickle2.data(), a_pickle2.size()
+);
+assert_equals(a_pickle1.data(), a_pickle2.data(), a_pickle1.size());
+
+/* A delta that stops short, by a byte or by half, changes nothing, so the
+ * whole one still applies afterwards */
+auto truncate_delta = [](
+    std::vector<std::uint8_t> delta, bool half
+) {
+    std::uint8_t const * key = (std::uint8_t const *)"secret_key";
+    std::size_t raw_length = _olm_enc_input(
+        key, 10, delta.data(), delta.size(), nullptr
+    );
+    raw_length -= half ? raw_length / 2 : 1;
+    std::vector<std::uint8_t> output(_olm_enc_output_length(raw_length));
+    std::memcpy(
+        _olm_enc_output_pos(output.data(), raw_length), delta.data(), raw_length
+    );
+    _olm_enc_output(key, 10, output.data(), raw_length);
+    return output;
+};
+tmp_base = account_base;
+std::vector<std::uint8_t> account_buffer3(::olm_account_size());
+::OlmAccount *account3 = ::olm_account(account_buffer3.data());
+assert_not_equals(std::size_t(-1), ::olm_unpickle_account(
+    account3, "secret_key", 10, tmp_base.data(), tmp_base.size()
+));
+tmp_base = session_base;
+std::vector<std::uint8_t> session_buffer4(::olm_session_size());
+::OlmSession *session4 = ::olm_session(session_buffer4.data());
+assert_not_equals(std::size_t(-1), ::olm_unpickle_session(
+    session4, "secret_key", 10, tmp_base.data(), tmp_base.size()
+));
+std::vector<std::uint8_t> account_pickle3(::olm_pickle_account_length(account3));
+::olm_pickle_account(
+    account3, "secret_key", 10, account_pickle3.data(), account_pickle3.size()
+);
+std::vector<std::uint8_t> session_pickle4(::olm_pickle_session_length(session4));
+::olm_pickle_session(
+    session4, "secret_key", 10, session_pickle4.data(), session_pickle4.size()
+);
+for (bool half : {false, true}) {
+    tmp_delta = truncate_delta(account_deltas[0], half);
+    assert_equals(std::size_t(-1), ::olm_unpickle_account_delta(
+        account3, "secret_key", 10, tmp_delta.data(), tmp_delta.size()
+    ));
+    assert_equals(
+        std::string("CORRUPTED_PICKLE"),
+        std::string(::olm_account_last_error(account3))
+    );
+    std::vector<std::uint8_t> pickle(account_pickle3.size());
+    ::olm_pickle_account(account3, "secret_key", 10, pickle.data(), pickle.size());
+    assert_equals(account_pickle3.data(), pickle.data(), pickle.size());
+
+    tmp_delta = truncate_delta(session_deltas[0], half);
+    assert_equals(std::size_t(-1), ::olm_unpickle_session_delta(
+        session4, "secret_key", 10, tmp_delta.data(), tmp_delta.size()
+    ));
+    assert_equals(
+        std::string("CORRUPTED_PICKLE"),
+        std::string(::olm_session_last_error(session4))
+    );
+    pickle.resize(session_pickle4.size());
+    ::olm_pickle_session(session4, "secret_key", 10, pickle.data(), pickle.size());
+    assert_equals(session_pickle4.data(), pickle.data(), pickle.size());
+}
+tmp_delta = account_deltas[0];
+assert_equals(tmp_delta.size(), ::olm_unpickle_account_delta(
+    account3, "secret_key", 10, tmp_delta.data(), tmp_delta.size()
+));
+tmp_delta = session_deltas[0];
+assert_equals(tmp_delta.size(), ::olm_unpickle_session_delta(
+    session3, "secret_key", 10, tmp_delta.data(), tmp_delta.size()
+));
+}
+
 }
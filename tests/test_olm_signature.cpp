@@ -78,4 +78,175 @@ assert_not_equals(std::size_t(-1), ::olm_ed25519_verify(
 
 }
 
+{ /** Batch Verify Test */
+TestCase test_case("Batch verify test");
+
+MockRandom mock_random_b('B', 0x00);
+
+void * account_buffer = check_malloc(::olm_account_size());
+::OlmAccount * account = ::olm_account(account_buffer);
+
+std::size_t random_size = ::olm_create_account_random_length(account);
+void * random = check_malloc(random_size);
+mock_random_b(random, random_size);
+::olm_create_account(account, random, random_size);
+::free(random);
+
+std::size_t id_keys_size = ::olm_account_identity_keys_length(account);
+std::uint8_t * id_keys = (std::uint8_t *) check_malloc(id_keys_size);
+assert_not_equals(std::size_t(-1), ::olm_account_identity_keys(
+    account, id_keys, id_keys_size
+));
+
+const std::size_t count = 5;
+std::size_t signature_size = ::olm_account_signature_length(account);
+std::uint8_t messages[count][8];
+std::uint8_t signatures[count][128];
+void const * key_pointers[count];
+std::size_t key_lengths[count];
+void const * message_pointers[count];
+std::size_t message_lengths[count];
+void * signature_pointers[count];
+std::size_t signature_lengths[count];
+int results[count];
+
+for (std::size_t i = 0; i < count; ++i) {
+    std::memcpy(messages[i], "Message0", 8);
+    messages[i][7] += i;
+    assert_not_equals(std::size_t(-1), ::olm_account_sign(
+        account, messages[i], 8, signatures[i], signature_size
+    ));
+    key_pointers[i] = id_keys + 71;
+    key_lengths[i] = 43;
+    message_pointers[i] = messages[i];
+    message_lengths[i] = 8;
+    signature_pointers[i] = signatures[i];
+    signature_lengths[i] = signature_size;
+}
+
+void * utility_buffer = check_malloc(::olm_utility_size());
+::OlmUtility * utility = ::olm_utility(utility_buffer);
+
+/* signatures are decoded in place, so check a copy */
+std::uint8_t copies[count][128];
+std::memcpy(copies, signatures, sizeof(copies));
+for (std::size_t i = 0; i < count; ++i) {
+    signature_pointers[i] = copies[i];
+}
+assert_equals(std::size_t(0), ::olm_ed25519_verify_batch(
+    utility, count, key_pointers, key_lengths,
+    message_pointers, message_lengths,
+    signature_pointers, signature_lengths, results
+));
+for (std::size_t i = 0; i < count; ++i) {
+    assert_equals(1, results[i]);
+}
+
+std::memcpy(copies, signatures, sizeof(copies));
+messages[1][0] = 'X';
+assert_equals(std::size_t(-1), ::olm_ed25519_verify_batch(
+    utility, count, key_pointers, key_lengths,
+    message_pointers, message_lengths,
+    signature_pointers, signature_lengths, results
+));
+assert_equals(
+    std::string("BAD_MESSAGE_MAC"),
+    std::string(::olm_utility_last_error(utility))
+);
+for (std::size_t i = 0; i < count; ++i) {
+    assert_equals(i == 1 ? 0 : 1, results[i]);
+}
+
+std::memcpy(copies, signatures, sizeof(copies));
+messages[1][0] = 'M';
+key_lengths[3] = 42;
+assert_equals(std::size_t(-1), ::olm_ed25519_verify_batch(
+    utility, count, key_pointers, key_lengths,
+    message_pointers, message_lengths,
+    signature_pointers, signature_lengths, results
+));
+assert_equals(
+    std::string("INVALID_BASE64"),
+    std::string(::olm_utility_last_error(utility))
+);
+for (std::size_t i = 0; i < count; ++i) {
+    assert_equals(i == 3 ? 0 : 1, results[i]);
+}
+
+::free(utility_buffer);
+::free(id_keys);
+::free(account_buffer);
+}
+
+{ /** Prepared Key Test */
+TestCase test_case("Prepared key test");
+
+MockRandom mock_random_c('C', 0x00);
+
+void * account_buffer = check_malloc(::olm_account_size());
+::OlmAccount * account = ::olm_account(account_buffer);
+
+std::size_t random_size = ::olm_create_account_random_length(account);
+void * random = check_malloc(random_size);
+mock_random_c(random, random_size);
+::olm_create_account(account, random, random_size);
+::free(random);
+
+std::size_t id_keys_size = ::olm_account_identity_keys_length(account);
+std::uint8_t * id_keys = (std::uint8_t *) check_malloc(id_keys_size);
+assert_not_equals(std::size_t(-1), ::olm_account_identity_keys(
+    account, id_keys, id_keys_size
+));
+
+std::uint8_t message[] = "Hello, World";
+std::size_t message_size = sizeof(message) - 1;
+std::size_t signature_size = ::olm_account_signature_length(account);
+std::uint8_t signature[128];
+assert_not_equals(std::size_t(-1), ::olm_account_sign(
+    account, message, message_size, signature, signature_size
+));
+
+void * utility_buffer = check_malloc(::olm_utility_size());
+::OlmUtility * utility = ::olm_utility(utility_buffer);
+void * key_buffer = check_malloc(::olm_ed25519_prepared_key_size());
+::OlmEd25519PreparedKey * key = ::olm_ed25519_prepared_key(key_buffer);
+
+assert_equals(std::size_t(-1), ::olm_ed25519_prepare_key(
+    utility, key, id_keys + 71, 42
+));
+assert_equals(
+    std::string("INVALID_BASE64"),
+    std::string(::olm_utility_last_error(utility))
+);
+assert_not_equals(std::size_t(-1), ::olm_ed25519_prepare_key(
+    utility, key, id_keys + 71, 43
+));
+
+/* the key can be reused; signatures are decoded in place */
+for (int i = 0; i < 2; ++i) {
+    std::uint8_t copy[128];
+    std::memcpy(copy, signature, signature_size);
+    assert_equals(std::size_t(0), ::olm_ed25519_verify_prepared(
+        utility, key, message, message_size, copy, signature_size
+    ));
+}
+
+std::uint8_t copy[128];
+std::memcpy(copy, signature, signature_size);
+message[0] = 'J';
+assert_equals(std::size_t(-1), ::olm_ed25519_verify_prepared(
+    utility, key, message, message_size, copy, signature_size
+));
+assert_equals(
+    std::string("BAD_MESSAGE_MAC"),
+    std::string(::olm_utility_last_error(utility))
+);
+
+::olm_clear_ed25519_prepared_key(key);
+::free(key_buffer);
+::free(utility_buffer);
+::free(id_keys);
+::free(account_buffer);
+}
+
 }
@@ -1,4 +1,5 @@
 #include "olm/pk.h"
+#include "olm/base64.hh"
 #include "olm/crypto.h"
 #include "olm/olm.h"
 
@@ -165,6 +166,65 @@ free(plaintext_buffer);
 
 }
 
+{ /* Binary pickling */
+
+TestCase test_case("Public Key Decryption binary pickling");
+
+std::vector<std::uint8_t> decryption_buffer(olm_pk_decryption_size());
+OlmPkDecryption *decryption = olm_pk_decryption(decryption_buffer.data());
+
+std::uint8_t alice_private[32] = {
+    0x77, 0x07, 0x6D, 0x0A, 0x73, 0x18, 0xA5, 0x7D,
+    0x3C, 0x16, 0xC1, 0x72, 0x51, 0xB2, 0x66, 0x45,
+    0xDF, 0x4C, 0x2F, 0x87, 0xEB, 0xC0, 0x99, 0x2A,
+    0xB1, 0x77, 0xFB, 0xA5, 0x1D, 0xB9, 0x2C, 0x2A
+};
+
+const std::uint8_t *alice_public = (std::uint8_t *) "hSDwCYkwp1R0i33ctD73Wg2/Og0mOBr066SpjqqbTmoK";
+
+std::vector<std::uint8_t> pubkey(olm_pk_key_length());
+
+olm_pk_key_from_private(
+    decryption,
+    pubkey.data(), pubkey.size(),
+    alice_private, sizeof(alice_private)
+);
+
+const uint8_t *PICKLE_KEY=(uint8_t *)"secret_key";
+std::size_t pickle_length = olm_pickle_pk_decryption_binary_length(decryption);
+assert_equals(
+    olm_pickle_pk_decryption_length(decryption),
+    olm::encode_base64_length(pickle_length)
+);
+std::vector<std::uint8_t> pickle_buffer(pickle_length);
+const uint8_t *expected_pickle = (uint8_t *) "qx37WTQrjZLz5tId/uBX9B3/okqAbV1ofl9UnHKno1eipByCpXleAAlAZoJgYnCDOQZDQWzo3luTSfkF9pU1mOILCbbouubs6TVeDyPfgGD9i86J8irHjA";
+
+assert_equals(pickle_length, olm_pickle_pk_decryption_binary(
+    decryption,
+    PICKLE_KEY, strlen((char *)PICKLE_KEY),
+    pickle_buffer.data(), pickle_buffer.size()
+));
+
+/* the binary pickle is the base64 pickle before it is encoded */
+std::vector<std::uint8_t> encoded(olm::encode_base64_length(pickle_length));
+olm::encode_base64(pickle_buffer.data(), pickle_length, encoded.data());
+assert_equals(expected_pickle, encoded.data(), encoded.size());
+
+olm_clear_pk_decryption(decryption);
+
+memset(pubkey.data(), 0, olm_pk_key_length());
+
+assert_equals(pickle_length, olm_unpickle_pk_decryption_binary(
+    decryption,
+    PICKLE_KEY, strlen((char *)PICKLE_KEY),
+    pickle_buffer.data(), pickle_buffer.size(),
+    pubkey.data(), pubkey.size()
+));
+
+assert_equals(alice_public, pubkey.data(), olm_pk_key_length());
+
+}
+
 { /* Signing Test Case 1 */
 
 TestCase test_case("Public Key Signing");
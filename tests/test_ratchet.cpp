@@ -219,4 +219,192 @@ random[31]++;
 
 }
 
+{ /* New chain test case */
+
+TestCase test_case("Olm New Chain");
+
+olm::Ratchet alice(kdf_info, cipher);
+olm::Ratchet bob(kdf_info, cipher);
+
+alice.initialise_as_alice(shared_secret, sizeof(shared_secret) - 1, alice_key);
+bob.initialise_as_bob(shared_secret, sizeof(shared_secret) - 1, alice_key.public_key);
+
+std::uint8_t plaintext[] = "Message";
+std::size_t plaintext_length = sizeof(plaintext) - 1;
+std::uint8_t random[] = "This is a random 32 byte string.";
+
+/* Bob replies to Alice twice on a new chain */
+std::vector<std::uint8_t> message_1(bob.encrypt_output_length(plaintext_length));
+bob.encrypt(
+    plaintext, plaintext_length, random, 32,
+    message_1.data(), message_1.size()
+);
+std::vector<std::uint8_t> message_2(bob.encrypt_output_length(plaintext_length));
+bob.encrypt(
+    plaintext, plaintext_length, NULL, 0,
+    message_2.data(), message_2.size()
+);
+std::vector<std::uint8_t> output(
+    alice.decrypt_max_plaintext_length(message_2.data(), message_2.size())
+);
+
+/* A corrupted message on the new chain is rejected, but the chain stays
+ * pending */
+std::vector<std::uint8_t> corrupted(message_2);
+corrupted[corrupted.size() - 1] ^= 1;
+assert_equals(std::size_t(-1), alice.decrypt(
+    corrupted.data(), corrupted.size(), output.data(), output.size()
+));
+assert_equals(OlmErrorCode::OLM_BAD_MESSAGE_MAC, alice.last_error);
+assert_equals(std::size_t(1), alice.pending_chains.size());
+assert_equals(std::size_t(1), alice.sender_chain.size());
+assert_equals(std::size_t(0), alice.receiver_chains.size());
+
+/* Accepting the chain uses and clears the pending chains */
+assert_equals(plaintext_length, alice.decrypt(
+    message_2.data(), message_2.size(), output.data(), output.size()
+));
+assert_equals(std::size_t(0), alice.pending_chains.size());
+assert_equals(std::size_t(0), alice.sender_chain.size());
+assert_equals(std::size_t(1), alice.receiver_chains.size());
+assert_equals(plaintext_length, alice.decrypt(
+    message_1.data(), message_1.size(), output.data(), output.size()
+));
+
+/* Alice and Bob carry on with the new root key */
+std::vector<std::uint8_t> message_3(alice.encrypt_output_length(plaintext_length));
+alice.encrypt(
+    plaintext, plaintext_length, random, 32,
+    message_3.data(), message_3.size()
+);
+assert_equals(plaintext_length, bob.decrypt(
+    message_3.data(), message_3.size(), output.data(), output.size()
+));
+assert_equals(std::size_t(0), bob.pending_chains.size());
+
+} /* New chain test case */
+
+{ /* Skipped message key capacity */
+
+TestCase test_case("Olm Skipped Message Key Capacity");
+
+std::size_t const capacity = 100;
+std::vector<std::uint8_t> storage(
+    olm::SkippedMessageKeyStore::storage_size(capacity)
+);
+olm::Ratchet alice(kdf_info, cipher);
+olm::Ratchet bob(kdf_info, cipher, storage.data(), capacity);
+olm::Ratchet carol(kdf_info, cipher);
+assert_equals(capacity, bob.skipped_message_keys.capacity());
+assert_equals(
+    olm::MAX_SKIPPED_MESSAGE_KEYS, carol.skipped_message_keys.capacity()
+);
+
+alice.initialise_as_alice(shared_secret, sizeof(shared_secret) - 1, alice_key);
+bob.initialise_as_bob(shared_secret, sizeof(shared_secret) - 1, alice_key.public_key);
+
+std::uint8_t plaintext[] = "Message";
+std::size_t plaintext_length = sizeof(plaintext) - 1;
+std::uint8_t random[] = "This is a random 32 byte string.";
+
+/* Alice sends Bob 101 messages and the last arrives first */
+std::vector<std::vector<std::uint8_t>> messages;
+for (unsigned i = 0; i <= capacity; ++i) {
+    messages.emplace_back(alice.encrypt_output_length(plaintext_length));
+    alice.encrypt(
+        plaintext, plaintext_length, random, alice.encrypt_random_length(),
+        messages.back().data(), messages.back().size()
+    );
+}
+
+std::vector<std::uint8_t> output(
+    bob.decrypt_max_plaintext_length(messages[0].data(), messages[0].size())
+);
+assert_equals(plaintext_length, bob.decrypt(
+    messages[capacity].data(), messages[capacity].size(),
+    output.data(), output.size()
+));
+assert_equals(capacity, bob.skipped_message_keys.size());
+
+/* A ratchet with the default capacity keeps the newest of the keys when
+ * the pickle is loaded */
+std::vector<std::uint8_t> pickled(olm::pickle_length(bob));
+olm::pickle(pickled.data(), bob);
+olm::unpickle(pickled.data(), pickled.data() + pickled.size(), carol, false);
+assert_equals(
+    olm::MAX_SKIPPED_MESSAGE_KEYS, carol.skipped_message_keys.size()
+);
+
+/* The others arrive in an arbitrary order */
+for (unsigned i = 0; i < capacity; ++i) {
+    std::vector<std::uint8_t> const & message = messages[(i * 37) % capacity];
+    assert_equals(plaintext_length, bob.decrypt(
+        message.data(), message.size(), output.data(), output.size()
+    ));
+    assert_equals(plaintext, output.data(), plaintext_length);
+
+    assert_equals(
+        (i * 37) % capacity >= capacity - olm::MAX_SKIPPED_MESSAGE_KEYS
+            ? plaintext_length : std::size_t(-1),
+        carol.decrypt(
+            message.data(), message.size(), output.data(), output.size()
+        )
+    );
+}
+assert_equals(std::size_t(0), bob.skipped_message_keys.size());
+assert_equals(std::size_t(0), carol.skipped_message_keys.size());
+
+} /* Skipped message key capacity */
+
+{ /* Work budget */
+
+TestCase test_case("Olm Work Budget");
+
+olm::Ratchet alice(kdf_info, cipher);
+olm::Ratchet bob(kdf_info, cipher);
+
+alice.initialise_as_alice(shared_secret, sizeof(shared_secret) - 1, alice_key);
+bob.initialise_as_bob(shared_secret, sizeof(shared_secret) - 1, alice_key.public_key);
+
+std::uint8_t plaintext[] = "Message";
+std::size_t plaintext_length = sizeof(plaintext) - 1;
+
+std::vector<std::vector<std::uint8_t>> messages;
+for (unsigned i = 0; i < 50; ++i) {
+    messages.emplace_back(alice.encrypt_output_length(plaintext_length));
+    alice.encrypt(
+        plaintext, plaintext_length, NULL, 0,
+        messages.back().data(), messages.back().size()
+    );
+}
+std::vector<std::uint8_t> output(
+    bob.decrypt_max_plaintext_length(messages[0].data(), messages[0].size())
+);
+
+bob.work_budget = 10;
+assert_equals(std::size_t(-1), bob.decrypt(
+    messages[49].data(), messages[49].size(), output.data(), output.size()
+));
+assert_equals(OlmErrorCode::OLM_WORK_BUDGET_EXCEEDED, bob.last_error);
+assert_equals(std::uint32_t(0), bob.receiver_chains[0].chain_key.index);
+
+/* messages within the budget still decrypt, and move the chain along */
+assert_equals(plaintext_length, bob.decrypt(
+    messages[10].data(), messages[10].size(), output.data(), output.size()
+));
+assert_equals(plaintext_length, bob.decrypt(
+    messages[20].data(), messages[20].size(), output.data(), output.size()
+));
+/* skipped keys cost nothing */
+assert_equals(plaintext_length, bob.decrypt(
+    messages[0].data(), messages[0].size(), output.data(), output.size()
+));
+
+bob.work_budget = 0;
+assert_equals(plaintext_length, bob.decrypt(
+    messages[49].data(), messages[49].size(), output.data(), output.size()
+));
+
+} /* Work budget */
+
 }
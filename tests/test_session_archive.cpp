@@ -0,0 +1,336 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/inbound_group_session.h"
+#include "olm/outbound_group_session.h"
+#include "olm/session_archive.h"
+#include "unittest.hh"
+
+#include <cstring>
+#include <vector>
+
+int main() {
+
+const std::size_t SESSION_COUNT = 5;
+
+std::vector<std::vector<uint8_t>> inbound_memory;
+std::vector<OlmInboundGroupSession *> sessions;
+for (std::size_t i = 0; i < SESSION_COUNT; ++i) {
+    std::vector<uint8_t> outbound_memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *outbound = olm_outbound_group_session(
+        outbound_memory.data()
+    );
+    std::vector<uint8_t> random_bytes(
+        olm_init_outbound_group_session_random_length(outbound)
+    );
+    for (std::size_t j = 0; j < random_bytes.size(); ++j) {
+        random_bytes[j] = uint8_t(i * 31 + j);
+    }
+    olm_init_outbound_group_session(
+        outbound, random_bytes.data(), random_bytes.size()
+    );
+    std::vector<uint8_t> session_key(
+        olm_outbound_group_session_key_length(outbound)
+    );
+    olm_outbound_group_session_key(
+        outbound, session_key.data(), session_key.size()
+    );
+
+    inbound_memory.emplace_back(olm_inbound_group_session_size());
+    sessions.push_back(olm_inbound_group_session(inbound_memory.back().data()));
+    olm_init_inbound_group_session(
+        sessions.back(), session_key.data(), session_key.size()
+    );
+}
+
+/* sessions 0, 2 and 4 are in one room, 1 in another and 3 in none */
+uint8_t const room_1[] = "!room1:example.org";
+uint8_t const room_2[] = "!room2:example.org";
+std::vector<uint8_t const *> room_ids = {
+    room_1, room_2, room_1, nullptr, room_1
+};
+std::vector<std::size_t> room_id_lengths = {
+    sizeof(room_1) - 1, sizeof(room_2) - 1, sizeof(room_1) - 1, 0,
+    sizeof(room_1) - 1
+};
+
+{
+    TestCase test_case("Non-destructive inbound group session unpickle");
+
+    std::vector<uint8_t> key_memory(olm_pickle_key_size());
+    OlmPickleKey *pickle_key = olm_pickle_key_aes_gcm(
+        key_memory.data(), "secret_key", 10
+    );
+
+    std::size_t pickle_length =
+        olm_pickle_inbound_group_session_binary_with_key_length(
+            sessions[0], pickle_key
+        );
+    std::vector<uint8_t> pickle(pickle_length);
+    assert_equals(pickle_length, olm_pickle_inbound_group_session_binary_with_key(
+        sessions[0], pickle_key, pickle.data(), pickle.size()
+    ));
+    std::vector<uint8_t> const original(pickle);
+
+    std::vector<uint8_t> memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *session = olm_inbound_group_session(memory.data());
+    std::vector<uint8_t> scratch(pickle_length);
+    assert_equals((size_t)-1, olm_unpickle_inbound_group_session_binary_with_key(
+        session, pickle_key, pickle.data(), pickle.size(),
+        scratch.data(), scratch.size() - 1
+    ));
+    assert_equals(
+        std::string("OUTPUT_BUFFER_TOO_SMALL"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+    assert_equals(pickle_length, olm_unpickle_inbound_group_session_binary_with_key(
+        session, pickle_key, pickle.data(), pickle.size(),
+        scratch.data(), scratch.size()
+    ));
+
+    /* the pickle is left as it was, and the scratch space is cleared */
+    assert_equals(original.data(), pickle.data(), pickle_length);
+    std::vector<uint8_t> zeroes(pickle_length);
+    assert_equals(zeroes.data(), scratch.data(), pickle_length);
+
+    /* the pickle can be loaded again from the same buffer */
+    assert_equals(pickle_length, olm_unpickle_inbound_group_session_binary_with_key(
+        session, pickle_key, pickle.data(), pickle.size(),
+        scratch.data(), scratch.size()
+    ));
+    assert_equals(pickle_length, olm_pickle_inbound_group_session_binary_with_key(
+        session, pickle_key, pickle.data(), pickle.size()
+    ));
+    assert_equals(original.data(), pickle.data(), pickle_length);
+
+    /* so can a binary pickle written with the plain key */
+    pickle_length = olm_pickle_inbound_group_session_binary_length(sessions[0]);
+    pickle.resize(pickle_length);
+    scratch.resize(pickle_length);
+    olm_pickle_inbound_group_session_binary(
+        sessions[0], "secret_key", 10, pickle.data(), pickle.size()
+    );
+    assert_equals(pickle_length, olm_unpickle_inbound_group_session_binary_with_key(
+        session, pickle_key, pickle.data(), pickle.size(),
+        scratch.data(), scratch.size()
+    ));
+}
+
+for (int use_gcm = 0; use_gcm < 2; ++use_gcm) {
+    TestCase test_case(
+        use_gcm ? "Session archive with AES-GCM" : "Session archive"
+    );
+
+    std::vector<uint8_t> key_memory(olm_pickle_key_size());
+    OlmPickleKey *pickle_key = use_gcm
+        ? olm_pickle_key_aes_gcm(key_memory.data(), "secret_key", 10)
+        : olm_pickle_key(key_memory.data(), "secret_key", 10);
+
+    std::vector<uint8_t> archive_memory(olm_session_archive_size());
+    OlmSessionArchive *archive = olm_session_archive(archive_memory.data());
+
+    std::size_t archive_length = olm_session_archive_length(
+        sessions.data(), room_ids.data(), room_id_lengths.data(),
+        SESSION_COUNT, pickle_key
+    );
+    std::vector<uint8_t> data(archive_length);
+    assert_equals((size_t)-1, olm_write_session_archive(
+        archive, sessions.data(), room_ids.data(), room_id_lengths.data(),
+        SESSION_COUNT, pickle_key, data.data(), archive_length - 1
+    ));
+    assert_equals(
+        std::string("OUTPUT_BUFFER_TOO_SMALL"),
+        std::string(olm_session_archive_last_error(archive))
+    );
+    assert_equals(archive_length, olm_write_session_archive(
+        archive, sessions.data(), room_ids.data(), room_id_lengths.data(),
+        SESSION_COUNT, pickle_key, data.data(), data.size()
+    ));
+    std::vector<uint8_t> const original(data);
+
+    std::vector<uint8_t> archive_memory2(olm_session_archive_size());
+    OlmSessionArchive *archive2 = olm_session_archive(archive_memory2.data());
+    assert_equals(SESSION_COUNT, olm_open_session_archive(
+        archive2, data.data(), data.size()
+    ));
+    assert_equals(SESSION_COUNT, olm_session_archive_entry_count(archive2));
+
+    /* the entries are in order of session id */
+    std::vector<uint8_t> previous_id;
+    for (std::size_t entry = 0; entry < SESSION_COUNT; ++entry) {
+        std::vector<uint8_t> id(olm_inbound_group_session_id_length(sessions[0]));
+        assert_equals(id.size(), olm_session_archive_session_id(
+            archive2, entry, id.data(), id.size()
+        ));
+        assert_equals(true, previous_id < id);
+        previous_id = id;
+    }
+
+    for (std::size_t i = 0; i < SESSION_COUNT; ++i) {
+        std::vector<uint8_t> id(olm_inbound_group_session_id_length(sessions[i]));
+        olm_inbound_group_session_id(sessions[i], id.data(), id.size());
+        std::size_t entry = olm_session_archive_find(
+            archive2, id.data(), id.size()
+        );
+        assert_not_equals((size_t)-1, entry);
+
+        std::vector<uint8_t> room_id(32);
+        assert_equals(room_id_lengths[i], olm_session_archive_room_id(
+            archive2, entry, room_id.data(), room_id.size()
+        ));
+        if (room_ids[i]) {
+            assert_equals(room_ids[i], room_id.data(), room_id_lengths[i]);
+        }
+
+        std::vector<uint8_t> scratch(
+            olm_session_archive_scratch_length(archive2, entry)
+        );
+        std::vector<uint8_t> memory(olm_inbound_group_session_size());
+        OlmInboundGroupSession *session = olm_inbound_group_session(
+            memory.data()
+        );
+        assert_not_equals((size_t)-1, olm_session_archive_unpickle(
+            archive2, entry, session, pickle_key, scratch.data(), scratch.size()
+        ));
+
+        std::vector<uint8_t> pickle1(
+            olm_pickle_inbound_group_session_length(sessions[i])
+        );
+        std::vector<uint8_t> pickle2(pickle1.size());
+        olm_pickle_inbound_group_session(
+            sessions[i], "secret_key", 10, pickle1.data(), pickle1.size()
+        );
+        assert_equals(pickle2.size(), olm_pickle_inbound_group_session(
+            session, "secret_key", 10, pickle2.data(), pickle2.size()
+        ));
+        assert_equals(pickle1.data(), pickle2.data(), pickle1.size());
+    }
+
+    /* reading the archive never writes to it */
+    assert_equals(original.data(), data.data(), archive_length);
+
+    std::size_t entries[SESSION_COUNT];
+    assert_equals(std::size_t(3), olm_session_archive_find_room(
+        archive2, room_1, sizeof(room_1) - 1, entries, SESSION_COUNT
+    ));
+    for (std::size_t i = 0; i < 3; ++i) {
+        std::vector<uint8_t> room_id(32);
+        assert_equals(sizeof(room_1) - 1, olm_session_archive_room_id(
+            archive2, entries[i], room_id.data(), room_id.size()
+        ));
+        if (i > 0) {
+            assert_equals(true, entries[i - 1] < entries[i]);
+        }
+    }
+    assert_equals(std::size_t(1), olm_session_archive_find_room(
+        archive2, room_2, sizeof(room_2) - 1, entries, 0
+    ));
+    assert_equals(std::size_t(0), olm_session_archive_find_room(
+        archive2, room_1, 5, entries, SESSION_COUNT
+    ));
+
+    uint8_t unknown_id[] = "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
+    assert_equals((size_t)-1, olm_session_archive_find(
+        archive2, unknown_id, sizeof(unknown_id) - 1
+    ));
+    assert_equals(
+        std::string("UNKNOWN_SESSION_ID"),
+        std::string(olm_session_archive_last_error(archive2))
+    );
+
+    assert_equals((size_t)-1, olm_session_archive_scratch_length(
+        archive2, SESSION_COUNT
+    ));
+    assert_equals(
+        std::string("BAD_SESSION_ARCHIVE"),
+        std::string(olm_session_archive_last_error(archive2))
+    );
+
+    /* a wrong key is reported by the session */
+    std::vector<uint8_t> wrong_key_memory(olm_pickle_key_size());
+    OlmPickleKey *wrong_key = olm_pickle_key(
+        wrong_key_memory.data(), "secret_kez", 10
+    );
+    std::vector<uint8_t> scratch(olm_session_archive_scratch_length(archive2, 0));
+    std::vector<uint8_t> memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *session = olm_inbound_group_session(memory.data());
+    assert_equals((size_t)-1, olm_session_archive_unpickle(
+        archive2, 0, session, wrong_key, scratch.data(), scratch.size()
+    ));
+    assert_equals(
+        std::string("BAD_ACCOUNT_KEY"),
+        std::string(olm_inbound_group_session_last_error(session))
+    );
+
+    /* a truncated archive is rejected when opened, or when an entry that
+     * points past the end is used */
+    assert_equals((size_t)-1, olm_open_session_archive(
+        archive2, data.data(), 40
+    ));
+    assert_equals(
+        std::string("BAD_SESSION_ARCHIVE"),
+        std::string(olm_session_archive_last_error(archive2))
+    );
+    assert_equals(SESSION_COUNT, olm_open_session_archive(
+        archive2, data.data(), archive_length - 1
+    ));
+    bool failed = false;
+    for (std::size_t entry = 0; entry < SESSION_COUNT; ++entry) {
+        if (olm_session_archive_scratch_length(archive2, entry) == (size_t)-1) {
+            failed = true;
+        }
+    }
+    assert_equals(true, failed);
+}
+
+{
+    TestCase test_case("Session archive with a repeated session");
+
+    std::vector<uint8_t> key_memory(olm_pickle_key_size());
+    OlmPickleKey *pickle_key = olm_pickle_key(
+        key_memory.data(), "secret_key", 10
+    );
+    std::vector<uint8_t> archive_memory(olm_session_archive_size());
+    OlmSessionArchive *archive = olm_session_archive(archive_memory.data());
+
+    OlmInboundGroupSession * repeated[] = {
+        sessions[0], sessions[1], sessions[0]
+    };
+    std::vector<uint8_t> data(olm_session_archive_length(
+        repeated, nullptr, nullptr, 3, pickle_key
+    ));
+    assert_equals((size_t)-1, olm_write_session_archive(
+        archive, repeated, nullptr, nullptr, 3, pickle_key,
+        data.data(), data.size()
+    ));
+    assert_equals(
+        std::string("BAD_SESSION_ARCHIVE"),
+        std::string(olm_session_archive_last_error(archive))
+    );
+
+    /* an archive without tags finds no rooms */
+    std::size_t archive_length = olm_session_archive_length(
+        repeated, nullptr, nullptr, 2, pickle_key
+    );
+    assert_equals(archive_length, olm_write_session_archive(
+        archive, repeated, nullptr, nullptr, 2, pickle_key,
+        data.data(), data.size()
+    ));
+    std::size_t entries[1];
+    assert_equals(std::size_t(0), olm_session_archive_find_room(
+        archive, room_1, sizeof(room_1) - 1, entries, 1
+    ));
+}
+
+}
@@ -0,0 +1,124 @@
+/* Copyright 2020 The Matrix.org Foundation C.I.C.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/crypto.h"
+#include "olm/cpu.h"
+#include "olm/sha256_hw.h"
+
+extern "C" {
+#include "crypto-algorithms/sha256.h"
+}
+
+#include "unittest.hh"
+
+#include <cstring>
+
+namespace {
+
+void fill(std::uint8_t * buffer, std::size_t length, std::uint8_t seed) {
+    for (std::size_t i = 0; i < length; ++i) {
+        buffer[i] = std::uint8_t(seed + 17 * i + (i >> 5));
+    }
+}
+
+const std::uint32_t INITIAL_STATE[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+void check_backend(
+    _olm_sha256_blocks_function blocks_function
+) {
+    std::uint8_t data[64 * 9];
+    fill(data, sizeof(data), 5);
+    for (std::size_t blocks = 1; blocks <= 9; ++blocks) {
+        ::WORD expected[8];
+        std::uint32_t actual[8];
+        std::memcpy(expected, INITIAL_STATE, sizeof(expected));
+        std::memcpy(actual, INITIAL_STATE, sizeof(actual));
+        ::sha256_blocks_portable(expected, data, blocks);
+        blocks_function(actual, data, blocks);
+        assert_equals((std::uint8_t *)expected, (std::uint8_t *)actual, 32);
+    }
+}
+
+} // namespace
+
+int main() {
+
+{ /* SHA-256 FIPS 180-2 */
+
+TestCase test_case("SHA-256 FIPS 180-2");
+
+std::uint8_t const abc[] = "abc";
+std::uint8_t const abc_expected[32] = {
+    0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA,
+    0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+    0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C,
+    0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD
+};
+std::uint8_t actual[32];
+_olm_crypto_sha256(abc, 3, actual);
+assert_equals(abc_expected, actual, 32);
+
+std::uint8_t const two_block[] =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+std::uint8_t const two_block_expected[32] = {
+    0x24, 0x8D, 0x6A, 0x61, 0xD2, 0x06, 0x38, 0xB8,
+    0xE5, 0xC0, 0x26, 0x93, 0x0C, 0x3E, 0x60, 0x39,
+    0xA3, 0x3C, 0xE4, 0x59, 0x64, 0xFF, 0x21, 0x67,
+    0xF6, 0xEC, 0xED, 0xD4, 0x19, 0xDB, 0x06, 0xC1
+};
+_olm_crypto_sha256(two_block, sizeof(two_block) - 1, actual);
+assert_equals(two_block_expected, actual, 32);
+
+/* one million 'a's, fed in awkwardly sized pieces */
+std::uint8_t const million_expected[32] = {
+    0xCD, 0xC7, 0x6E, 0x5C, 0x99, 0x14, 0xFB, 0x92,
+    0x81, 0xA1, 0xC7, 0xE2, 0x84, 0xD7, 0x3E, 0x67,
+    0xF1, 0x80, 0x9A, 0x48, 0xA4, 0x97, 0x20, 0x0E,
+    0x04, 0x6D, 0x39, 0xCC, 0xC7, 0x11, 0x2C, 0xD0
+};
+std::uint8_t as[1000];
+std::memset(as, 'a', sizeof(as));
+::SHA256_CTX context;
+::sha256_init(&context);
+std::size_t remaining = 1000000;
+std::size_t chunk = 1;
+while (remaining) {
+    std::size_t length = chunk < remaining ? chunk : remaining;
+    ::sha256_update(&context, as, length);
+    remaining -= length;
+    chunk = chunk * 7 % 997 + 1;
+}
+::sha256_final(&context, actual);
+assert_equals(million_expected, actual, 32);
+
+} /* SHA-256 FIPS 180-2 */
+
+{ /* SHA-256 hardware backends */
+
+TestCase test_case("SHA-256 hardware backends");
+
+unsigned int features = _olm_cpu_features();
+if ((features & OLM_CPU_SHA) && (features & OLM_CPU_SSE41)) {
+    check_backend(_olm_sha256_blocks_shani);
+}
+if ((features & OLM_CPU_AVX2) && (features & OLM_CPU_BMI2)) {
+    check_backend(_olm_sha256_blocks_avx2);
+}
+
+} /* SHA-256 hardware backends */
+
+}